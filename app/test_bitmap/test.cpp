@@ -160,6 +160,136 @@ int test_conv_to_grayscale()
 	return 0;
 }
 
+int test_encode_yuyv_jpeg_widths()
+{
+	// Odd widths and widths of 4n+2 have YUYV rows not multiple of 8 bytes
+	const int widths[] = { 1, 5, 6, 333, 334, 336 };
+	const int height = 16;
+	for (int width : widths)
+	{
+		dseed::autoref<dseed::bitmaps::bitmap> rgb;
+		if (dseed::failed(dseed::bitmaps::create_bitmap(dseed::bitmaps::bitmaptype::bitmap2d, dseed::size3i(width, height, 1),
+			dseed::color::pixelformat::rgb8, nullptr, &rgb)))
+			return -1;
+
+		const size_t stride = dseed::color::calc_bitmap_stride(dseed::color::pixelformat::rgb8, width);
+		uint8_t* pixels;
+		rgb->lock((void**)&pixels);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				uint8_t* pixel = pixels + y * stride + x * 3;
+				pixel[0] = (uint8_t)(x * 255 / width);
+				pixel[1] = (uint8_t)(y * 255 / height);
+				pixel[2] = 128;
+			}
+		}
+		rgb->unlock();
+
+		dseed::autoref<dseed::bitmaps::bitmap> yuyv;
+		if (dseed::failed(dseed::bitmaps::reformat_bitmap(rgb, dseed::color::pixelformat::yuyv8, &yuyv)))
+			return -2;
+
+		dseed::autoref<dseed::blob> blob;
+		if (dseed::failed(dseed::create_empty_blob(1024 * 1024, &blob)))
+			return -3;
+
+		dseed::bitmaps::jpeg_encoder_options options(100);
+		dseed::bitmaps::bitmap* frame = yuyv;
+		size_t written;
+		if (dseed::failed(dseed::bitmaps::encode_bitmap_into(dseed::bitmaps::create_jpeg_bitmap_encoder, &options, &frame, 1, blob, &written)))
+			return -4;
+
+		dseed::autoref<dseed::io::stream> stream;
+		if (dseed::failed(dseed::io::create_fixed_memorystream(blob->ptr(), written, &stream)))
+			return -5;
+
+		dseed::autoref<dseed::bitmaps::bitmap_array> decoder;
+		dseed::autoref<dseed::bitmaps::bitmap> decoded, decodedRgb;
+		if (dseed::failed(dseed::bitmaps::create_jpeg_bitmap_decoder(stream, &decoder))
+			|| dseed::failed(decoder->at(0, &decoded))
+			|| dseed::failed(dseed::bitmaps::reformat_bitmap(decoded, dseed::color::pixelformat::rgb8, &decodedRgb)))
+			return -6;
+
+		uint8_t* decodedPixels;
+		rgb->lock((void**)&pixels);
+		decodedRgb->lock((void**)&decodedPixels);
+		size_t error = 0;
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width * 3; ++x)
+				error += abs(pixels[y * stride + x] - decodedPixels[y * stride + x]);
+		decodedRgb->unlock();
+		rgb->unlock();
+
+		// Sheared or repeated rows go far beyond chroma subsampling error
+		if (error / (width * height * 3) > 12)
+			return -7;
+	}
+
+	return 0;
+}
+
+int test_ktx2_array_round_trip()
+{
+	// Array layers keep their count on every mip level, unlike slices of volume texture
+	const int layers = 3;
+	dseed::autoref<dseed::bitmaps::bitmap> levels[3];
+	for (int level = 0; level < 3; ++level)
+	{
+		const int width = 4 >> level;
+		if (dseed::failed(dseed::bitmaps::create_bitmap(dseed::bitmaps::bitmaptype::bitmap3d, dseed::size3i(width, width, layers),
+			dseed::color::pixelformat::rgba8, nullptr, &levels[level])))
+			return -1;
+
+		uint8_t* pixels;
+		levels[level]->lock((void**)&pixels);
+		for (size_t i = 0; i < (size_t)width * width * layers * 4; ++i)
+			pixels[i] = (uint8_t)(i * 7 + level);
+		levels[level]->unlock();
+	}
+
+	dseed::bitmaps::ktx2_encoder_options options(dseed::bitmaps::ktx2_supercompression::none, -1, 0, true);
+	dseed::bitmaps::bitmap* frames[] = { levels[0], levels[1], levels[2] };
+
+	dseed::autoref<dseed::blob> encoded;
+	size_t encodedLength;
+	if (dseed::failed(dseed::create_empty_blob(64 * 1024, &encoded))
+		|| dseed::failed(dseed::bitmaps::encode_bitmap_into(dseed::bitmaps::create_ktx2_bitmap_encoder, &options, frames, 3, encoded, &encodedLength)))
+		return -2;
+
+	dseed::autoref<dseed::io::stream> stream;
+	dseed::autoref<dseed::bitmaps::bitmap_array> decoder;
+	if (dseed::failed(dseed::io::create_fixed_memorystream(encoded->ptr(), encodedLength, &stream))
+		|| dseed::failed(dseed::bitmaps::create_ktx2_bitmap_decoder(stream, &decoder))
+		|| decoder->size() != 3)
+		return -3;
+
+	dseed::autoref<dseed::bitmaps::bitmap> decoded[3];
+	for (int level = 0; level < 3; ++level)
+	{
+		if (dseed::failed(decoder->at(level, &decoded[level])))
+			return -4;
+
+		const auto size = decoded[level]->size();
+		if (decoded[level]->type() != dseed::bitmaps::bitmaptype::bitmap3d || size.width != (4 >> level) || size.depth != layers)
+			return -5;
+	}
+
+	// Decoded array is encoded again as same file
+	dseed::bitmaps::bitmap* decodedFrames[] = { decoded[0], decoded[1], decoded[2] };
+	dseed::autoref<dseed::blob> reencoded;
+	size_t reencodedLength;
+	if (dseed::failed(dseed::create_empty_blob(64 * 1024, &reencoded))
+		|| dseed::failed(dseed::bitmaps::encode_bitmap_into(dseed::bitmaps::create_ktx2_bitmap_encoder, &options, decodedFrames, 3, reencoded, &reencodedLength)))
+		return -6;
+
+	if (reencodedLength != encodedLength || memcmp(encoded->ptr(), reencoded->ptr(), encodedLength) != 0)
+		return -7;
+
+	return 0;
+}
+
 int main(int argc, char* argv[])
 {
 #if COMPILER_MSVC
@@ -168,5 +298,7 @@ int main(int argc, char* argv[])
 	
 	//return test_split_and_join_bitmap_pixel_element();
 	//return test_histogram_euqualization();
-	return test_conv_to_grayscale();
+	//return test_conv_to_grayscale();
+	//return test_encode_yuyv_jpeg_widths();
+	return test_ktx2_array_round_trip();
 }
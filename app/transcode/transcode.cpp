@@ -0,0 +1,696 @@
+#include <dseed.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Batch Transcoder
+//  : Files are read, decoded, transformed, encoded and written in a pipeline.
+//    Reading and writing run on their own threads, so I/O overlaps with codec work on workers.
+//  : At most in-flight count of files are held in memory at once.
+//  : Time of each stage is summed over threads and printed with throughput at the end,
+//    so this also works as a benchmark of libdseed codecs.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+
+enum class operation_type
+{
+	reformat,
+	resize,
+	scale,
+	filter,
+	flip,
+};
+
+struct operation
+{
+	operation_type type;
+	dseed::color::pixelformat format;
+	dseed::size2i size;
+	float scale;
+	dseed::bitmaps::resize method;
+	dseed::bitmaps::bitmap_filter_mask mask;
+	dseed::bitmaps::inplace_transform flip;
+};
+
+struct encoder_entry
+{
+	const char* name;
+	const char* extension;
+	dseed::error_t(*create)(dseed::io::stream*, const dseed::bitmaps::bitmap_encoder_options*, dseed::bitmaps::bitmap_encoder**);
+};
+
+static const encoder_entry g_encoders[] = {
+	{ "png", "png", dseed::bitmaps::create_png_bitmap_encoder },
+	{ "jpeg", "jpg", dseed::bitmaps::create_jpeg_bitmap_encoder },
+	{ "webp", "webp", dseed::bitmaps::create_webp_bitmap_encoder },
+	{ "gif", "gif", dseed::bitmaps::create_gif_bitmap_encoder },
+	{ "tiff", "tif", dseed::bitmaps::create_tiff_bitmap_encoder },
+	{ "dds", "dds", dseed::bitmaps::create_dds_bitmap_encoder },
+	{ "ktx2", "ktx2", dseed::bitmaps::create_ktx2_bitmap_encoder },
+	{ "qoi", "qoi", dseed::bitmaps::create_qoi_bitmap_encoder },
+	{ "bmp", "bmp", dseed::bitmaps::create_dib_bitmap_encoder },
+	{ "ico", "ico", dseed::bitmaps::create_ico_bitmap_encoder },
+};
+
+static const struct { const char* name; dseed::color::pixelformat format; } g_formats[] = {
+	{ "rgba8", dseed::color::pixelformat::rgba8 }, { "rgb8", dseed::color::pixelformat::rgb8 },
+	{ "bgra8", dseed::color::pixelformat::bgra8 }, { "bgr8", dseed::color::pixelformat::bgr8 },
+	{ "rgbaf", dseed::color::pixelformat::rgbaf }, { "bgra4", dseed::color::pixelformat::bgra4 },
+	{ "bgr565", dseed::color::pixelformat::bgr565 }, { "r8", dseed::color::pixelformat::r8 },
+	{ "yuv8", dseed::color::pixelformat::yuv8 }, { "yuva8", dseed::color::pixelformat::yuva8 },
+	{ "hsv8", dseed::color::pixelformat::hsv8 }, { "hsva8", dseed::color::pixelformat::hsva8 },
+	{ "bgra8_indexed8", dseed::color::pixelformat::bgra8_indexed8 }, { "bgr8_indexed8", dseed::color::pixelformat::bgr8_indexed8 },
+};
+
+static const struct { const char* name; dseed::bitmaps::resize method; } g_methods[] = {
+	{ "nearest", dseed::bitmaps::resize::nearest }, { "bilinear", dseed::bitmaps::resize::bilinear },
+	{ "bicubic", dseed::bitmaps::resize::bicubic }, { "lanczos", dseed::bitmaps::resize::lanczos },
+	{ "lanczos2", dseed::bitmaps::resize::lanczos2 }, { "lanczos3", dseed::bitmaps::resize::lanczos3 },
+	{ "lanczos4", dseed::bitmaps::resize::lanczos4 }, { "lanczos5", dseed::bitmaps::resize::lanczos5 },
+};
+
+enum stage
+{
+	stage_read,
+	stage_decode,
+	stage_transform,
+	stage_encode,
+	stage_write,
+	stage_count,
+};
+
+static const char* g_stageNames[stage_count] = { "read", "decode", "transform", "encode", "write" };
+
+struct options
+{
+	std::vector<std::string> inputs;
+	std::string output_dir = ".";
+	const encoder_entry* encoder = &g_encoders[0];
+	std::vector<operation> operations;
+	size_t threads = 0;
+	size_t in_flight = 0;
+	bool recursive = false;
+	bool all_frames = false;
+	bool dry_run = false;
+	bool quiet = false;
+};
+
+struct input_file
+{
+	std::filesystem::path path;
+	// Output path relative to output directory, without extension
+	std::filesystem::path relative;
+};
+
+struct job
+{
+	std::filesystem::path input;
+	std::filesystem::path output;
+	dseed::autoref<dseed::blob> source;
+	dseed::autoref<dseed::io::stream> encoded;
+	dseed::error_t error = dseed::error_good;
+	stage failed_stage = stage_read;
+	size_t pixels = 0;
+};
+
+// Blocking queue between stages; pop returns false after close and drain
+template<class T>
+class bounded_queue
+{
+public:
+	void push(T&& item)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_items.push_back(std::move(item));
+		}
+		_cv.notify_one();
+	}
+
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cv.wait(lock, [this] { return !_items.empty() || _closed; });
+		if (_items.empty())
+			return false;
+		item = std::move(_items.front());
+		_items.pop_front();
+		return true;
+	}
+
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_closed = true;
+		}
+		_cv.notify_all();
+	}
+
+private:
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	std::deque<T> _items;
+	bool _closed = false;
+};
+
+// Counts files held by pipeline; reader waits for a slot before reading next file
+class slot_counter
+{
+public:
+	slot_counter(size_t capacity) : _available(capacity) { }
+
+	void acquire()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cv.wait(lock, [this] { return _available > 0; });
+		--_available;
+	}
+
+	void release()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			++_available;
+		}
+		_cv.notify_one();
+	}
+
+private:
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	size_t _available;
+};
+
+struct statistics
+{
+	std::atomic<int64_t> ticks[stage_count] = {};
+	std::atomic<size_t> succeeded { 0 }, failed { 0 };
+	std::atomic<size_t> bytes_in { 0 }, bytes_out { 0 }, pixels { 0 };
+
+	void add(stage s, const dseed::timespan& begin) noexcept
+	{
+		ticks[s] += (dseed::timespan::current_ticks() - begin).ticks();
+	}
+};
+
+static bool parse_format(const char* name, dseed::color::pixelformat& format)
+{
+	for (auto& f : g_formats)
+		if (strcmp(f.name, name) == 0)
+		{
+			format = f.format;
+			return true;
+		}
+	return false;
+}
+
+static bool parse_method(const char* name, dseed::bitmaps::resize& method)
+{
+	for (auto& m : g_methods)
+		if (strcmp(m.name, name) == 0)
+		{
+			method = m.method;
+			return true;
+		}
+	return false;
+}
+
+// Parses "<type>:<arguments>" of -x option
+static bool parse_operation(const std::string& text, operation& op)
+{
+	const auto colon = text.find(':');
+	if (colon == std::string::npos)
+		return false;
+	const std::string type = text.substr(0, colon), args = text.substr(colon + 1);
+
+	op.method = dseed::bitmaps::resize::bilinear;
+	const auto methodColon = args.find(':');
+	const std::string value = args.substr(0, methodColon);
+	if (methodColon != std::string::npos && !parse_method(args.substr(methodColon + 1).c_str(), op.method))
+		return false;
+
+	if (type == "reformat")
+	{
+		op.type = operation_type::reformat;
+		return parse_format(value.c_str(), op.format);
+	}
+	else if (type == "resize")
+	{
+		op.type = operation_type::resize;
+		return sscanf(value.c_str(), "%dx%d", &op.size.width, &op.size.height) == 2
+			&& op.size.width >= 0 && op.size.height >= 0 && (op.size.width > 0 || op.size.height > 0);
+	}
+	else if (type == "scale")
+	{
+		op.type = operation_type::scale;
+		op.scale = (float)atof(value.c_str());
+		return op.scale > 0;
+	}
+	else if (type == "filter")
+	{
+		op.type = operation_type::filter;
+		if (value == "sharpen") dseed::bitmaps::bitmap_filter_mask::sharpen_3(&op.mask);
+		else if (value == "blur") dseed::bitmaps::bitmap_filter_mask::gaussian_blur_3(&op.mask);
+		else if (value == "blur5") dseed::bitmaps::bitmap_filter_mask::gaussian_blur_5(&op.mask);
+		else if (value == "unsharp") dseed::bitmaps::bitmap_filter_mask::unsharpmask_5(&op.mask);
+		else if (value == "edge") dseed::bitmaps::bitmap_filter_mask::edge_detection_3(&op.mask);
+		else return false;
+		return true;
+	}
+	else if (type == "flip")
+	{
+		op.type = operation_type::flip;
+		if (value == "h") op.flip = dseed::bitmaps::inplace_transform::flip_horizontal;
+		else if (value == "v") op.flip = dseed::bitmaps::inplace_transform::flip_vertical;
+		else return false;
+		return true;
+	}
+
+	return false;
+}
+
+static void print_usage()
+{
+	printf("usage: dseed_transcode [options] <file|directory|@list>...\n"
+		"  -o <dir>      output directory (default: .)\n"
+		"  -e <encoder>  png, jpeg, webp, gif, tiff, dds, ktx2, qoi, bmp, ico (default: png)\n"
+		"  -x <op>       operation, applied in given order:\n"
+		"                  reformat:<format>\n"
+		"                  resize:<width>x<height>[:<method>]  (0 keeps aspect ratio)\n"
+		"                  scale:<ratio>[:<method>]\n"
+		"                  filter:<sharpen|blur|blur5|unsharp|edge>\n"
+		"                  flip:<h|v>\n"
+		"  -j <count>    worker threads (default: hardware concurrency)\n"
+		"  -m <count>    maximum files in memory (default: twice of workers)\n"
+		"  -r            scan directories recursively\n"
+		"  -a            transcode every frame, not only first\n"
+		"  -n            do not write outputs\n"
+		"  -q            do not print each file\n");
+}
+
+static bool parse_options(int argc, char* argv[], options& opts)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "-o" && hasValue) opts.output_dir = argv[++i];
+		else if (arg == "-e" && hasValue)
+		{
+			const std::string name = argv[++i];
+			opts.encoder = nullptr;
+			for (auto& e : g_encoders)
+				if (name == e.name)
+					opts.encoder = &e;
+			if (opts.encoder == nullptr)
+			{
+				fprintf(stderr, "unknown encoder: %s\n", name.c_str());
+				return false;
+			}
+		}
+		else if (arg == "-x" && hasValue)
+		{
+			operation op = {};
+			if (!parse_operation(argv[++i], op))
+			{
+				fprintf(stderr, "invalid operation: %s\n", argv[i]);
+				return false;
+			}
+			opts.operations.push_back(op);
+		}
+		else if (arg == "-j" && hasValue) opts.threads = (size_t)atoi(argv[++i]);
+		else if (arg == "-m" && hasValue) opts.in_flight = (size_t)atoi(argv[++i]);
+		else if (arg == "-r") opts.recursive = true;
+		else if (arg == "-a") opts.all_frames = true;
+		else if (arg == "-n") opts.dry_run = true;
+		else if (arg == "-q") opts.quiet = true;
+		else if (arg.size() > 1 && arg[0] == '-')
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			return false;
+		}
+		else opts.inputs.push_back(arg);
+	}
+
+	if (opts.threads == 0)
+		opts.threads = dseed::maximum(1u, std::thread::hardware_concurrency());
+	if (opts.in_flight == 0)
+		opts.in_flight = opts.threads * 2;
+
+	return !opts.inputs.empty();
+}
+
+// Output keeps whole source file name(a.png -> a.png.webp), so sources differ only in extension do not collide
+//  : Files found in directory keep their sub-directory in output directory.
+static void collect_inputs(const options& opts, std::vector<input_file>& files)
+{
+	namespace fs = std::filesystem;
+	for (auto& input : opts.inputs)
+	{
+		std::error_code ec;
+		if (input[0] == '@')
+		{
+			std::ifstream list(input.substr(1));
+			std::string line;
+			while (std::getline(list, line))
+				if (!line.empty())
+					files.push_back({ line, fs::path(line).filename() });
+		}
+		else if (fs::is_directory(input, ec))
+		{
+			auto add = [&](const fs::directory_entry& entry)
+			{
+				if (entry.is_regular_file(ec))
+					files.push_back({ entry.path(), entry.path().lexically_relative(input) });
+			};
+			if (opts.recursive)
+			{
+				for (auto& entry : fs::recursive_directory_iterator(input, ec))
+					add(entry);
+			}
+			else
+			{
+				for (auto& entry : fs::directory_iterator(input, ec))
+					add(entry);
+			}
+		}
+		else files.push_back({ input, fs::path(input).filename() });
+	}
+}
+
+static dseed::error_t read_file(const std::filesystem::path& path, dseed::blob** blob)
+{
+	dseed::autoref<dseed::io::stream> stream;
+	if (auto err = dseed::io::create_native_filestream(path.string().c_str(), false, &stream); dseed::failed(err))
+		return err;
+
+	const size_t length = stream->length();
+	dseed::autoref<dseed::blob> temp;
+	if (auto err = dseed::create_empty_blob(length, &temp); dseed::failed(err))
+		return err;
+	if (stream->read(temp->ptr(), length) != length)
+		return dseed::error_io;
+
+	*blob = temp.detach();
+	return dseed::error_good;
+}
+
+static dseed::error_t apply_operation(const operation& op, dseed::bitmaps::bitmap* bitmap, dseed::bitmaps::bitmap** result)
+{
+	const auto size = bitmap->size();
+	switch (op.type)
+	{
+	case operation_type::reformat:
+		return dseed::bitmaps::reformat_bitmap(bitmap, op.format, result);
+
+	case operation_type::resize:
+	case operation_type::scale:
+		{
+			dseed::size3i target(op.size.width, op.size.height, size.depth);
+			if (op.type == operation_type::scale)
+			{
+				target.width = (int)(size.width * op.scale + 0.5f);
+				target.height = (int)(size.height * op.scale + 0.5f);
+			}
+			else if (target.width == 0)
+				target.width = (int)((int64_t)size.width * target.height / size.height);
+			else if (target.height == 0)
+				target.height = (int)((int64_t)size.height * target.width / size.width);
+			target.width = dseed::maximum(target.width, 1);
+			target.height = dseed::maximum(target.height, 1);
+			return dseed::bitmaps::resize_bitmap(bitmap, op.method, target, result);
+		}
+
+	case operation_type::filter:
+		return dseed::bitmaps::filter_bitmap(bitmap, op.mask, result);
+
+	case operation_type::flip:
+		if (auto err = dseed::bitmaps::transform_bitmap_inplace(bitmap, op.flip); dseed::failed(err))
+			return err;
+		*result = bitmap;
+		bitmap->retain();
+		return dseed::error_good;
+	}
+
+	return dseed::error_invalid_args;
+}
+
+// Encodes frame; formats that encoder does not take are converted to common ones and tried again
+static dseed::error_t encode_frame(dseed::bitmaps::bitmap_encoder* encoder, dseed::bitmaps::bitmap* bitmap)
+{
+	auto err = encoder->encode_frame(bitmap);
+	if (err != dseed::error_not_support)
+		return err;
+
+	// Lossless conversions are tried before quantizing into palette
+	for (auto format : { dseed::color::pixelformat::rgba8, dseed::color::pixelformat::bgra8, dseed::color::pixelformat::rgb8,
+		dseed::color::pixelformat::bgr8, dseed::color::pixelformat::bgra8_indexed8 })
+	{
+		if (format == bitmap->format())
+			continue;
+		dseed::autoref<dseed::bitmaps::bitmap> converted;
+		if (dseed::failed(dseed::bitmaps::reformat_bitmap(bitmap, format, &converted)))
+			continue;
+		if ((err = encoder->encode_frame(converted)) != dseed::error_not_support)
+			return err;
+	}
+	return err;
+}
+
+// Decode, transform and encode stages of one file
+static void process(job& j, const options& opts, statistics& stats)
+{
+	auto fail = [&](stage s, dseed::error_t err) { j.failed_stage = s; j.error = err; };
+
+	auto begin = dseed::timespan::current_ticks();
+	dseed::autoref<dseed::io::stream> input;
+	dseed::autoref<dseed::bitmaps::bitmap_array> decoder;
+	if (auto err = dseed::io::create_blob_memorystream(j.source, &input); dseed::failed(err))
+		return fail(stage_decode, err);
+	if (auto err = dseed::bitmaps::detect_bitmap_decoder(input, &decoder); dseed::failed(err))
+		return fail(stage_decode, err);
+
+	const size_t frames = opts.all_frames ? decoder->size() : dseed::minimum<size_t>(decoder->size(), 1);
+	std::vector<dseed::autoref<dseed::bitmaps::bitmap>> bitmaps(frames);
+	for (size_t i = 0; i < frames; ++i)
+		if (auto err = decoder->at(i, &bitmaps[i]); dseed::failed(err))
+			return fail(stage_decode, err);
+	stats.add(stage_decode, begin);
+
+	begin = dseed::timespan::current_ticks();
+	for (auto& bitmap : bitmaps)
+	{
+		for (auto& op : opts.operations)
+		{
+			dseed::autoref<dseed::bitmaps::bitmap> result;
+			auto err = apply_operation(op, bitmap, &result);
+			// Operations on block compressed or packed formats are done after decompressing
+			if (err == dseed::error_not_support && bitmap->format() != dseed::color::pixelformat::rgba8)
+			{
+				dseed::autoref<dseed::bitmaps::bitmap> converted;
+				if (dseed::succeeded(err = dseed::bitmaps::reformat_bitmap(bitmap, dseed::color::pixelformat::rgba8, &converted)))
+					err = apply_operation(op, converted, &result);
+			}
+			if (dseed::failed(err))
+				return fail(stage_transform, err);
+			bitmap = result;
+		}
+		const auto size = bitmap->size();
+		j.pixels += (size_t)size.width * size.height * size.depth;
+	}
+	stats.add(stage_transform, begin);
+
+	begin = dseed::timespan::current_ticks();
+	dseed::autoref<dseed::bitmaps::bitmap_encoder> encoder;
+	if (auto err = dseed::io::create_variable_memorystream(&j.encoded); dseed::failed(err))
+		return fail(stage_encode, err);
+	if (auto err = opts.encoder->create(j.encoded, nullptr, &encoder); dseed::failed(err))
+		return fail(stage_encode, err);
+	for (auto& bitmap : bitmaps)
+		if (auto err = encode_frame(encoder, bitmap); dseed::failed(err))
+			return fail(stage_encode, err);
+	if (auto err = encoder->commit(); dseed::failed(err))
+		return fail(stage_encode, err);
+	stats.add(stage_encode, begin);
+
+	// Source is not needed anymore, so memory of file is released before waiting for writer
+	j.source = nullptr;
+}
+
+static dseed::error_t write_file(job& j)
+{
+	const size_t length = j.encoded->length();
+	std::vector<uint8_t> buffer(dseed::minimum<size_t>(length, 1024 * 1024));
+
+	std::error_code ec;
+	std::filesystem::create_directories(j.output.parent_path(), ec);
+
+	dseed::autoref<dseed::io::stream> output;
+	if (auto err = dseed::io::create_native_filestream(j.output.string().c_str(), true, &output); dseed::failed(err))
+		return err;
+	if (auto err = output->set_length(length); dseed::failed(err))
+		return err;
+
+	j.encoded->seek(dseed::io::seekorigin::begin, 0);
+	for (size_t written = 0; written < length; )
+	{
+		const size_t read = j.encoded->read(buffer.data(), dseed::minimum(buffer.size(), length - written));
+		if (read == 0 || output->write(buffer.data(), read) != read)
+			return dseed::error_io;
+		written += read;
+	}
+	output->flush();
+	return dseed::error_good;
+}
+
+static void print_statistics(const statistics& stats, const options& opts, const dseed::timespan& elapsed)
+{
+	const double seconds = dseed::maximum(elapsed.total_seconds(), 1e-9);
+	const size_t files = stats.succeeded + stats.failed;
+	printf("\n%zu files (%zu failed), %zu workers, %zu in flight, %.3f s\n",
+		files, (size_t)stats.failed, opts.threads, opts.in_flight, seconds);
+	printf("%-10s %12s %12s %8s\n", "stage", "total(ms)", "per file(ms)", "share");
+
+	int64_t sum = 0;
+	for (auto& t : stats.ticks)
+		sum += t;
+	for (int s = 0; s < stage_count; ++s)
+	{
+		// total_milliseconds is clamped to about 214 s, stage totals of a batch are longer
+		const double ms = dseed::timespan(stats.ticks[s]).total_seconds() * 1000.0;
+		printf("%-10s %12.2f %12.3f %7.1f%%\n", g_stageNames[s], ms, files > 0 ? ms / files : 0.0,
+			sum > 0 ? stats.ticks[s] * 100.0 / sum : 0.0);
+	}
+
+	printf("throughput: %.2f files/s, %.2f MB/s in, %.2f MB/s out, %.2f Mpixels/s\n",
+		files / seconds, stats.bytes_in / seconds / (1024 * 1024), stats.bytes_out / seconds / (1024 * 1024),
+		stats.pixels / seconds / 1000000);
+}
+
+int main(int argc, char* argv[])
+{
+	options opts;
+	if (!parse_options(argc, argv, opts))
+	{
+		print_usage();
+		return -1;
+	}
+
+	std::vector<input_file> files;
+	collect_inputs(opts, files);
+	if (files.empty())
+	{
+		fprintf(stderr, "no input files\n");
+		return -1;
+	}
+
+	statistics stats;
+	slot_counter slots(opts.in_flight);
+	bounded_queue<job*> decodeQueue, writeQueue;
+	const auto started = dseed::timespan::current_ticks();
+
+	// Reader
+	std::thread reader([&]()
+	{
+		for (auto& file : files)
+		{
+			slots.acquire();
+
+			auto j = new job();
+			j->input = file.path;
+			j->output = std::filesystem::path(opts.output_dir) / file.relative;
+			j->output += std::string(".") + opts.encoder->extension;
+
+			const auto begin = dseed::timespan::current_ticks();
+			if (auto err = read_file(file.path, &j->source); dseed::failed(err))
+			{
+				j->error = err;
+				j->failed_stage = stage_read;
+			}
+			else stats.bytes_in += j->source->size();
+			stats.add(stage_read, begin);
+
+			if (dseed::failed(j->error)) writeQueue.push(std::move(j));
+			else decodeQueue.push(std::move(j));
+		}
+		decodeQueue.close();
+	});
+
+	// Workers
+	std::vector<std::thread> workers;
+	std::atomic<size_t> runningWorkers(opts.threads);
+	for (size_t t = 0; t < opts.threads; ++t)
+	{
+		workers.emplace_back([&]()
+		{
+			job* j;
+			while (decodeQueue.pop(j))
+			{
+				process(*j, opts, stats);
+				writeQueue.push(std::move(j));
+			}
+			if (--runningWorkers == 0)
+				writeQueue.close();
+		});
+	}
+
+	// Writer
+	std::thread writer([&]()
+	{
+		job* j;
+		while (writeQueue.pop(j))
+		{
+			if (dseed::succeeded(j->error))
+			{
+				const auto begin = dseed::timespan::current_ticks();
+				if (!opts.dry_run)
+				{
+					if (auto err = write_file(*j); dseed::failed(err))
+					{
+						j->error = err;
+						j->failed_stage = stage_write;
+					}
+				}
+				stats.add(stage_write, begin);
+			}
+
+			if (dseed::succeeded(j->error))
+			{
+				++stats.succeeded;
+				stats.bytes_out += j->encoded->length();
+				stats.pixels += j->pixels;
+				if (!opts.quiet)
+					printf("%s -> %s\n", j->input.string().c_str(), j->output.string().c_str());
+			}
+			else
+			{
+				++stats.failed;
+				fprintf(stderr, "%s: %s failed (error %d)\n", j->input.string().c_str(), g_stageNames[j->failed_stage], (int)j->error);
+			}
+
+			delete j;
+			slots.release();
+		}
+	});
+
+	reader.join();
+	for (auto& worker : workers)
+		worker.join();
+	writer.join();
+
+	print_statistics(stats, opts, dseed::timespan::current_ticks() - started);
+	return stats.failed > 0 ? 1 : 0;
+}
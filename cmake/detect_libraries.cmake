@@ -153,6 +153,39 @@ IF(${DSEED_USE_LIBRAW})
 	ENDIF()
 ENDIF()
 
+# zlib
+IF(${DSEED_USE_ZLIB})
+	FIND_PACKAGE(ZLIB QUIET)
+	IF(NOT ZLIB_FOUND)
+		SET(DSEED_USE_ZLIB OFF)
+		MESSAGE(STATUS "[dseed] # Not found zlib")
+	ENDIF()
+
+	IF(${DSEED_USE_ZLIB})
+		MESSAGE(STATUS "[dseed] # Use zlib")
+		LIST(APPEND DSEED_INCLUDE_DIRS ${ZLIB_INCLUDE_DIRS})
+		LIST(APPEND DSEED_LINK_LIBS ${ZLIB_LIBRARY})
+		LIST(APPEND DSEED_DEFINITIONS -DUSE_ZLIB)
+	ENDIF()
+ENDIF()
+
+# zstd
+IF(${DSEED_USE_ZSTD})
+	FIND_PATH(ZSTD_INCLUDE_DIR zstd.h)
+	FIND_LIBRARY(ZSTD_LIBRARY NAMES zstd zstd_static)
+	IF(NOT ZSTD_INCLUDE_DIR OR NOT ZSTD_LIBRARY)
+		SET(DSEED_USE_ZSTD OFF)
+		MESSAGE(STATUS "[dseed] # Not found zstd")
+	ENDIF()
+
+	IF(${DSEED_USE_ZSTD})
+		MESSAGE(STATUS "[dseed] # Use zstd")
+		LIST(APPEND DSEED_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
+		LIST(APPEND DSEED_LINK_LIBS ${ZSTD_LIBRARY})
+		LIST(APPEND DSEED_DEFINITIONS -DUSE_ZSTD)
+	ENDIF()
+ENDIF()
+
 # Windows Imaging Codecs
 IF(${DSEED_USE_WINDOWS_IMAGING_CODECS})
 	IF(NOT (PLATFORM_WINDOWS OR PLATFORM_UWP))
@@ -64,6 +64,9 @@ namespace dseed::bitmaps
 
 	DSEEDEXP error_t create_bitmap(const void* pixels, bitmaptype type, const size3i& size, color::pixelformat format, palette* palette, bitmap** bitmap) noexcept;
 	DSEEDEXP error_t create_bitmap(bitmaptype type, const size3i& size, color::pixelformat format, palette* palette, bitmap** bitmap) noexcept;
+	// Bitmap referencing pixels in blob from offset without copy
+	//  : Blob is retained while bitmap is alive.
+	DSEEDEXP error_t create_bitmap(dseed::blob* blob, size_t offset, bitmaptype type, const size3i& size, color::pixelformat format, palette* palette, bitmap** bitmap) noexcept;
 
 	enum class arraytype
 	{
@@ -98,12 +101,30 @@ namespace dseed::bitmaps
 		return create_bitmap_array(type, bitmaps.size(), reinterpret_cast<bitmap**>(bitmaps.data()), arr);
 	}
 
+	// Frame Loader for Lazy Bitmap Array
+	//  : Called on first access of frame, or again after frame is evicted from cache.
+	//  : Calls are serialized by array, loader can keep stream and decoder state.
+	class DSEEDEXP bitmap_frame_loader : public object
+	{
+	public:
+		virtual error_t load(size_t index, bitmap** bitmap) noexcept = 0;
+	};
+
+	// Lazy Bitmap Array Creation
+	//  : Frames are decoded by loader on demand.
+	//  : Least recently used frame is evicted when more than cacheSize frames are decoded.
+	DSEEDEXP error_t create_lazy_bitmap_array(arraytype type, size_t size, bitmap_frame_loader* loader, size_t cacheSize, bitmap_array** arr) noexcept;
+
 	enum
 	{
 		bitmap_encoder_options_for_png,
 		bitmap_encoder_options_for_jpeg,
 		bitmap_encoder_options_for_webp,
 		bitmap_encoder_options_for_wic,
+		bitmap_encoder_options_for_gif,
+		bitmap_encoder_options_for_tiff,
+		bitmap_encoder_options_for_ktx2,
+		bitmap_encoder_options_for_dds,
 	};
 
 	struct DSEEDEXP bitmap_encoder_options
@@ -174,8 +195,84 @@ namespace dseed::bitmaps
 	//  : RGBA, RGB, BGRA, BGR, Grayscale, YCbCr(YUV), Palette color, Chroma Subsampled YCbCr formats(YCbCr 4:2:2 aka YUYV, YCbCr 4:2:0 aka NV12)
 	//    can be converted to each other.
 	//  : Compressed color formats can be converted from/to RGBA only. (BC6H, BC7, ETC2, PVRTC, ASTC not implemented now)
+	//  : Palette color is made by quantize_bitmap with default options.
 	DSEEDEXP error_t reformat_bitmap(bitmap* original, dseed::color::pixelformat reformat, bitmap** bitmap);
 
+	// Palette building methods
+	enum class quantize_method
+	{
+		// Median cut; fastest
+		median_cut,
+		// Median cut refined by k-means iterations
+		kmeans,
+		// Exoquant high quality; slowest
+		exoquant,
+	};
+
+	// Dithering methods for mapping to palette
+	enum class dither_method
+	{
+		none,
+		// 8x8 Bayer matrix; rows are mapped in parallel, and static areas stay stable across frames
+		ordered,
+		floyd_steinberg,
+	};
+
+	// Palette Quantization Options
+	//  : Colors is palette size, 2~256.
+	//  : If sample_limit is not 0, at most sample_limit pixels picked evenly from each feed are used to build palette.
+	//  : If alpha is false, alpha of pixels is ignored and palette is opaque.
+	//  : K-means and mapping run on worker threads; 0 threads means hardware concurrency.
+	//    Quantizers driven from worker threads of caller should use 1 thread.
+	struct DSEEDEXP quantize_options
+	{
+		quantize_method method;
+		dither_method dither;
+		int colors;
+		size_t sample_limit;
+		bool alpha;
+		int threads;
+		quantize_options(quantize_method method = quantize_method::kmeans, dither_method dither = dither_method::floyd_steinberg,
+			int colors = 256, size_t sample_limit = 65536, bool alpha = true, int threads = 0) noexcept
+			: method(method), dither(dither), colors(colors), sample_limit(sample_limit), alpha(alpha), threads(threads)
+		{ }
+	};
+
+	// Palette Quantizer
+	//  : Palette is built once from fed pixels(or set directly), and reused to map any number of bitmaps(frames).
+	//  : Nearest palette entry of opaque colors is cached in 3D lookup table while palette is kept,
+	//    so later mappings with same palette are cheaper.
+	//  : Mapping is thread safe, feeding and building are not.
+	class DSEEDEXP bitmap_quantizer : public object
+	{
+	public:
+		// Adds pixels(RGBA order) to palette building
+		virtual error_t feed_pixels(const color::rgba8* pixels, size_t count) noexcept = 0;
+		// Adds pixels of bitmap to palette building
+		virtual error_t feed(bitmap* bitmap) noexcept = 0;
+		// Builds palette from fed pixels; fed pixels are released
+		virtual error_t build() noexcept = 0;
+		// Uses given palette instead of building
+		virtual error_t set_palette(const color::rgba8* palette, size_t count) noexcept = 0;
+
+	public:
+		virtual size_t palette_size() noexcept = 0;
+		virtual error_t copy_palette(color::rgba8* palette) noexcept = 0;
+
+	public:
+		// Maps pixels(RGBA order) to palette indices
+		//  : Stride is bytes between index rows, 0 means tightly packed.
+		virtual error_t map_pixels(const color::rgba8* pixels, const size2i& size, uint8_t* indices, size_t stride) noexcept = 0;
+		// Maps bitmap to indexed bitmap(BGRA8 Indexed, BGR8 Indexed)
+		virtual error_t map(bitmap* original, color::pixelformat format, bitmap** bitmap) noexcept = 0;
+	};
+
+	DSEEDEXP error_t create_bitmap_quantizer(const quantize_options& options, bitmap_quantizer** quantizer) noexcept;
+
+	// Bitmap Palette Quantization
+	//  : Builds palette from bitmap and maps it to indexed bitmap(BGRA8 Indexed, BGR8 Indexed).
+	DSEEDEXP error_t quantize_bitmap(bitmap* original, const quantize_options& options, color::pixelformat format, bitmap** bitmap);
+
 	// Resize methods
 	enum class resize
 	{
@@ -248,6 +345,63 @@ namespace dseed::bitmaps
 	//  : RGBA, RGB, BGRA, BGR, Grayscale, YCbCr(YUV, 4:4:4) only support.
 	DSEEDEXP error_t flip_vertical_bitmap(bitmap* original, bitmap** bitmap);
 
+	// Rotation angles (Clockwise)
+	enum class rotation
+	{
+		rotate90,
+		rotate180,
+		rotate270,
+	};
+
+	// Bitmap Rotation
+	//  : RGBA, RGB, RGBAF, BGRA, BGR, BGRA4, BGR565, Grayscale, YCbCr(YUV, 4:4:4), HSV only support.
+	DSEEDEXP error_t rotate_bitmap(bitmap* original, rotation rotation, bitmap** bitmap);
+	// Bitmap Transpose (Swap X and Y axis)
+	//  : RGBA, RGB, RGBAF, BGRA, BGR, BGRA4, BGR565, Grayscale, YCbCr(YUV, 4:4:4), HSV only support.
+	DSEEDEXP error_t transpose_bitmap(bitmap* original, bitmap** bitmap);
+
+	// In-place transforms that keep the bitmap size
+	enum class inplace_transform
+	{
+		rotate180,
+		flip_horizontal,
+		flip_vertical,
+	};
+
+	// Bitmap In-place Transform
+	//  : Transforms pixels of bitmap itself without allocating new bitmap.
+	//  : RGBA, RGB, RGBAF, BGRA, BGR, BGRA4, BGR565, Grayscale, YCbCr(YUV, 4:4:4), HSV only support.
+	DSEEDEXP error_t transform_bitmap_inplace(bitmap* bitmap, inplace_transform transform);
+
+	// Edge handling for coordinates out of bitmap
+	enum class edgemode
+	{
+		// Fill with border color
+		constant,
+		// Repeat edge pixels
+		clamp,
+		// Repeat whole bitmap
+		wrap,
+		// Repeat whole bitmap with mirroring
+		mirror,
+	};
+
+	// Bitmap Affine Warp
+	//  : matrix maps source coordinates to destination coordinates as (x, y, 0, 1) * matrix.
+	//    (m11, m12, m21, m22, m41, m42 are used)
+	//  : Nearest, Bilinear, Bicubic only support.
+	//  : border is normalized color for constant edge mode.
+	//  : RGBA, RGB, RGBAF, BGRA, BGR, Grayscale, GrayscaleF, YCbCr(YUV, 4:4:4), HSV only support.
+	DSEEDEXP error_t warp_affine_bitmap(bitmap* original, const f32x4x4_t& matrix, resize interpolation, edgemode edge,
+		const size2i& size, bitmap** bitmap, const color::colorv& border = color::colorv());
+	// Bitmap Perspective Warp
+	//  : matrix maps source coordinates to destination coordinates as (x, y, 0, 1) * matrix = (x', y', z', w'),
+	//    destination coordinates are (x' / w', y' / w'). (m14, m24, m44 are used as perspective terms)
+	//  : Nearest, Bilinear, Bicubic only support.
+	//  : RGBA, RGB, RGBAF, BGRA, BGR, Grayscale, GrayscaleF, YCbCr(YUV, 4:4:4), HSV only support.
+	DSEEDEXP error_t warp_perspective_bitmap(bitmap* original, const f32x4x4_t& matrix, resize interpolation, edgemode edge,
+		const size2i& size, bitmap** bitmap, const color::colorv& border = color::colorv());
+
 	enum class histogram_color
 	{
 		first,
@@ -286,16 +440,82 @@ namespace dseed::bitmaps
 
 	// Bitmap Binary Operation
 	//  : RGBA, RGB, BGRA, BGR, Grayscale, YCbCr(YUV, 4:4:4) only support.
-	DSEEDEXP error_t bitmap_binary_operation(bitmap* b1, bitmap* b2, binary_operator op, bitmap** bitmap);
+	//  : If saturate is true, results are clamped to element range instead of wrapping around.
+	//    (BGRA4, BGR565 not support saturate)
+	DSEEDEXP error_t bitmap_binary_operation(bitmap* b1, bitmap* b2, binary_operator op, bitmap** bitmap, bool saturate = false);
 	// Bitmap Unary Operation
 	//  : RGBA, RGB, BGRA, BGR, Grayscale, YCbCr(YUV, 4:4:4) only support.
-	DSEEDEXP error_t bitmap_unary_operation(bitmap* b, unary_operator op, bitmap** bitmap);
+	//  : If saturate is true, results are clamped to element range instead of wrapping around.
+	//    (BGRA4, BGR565 not support saturate)
+	DSEEDEXP error_t bitmap_unary_operation(bitmap* b, unary_operator op, bitmap** bitmap, bool saturate = false);
+
+	// Bitmap Expression Node Index
+	using expression_node = int32_t;
+
+	// Lazy Bitmap Expression
+	//  : Records Binary/Unary/Apply Histogram operations as node graph,
+	//    and evaluates whole graph in one tiled pass without intermediate bitmaps.
+	//  : All sources must have same type, size and format.
+	//  : RGBA, RGB, RGBAF, BGRA, BGR, Grayscale, YCbCr(YUV, 4:4:4), HSV only support.
+	class DSEEDEXP bitmap_expression : public object
+	{
+	public:
+		virtual error_t source(bitmap* bitmap, expression_node* node) noexcept = 0;
+		virtual error_t binary_operation(expression_node n1, expression_node n2, binary_operator op, expression_node* node) noexcept = 0;
+		virtual error_t unary_operation(expression_node n, unary_operator op, expression_node* node) noexcept = 0;
+		virtual error_t apply_histogram(expression_node n, histogram_color color, const histogram* histogram, expression_node* node) noexcept = 0;
+
+	public:
+		virtual error_t evaluate(expression_node root, bitmap** bitmap) noexcept = 0;
+	};
+
+	DSEEDEXP error_t create_bitmap_expression(bitmap_expression** expression) noexcept;
 }
 
 namespace dseed::bitmaps
 {
 	DSEEDEXP error_t bitmap_split_rgb_elements(bitmap* original, bitmap** r, bitmap** g, bitmap** b, bitmap** a);
 	DSEEDEXP error_t bitmap_join_rgb_elements(bitmap* r, bitmap* g, bitmap* b, bitmap* a, bitmap** rgba);
+
+	// Planar Bitmap
+	//  : Keeps every element of pixels as separated plane in one allocation.
+	//  : Planes are stored in element order, and each plane has same layout as R8 or RF bitmap.
+	class DSEEDEXP planar_bitmap : public object
+	{
+	public:
+		virtual bitmaptype type() noexcept = 0;
+		virtual size3i size() noexcept = 0;
+		// Interleaved pixel format of planes
+		virtual color::pixelformat format() noexcept = 0;
+		// Pixel format of each plane (R8 or RF)
+		virtual color::pixelformat plane_format() noexcept = 0;
+		virtual size_t planes() noexcept = 0;
+		// Bytes of each plane
+		virtual size_t plane_size() noexcept = 0;
+
+	public:
+		virtual error_t lock(void** ptr) noexcept = 0;
+		virtual error_t unlock() noexcept = 0;
+
+	public:
+		// Copy one plane to new bitmap
+		virtual error_t plane(size_t index, bitmap** bitmap) noexcept = 0;
+	};
+
+	// Planar Bitmap Creation
+	//  : RGBA, RGB, RGBAF, BGRA, BGR, Grayscale, GrayscaleF, YCbCr(YUV, 4:4:4), HSV only support.
+	DSEEDEXP error_t create_planar_bitmap(bitmaptype type, const size3i& size, color::pixelformat format, planar_bitmap** bitmap) noexcept;
+
+	// Split interleaved bitmap to planar bitmap
+	DSEEDEXP error_t bitmap_split_planar(bitmap* original, planar_bitmap** planar);
+	// Split interleaved bitmap to existing planar bitmap without allocation
+	//  : Type, size and format must be same.
+	DSEEDEXP error_t bitmap_split_planar_into(bitmap* original, planar_bitmap* planar);
+	// Join planar bitmap to interleaved bitmap
+	DSEEDEXP error_t bitmap_join_planar(planar_bitmap* planar, bitmap** bitmap);
+	// Join planar bitmap to existing interleaved bitmap without allocation
+	//  : Type, size and format must be same.
+	DSEEDEXP error_t bitmap_join_planar_into(planar_bitmap* planar, bitmap* bitmap);
 }
 
 #include "decoders.h"
@@ -306,9 +526,22 @@ namespace dseed::bitmaps
 	// Decoder Creation Function Prototype
 	using createbitmapdecoder_fn = error_t(*) (dseed::io::stream*, dseed::bitmaps::bitmap_array**);
 	// Add Bitmap Decoder to Detection Queue
-	DSEEDEXP error_t add_bitmap_decoder(createbitmapdecoder_fn fn);
+	//  : Prober is optional, decoder without prober is skipped in detect_bitmap_info.
+	//  : Decoder with signatures is tried only if one of them matches head of stream,
+	//    decoder without signature is tried after every matched decoder failed.
+	//  : Decode-into function is optional, decoder without it is skipped in decode_bitmap_into.
+	DSEEDEXP error_t add_bitmap_decoder(createbitmapdecoder_fn fn, decoder_prober_func probe = nullptr,
+		const dseed::io::stream_signature* signatures = nullptr, size_t signatureCount = 0, decoder_into_func into = nullptr);
 	// Detect Bitmap Decoder from Stream
 	DSEEDEXP error_t detect_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder);
+	// Detect Bitmap Information from Stream without Decoding
+	DSEEDEXP error_t detect_bitmap_info(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info);
+	// Decode First Frame into Caller Memory without Intermediate Copy
+	//  : Stride 0 means tightly packed rows; layout is same as detect_bitmap_info reports.
+	DSEEDEXP error_t decode_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr);
+	// Decode First Frame into Existing Bitmap
+	//  : Destination must have same size and format as detect_bitmap_info reports.
+	DSEEDEXP error_t decode_bitmap_into(dseed::io::stream* stream, dseed::bitmaps::bitmap* destination);
 }
 
 #endif
\ No newline at end of file
@@ -5,6 +5,124 @@ namespace dseed::bitmaps
 {
 	using decoder_creator_func = error_t(*)(dseed::io::stream*, dseed::bitmaps::bitmap_array**);
 
+	// Image information from header only
+	//  : Format is same as decoded bitmap format.
+	struct bitmap_info
+	{
+		bitmaptype type;
+		size3i size;
+		color::pixelformat format;
+		arraytype frametype;
+		size_t frames;
+
+		bitmap_info() noexcept
+			: type(bitmaptype::bitmap2d), size(0, 0, 0), format(color::pixelformat::unknown)
+			, frametype(arraytype::plain), frames(0)
+		{ }
+		bitmap_info(bitmaptype type, const size3i& size, color::pixelformat format,
+			arraytype frametype = arraytype::plain, size_t frames = 1) noexcept
+			: type(type), size(size), format(format), frametype(frametype), frames(frames)
+		{ }
+	};
+
+	// Prober Function Prototype
+	//  : Reads headers only, pixel data is not decoded.
+	using decoder_prober_func = error_t(*)(dseed::io::stream*, dseed::bitmaps::bitmap_info*);
+
+	// Decode-into Function Prototype
+	//  : Decodes first frame straight into caller memory(locked bitmap, mapped staging buffer),
+	//    no intermediate buffer is allocated. Layout follows bitmap_info reported by prober.
+	//  : Stride is bytes between rows(block rows for compressed formats), 0 means tightly packed.
+	//  : Info is optional, filled with decoded layout.
+	using decoder_into_func = error_t(*)(dseed::io::stream*, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info);
+
+	// Row Sink for Streaming Decoder
+	//  : begin is called when header is parsed, row is called once per final row in top-down order.
+	//  : Failure from sink stops decoding, and is returned from push.
+	class DSEEDEXP bitmap_row_sink : public object
+	{
+	public:
+		virtual error_t begin(const bitmap_info& info) noexcept = 0;
+		virtual error_t row(size_t y, const void* pixels, size_t bytes) noexcept = 0;
+		virtual error_t end() noexcept = 0;
+	};
+
+	// Streaming Decoder
+	//  : Encoded data is pushed in pieces as it arrives(network, chunked upload),
+	//    neither whole file nor whole image is kept except for interlaced image.
+	class DSEEDEXP bitmap_stream_decoder : public object
+	{
+	public:
+		virtual error_t push(const void* data, size_t length) noexcept = 0;
+		virtual bool completed() noexcept = 0;
+	};
+
+	// JPEG Decoding Options
+	//  : Image is reduced in IDCT by 1/scale_denominator(1, 2, 4 or 8), so less work than full decode and resize.
+	//  : If minimum_size is not empty, the largest reduction keeping both dimensions at least minimum_size is chosen.
+	//  : Region is in reduced image coordinates, empty region means whole image.
+	//    Rows out of region are skipped, columns are cropped to iMCU boundary before IDCT.
+	struct DSEEDEXP jpeg_decoder_options
+	{
+		int scale_denominator;
+		size2i minimum_size;
+		rect2i region;
+		bool yuv;
+		jpeg_decoder_options(int scale_denominator = 1, const size2i& minimum_size = size2i(0, 0),
+			const rect2i& region = rect2i(0, 0, 0, 0), bool yuv = false) noexcept
+			: scale_denominator(scale_denominator), minimum_size(minimum_size), region(region), yuv(yuv)
+		{ }
+	};
+
+	// JPEG 2000 Decoding Options
+	//  : Image is decoded at reduce_level resolution level, each level halves both dimensions.
+	//    Higher wavelet levels are never decoded, so lowest levels give thumbnail cheaply.
+	//  : If minimum_size is not empty, the highest level keeping both dimensions at least minimum_size is chosen.
+	//    Level is lowered to the number of levels in codestream.
+	//  : Region is in reduced image coordinates, empty region means whole image.
+	//    Only tiles and code-blocks intersecting region are decoded.
+	//  : Code-blocks are decoded on threads of openjpeg, 0 threads means hardware concurrency.
+	struct DSEEDEXP jpeg2000_decoder_options
+	{
+		int reduce_level;
+		size2i minimum_size;
+		rect2i region;
+		int threads;
+		jpeg2000_decoder_options(int reduce_level = 0, const size2i& minimum_size = size2i(0, 0),
+			const rect2i& region = rect2i(0, 0, 0, 0), int threads = 0) noexcept
+			: reduce_level(reduce_level), minimum_size(minimum_size), region(region), threads(threads)
+		{ }
+	};
+
+	// KTX2 Decoding Options
+	//  : Array exposes level_count levels from base_level, so array index 0 is base_level of file.
+	//  : 0 level count means every level from base_level; levels out of range are never read.
+	struct DSEEDEXP ktx2_decoder_options
+	{
+		int base_level;
+		int level_count;
+		ktx2_decoder_options(int base_level = 0, int level_count = 0) noexcept
+			: base_level(base_level), level_count(level_count)
+		{ }
+	};
+
+	// Animated Bitmap Decoding Options(GIF, WebP)
+	//  : Frames are composited over previous frames, so decoding starts from key frame,
+	//    which covers whole canvas or follows disposal of whole canvas.
+	//  : If parallel is true, every frame is decoded on creation, and runs from each key frame are decoded on worker threads.
+	//    0 threads means hardware concurrency.
+	//  : Otherwise frames are decoded on access. Up to cache_size composited frames and canvases are kept,
+	//    so seeking resumes from nearest key frame or cached canvas instead of first frame.
+	struct DSEEDEXP animation_decoder_options
+	{
+		bool parallel;
+		int threads;
+		int cache_size;
+		animation_decoder_options(bool parallel = false, int threads = 0, int cache_size = 8) noexcept
+			: parallel(parallel), threads(threads), cache_size(cache_size)
+		{ }
+	};
+
 	enum class windows_imaging_codec_load_format
 	{
 		unknown,
@@ -20,16 +138,57 @@ namespace dseed::bitmaps
 
 	DSEEDEXP error_t create_dds_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_ktx_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_ktx2_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_ktx2_bitmap_decoder_with_options(dseed::io::stream* stream, const dseed::bitmaps::ktx2_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_pkm_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_astc_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_qoi_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
 
 	DSEEDEXP error_t create_png_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_png_stream_decoder(dseed::bitmaps::bitmap_row_sink* sink, dseed::bitmaps::bitmap_stream_decoder** decoder) noexcept;
 	DSEEDEXP error_t create_jpeg_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_jpeg_bitmap_decoder_yuv(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_jpeg_bitmap_decoder_with_options(dseed::io::stream* stream, const dseed::bitmaps::jpeg_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_jpeg2000_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_jpeg2000_bitmap_decoder_with_options(dseed::io::stream* stream, const dseed::bitmaps::jpeg2000_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_webp_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_webp_bitmap_decoder_with_options(dseed::io::stream* stream, const dseed::bitmaps::animation_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_tiff_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
 	DSEEDEXP error_t create_gif_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept;
+	DSEEDEXP error_t create_gif_bitmap_decoder_with_options(dseed::io::stream* stream, const dseed::bitmaps::animation_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept;
+
+	DSEEDEXP error_t probe_dib_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_tga_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_ico_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_cur_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+
+	DSEEDEXP error_t probe_dds_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_ktx_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_ktx2_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_pkm_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_astc_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_qoi_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+
+	DSEEDEXP error_t probe_png_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_jpeg_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_jpeg2000_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_webp_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_tiff_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+	DSEEDEXP error_t probe_gif_bitmap(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept;
+
+	DSEEDEXP error_t decode_dib_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_tga_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+
+	DSEEDEXP error_t decode_dds_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_ktx_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_ktx2_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_pkm_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_astc_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_qoi_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+
+	DSEEDEXP error_t decode_png_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_jpeg_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
+	DSEEDEXP error_t decode_webp_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info = nullptr) noexcept;
 }
 
 #endif
\ No newline at end of file
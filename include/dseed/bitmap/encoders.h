@@ -8,29 +8,190 @@ namespace dseed::bitmaps
 #else
 #	pragma pack (1)
 #endif
+	// PNG Row Filter
+	//  : Adaptive tries every filter per row and picks the one with minimum sum of absolute differences.
+	enum class png_filter : int32_t
+	{
+		none, sub, up, average, paeth, adaptive,
+	};
+
+	// zlib Strategy for PNG
+	enum class png_strategy : int32_t
+	{
+		normal, filtered, huffman_only, rle, fixed,
+	};
+
+	// PNG Encoder Options
+	//  : Compression level is zlib level(0~9).
+	//  : If threads is not 1, row bands are filtered and deflated on worker threads, then stitched into one IDAT stream;
+	//    0 means hardware concurrency.
 	struct DSEEDEXP png_encoder_options : public bitmap_encoder_options
 	{
-		png_encoder_options()
+		int compression_level;
+		png_filter filter;
+		png_strategy strategy;
+		int threads;
+		png_encoder_options(int compression_level = 9, png_filter filter = png_filter::adaptive,
+			png_strategy strategy = png_strategy::normal, int threads = 1)
 			: bitmap_encoder_options(sizeof(png_encoder_options), bitmap_encoder_options_for_png)
+			, compression_level(compression_level), filter(filter), strategy(strategy), threads(threads)
 		{ }
 	};
 
+	// JPEG Chroma Subsampling
+	//  : Ignored for chroma subsampled input(nv12 is 4:2:0, yuyv8 is 4:2:2) which is stored as is.
+	enum class jpeg_subsampling : int32_t
+	{
+		yuv444, yuv422, yuv420,
+	};
+
+	// JPEG Encoder Options
+	//  : Fast DCT is less accurate integer DCT.
+	//  : Optimized Huffman tables take one more pass over coefficients.
 	struct DSEEDEXP jpeg_encoder_options : public bitmap_encoder_options
 	{
 		int quality;
-		jpeg_encoder_options(int quality = 80)
+		jpeg_subsampling subsampling;
+		bool fast_dct;
+		bool optimize_coding;
+		bool progressive;
+		jpeg_encoder_options(int quality = 80, jpeg_subsampling subsampling = jpeg_subsampling::yuv420,
+			bool fast_dct = false, bool optimize_coding = false, bool progressive = false)
 			: bitmap_encoder_options(sizeof(jpeg_encoder_options), bitmap_encoder_options_for_jpeg)
-			, quality(quality)
+			, quality(quality), subsampling(subsampling), fast_dct(fast_dct)
+			, optimize_coding(optimize_coding), progressive(progressive)
 		{ }
 	};
 
+	// WebP Encoder Preset
+	//  : Picture, photo, drawing, icon and text are libwebp presets.
+	//  : Realtime is for live paths; fast method, single pass, no alpha filtering.
+	enum class webp_preset : int32_t
+	{
+		none, picture, photo, drawing, icon, text, realtime,
+	};
+
+	// WebP Encoder Options
+	//  : Method is effort from 0(fastest) to 6(slowest); -1 means 6 for none, 2 for realtime and 4 for other presets.
+	//  : Lossless level 0~9 overrides lossless, quality and method by libwebp lossless preset; -1 means not used.
+	//  : Alpha filtering is 0(none), 1(fast) or 2(best); -1 means preset's.
 	struct DSEEDEXP webp_encoder_options : public bitmap_encoder_options
 	{
 		int quality;
 		bool lossless;
-		webp_encoder_options(int quality = 75, bool lossless = false)
+		webp_preset preset;
+		int method;
+		int lossless_level;
+		bool multithread;
+		bool alpha_compression;
+		int alpha_filtering;
+		int alpha_quality;
+		webp_encoder_options(int quality = 75, bool lossless = false, webp_preset preset = webp_preset::none,
+			int method = -1, int lossless_level = -1, bool multithread = true,
+			bool alpha_compression = true, int alpha_filtering = -1, int alpha_quality = 100)
 			: bitmap_encoder_options(sizeof(webp_encoder_options), bitmap_encoder_options_for_webp)
-			, quality(quality), lossless(lossless)
+			, quality(quality), lossless(lossless), preset(preset), method(method), lossless_level(lossless_level)
+			, multithread(multithread), alpha_compression(alpha_compression), alpha_filtering(alpha_filtering)
+			, alpha_quality(alpha_quality)
+		{ }
+	};
+
+	// GIF Encoder Options
+	//  : Truecolor frames are quantized on worker threads; 0 threads means hardware concurrency.
+	//  : Frame differencing writes only changed rectangle of opaque frame, unchanged pixels in it are transparent.
+	//    Dither other than ordered makes static area differ between frames, so rectangles grow.
+	//  : Global palette is made from all frames, so frames are kept until commit.
+	//    Every frame is mapped with one quantizer, so its lookup cache is shared.
+	struct DSEEDEXP gif_encoder_options : public bitmap_encoder_options
+	{
+		bool frame_differencing;
+		bool global_palette;
+		int threads;
+		quantize_method quantize;
+		dither_method dither;
+		gif_encoder_options(bool frame_differencing = true, bool global_palette = false, int threads = 0,
+			quantize_method quantize = quantize_method::exoquant, dither_method dither = dither_method::ordered)
+			: bitmap_encoder_options(sizeof(gif_encoder_options), bitmap_encoder_options_for_gif)
+			, frame_differencing(frame_differencing), global_palette(global_palette), threads(threads)
+			, quantize(quantize), dither(dither)
+		{ }
+	};
+
+	// TIFF Compression
+	//  : ZSTD is available only if libtiff is built with it.
+	enum class tiff_compression : int32_t
+	{
+		none, lzw, deflate, zstd,
+	};
+
+	// TIFF Encoder Options
+	//  : Compression level is for deflate(1~9) and ZSTD(1~22); -1 means codec default.
+	//  : Predictor is horizontal differencing for integer and floating point predictor for float pixels.
+	//  : Tile size must be multiple of 16; 0 rows per strip means libtiff default strip size.
+	//  : Tiles(strips) are compressed on worker threads except ZSTD; 0 threads means hardware concurrency.
+	struct DSEEDEXP tiff_encoder_options : public bitmap_encoder_options
+	{
+		tiff_compression compression;
+		int compression_level;
+		bool predictor;
+		bool tiled;
+		int tile_width, tile_height;
+		int rows_per_strip;
+		int threads;
+		tiff_encoder_options(tiff_compression compression = tiff_compression::lzw, int compression_level = -1,
+			bool predictor = false, bool tiled = false, int tile_width = 256, int tile_height = 256,
+			int rows_per_strip = 0, int threads = 0)
+			: bitmap_encoder_options(sizeof(tiff_encoder_options), bitmap_encoder_options_for_tiff)
+			, compression(compression), compression_level(compression_level), predictor(predictor)
+			, tiled(tiled), tile_width(tile_width), tile_height(tile_height), rows_per_strip(rows_per_strip)
+			, threads(threads)
+		{ }
+	};
+
+	// KTX2 Supercompression
+	//  : Values are same as supercompressionScheme of KTX2; ZSTD and zlib are available only if libdseed is built with them.
+	enum class ktx2_supercompression : int32_t
+	{
+		none = 0, zstd = 2, zlib = 3,
+	};
+
+	// KTX2 Encoder Options
+	//  : Frames are mip levels from largest; levels are written from smallest, so head of file has every low mip.
+	//  : Compression level is for ZSTD(1~22) and zlib(1~9); -1 means codec default.
+	//  : Levels are supercompressed on worker threads; 0 threads means hardware concurrency.
+	//  : If array is true, depth of 3D frame is count of array layers which are not halved per level,
+	//    otherwise 3D frame is volume texture.
+	struct DSEEDEXP ktx2_encoder_options : public bitmap_encoder_options
+	{
+		ktx2_supercompression supercompression;
+		int compression_level;
+		int threads;
+		bool array;
+		ktx2_encoder_options(ktx2_supercompression supercompression = ktx2_supercompression::none,
+			int compression_level = -1, int threads = 0, bool array = false)
+			: bitmap_encoder_options(sizeof(ktx2_encoder_options), bitmap_encoder_options_for_ktx2)
+			, supercompression(supercompression), compression_level(compression_level), threads(threads), array(array)
+		{ }
+	};
+
+	// DDS Encoder Options
+	//  : If format is unknown, frames are mip levels already in stored format.
+	//  : Otherwise one RGBA8 or RGBAF frame is given, then mip chain is generated and compressed to format
+	//    (BC1~BC5, BC7, RGBA8, BGRA8) on worker threads; 0 mip levels means full chain.
+	//  : Bilinear mip filter is 2x2 box filter fused with compression; other filters resize each level from frame.
+	//  : Cubemap frame is written as cubemap; if array is true, depth of 3D frame is count of array slices.
+	//  : 0 threads means hardware concurrency.
+	struct DSEEDEXP dds_encoder_options : public bitmap_encoder_options
+	{
+		dseed::color::pixelformat format;
+		int mip_levels;
+		resize mip_filter;
+		bool array;
+		int threads;
+		dds_encoder_options(dseed::color::pixelformat format = dseed::color::pixelformat::unknown, int mip_levels = 0,
+			resize mip_filter = resize::bilinear, bool array = false, int threads = 0)
+			: bitmap_encoder_options(sizeof(dds_encoder_options), bitmap_encoder_options_for_dds)
+			, format(format), mip_levels(mip_levels), mip_filter(mip_filter), array(array), threads(threads)
 		{ }
 	};
 
@@ -62,10 +223,15 @@ namespace dseed::bitmaps
 #	pragma pack ()
 #endif
 
+	// Encoder Creation Function Prototype
+	//  : Encoders write through buffered stream of default_stream_buffer_size, and write it out on commit.
+	//    Buffered stream given by caller is used as is, so buffer size can be chosen by wrapping stream.
 	using encoder_creator_func = error_t(*)(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
 
 	DSEEDEXP error_t create_dib_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
 	DSEEDEXP error_t create_dds_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
+	DSEEDEXP error_t create_ktx2_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
+	DSEEDEXP error_t create_qoi_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
 
 	DSEEDEXP error_t create_ico_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
 	DSEEDEXP error_t create_cur_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
@@ -77,6 +243,12 @@ namespace dseed::bitmaps
 	DSEEDEXP error_t create_tiff_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
 
 	DSEEDEXP error_t create_wic_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder);
+
+	// Encode Frames into Preallocated Blob without Intermediate Stream Buffer
+	//  : Encoded bytes are written from head of blob, and written is set to their length.
+	//  : error_out_of_range is returned if encoded bytes do not fit in blob.
+	DSEEDEXP error_t encode_bitmap_into(encoder_creator_func creator, const dseed::bitmaps::bitmap_encoder_options* options,
+		dseed::bitmaps::bitmap* const* frames, size_t count, dseed::blob* blob, size_t* written);
 }
 
 #endif
\ No newline at end of file
@@ -29,9 +29,57 @@ namespace dseed::io
 		virtual bool seekable() noexcept = 0;
 	};
 
+	// Maximum bytes compared in decoder detection
+	constexpr size_t maximum_signature_length = 64;
+
+	// Magic bytes for decoder detection
+	//  : Compared with head of stream. Mask is optional; zero bits in mask are ignored.
+	struct stream_signature
+	{
+		const void* magic;
+		const void* mask;
+		size_t length;
+	};
+
 	DSEEDEXP dseed::error_t create_fixed_memorystream(void* buffer, size_t length, dseed::io::stream** stream);
 	DSEEDEXP dseed::error_t create_variable_memorystream(dseed::io::stream** stream, bool remove_after_read = false);
 	DSEEDEXP dseed::error_t create_native_filestream(const char* path, bool create, dseed::io::stream** stream);
+
+	// Stream over memory of blob
+	//  : Blob is retained by stream. Container decoders(DDS, KTX, PKM, ASTC) make bitmaps
+	//    referencing blob memory instead of copying pixels from this stream.
+	class DSEEDEXP blobstream : public stream
+	{
+	public:
+		virtual dseed::error_t blob(dseed::blob** blob) noexcept = 0;
+	};
+
+	DSEEDEXP dseed::error_t create_blob_memorystream(dseed::blob* blob, dseed::io::stream** stream);
+
+	// Write-combining Stream
+	//  : Small writes are gathered in buffer and written to base stream in one call
+	//    when buffer is full, or before read, seek, set_length and flush.
+	//  : Writes not smaller than buffer go to base stream directly after gathered bytes.
+	//  : Memory streams are not buffered; writes go to them directly.
+	//  : Failed write to base stream is reported by commit, and later writes are refused.
+	class DSEEDEXP bufferedstream : public stream
+	{
+	public:
+		// Writes gathered bytes, then flushes base stream
+		virtual dseed::error_t commit() noexcept = 0;
+	};
+
+	constexpr size_t default_stream_buffer_size = 64 * 1024;
+
+	// Buffered stream is returned as is, so buffer size of stream given to encoders can be chosen by caller.
+	//  : 0 buffer size means writes go to base stream directly.
+	DSEEDEXP dseed::error_t create_buffered_stream(dseed::io::stream* stream, size_t buffer_size, dseed::io::bufferedstream** buffered);
+
+	// Memory mapped file
+	//  : Mapping is copy-on-write, so writing to blob does not change file.
+	//  : File is unmapped when blob and every bitmap referencing it are released.
+	DSEEDEXP dseed::error_t create_mapped_file_blob(const char* path, dseed::blob** blob);
+	DSEEDEXP dseed::error_t create_mapped_filestream(const char* path, dseed::io::stream** stream);
 }
 
 #endif
\ No newline at end of file
@@ -108,6 +108,8 @@ namespace dseed
 		andop,
 		orop,
 		xorop,
+		minimum,
+		maximum,
 	};
 
 	enum class unary_operator
@@ -50,6 +50,17 @@ namespace dseed
 		return _mm_or_si128(_mm_shuffle_epi8(lo, lo_mask), _mm_shuffle_epi8(hi, hi_mask));
 	}
 	static inline i32x4_t multiply8(const i32x4_t& v, int s) noexcept { return multiply8(v, _mm_set1_epi8(s)); }
+	static inline i32x4_t addsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return _mm_adds_epu8(v1, v2); }
+	static inline i32x4_t subtractsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return _mm_subs_epu8(v1, v2); }
+	static inline i32x4_t multiplysat8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		const auto zero = _mm_setzero_si128();
+		const auto max = _mm_set1_epi16(255);
+
+		const auto lo = _mm_mullo_epi16(_mm_unpacklo_epi8(v1, zero), _mm_unpacklo_epi8(v2, zero));
+		const auto hi = _mm_mullo_epi16(_mm_unpackhi_epi8(v1, zero), _mm_unpackhi_epi8(v2, zero));
+		return _mm_packus_epi16(_mm_min_epu16(lo, max), _mm_min_epu16(hi, max));
+	}
 #elif !DONT_USE_NEON
 	static inline f32x4_t addfv(const f32x4_t& v1, const f32x4_t& v2) noexcept { return vaddq_f32(v1, v2); }
 	static inline f32x4_t subtractfv(const f32x4_t& v1, const f32x4_t& v2) noexcept { return vsubq_f32(v1, v2); }
@@ -102,6 +113,21 @@ namespace dseed
 	static inline i32x4_t negate8(const i32x4_t& v) noexcept { return vnegq_s8(v); }
 	static inline i32x4_t multiply8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return vmulq_s8(v1, v2); }
 	static inline i32x4_t multiply8(const i32x4_t& v, int s) noexcept { return vmulq_s8(v, vmovq_n_s8(s)); }
+	static inline i32x4_t addsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		return vreinterpretq_s32_u8(vqaddq_u8(vreinterpretq_u8_s32(v1), vreinterpretq_u8_s32(v2)));
+	}
+	static inline i32x4_t subtractsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		return vreinterpretq_s32_u8(vqsubq_u8(vreinterpretq_u8_s32(v1), vreinterpretq_u8_s32(v2)));
+	}
+	static inline i32x4_t multiplysat8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		const uint8x16_t u1 = vreinterpretq_u8_s32(v1), u2 = vreinterpretq_u8_s32(v2);
+		const uint16x8_t lo = vmull_u8(vget_low_u8(u1), vget_low_u8(u2));
+		const uint16x8_t hi = vmull_u8(vget_high_u8(u1), vget_high_u8(u2));
+		return vreinterpretq_s32_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+	}
 #elif DONT_USE_SIMD
 	static inline f32x4_t addfv(const f32x4_t& v1, const f32x4_t& v2) noexcept { return f32x4_t(v1.x() + v2.x(), v1.y() + v2.y(), v1.z() + v2.z(), v1.w() + v2.w()); }
 	static inline f32x4_t subtractfv(const f32x4_t& v1, const f32x4_t& v2) noexcept { return f32x4_t(v1.x() - v2.x(), v1.y() - v2.y(), v1.z() - v2.z(), v1.w() - v2.w()); }
@@ -317,6 +343,36 @@ namespace dseed
 		};
 		return i32x4_t(result);
 	}
+	static inline i32x4_t addsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		const uint8_t* arr1 = (const uint8_t*)&v1;
+		const uint8_t* arr2 = (const uint8_t*)&v2;
+		i32x4_t ret;
+		uint8_t* result = (uint8_t*)&ret;
+		for (int i = 0; i < 16; ++i)
+			result[i] = (uint8_t)min(arr1[i] + arr2[i], 255);
+		return ret;
+	}
+	static inline i32x4_t subtractsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		const uint8_t* arr1 = (const uint8_t*)&v1;
+		const uint8_t* arr2 = (const uint8_t*)&v2;
+		i32x4_t ret;
+		uint8_t* result = (uint8_t*)&ret;
+		for (int i = 0; i < 16; ++i)
+			result[i] = (uint8_t)max(arr1[i] - arr2[i], 0);
+		return ret;
+	}
+	static inline i32x4_t multiplysat8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		const uint8_t* arr1 = (const uint8_t*)&v1;
+		const uint8_t* arr2 = (const uint8_t*)&v2;
+		i32x4_t ret;
+		uint8_t* result = (uint8_t*)&ret;
+		for (int i = 0; i < 16; ++i)
+			result[i] = (uint8_t)min(arr1[i] * arr2[i], 255);
+		return ret;
+	}
 #endif
 }
 
@@ -27,6 +27,8 @@ namespace dseed
 	static inline i32x4_t abs8(const i32x4_t& v) noexcept { return _mm_abs_epi8(v); }
 	static inline i32x4_t minv8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return _mm_min_epi8(v1, v2); }
 	static inline i32x4_t maxv8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return _mm_max_epi8(v1, v2); }
+	static inline i32x4_t minvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return _mm_min_epu8(v1, v2); }
+	static inline i32x4_t maxvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return _mm_max_epu8(v1, v2); }
 #elif !DONT_USE_NEON
 	static inline f32x4_t sqrt(const f32x4_t& v) noexcept { return vrecpeq_f32(vrsqrteq_f32(v)); }
 	static inline f32x4_t rcp(const f32x4_t& v) noexcept { return vrecpeq_f32(v); }
@@ -60,6 +62,8 @@ namespace dseed
 	static inline i32x4_t abs8(const i32x4_t& v) noexcept { return vabsq_s8(v); }
 	static inline i32x4_t minv8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return vminq_s8(v1, v2); }
 	static inline i32x4_t maxv8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return vmaxq_s8(v1, v2); }
+	static inline i32x4_t minvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return vreinterpretq_s32_u8(vminq_u8(vreinterpretq_u8_s32(v1), vreinterpretq_u8_s32(v2))); }
+	static inline i32x4_t maxvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept { return vreinterpretq_s32_u8(vmaxq_u8(vreinterpretq_u8_s32(v1), vreinterpretq_u8_s32(v2))); }
 #elif DONT_USE_SIMD
 	static inline f32x4_t sqrt(const f32x4_t& v) noexcept { return f32x4_t(sqrtf(v.x()), sqrtf(v.y()), sqrtf(v.z()), sqrtf(v.w())); }
 	static inline f32x4_t rcp(const f32x4_t& v) noexcept { return f32x4_t(1 / v.x(), 1 / v.y(), 1 / v.z(), 1 / v.w()); }
@@ -194,6 +198,26 @@ namespace dseed
 		};
 		return i32x4_t(result);
 	}
+	static inline i32x4_t minvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		const uint8_t* arr1 = (const uint8_t*)&v1;
+		const uint8_t* arr2 = (const uint8_t*)&v2;
+		i32x4_t ret;
+		uint8_t* result = (uint8_t*)&ret;
+		for (int i = 0; i < 16; ++i)
+			result[i] = min(arr1[i], arr2[i]);
+		return ret;
+	}
+	static inline i32x4_t maxvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept
+	{
+		const uint8_t* arr1 = (const uint8_t*)&v1;
+		const uint8_t* arr2 = (const uint8_t*)&v2;
+		i32x4_t ret;
+		uint8_t* result = (uint8_t*)&ret;
+		for (int i = 0; i < 16; ++i)
+			result[i] = max(arr1[i], arr2[i]);
+		return ret;
+	}
 #endif
 }
 
@@ -327,6 +327,10 @@ namespace dseed
 	static inline i32x4_t multiply8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
 	static inline i32x4_t multiply8(const i32x4_t& v, int s) noexcept;
 	static inline i32x4_t multiply8(int s, const i32x4_t& v) noexcept { return multiply8(v, s); }
+	// Unsigned saturated 8-bit arithmetics
+	static inline i32x4_t addsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
+	static inline i32x4_t subtractsat8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
+	static inline i32x4_t multiplysat8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
 
 	///////////////////////////////////////////////////////////////////////////////////////////
 	//
@@ -412,6 +416,8 @@ namespace dseed
 	static inline i32x4_t abs8(const i32x4_t& v) noexcept;
 	static inline i32x4_t minv8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
 	static inline i32x4_t maxv8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
+	static inline i32x4_t minvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
+	static inline i32x4_t maxvu8(const i32x4_t& v1, const i32x4_t& v2) noexcept;
 
 	static inline f32x4_t sin(const f32x4_t& v) noexcept;
 	static inline f32x4_t cos(const f32x4_t& v) noexcept;
@@ -235,7 +235,11 @@ namespace dseed::media
 namespace dseed::media
 {
 	using createmediadecoder_fn = error_t(*) (dseed::io::stream*, media_decoder**);
-	DSEEDEXP error_t add_media_decoder(createmediadecoder_fn fn);
+	// Add Media Decoder to Detection Queue
+	//  : Decoder with signatures is tried only if one of them matches head of stream,
+	//    decoder without signature is tried after every matched decoder failed.
+	DSEEDEXP error_t add_media_decoder(createmediadecoder_fn fn,
+		const dseed::io::stream_signature* signatures = nullptr, size_t signatureCount = 0);
 	DSEEDEXP error_t detect_media_decoder(dseed::io::stream* stream, dseed::media::media_decoder** decoder);
 }
 
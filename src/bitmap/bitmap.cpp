@@ -1,10 +1,13 @@
 #include <dseed.h>
 
 #include <cstring>
+#include <list>
 
 #include <mutex>
 #include <shared_mutex>
 
+#include "../libs/SignatureHelper.hxx"
+
 class __internal_palette : public dseed::bitmaps::palette
 {
 public:
@@ -92,11 +95,24 @@ public:
 		bufferSize = 4 * ((bufferSize * ((24 + 7) / 8) + 3) / 4);
 		_pixels.resize(bufferSize);
 
+		_data = _pixels.data();
+
 		dseed::create_attributes(&_extraInfo);
 
 		if (pixels)
 			memcpy(_pixels.data(), pixels, bufferSize);
 	}
+	__internal_bitmap(dseed::blob* blob, size_t offset, dseed::bitmaps::bitmaptype type, dseed::color::pixelformat format, const dseed::size3i& size, dseed::bitmaps::palette* palette)
+		: _refCount(1), _type(type), _format(format), _size(size), _palette(palette), _blob(blob), _extraInfo(nullptr)
+	{
+		_stride = dseed::color::calc_bitmap_stride(format, size.width);
+		_planeSize = dseed::color::calc_bitmap_plane_size(format, dseed::size2i(size.width, size.height));
+
+		// Pixels are not copied, blob is kept alive by this bitmap
+		_data = ((uint8_t*)blob->ptr()) + offset;
+
+		dseed::create_attributes(&_extraInfo);
+	}
 
 public:
 	virtual int32_t retain() override { return ++_refCount; }
@@ -135,7 +151,7 @@ public:
 	{
 		if (!_mutex.try_lock())
 			_mutex.lock();
-		*ptr = _pixels.data();
+		*ptr = _data;
 		return dseed::error_good;
 	}
 	virtual dseed::error_t unlock() noexcept override
@@ -147,12 +163,12 @@ public:
 public:
 	virtual dseed::error_t copy_pixels(void* dest, size_t depth) override
 	{
-		if (_pixels.empty())
+		if (_data == nullptr)
 			return dseed::error_not_support;
 		if ((depth >= _size.depth || depth < 0) || dest == nullptr)
 			return dseed::error_invalid_args;
 
-		memcpy(dest, _pixels.data() + (depth * _planeSize), _planeSize);
+		memcpy(dest, _data + (depth * _planeSize), _planeSize);
 
 		return dseed::error_good;
 	}
@@ -184,7 +200,7 @@ public:
 				break;
 
 			uint8_t* bufferY = ((uint8_t*)ptr) + startPoint + dseed::color::calc_bitmap_stride(_format, area.width) * (y - area.y);
-			uint8_t* pixelsY = _pixels.data() + startPoint + _stride * y + pixelStride * area.x;
+			uint8_t* pixelsY = _data + startPoint + _stride * y + pixelStride * area.x;
 
 			memcpy(bufferY, pixelsY, pixelStride * width);
 		}
@@ -219,7 +235,7 @@ public:
 				break;
 
 			const uint8_t* bufferY = ((const uint8_t*)ptr) + startPoint + dseed::color::calc_bitmap_stride(_format, area.width) * (y - area.y);
-			uint8_t* pixelsY = _pixels.data() + startPoint + _stride * y + pixelStride * area.x;
+			uint8_t* pixelsY = _data + startPoint + _stride * y + pixelStride * area.x;
 
 			memcpy(pixelsY, bufferY, pixelStride * width);
 		}
@@ -254,6 +270,8 @@ private:
 	dseed::autoref<dseed::bitmaps::palette> _palette;
 
 	std::vector<uint8_t> _pixels;
+	dseed::autoref<dseed::blob> _blob;
+	uint8_t* _data;
 	size_t _stride, _planeSize;
 
 	dseed::autoref<dseed::attributes> _extraInfo;
@@ -290,6 +308,25 @@ dseed::error_t dseed::bitmaps::create_bitmap(bitmaptype type, const size3i& size
 	return create_bitmap(nullptr, type, size, format, palette, bitmap);
 }
 
+dseed::error_t dseed::bitmaps::create_bitmap(dseed::blob* blob, size_t offset, bitmaptype type, const size3i& size, color::pixelformat format, palette* palette, bitmap** bitmap) noexcept
+{
+	if (blob == nullptr || size.width <= 0 || size.height <= 0 || size.depth <= 0 || bitmap == nullptr
+		|| !(type >= bitmaptype::bitmap2d && type <= bitmaptype::bitmap3d))
+		return dseed::error_invalid_args;
+	if ((format == color::pixelformat::bgra8_indexed8 || format == color::pixelformat::bgr8_indexed8) && palette == nullptr)
+		return dseed::error_invalid_args;
+
+	const size_t totalSize = color::calc_bitmap_total_size(format, size);
+	if (totalSize == 0 || offset > blob->size() || blob->size() - offset < totalSize)
+		return dseed::error_out_of_range;
+
+	*bitmap = new __internal_bitmap(blob, offset, type, format, size, palette);
+	if (*bitmap == nullptr)
+		return dseed::error_out_of_memory;
+
+	return dseed::error_good;
+}
+
 class __common_bitmap_array : public dseed::bitmaps::bitmap_array
 {
 public:
@@ -353,6 +390,81 @@ dseed::error_t dseed::bitmaps::create_bitmap_array(arraytype type, size_t size,
 	return dseed::error_good;
 }
 
+class __lazy_bitmap_array : public dseed::bitmaps::bitmap_array
+{
+public:
+	__lazy_bitmap_array(dseed::bitmaps::arraytype frametype, size_t size, dseed::bitmaps::bitmap_frame_loader* loader, size_t cacheSize)
+		: _refCount(1), _frametype(frametype), _frames(size), _loader(loader), _cacheSize(dseed::maximum<size_t>(1, cacheSize))
+	{ }
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		const auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t at(size_t i, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		if (!(i >= 0 && i < _frames.size())) return dseed::error_invalid_args;
+		if (bitmap == nullptr) return dseed::error_invalid_args;
+
+		std::lock_guard<std::mutex> guard(_mutex);
+
+		if (_frames[i] == nullptr)
+		{
+			dseed::autoref<dseed::bitmaps::bitmap> frame;
+			if (auto err = _loader->load(i, &frame); dseed::failed(err))
+				return err;
+			if (frame == nullptr)
+				return dseed::error_fail;
+
+			if (_recent.size() >= _cacheSize)
+			{
+				_frames[_recent.back()].release();
+				_recent.pop_back();
+			}
+			_frames[i] = frame;
+		}
+		else
+			_recent.remove(i);
+		_recent.push_front(i);
+
+		*bitmap = _frames[i];
+		(*bitmap)->retain();
+
+		return dseed::error_good;
+	}
+	virtual size_t size() noexcept override { return _frames.size(); }
+	virtual dseed::bitmaps::arraytype type() noexcept override { return _frametype; }
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::bitmaps::arraytype _frametype;
+	std::mutex _mutex;
+	std::vector<dseed::autoref<dseed::bitmaps::bitmap>> _frames;
+	std::list<size_t> _recent;
+	dseed::autoref<dseed::bitmaps::bitmap_frame_loader> _loader;
+	size_t _cacheSize;
+};
+
+dseed::error_t dseed::bitmaps::create_lazy_bitmap_array(arraytype type, size_t size, dseed::bitmaps::bitmap_frame_loader* loader,
+	size_t cacheSize, dseed::bitmaps::bitmap_array** arr) noexcept
+{
+	if (size <= 0 || loader == nullptr || arr == nullptr)
+		return dseed::error_invalid_args;
+
+	*arr = new __lazy_bitmap_array(type, size, loader, cacheSize);
+	if (*arr == nullptr)
+		return dseed::error_out_of_memory;
+
+	return dseed::error_good;
+}
+
 constexpr int32_t MAXIMUM_BITMAP_DECODER_COUNT = 512;
 std::function<dseed::error_t(dseed::io::stream*, dseed::bitmaps::bitmap_array**)> g_bitmap_decoder_creator[MAXIMUM_BITMAP_DECODER_COUNT] =
 {
@@ -360,6 +472,7 @@ std::function<dseed::error_t(dseed::io::stream*, dseed::bitmaps::bitmap_array**)
 	dseed::bitmaps::create_tga_bitmap_decoder,
 	dseed::bitmaps::create_dds_bitmap_decoder,
 	dseed::bitmaps::create_ktx_bitmap_decoder,
+	dseed::bitmaps::create_ktx2_bitmap_decoder,
 	dseed::bitmaps::create_pkm_bitmap_decoder,
 	dseed::bitmaps::create_astc_bitmap_decoder,
 	dseed::bitmaps::create_ico_bitmap_decoder,
@@ -370,27 +483,119 @@ std::function<dseed::error_t(dseed::io::stream*, dseed::bitmaps::bitmap_array**)
 	dseed::bitmaps::create_webp_bitmap_decoder,
 	dseed::bitmaps::create_tiff_bitmap_decoder,
 	dseed::bitmaps::create_gif_bitmap_decoder,
+	dseed::bitmaps::create_qoi_bitmap_decoder,
 	dseed::bitmaps::create_windows_imaging_codec_bitmap_decoder,
 };
-std::atomic<int32_t> g_bitmap_decoder_creator_count = 15;
+dseed::bitmaps::decoder_prober_func g_bitmap_decoder_prober[MAXIMUM_BITMAP_DECODER_COUNT] =
+{
+	dseed::bitmaps::probe_dib_bitmap,
+	dseed::bitmaps::probe_tga_bitmap,
+	dseed::bitmaps::probe_dds_bitmap,
+	dseed::bitmaps::probe_ktx_bitmap,
+	dseed::bitmaps::probe_ktx2_bitmap,
+	dseed::bitmaps::probe_pkm_bitmap,
+	dseed::bitmaps::probe_astc_bitmap,
+	dseed::bitmaps::probe_ico_bitmap,
+	dseed::bitmaps::probe_cur_bitmap,
+	dseed::bitmaps::probe_png_bitmap,
+	dseed::bitmaps::probe_jpeg_bitmap,
+	dseed::bitmaps::probe_jpeg2000_bitmap,
+	dseed::bitmaps::probe_webp_bitmap,
+	dseed::bitmaps::probe_tiff_bitmap,
+	dseed::bitmaps::probe_gif_bitmap,
+	dseed::bitmaps::probe_qoi_bitmap,
+	nullptr,
+};
+dseed::bitmaps::decoder_into_func g_bitmap_decoder_into[MAXIMUM_BITMAP_DECODER_COUNT] =
+{
+	dseed::bitmaps::decode_dib_bitmap_into,
+	dseed::bitmaps::decode_tga_bitmap_into,
+	dseed::bitmaps::decode_dds_bitmap_into,
+	dseed::bitmaps::decode_ktx_bitmap_into,
+	dseed::bitmaps::decode_ktx2_bitmap_into,
+	dseed::bitmaps::decode_pkm_bitmap_into,
+	dseed::bitmaps::decode_astc_bitmap_into,
+	nullptr,
+	nullptr,
+	dseed::bitmaps::decode_png_bitmap_into,
+	dseed::bitmaps::decode_jpeg_bitmap_into,
+	nullptr,
+	dseed::bitmaps::decode_webp_bitmap_into,
+	nullptr,
+	nullptr,
+	dseed::bitmaps::decode_qoi_bitmap_into,
+	nullptr,
+};
+__signatures g_bitmap_decoder_signatures[MAXIMUM_BITMAP_DECODER_COUNT] =
+{
+	{ { 'B', 'M' } },
+	{ },
+	{ { 'D', 'D', 'S', ' ' } },
+	{ { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A } },
+	{ { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A } },
+	{ { 'P', 'K', 'M', ' ' } },
+	{ { 0x13, 0xAB, 0xA1, 0x5C } },
+	{ { 0x00, 0x00, 0x01, 0x00 } },
+	{ { 0x00, 0x00, 0x02, 0x00 } },
+	{ { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A } },
+	{ { 0xFF, 0xD8, 0xFF } },
+	{
+		{ 0x00, 0x00, 0x00, 0x0C, 0x6A, 0x50, 0x20, 0x20, 0x0D, 0x0A, 0x87, 0x0A },
+		{ 0x0D, 0x0A, 0x87, 0x0A },
+		{ 0xFF, 0x4F, 0xFF, 0x51 },
+	},
+	{ { { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P' }, { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF } } },
+	{ { { 'I', 'I', 0x2A, 0x00 } }, { { 'M', 'M', 0x00, 0x2A } } },
+	{ { { 'G', 'I', 'F', '8', '7', 'a' } }, { { 'G', 'I', 'F', '8', '9', 'a' } } },
+	{ { 'q', 'o', 'i', 'f' } },
+	{ },
+};
+std::atomic<int32_t> g_bitmap_decoder_creator_count = 17;
 
-dseed::error_t dseed::bitmaps::add_bitmap_decoder(createbitmapdecoder_fn fn)
+dseed::error_t dseed::bitmaps::add_bitmap_decoder(createbitmapdecoder_fn fn, decoder_prober_func probe,
+	const dseed::io::stream_signature* signatures, size_t signatureCount, decoder_into_func into)
 {
 	if (fn == nullptr)
 		return dseed::error_invalid_args;
 
-	g_bitmap_decoder_creator[++g_bitmap_decoder_creator_count] = fn;
+	__signatures copied;
+	if (!__copy_signatures(signatures, signatureCount, copied))
+		return dseed::error_invalid_args;
+
+	auto index = g_bitmap_decoder_creator_count++;
+	if (index >= MAXIMUM_BITMAP_DECODER_COUNT)
+	{
+		--g_bitmap_decoder_creator_count;
+		return dseed::error_out_of_range;
+	}
+
+	g_bitmap_decoder_creator[index] = fn;
+	g_bitmap_decoder_prober[index] = probe;
+	g_bitmap_decoder_into[index] = into;
+	g_bitmap_decoder_signatures[index] = std::move(copied);
 	return dseed::error_good;
 }
 
+void __sniff_bitmap_decoders(dseed::io::stream* stream, std::vector<int32_t>& order)
+{
+	uint8_t head[dseed::io::maximum_signature_length];
+	auto headLength = __read_signature_head(stream, head);
+	__sniff_decoders(head, headLength, g_bitmap_decoder_creator_count,
+		[](int32_t i) -> const __signatures& { return g_bitmap_decoder_signatures[i]; }, order);
+}
+
 dseed::error_t dseed::bitmaps::detect_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder)
 {
 	if (stream == nullptr || !stream->seekable() || decoder == nullptr)
 		return dseed::error_invalid_args;
 
-	for (int i = 0; i < g_bitmap_decoder_creator_count; ++i)
+	std::vector<int32_t> order;
+	__sniff_bitmap_decoders(stream, order);
+
+	for (auto i : order)
 	{
 		stream->seek(dseed::io::seekorigin::begin, 0);
+		*decoder = nullptr;
 		auto err = g_bitmap_decoder_creator[i](stream, decoder);
 		if (dseed::succeeded(err))
 			return dseed::error_good;
@@ -398,8 +603,199 @@ dseed::error_t dseed::bitmaps::detect_bitmap_decoder(dseed::io::stream* stream,
 		{
 			if (*decoder)
 				(*decoder)->release();
+			*decoder = nullptr;
 		}
 	}
 
 	return dseed::error_not_support;
-}
\ No newline at end of file
+}
+
+// Index of first decoder whose prober accepts stream, -1 if none
+int32_t __probe_bitmap_decoder(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info)
+{
+	std::vector<int32_t> order;
+	__sniff_bitmap_decoders(stream, order);
+
+	for (auto i : order)
+	{
+		if (g_bitmap_decoder_prober[i] == nullptr)
+			continue;
+
+		stream->seek(dseed::io::seekorigin::begin, 0);
+		if (dseed::succeeded(g_bitmap_decoder_prober[i](stream, info)))
+			return i;
+	}
+
+	return -1;
+}
+
+dseed::error_t dseed::bitmaps::detect_bitmap_info(dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info)
+{
+	if (stream == nullptr || !stream->seekable() || info == nullptr)
+		return dseed::error_invalid_args;
+
+	if (__probe_bitmap_decoder(stream, info) < 0)
+		return dseed::error_not_support;
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_bitmap_into(dseed::io::stream* stream, void* pixels, size_t stride, size_t length, dseed::bitmaps::bitmap_info* info)
+{
+	if (stream == nullptr || !stream->seekable() || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	// Decoder is chosen by prober, so other decoders never write garbage into caller memory
+	dseed::bitmaps::bitmap_info probed;
+	auto index = __probe_bitmap_decoder(stream, &probed);
+	if (index < 0 || g_bitmap_decoder_into[index] == nullptr)
+		return dseed::error_not_support;
+
+	stream->seek(dseed::io::seekorigin::begin, 0);
+	return g_bitmap_decoder_into[index](stream, pixels, stride, length, info);
+}
+
+dseed::error_t dseed::bitmaps::decode_bitmap_into(dseed::io::stream* stream, dseed::bitmaps::bitmap* destination)
+{
+	if (stream == nullptr || !stream->seekable() || destination == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::bitmaps::bitmap_info info;
+	auto index = __probe_bitmap_decoder(stream, &info);
+	if (index < 0 || g_bitmap_decoder_into[index] == nullptr)
+		return dseed::error_not_support;
+
+	// Header is checked first, so destination is not touched when layout differs
+	const auto size = destination->size();
+	const auto format = destination->format();
+	if (info.format != format || info.size.width != size.width || info.size.height != size.height)
+		return dseed::error_invalid_args;
+
+	void* ptr;
+	if (dseed::failed(destination->lock(&ptr)))
+		return dseed::error_fail;
+
+	stream->seek(dseed::io::seekorigin::begin, 0);
+	// Rows of bitmap are aligned for 24-bit formats, so its stride is given instead of packed rows
+	auto err = g_bitmap_decoder_into[index](stream, ptr, dseed::color::calc_bitmap_stride(format, size.width),
+		dseed::color::calc_bitmap_total_size(format, size), nullptr);
+
+	destination->unlock();
+	return err;
+}
+
+// Stream over preallocated blob for encode_bitmap_into
+//  : Encoders may seek back after writing, so end of encoded bytes is farthest written position.
+class __blob_encode_stream : public dseed::io::stream
+{
+public:
+	__blob_encode_stream(dseed::blob* blob)
+		: _refCount(1), _blob(blob), _position(0), _end(0), _overflowed(false)
+	{ }
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual size_t read(void* buffer, size_t length) noexcept override
+	{
+		length = dseed::minimum(length, _end - dseed::minimum(_position, _end));
+		memcpy(buffer, (const uint8_t*)_blob->ptr() + _position, length);
+		_position += length;
+		return length;
+	}
+	virtual size_t write(const void* data, size_t length) noexcept override
+	{
+		if (length > _blob->size() - _position)
+		{
+			_overflowed = true;
+			return 0;
+		}
+
+		memcpy((uint8_t*)_blob->ptr() + _position, data, length);
+		_position += length;
+		_end = dseed::maximum(_end, _position);
+		return length;
+	}
+	virtual bool seek(dseed::io::seekorigin origin, size_t offset) noexcept override
+	{
+		switch (origin)
+		{
+		case dseed::io::seekorigin::begin: break;
+		case dseed::io::seekorigin::current: offset += _position; break;
+		case dseed::io::seekorigin::end: offset = _end - offset; break;
+		default: return false;
+		}
+		if (offset > _blob->size())
+			return false;
+
+		_position = offset;
+		return true;
+	}
+	virtual void flush() noexcept override { }
+	virtual dseed::error_t set_length(size_t length) noexcept override
+	{
+		if (length > _blob->size())
+			return dseed::error_out_of_range;
+		_end = length;
+		return dseed::error_good;
+	}
+
+public:
+	virtual size_t position() noexcept override { return _position; }
+	virtual size_t length() noexcept override { return _end; }
+
+public:
+	virtual bool readable() noexcept override { return true; }
+	virtual bool writable() noexcept override { return true; }
+	virtual bool seekable() noexcept override { return true; }
+
+public:
+	inline size_t end() const noexcept { return _end; }
+	inline bool overflowed() const noexcept { return _overflowed; }
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::blob> _blob;
+	size_t _position, _end;
+	bool _overflowed;
+};
+
+dseed::error_t dseed::bitmaps::encode_bitmap_into(encoder_creator_func creator, const bitmap_encoder_options* options,
+	bitmap* const* frames, size_t count, dseed::blob* blob, size_t* written)
+{
+	if (creator == nullptr || frames == nullptr || count == 0 || blob == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::autoref<__blob_encode_stream> stream;
+	stream.attach(new __blob_encode_stream(blob));
+	if (stream == nullptr)
+		return dseed::error_out_of_memory;
+
+	// Stream without buffer is given, so encoders write straight into blob memory
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, 0, &buffered); dseed::failed(err))
+		return err;
+
+	dseed::autoref<dseed::bitmaps::bitmap_encoder> encoder;
+	auto err = creator(buffered, options, &encoder);
+	for (size_t i = 0; i < count && dseed::succeeded(err); ++i)
+		err = encoder->encode_frame(frames[i]);
+	if (dseed::succeeded(err))
+		err = encoder->commit();
+
+	if (stream->overflowed())
+		return dseed::error_out_of_range;
+	if (dseed::failed(err))
+		return err;
+
+	if (written != nullptr)
+		*written = stream->end();
+	return dseed::error_good;
+}
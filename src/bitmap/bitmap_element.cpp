@@ -1,46 +1,104 @@
 #include <dseed.h>
 
+#include <cassert>
+#include <mutex>
+#include <vector>
+
+#include "common.hxx"
+
+using namespace dseed::color;
+using namespace dseed::bitmaps::rowkernel;
+using size2i = dseed::size2i;
+
+// Deinterleave whole interleaved pixels into element planes
+//  : Null plane is written to scratch row and discarded.
+//  : planeStride, planeDepth are bytes of one row and one depth of each plane.
+inline void __split_planes(const uint8_t* src, pixelformat format, const dseed::size3i& size,
+	uint8_t* const* planes, size_t planeStride, size_t planeDepth, uint8_t* scratch) noexcept
+{
+	const auto type = format2element(format);
+	const size_t elements = format2elements(format);
+	const size_t stride = calc_bitmap_stride(format, size.width);
+	const size_t depth = calc_bitmap_plane_size(format, size2i(size.width, size.height));
+
+	uint8_t* rowPlanes[4];
+	for (size_t z = 0; z < size.depth; ++z)
+	{
+		for (size_t y = 0; y < size.height; ++y)
+		{
+			const uint8_t* srcRow = src + (z * depth) + (y * stride);
+			for (size_t e = 0; e < elements; ++e)
+				rowPlanes[e] = planes[e] ? planes[e] + (z * planeDepth) + (y * planeStride) : scratch;
+
+			if (elements == 1)
+				memcpy(rowPlanes[0], srcRow, size.width * element_size(type));
+			else if (type == elementtype::single && elements == 4)
+				deinterleavef(reinterpret_cast<float* const*>(rowPlanes), reinterpret_cast<const float*>(srcRow), size.width);
+			else
+				deinterleave8(rowPlanes, srcRow, size.width, elements);
+		}
+	}
+}
+
+// Interleave element planes into whole interleaved pixels
+inline void __join_planes(uint8_t* dest, pixelformat format, const dseed::size3i& size,
+	const uint8_t* const* planes, size_t planeStride, size_t planeDepth) noexcept
+{
+	const auto type = format2element(format);
+	const size_t elements = format2elements(format);
+	const size_t stride = calc_bitmap_stride(format, size.width);
+	const size_t depth = calc_bitmap_plane_size(format, size2i(size.width, size.height));
+
+	const uint8_t* rowPlanes[4];
+	for (size_t z = 0; z < size.depth; ++z)
+	{
+		for (size_t y = 0; y < size.height; ++y)
+		{
+			uint8_t* destRow = dest + (z * depth) + (y * stride);
+			for (size_t e = 0; e < elements; ++e)
+				rowPlanes[e] = planes[e] + (z * planeDepth) + (y * planeStride);
+
+			if (elements == 1)
+				memcpy(destRow, rowPlanes[0], size.width * element_size(type));
+			else if (type == elementtype::single && elements == 4)
+				interleavef(reinterpret_cast<float*>(destRow), reinterpret_cast<const float* const*>(rowPlanes), size.width);
+			else
+				interleave8(destRow, rowPlanes, size.width, elements);
+		}
+	}
+}
+
 dseed::error_t dseed::bitmaps::bitmap_split_rgb_elements(bitmap* original, bitmap** r, bitmap** g, bitmap** b, bitmap** a)
 {
+	if (original == nullptr)
+		return dseed::error_invalid_args;
+
 	const auto bitmaptype = original->type();
 	const auto format = original->format();
 	const auto size = original->size();
-	const auto stride = dseed::color::calc_bitmap_stride(format, size.width);
 
-	dseed::color::pixelformat outputFormat = dseed::color::pixelformat::rf;
-	auto bytesPerSampleOriginal = 0, bytesPerSampleSplit = 0;
+	pixelformat outputFormat;
 	bool has_alpha = false;
 	switch (format) {
-	case dseed::color::pixelformat::rgb8:
-	case dseed::color::pixelformat::bgr8:
-	case dseed::color::pixelformat::yuv8:
-	case dseed::color::pixelformat::hsv8:
-		outputFormat = dseed::color::pixelformat::r8;
-		bytesPerSampleOriginal = 3;
-		bytesPerSampleSplit = 1;
+	case pixelformat::rgb8:
+	case pixelformat::bgr8:
+	case pixelformat::yuv8:
+	case pixelformat::hsv8:
+	case pixelformat::bgr565:
+		outputFormat = pixelformat::r8;
 		break;
 
-	case dseed::color::pixelformat::bgr565:
-	case dseed::color::pixelformat::bgra4:
-		outputFormat = dseed::color::pixelformat::r8;
-		bytesPerSampleOriginal = 2;
-		bytesPerSampleSplit = 1;
-		break;
-
-	case dseed::color::pixelformat::rgba8:
-	case dseed::color::pixelformat::bgra8:
-	case dseed::color::pixelformat::yuva8:
-	case dseed::color::pixelformat::hsva8:
-		outputFormat = dseed::color::pixelformat::r8;
-		bytesPerSampleOriginal = 4;
-		bytesPerSampleSplit = 1;
+	case pixelformat::rgba8:
+	case pixelformat::bgra8:
+	case pixelformat::yuva8:
+	case pixelformat::hsva8:
+	case pixelformat::bgra4:
+		outputFormat = pixelformat::r8;
 		has_alpha = true;
 		break;
 
-	case dseed::color::pixelformat::rgbaf:
-		outputFormat = dseed::color::pixelformat::rf;
-		bytesPerSampleOriginal = 16;
-		bytesPerSampleSplit = 4;
+	case pixelformat::rgbaf:
+		outputFormat = pixelformat::rf;
 		has_alpha = true;
 		break;
 
@@ -48,8 +106,6 @@ dseed::error_t dseed::bitmaps::bitmap_split_rgb_elements(bitmap* original, bitma
 		return dseed::error_invalid_args;
 	}
 
-	auto strideSplit = dseed::color::calc_bitmap_stride(outputFormat, size.width);
-
 	dseed::autoref<dseed::bitmaps::bitmap> tr, tg, tb, ta;
 	auto rr =
 		r != nullptr
@@ -71,96 +127,47 @@ dseed::error_t dseed::bitmaps::bitmap_split_rgb_elements(bitmap* original, bitma
 	if (rr != dseed::error_good || rg != dseed::error_good || rb != dseed::error_good || ra != dseed::error_good)
 		return dseed::error_fail;
 
-	void* originalPtr;
-	original->lock(&originalPtr);
+	const uint8_t* originalPtr;
+	original->lock((void**)&originalPtr);
 
-	void* pr = nullptr,
-		* pg = nullptr,
-		* pb = nullptr,
-		* pa = nullptr;
-	if (tr) tr->lock(&pr);
-	if (tg) tg->lock(&pg);
-	if (tb) tb->lock(&pb);
-	if (ta) ta->lock(&pa);
+	uint8_t* planes[4] = { nullptr, nullptr, nullptr, nullptr };
+	if (tr) tr->lock((void**)&planes[0]);
+	if (tg) tg->lock((void**)&planes[1]);
+	if (tb) tb->lock((void**)&planes[2]);
+	if (ta) ta->lock((void**)&planes[3]);
 
-	for (auto z = 0; z < size.depth; ++z)
+	const size_t planeStride = calc_bitmap_stride(outputFormat, size.width);
+	const size_t planeDepth = calc_bitmap_plane_size(outputFormat, size2i(size.width, size.height));
+
+	if (format == pixelformat::bgr565 || format == pixelformat::bgra4)
 	{
-		for (auto y = 0; y < size.height; ++y)
+		// Packed formats need unpacking per pixel
+		const size_t stride = calc_bitmap_stride(format, size.width);
+		const size_t depth = calc_bitmap_plane_size(format, size2i(size.width, size.height));
+		for (size_t z = 0; z < size.depth; ++z)
 		{
-			const auto yStrideOriginal = y * stride;
-			const auto yStride = y * strideSplit;
-			for (auto x = 0; x < size.width; ++x)
+			for (size_t y = 0; y < size.height; ++y)
 			{
-				const auto xBytesPerSample = x * bytesPerSampleSplit;
-				void* offsetPtrOriginal = static_cast<int8_t*>(originalPtr) + yStrideOriginal + (x * bytesPerSampleOriginal);
-				void* offsetPtrRed = pr ? static_cast<int8_t*>(pr) + yStride + xBytesPerSample : nullptr;
-				void* offsetPtrGreen = pg ? static_cast<int8_t*>(pg) + yStride + xBytesPerSample : nullptr;
-				void* offsetPtrBlue = pb ? static_cast<int8_t*>(pb) + yStride + xBytesPerSample : nullptr;
-				void* offsetPtrAlpha = pa ? static_cast<int8_t*>(pa) + yStride + xBytesPerSample : nullptr;
-
-				switch (format) {
-				case dseed::color::pixelformat::rgb8:
-				case dseed::color::pixelformat::bgr8:
-				case dseed::color::pixelformat::yuv8:
-				case dseed::color::pixelformat::hsv8:
-				{
-					const auto origin = static_cast<const dseed::color::rgb8*>(offsetPtrOriginal);
-					if (offsetPtrRed) *static_cast<uint8_t*>(offsetPtrRed) = origin->r;
-					if (offsetPtrGreen) *static_cast<uint8_t*>(offsetPtrGreen) = origin->g;
-					if (offsetPtrBlue) *static_cast<uint8_t*>(offsetPtrBlue) = origin->b;
-					break;
-				}
-
-				case dseed::color::pixelformat::bgr565:
+				const uint8_t* srcRow = originalPtr + (z * depth) + (y * stride);
+				const size_t planeOffset = (z * planeDepth) + (y * planeStride);
+				for (size_t x = 0; x < size.width; ++x)
 				{
-					const auto origin = static_cast<const dseed::color::bgr565*>(offsetPtrOriginal);
-					const dseed::color::bgra8 bgra8 = *origin;
-					if (offsetPtrRed) *static_cast<uint8_t*>(offsetPtrRed) = bgra8.r;
-					if (offsetPtrGreen) *static_cast<uint8_t*>(offsetPtrGreen) = bgra8.g;
-					if (offsetPtrBlue) *static_cast<uint8_t*>(offsetPtrBlue) = bgra8.b;
-					break;
-				}
-					
-				case dseed::color::pixelformat::bgra4:
-				{
-					const auto origin = static_cast<const dseed::color::bgra4*>(offsetPtrOriginal);
-					const dseed::color::bgra8 bgra8 = *origin;
-					if (offsetPtrRed) *static_cast<uint8_t*>(offsetPtrRed) = bgra8.r;
-					if (offsetPtrGreen) *static_cast<uint8_t*>(offsetPtrGreen) = bgra8.g;
-					if (offsetPtrBlue) *static_cast<uint8_t*>(offsetPtrBlue) = bgra8.b;
-					if (offsetPtrAlpha) *static_cast<uint8_t*>(offsetPtrBlue) = bgra8.a;
-					break;
-				}
-
-				case dseed::color::pixelformat::rgba8:
-				case dseed::color::pixelformat::bgra8:
-				case dseed::color::pixelformat::yuva8:
-				case dseed::color::pixelformat::hsva8:
-				{
-					const auto origin = static_cast<const dseed::color::rgba8*>(offsetPtrOriginal);
-					if (offsetPtrRed) *static_cast<uint8_t*>(offsetPtrRed) = origin->r;
-					if (offsetPtrGreen) *static_cast<uint8_t*>(offsetPtrGreen) = origin->g;
-					if (offsetPtrBlue) *static_cast<uint8_t*>(offsetPtrBlue) = origin->b;
-					if (offsetPtrAlpha) *static_cast<uint8_t*>(offsetPtrAlpha) = origin->a;
-					break;
-				}
-
-				case dseed::color::pixelformat::rgbaf:
-				{
-					const auto origin = static_cast<const dseed::color::rgbaf*>(offsetPtrOriginal);
-					if (offsetPtrRed) *static_cast<float*>(offsetPtrRed) = origin->r;
-					if (offsetPtrGreen) *static_cast<float*>(offsetPtrGreen) = origin->g;
-					if (offsetPtrBlue) *static_cast<float*>(offsetPtrBlue) = origin->b;
-					if (offsetPtrAlpha) *static_cast<float*>(offsetPtrAlpha) = origin->a;
-					break;
-				}
-
-				default:
-					return dseed::error_invalid_op;
+					const bgra8 pixel = (format == pixelformat::bgr565)
+						? bgra8(reinterpret_cast<const bgr565*>(srcRow)[x])
+						: bgra8(reinterpret_cast<const bgra4*>(srcRow)[x]);
+					if (planes[0]) planes[0][planeOffset + x] = pixel.r;
+					if (planes[1]) planes[1][planeOffset + x] = pixel.g;
+					if (planes[2]) planes[2][planeOffset + x] = pixel.b;
+					if (planes[3]) planes[3][planeOffset + x] = pixel.a;
 				}
 			}
 		}
 	}
+	else
+	{
+		std::vector<uint8_t> scratch(size.width * element_size(format2element(format)));
+		__split_planes(originalPtr, format, size, planes, planeStride, planeDepth, scratch.data());
+	}
 
 	original->unlock();
 
@@ -179,135 +186,263 @@ dseed::error_t dseed::bitmaps::bitmap_split_rgb_elements(bitmap* original, bitma
 
 dseed::error_t dseed::bitmaps::bitmap_join_rgb_elements(bitmap* r, bitmap* g, bitmap* b, bitmap* a, bitmap** rgba)
 {
-	if (!r || !g || !b)
+	if (!r || !g || !b || !rgba)
 		return dseed::error_invalid_args;
 
 	const auto bitmaptype = r->type();
 	const auto format = r->format();
 	const auto size = r->size();
-	const auto stride = dseed::color::calc_bitmap_stride(format, size.width);
-	int bytesPerSampleSplit = 0;
-	int bytesPerSampleOriginal = 0;
 
-	if (format != g->format() || format != b->format() || (format != dseed::color::pixelformat::r8 && format != dseed::color::pixelformat::rf))
+	if (format != g->format() || format != b->format() || (format != pixelformat::r8 && format != pixelformat::rf))
 		return dseed::error_invalid_args;
 	if (bitmaptype != g->type() || bitmaptype != b->type())
 		return dseed::error_invalid_args;
 	if (size != g->size() || size != b->size())
 		return dseed::error_invalid_args;
 
-	auto outputFormat = dseed::color::pixelformat::unknown;
-
+	auto outputFormat = pixelformat::unknown;
 	if (a)
 	{
 		if (a->format() != format || a->type() != bitmaptype || a->size() != size)
 			return dseed::error_invalid_args;
 
-		if (format == dseed::color::pixelformat::r8)
-		{
-			outputFormat = dseed::color::pixelformat::rgba8;
-			bytesPerSampleSplit = 1;
-			bytesPerSampleOriginal = 4;
-		}
-		else if (format == dseed::color::pixelformat::rf)
-		{
-			outputFormat = dseed::color::pixelformat::rgbaf;
-			bytesPerSampleSplit = 4;
-			bytesPerSampleOriginal = 16;
-		}
-		else
-			return dseed::error_invalid_args;
+		outputFormat = (format == pixelformat::r8) ? pixelformat::rgba8 : pixelformat::rgbaf;
 	}
 	else
 	{
-		if (format == dseed::color::pixelformat::r8)
-		{
-			outputFormat = dseed::color::pixelformat::rgb8;
-			bytesPerSampleSplit = 1;
-		}
-		else
+		if (format != pixelformat::r8)
 			return dseed::error_invalid_args;
 
-		bytesPerSampleOriginal = 3;
+		outputFormat = pixelformat::rgb8;
+	}
+
+	// Same bitmap can be passed as multiple elements
+	bitmap* sources[4] = { r, g, b, a };
+	const uint8_t* planes[4] = { nullptr, nullptr, nullptr, nullptr };
+	for (int i = 0; i < 4 && sources[i]; ++i)
+	{
+		for (int j = 0; j < i; ++j)
+		{
+			if (sources[j] == sources[i])
+			{
+				planes[i] = planes[j];
+				break;
+			}
+		}
+		if (planes[i] == nullptr)
+			sources[i]->lock((void**)&planes[i]);
 	}
 
-	if (dseed::failed(dseed::bitmaps::create_bitmap(bitmaptype, size, outputFormat, nullptr, rgba)))
+	dseed::autoref<dseed::bitmaps::bitmap> temp;
+	if (dseed::failed(dseed::bitmaps::create_bitmap(bitmaptype, size, outputFormat, nullptr, &temp)))
 		return dseed::error_fail;
 
-	const auto outputStride = dseed::color::calc_bitmap_stride(outputFormat, size.width);
+	uint8_t* destPtr;
+	temp->lock((void**)&destPtr);
 
-	void* rgbaPtr;
-	(*rgba)->lock(&rgbaPtr);
+	__join_planes(destPtr, outputFormat, size, planes,
+		calc_bitmap_stride(format, size.width), calc_bitmap_plane_size(format, size2i(size.width, size.height)));
 
-	void* pr = nullptr,
-		* pg = nullptr,
-		* pb = nullptr,
-		* pa = nullptr;
-	r->lock(&pr);
-	g->lock(&pg);
-	b->lock(&pb);
-	if (a) a->lock(&pa);
+	temp->unlock();
 
-	for (auto z = 0; z < size.depth; ++z)
+	for (int i = 3; i >= 0; --i)
 	{
-		for (auto y = 0; y < size.height; ++y)
-		{
-			auto yStride = outputStride * y;
-			auto yStrideElement = stride * y;
+		if (sources[i] == nullptr)
+			continue;
+
+		bool duplicated = false;
+		for (int j = 0; j < i; ++j)
+			if (sources[j] == sources[i])
+				duplicated = true;
+		if (!duplicated)
+			sources[i]->unlock();
+	}
 
-			for (auto x = 0; x < size.width; ++x)
-			{
-				const auto xBytesPerSample = x * bytesPerSampleSplit;
-				void* offsetPtrOriginal = static_cast<int8_t*>(rgbaPtr) + yStride + (x * bytesPerSampleOriginal);
-				void* offsetPtrRed = static_cast<int8_t*>(pr) + yStrideElement + xBytesPerSample;
-				void* offsetPtrGreen = static_cast<int8_t*>(pg) + yStrideElement + xBytesPerSample;
-				void* offsetPtrBlue = static_cast<int8_t*>(pb) + yStrideElement + xBytesPerSample;
-				void* offsetPtrAlpha = pa ? static_cast<int8_t*>(pa) + yStrideElement + xBytesPerSample : nullptr;
-
-				switch (outputFormat)
-				{
-				case dseed::color::pixelformat::rgb8:
-				{
-					dseed::color::rgb8* r = static_cast<dseed::color::rgb8*>(offsetPtrOriginal);
-					r->r = *((uint8_t*)offsetPtrRed);
-					r->g = *((uint8_t*)offsetPtrGreen);
-					r->b = *((uint8_t*)offsetPtrBlue);
-				}
-				break;
+	*rgba = temp.detach();
 
-				case dseed::color::pixelformat::rgba8:
-				{
-					dseed::color::rgba8* r = static_cast<dseed::color::rgba8*>(offsetPtrOriginal);
-					r->r = *((uint8_t*)offsetPtrRed);
-					r->g = *((uint8_t*)offsetPtrGreen);
-					r->b = *((uint8_t*)offsetPtrBlue);
-					r->a = *((uint8_t*)offsetPtrAlpha);
-				}
-				break;
+	return dseed::error_good;
+}
 
-				case dseed::color::pixelformat::rgbaf:
-				{
-					dseed::color::rgbaf* r = static_cast<dseed::color::rgbaf*>(offsetPtrOriginal);
-					r->r = *((float*)offsetPtrRed);
-					r->g = *((float*)offsetPtrGreen);
-					r->b = *((float*)offsetPtrBlue);
-					r->a = *((float*)offsetPtrAlpha);
-				}
-				break;
+class __internal_planar_bitmap : public dseed::bitmaps::planar_bitmap
+{
+public:
+	__internal_planar_bitmap(dseed::bitmaps::bitmaptype type, const dseed::size3i& size, pixelformat format)
+		: _refCount(1), _type(type), _size(size), _format(format)
+	{
+		const auto elementType = format2element(format);
+		_planeFormat = (elementType == elementtype::single) ? pixelformat::rf : pixelformat::r8;
+		_planes = format2elements(format);
+		_planeSize = calc_bitmap_total_size(_planeFormat, size);
 
-				default:
-					return dseed::error_invalid_op;
-				}
-			}
-		}
+		_pixels.resize(_planeSize * _planes);
+	}
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::bitmaps::bitmaptype type() noexcept override { return _type; }
+	virtual dseed::size3i size() noexcept override { return _size; }
+	virtual pixelformat format() noexcept override { return _format; }
+	virtual pixelformat plane_format() noexcept override { return _planeFormat; }
+	virtual size_t planes() noexcept override { return _planes; }
+	virtual size_t plane_size() noexcept override { return _planeSize; }
+
+public:
+	virtual dseed::error_t lock(void** ptr) noexcept override
+	{
+		if (ptr == nullptr)
+			return dseed::error_invalid_args;
+		if (!_mutex.try_lock())
+			_mutex.lock();
+		*ptr = _pixels.data();
+		return dseed::error_good;
+	}
+	virtual dseed::error_t unlock() noexcept override
+	{
+		_mutex.unlock();
+		return dseed::error_good;
+	}
+
+public:
+	virtual dseed::error_t plane(size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		if (index >= _planes || bitmap == nullptr)
+			return dseed::error_invalid_args;
+
+		std::lock_guard<std::mutex> guard(_mutex);
+		return dseed::bitmaps::create_bitmap(_pixels.data() + (index * _planeSize), _type, _size, _planeFormat, nullptr, bitmap);
 	}
 
-	if (a) a->unlock();
-	b->unlock();
-	g->unlock();
-	r->unlock();
+private:
+	std::atomic<int32_t> _refCount;
+
+	dseed::bitmaps::bitmaptype _type;
+	dseed::size3i _size;
+	pixelformat _format, _planeFormat;
+	size_t _planes, _planeSize;
+
+	std::vector<uint8_t> _pixels;
+	std::mutex _mutex;
+};
+
+dseed::error_t dseed::bitmaps::create_planar_bitmap(bitmaptype type, const size3i& size, color::pixelformat format, planar_bitmap** bitmap) noexcept
+{
+	if (bitmap == nullptr || size.width <= 0 || size.height <= 0 || size.depth <= 0)
+		return dseed::error_invalid_args;
+	if (format2element(format) == elementtype::unknown)
+		return dseed::error_not_support;
+
+	*bitmap = new __internal_planar_bitmap(type, size, format);
+	if (*bitmap == nullptr)
+		return dseed::error_out_of_memory;
+
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::bitmap_split_planar(bitmap* original, planar_bitmap** planar)
+{
+	if (original == nullptr || planar == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::autoref<planar_bitmap> temp;
+	if (auto err = create_planar_bitmap(original->type(), original->size(), original->format(), &temp); dseed::failed(err))
+		return err;
+
+	if (auto err = bitmap_split_planar_into(original, temp); dseed::failed(err))
+		return err;
+
+	*planar = temp.detach();
+
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::bitmap_split_planar_into(bitmap* original, planar_bitmap* planar)
+{
+	if (original == nullptr || planar == nullptr)
+		return dseed::error_invalid_args;
+
+	const auto size = original->size();
+	const auto planarSize = planar->size();
+	if (original->type() != planar->type() || original->format() != planar->format()
+		|| size.width != planarSize.width || size.height != planarSize.height || size.depth != planarSize.depth)
+		return dseed::error_invalid_args;
+
+	const auto planeFormat = planar->plane_format();
+	const size_t planeSize = planar->plane_size();
+
+	const uint8_t* srcPtr;
+	uint8_t* planarPtr;
+	original->lock((void**)&srcPtr);
+	planar->lock((void**)&planarPtr);
+
+	uint8_t* planes[4] = { nullptr, nullptr, nullptr, nullptr };
+	assert(planar->planes() <= 4);
+	for (size_t i = 0; i < planar->planes(); ++i)
+		planes[i] = planarPtr + (i * planeSize);
+
+	__split_planes(srcPtr, original->format(), size, planes,
+		calc_bitmap_stride(planeFormat, size.width), calc_bitmap_plane_size(planeFormat, size2i(size.width, size.height)), nullptr);
+
+	planar->unlock();
+	original->unlock();
+
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::bitmap_join_planar(planar_bitmap* planar, bitmap** bitmap)
+{
+	if (planar == nullptr || bitmap == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::autoref<dseed::bitmaps::bitmap> temp;
+	if (dseed::failed(dseed::bitmaps::create_bitmap(planar->type(), planar->size(), planar->format(), nullptr, &temp)))
+		return dseed::error_fail;
+
+	if (auto err = bitmap_join_planar_into(planar, temp); dseed::failed(err))
+		return err;
+
+	*bitmap = temp.detach();
+
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::bitmap_join_planar_into(planar_bitmap* planar, bitmap* bitmap)
+{
+	if (planar == nullptr || bitmap == nullptr)
+		return dseed::error_invalid_args;
+
+	const auto size = bitmap->size();
+	const auto planarSize = planar->size();
+	if (bitmap->type() != planar->type() || bitmap->format() != planar->format()
+		|| size.width != planarSize.width || size.height != planarSize.height || size.depth != planarSize.depth)
+		return dseed::error_invalid_args;
+
+	const auto planeFormat = planar->plane_format();
+	const size_t planeSize = planar->plane_size();
 
-	(*rgba)->unlock();
+	const uint8_t* planarPtr;
+	uint8_t* destPtr;
+	planar->lock((void**)&planarPtr);
+	bitmap->lock((void**)&destPtr);
+
+	const uint8_t* planes[4] = { nullptr, nullptr, nullptr, nullptr };
+	assert(planar->planes() <= 4);
+	for (size_t i = 0; i < planar->planes(); ++i)
+		planes[i] = planarPtr + (i * planeSize);
+
+	__join_planes(destPtr, bitmap->format(), size, planes,
+		calc_bitmap_stride(planeFormat, size.width), calc_bitmap_plane_size(planeFormat, size2i(size.width, size.height)));
+
+	bitmap->unlock();
+	planar->unlock();
 
 	return dseed::error_good;
-}
\ No newline at end of file
+}
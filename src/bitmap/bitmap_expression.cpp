@@ -0,0 +1,312 @@
+#include <dseed.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "common.hxx"
+
+using namespace dseed::color;
+using namespace dseed::bitmaps::rowkernel;
+using size2i = dseed::size2i;
+
+// Tile size in bytes for one expression node
+//  : Every intermediate node owns one tile buffer, so it stays in L1/L2 cache while evaluating.
+#define EXPRESSION_TILE_SIZE						4096
+
+using exprbintp = std::tuple<elementtype, dseed::binary_operator>;
+using exprunatp = std::tuple<elementtype, dseed::unary_operator>;
+
+std::map<exprbintp, binaryfn> g_exprbinops = {
+	{ exprbintp(elementtype::byte, dseed::binary_operator::add), binary8<add8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::subtract), binary8<subtract8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::multiply), binary8<multiply8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::divide), binary8<divide8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::andop), binary8<and8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::orop), binary8<or8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::xorop), binary8<xor8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::minimum), binary8<min8op> },
+	{ exprbintp(elementtype::byte, dseed::binary_operator::maximum), binary8<max8op> },
+
+	{ exprbintp(elementtype::single, dseed::binary_operator::add), binaryf<addfop> },
+	{ exprbintp(elementtype::single, dseed::binary_operator::subtract), binaryf<subtractfop> },
+	{ exprbintp(elementtype::single, dseed::binary_operator::multiply), binaryf<multiplyfop> },
+	{ exprbintp(elementtype::single, dseed::binary_operator::divide), binaryf<dividefop> },
+	{ exprbintp(elementtype::single, dseed::binary_operator::minimum), binaryf<minfop> },
+	{ exprbintp(elementtype::single, dseed::binary_operator::maximum), binaryf<maxfop> },
+};
+
+std::map<exprunatp, unaryfn> g_exprunops = {
+	{ exprunatp(elementtype::byte, dseed::unary_operator::notop), unary8<not8op> },
+	{ exprunatp(elementtype::byte, dseed::unary_operator::invert), unary8<not8op> },
+
+	{ exprunatp(elementtype::single, dseed::unary_operator::negate), unaryf<negatefop> },
+	{ exprunatp(elementtype::single, dseed::unary_operator::invert), unaryf<invertfop> },
+};
+
+enum class expression_nodetype
+{
+	source,
+	binary,
+	unary,
+	histogram,
+};
+
+struct expression_nodeinfo
+{
+	expression_nodetype type;
+	size_t source;
+	dseed::bitmaps::expression_node n1, n2;
+	binaryfn binop;
+	unaryfn unop;
+	size_t element;
+	uint8_t table[256];
+};
+
+class __internal_bitmap_expression : public dseed::bitmaps::bitmap_expression
+{
+public:
+	__internal_bitmap_expression()
+		: _refCount(1), _type(dseed::bitmaps::bitmaptype::bitmap2d), _size(0, 0, 0), _format(pixelformat::unknown)
+	{ }
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t source(dseed::bitmaps::bitmap* bitmap, dseed::bitmaps::expression_node* node) noexcept override
+	{
+		if (bitmap == nullptr || node == nullptr)
+			return dseed::error_invalid_args;
+
+		if (_sources.empty())
+		{
+			if (format2element(bitmap->format()) == elementtype::unknown)
+				return dseed::error_not_support;
+
+			_type = bitmap->type();
+			_size = bitmap->size();
+			_format = bitmap->format();
+		}
+		else
+		{
+			const auto size = bitmap->size();
+			if (bitmap->type() != _type || bitmap->format() != _format
+				|| size.width != _size.width || size.height != _size.height || size.depth != _size.depth)
+				return dseed::error_invalid_args;
+		}
+
+		size_t sourceIndex = _sources.size();
+		for (size_t i = 0; i < _sources.size(); ++i)
+		{
+			if (_sources[i].get() == bitmap)
+			{
+				sourceIndex = i;
+				break;
+			}
+		}
+		if (sourceIndex == _sources.size())
+			_sources.emplace_back(dseed::autoref<dseed::bitmaps::bitmap>(bitmap));
+
+		expression_nodeinfo info = {};
+		info.type = expression_nodetype::source;
+		info.source = sourceIndex;
+
+		return push_node(info, node);
+	}
+	virtual dseed::error_t binary_operation(dseed::bitmaps::expression_node n1, dseed::bitmaps::expression_node n2, dseed::binary_operator op, dseed::bitmaps::expression_node* node) noexcept override
+	{
+		if (!is_valid_node(n1) || !is_valid_node(n2) || node == nullptr)
+			return dseed::error_invalid_args;
+
+		auto found = g_exprbinops.find(exprbintp(format2element(_format), op));
+		if (found == g_exprbinops.end())
+			return dseed::error_not_support;
+
+		expression_nodeinfo info = {};
+		info.type = expression_nodetype::binary;
+		info.n1 = n1;
+		info.n2 = n2;
+		info.binop = found->second;
+
+		return push_node(info, node);
+	}
+	virtual dseed::error_t unary_operation(dseed::bitmaps::expression_node n, dseed::unary_operator op, dseed::bitmaps::expression_node* node) noexcept override
+	{
+		if (!is_valid_node(n) || node == nullptr)
+			return dseed::error_invalid_args;
+
+		auto found = g_exprunops.find(exprunatp(format2element(_format), op));
+		if (found == g_exprunops.end())
+			return dseed::error_not_support;
+
+		expression_nodeinfo info = {};
+		info.type = expression_nodetype::unary;
+		info.n1 = n;
+		info.unop = found->second;
+
+		return push_node(info, node);
+	}
+	virtual dseed::error_t apply_histogram(dseed::bitmaps::expression_node n, dseed::bitmaps::histogram_color color, const dseed::bitmaps::histogram* histogram, dseed::bitmaps::expression_node* node) noexcept override
+	{
+		if (!is_valid_node(n) || histogram == nullptr || node == nullptr)
+			return dseed::error_invalid_args;
+		if (!histogram->calced_table)
+			return dseed::error_invalid_args;
+		if (format2element(_format) != elementtype::byte)
+			return dseed::error_not_support;
+		if (color < dseed::bitmaps::histogram_color::first || static_cast<size_t>(color) >= format2elements(_format))
+			return dseed::error_invalid_args;
+
+		expression_nodeinfo info = {};
+		info.type = expression_nodetype::histogram;
+		info.n1 = n;
+		info.element = static_cast<size_t>(color);
+		for (int i = 0; i < 256; ++i)
+			info.table[i] = saturate8(histogram->histogram_table[i]);
+
+		return push_node(info, node);
+	}
+
+public:
+	virtual dseed::error_t evaluate(dseed::bitmaps::expression_node root, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		if (!is_valid_node(root) || bitmap == nullptr)
+			return dseed::error_invalid_args;
+
+		std::vector<bool> reachable(root + 1, false);
+		reachable[root] = true;
+		for (auto i = root; i >= 0; --i)
+		{
+			if (!reachable[i])
+				continue;
+
+			const auto& info = _nodes[i];
+			if (info.type == expression_nodetype::binary)
+				reachable[info.n1] = reachable[info.n2] = true;
+			else if (info.type == expression_nodetype::unary || info.type == expression_nodetype::histogram)
+				reachable[info.n1] = true;
+		}
+
+		const size_t elementSize = element_size(format2element(_format));
+		const size_t elementsPerPixel = format2elements(_format);
+		const size_t rowElements = _size.width * elementsPerPixel;
+		const size_t tileElements = EXPRESSION_TILE_SIZE / elementSize;
+		const size_t stride = calc_bitmap_stride(_format, _size.width);
+		const size_t depth = calc_bitmap_plane_size(_format, size2i(_size.width, _size.height));
+
+		std::vector<std::vector<uint8_t>> tiles(root + 1);
+		for (auto i = 0; i < root; ++i)
+			if (reachable[i] && _nodes[i].type != expression_nodetype::source)
+				tiles[i].resize(EXPRESSION_TILE_SIZE);
+
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed(dseed::bitmaps::create_bitmap(_type, _size, _format, nullptr, &temp)))
+			return dseed::error_fail;
+
+		std::vector<const uint8_t*> sourcePtrs(_sources.size());
+		for (size_t i = 0; i < _sources.size(); ++i)
+			_sources[i]->lock((void**)&sourcePtrs[i]);
+		uint8_t* destPtr;
+		temp->lock((void**)&destPtr);
+
+		std::vector<const void*> nodePtrs(root + 1);
+		for (size_t z = 0; z < _size.depth; ++z)
+		{
+			const size_t depthZ = z * depth;
+			for (size_t y = 0; y < _size.height; ++y)
+			{
+				const size_t rowOffset = depthZ + (y * stride);
+
+				for (size_t x = 0; x < rowElements; x += tileElements)
+				{
+					const size_t count = dseed::minimum(tileElements, rowElements - x);
+					const size_t byteOffset = rowOffset + (x * elementSize);
+
+					for (auto i = 0; i <= root; ++i)
+					{
+						if (!reachable[i])
+							continue;
+
+						const auto& info = _nodes[i];
+						if (info.type == expression_nodetype::source)
+						{
+							nodePtrs[i] = sourcePtrs[info.source] + byteOffset;
+							continue;
+						}
+
+						void* nodeDest = (i == root) ? (void*)(destPtr + byteOffset) : (void*)tiles[i].data();
+						switch (info.type)
+						{
+						case expression_nodetype::binary:
+							info.binop(nodeDest, nodePtrs[info.n1], nodePtrs[info.n2], count);
+							break;
+						case expression_nodetype::unary:
+							info.unop(nodeDest, nodePtrs[info.n1], count);
+							break;
+						case expression_nodetype::histogram:
+							lookup8(reinterpret_cast<uint8_t*>(nodeDest), reinterpret_cast<const uint8_t*>(nodePtrs[info.n1]),
+								count, x, elementsPerPixel, info.element, info.table);
+							break;
+						default:
+							break;
+						}
+						nodePtrs[i] = nodeDest;
+					}
+
+					if (_nodes[root].type == expression_nodetype::source)
+						memcpy(destPtr + byteOffset, nodePtrs[root], count * elementSize);
+				}
+			}
+		}
+
+		temp->unlock();
+		for (auto& source : _sources)
+			source->unlock();
+
+		*bitmap = temp.detach();
+
+		return dseed::error_good;
+	}
+
+private:
+	inline bool is_valid_node(dseed::bitmaps::expression_node node) const noexcept
+	{
+		return node >= 0 && node < (dseed::bitmaps::expression_node)_nodes.size();
+	}
+	inline dseed::error_t push_node(const expression_nodeinfo& info, dseed::bitmaps::expression_node* node) noexcept
+	{
+		_nodes.push_back(info);
+		*node = (dseed::bitmaps::expression_node)(_nodes.size() - 1);
+		return dseed::error_good;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+
+	dseed::bitmaps::bitmaptype _type;
+	dseed::size3i _size;
+	pixelformat _format;
+
+	std::vector<dseed::autoref<dseed::bitmaps::bitmap>> _sources;
+	std::vector<expression_nodeinfo> _nodes;
+};
+
+dseed::error_t dseed::bitmaps::create_bitmap_expression(bitmap_expression** expression) noexcept
+{
+	if (expression == nullptr)
+		return dseed::error_invalid_args;
+
+	*expression = new __internal_bitmap_expression();
+	if (*expression == nullptr)
+		return dseed::error_out_of_memory;
+
+	return dseed::error_good;
+}
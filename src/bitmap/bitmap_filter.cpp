@@ -165,6 +165,10 @@ dseed::error_t dseed::bitmaps::filter_bitmap(dseed::bitmaps::bitmap* original, c
 	if (mask.width % 2 == 0 || mask.height % 2 == 0)
 		return dseed::error_invalid_args;
 
+	auto found = g_filters.find(original->format());
+	if (found == g_filters.end())
+		return dseed::error_not_support;
+
 	dseed::autoref<dseed::bitmaps::bitmap> temp;
 	if (dseed::failed(dseed::bitmaps::create_bitmap(original->type(), original->size(), original->format(), nullptr, &temp)))
 		return dseed::error_fail;
@@ -173,16 +177,14 @@ dseed::error_t dseed::bitmaps::filter_bitmap(dseed::bitmaps::bitmap* original, c
 	original->lock((void**)&srcPtr);
 	temp->lock((void**)&destPtr);
 
-	auto found = g_filters.find(original->format());
-	if (found == g_filters.end())
-		return dseed::error_not_support;
-
-	if (!found->second(destPtr, srcPtr, original->size(), mask))
-		return dseed::error_not_support;
+	const bool processed = found->second(destPtr, srcPtr, original->size(), mask);
 
 	temp->unlock();
 	original->unlock();
 
+	if (!processed)
+		return dseed::error_not_support;
+
 	*bitmap = temp.detach();
 
 	return dseed::error_good;
@@ -3,7 +3,10 @@
 #include <map>
 #include <tuple>
 
+#include "common.hxx"
+
 using namespace dseed::color;
+using namespace dseed::bitmaps::rowkernel;
 using size2i = dseed::size2i;
 
 template<class TPixel> inline TPixel padd(const TPixel& p1, const TPixel& p2) noexcept { return p1 + p2; }
@@ -56,100 +59,69 @@ inline bool binary_operation(uint8_t* dest, const uint8_t* src1, const uint8_t*
 }
 
 std::map<binoptp, binopfn> g_binops = {
-	{ binoptp(pixelformat::rgba8, dseed::binary_operator::add), binary_operation<rgba8, padd<rgba8>> },
-	{ binoptp(pixelformat::rgb8, dseed::binary_operator::add), binary_operation<rgb8, padd<rgb8>> },
-	{ binoptp(pixelformat::rgbaf, dseed::binary_operator::add), binary_operation<rgbaf, padd<rgbaf>> },
-	{ binoptp(pixelformat::bgra8, dseed::binary_operator::add), binary_operation<bgra8, padd<bgra8>> },
-	{ binoptp(pixelformat::bgr8, dseed::binary_operator::add), binary_operation<bgr8, padd<bgr8>> },
 	{ binoptp(pixelformat::bgra4, dseed::binary_operator::add), binary_operation<bgra4, padd<bgra4>> },
 	{ binoptp(pixelformat::bgr565, dseed::binary_operator::add), binary_operation<bgr565, padd<bgr565>> },
-	{ binoptp(pixelformat::r8, dseed::binary_operator::add), binary_operation<r8, padd<r8>> },
-	{ binoptp(pixelformat::rf, dseed::binary_operator::add), binary_operation<rf, padd<rf>> },
-	{ binoptp(pixelformat::yuva8, dseed::binary_operator::add), binary_operation<yuva8, padd<yuva8>> },
-	{ binoptp(pixelformat::yuv8, dseed::binary_operator::add), binary_operation<yuv8, padd<yuv8>> },
-	{ binoptp(pixelformat::hsva8, dseed::binary_operator::add), binary_operation<hsva8, padd<hsva8>> },
-	{ binoptp(pixelformat::hsv8, dseed::binary_operator::add), binary_operation<hsv8, padd<hsv8>> },
-
-	{ binoptp(pixelformat::rgba8, dseed::binary_operator::subtract), binary_operation<rgba8, psubtract<rgba8>> },
-	{ binoptp(pixelformat::rgb8, dseed::binary_operator::subtract), binary_operation<rgb8, psubtract<rgb8>> },
-	{ binoptp(pixelformat::rgbaf, dseed::binary_operator::subtract), binary_operation<rgbaf, psubtract<rgbaf>> },
-	{ binoptp(pixelformat::bgra8, dseed::binary_operator::subtract), binary_operation<bgra8, psubtract<bgra8>> },
-	{ binoptp(pixelformat::bgr8, dseed::binary_operator::subtract), binary_operation<bgr8, psubtract<bgr8>> },
+
 	{ binoptp(pixelformat::bgra4, dseed::binary_operator::subtract), binary_operation<bgra4, psubtract<bgra4>> },
 	{ binoptp(pixelformat::bgr565, dseed::binary_operator::subtract), binary_operation<bgr565, psubtract<bgr565>> },
-	{ binoptp(pixelformat::r8, dseed::binary_operator::subtract), binary_operation<r8, psubtract<r8>> },
-	{ binoptp(pixelformat::rf, dseed::binary_operator::subtract), binary_operation<rf, psubtract<rf>> },
-	{ binoptp(pixelformat::yuva8, dseed::binary_operator::subtract), binary_operation<yuva8, psubtract<yuva8>> },
-	{ binoptp(pixelformat::yuv8, dseed::binary_operator::subtract), binary_operation<yuv8, psubtract<yuv8>> },
-	{ binoptp(pixelformat::hsva8, dseed::binary_operator::subtract), binary_operation<hsva8, psubtract<hsva8>> },
-	{ binoptp(pixelformat::hsv8, dseed::binary_operator::subtract), binary_operation<hsv8, psubtract<hsv8>> },
-
-	{ binoptp(pixelformat::rgba8, dseed::binary_operator::multiply), binary_operation<rgba8, pmultiply<rgba8>> },
-	{ binoptp(pixelformat::rgb8, dseed::binary_operator::multiply), binary_operation<rgb8, pmultiply<rgb8>> },
-	{ binoptp(pixelformat::rgbaf, dseed::binary_operator::multiply), binary_operation<rgbaf, pmultiply<rgbaf>> },
-	{ binoptp(pixelformat::bgra8, dseed::binary_operator::multiply), binary_operation<bgra8, pmultiply<bgra8>> },
-	{ binoptp(pixelformat::bgr8, dseed::binary_operator::multiply), binary_operation<bgr8, pmultiply<bgr8>> },
+
 	{ binoptp(pixelformat::bgra4, dseed::binary_operator::multiply), binary_operation<bgra4, pmultiply<bgra4>> },
 	{ binoptp(pixelformat::bgr565, dseed::binary_operator::multiply), binary_operation<bgr565, pmultiply<bgr565>> },
-	{ binoptp(pixelformat::r8, dseed::binary_operator::multiply), binary_operation<r8, pmultiply<r8>> },
-	{ binoptp(pixelformat::rf, dseed::binary_operator::multiply), binary_operation<rf, pmultiply<rf>> },
-	{ binoptp(pixelformat::yuva8, dseed::binary_operator::multiply), binary_operation<yuva8, pmultiply<yuva8>> },
-	{ binoptp(pixelformat::yuv8, dseed::binary_operator::multiply), binary_operation<yuv8, pmultiply<yuv8>> },
-	{ binoptp(pixelformat::hsva8, dseed::binary_operator::multiply), binary_operation<hsva8, pmultiply<hsva8>> },
-	{ binoptp(pixelformat::hsv8, dseed::binary_operator::multiply), binary_operation<hsv8, pmultiply<hsv8>> },
-
-	{ binoptp(pixelformat::rgba8, dseed::binary_operator::divide), binary_operation<rgba8, pdivide<rgba8>> },
-	{ binoptp(pixelformat::rgb8, dseed::binary_operator::divide), binary_operation<rgb8, pdivide<rgb8>> },
-	{ binoptp(pixelformat::rgbaf, dseed::binary_operator::divide), binary_operation<rgbaf, pdivide<rgbaf>> },
-	{ binoptp(pixelformat::bgra8, dseed::binary_operator::divide), binary_operation<bgra8, pdivide<bgra8>> },
-	{ binoptp(pixelformat::bgr8, dseed::binary_operator::divide), binary_operation<bgr8, pdivide<bgr8>> },
+
 	{ binoptp(pixelformat::bgra4, dseed::binary_operator::divide), binary_operation<bgra4, pdivide<bgra4>> },
 	{ binoptp(pixelformat::bgr565, dseed::binary_operator::divide), binary_operation<bgr565, pdivide<bgr565>> },
-	{ binoptp(pixelformat::r8, dseed::binary_operator::divide), binary_operation<r8, pdivide<r8>> },
-	{ binoptp(pixelformat::rf, dseed::binary_operator::divide), binary_operation<rf, pdivide<rf>> },
-	{ binoptp(pixelformat::yuva8, dseed::binary_operator::divide), binary_operation<yuva8, pdivide<yuva8>> },
-	{ binoptp(pixelformat::yuv8, dseed::binary_operator::divide), binary_operation<yuv8, pdivide<yuv8>> },
-	{ binoptp(pixelformat::hsva8, dseed::binary_operator::divide), binary_operation<hsva8, pdivide<hsva8>> },
-	{ binoptp(pixelformat::hsv8, dseed::binary_operator::divide), binary_operation<hsv8, pdivide<hsv8>> },
-
-	{ binoptp(pixelformat::rgba8, dseed::binary_operator::andop), binary_operation<rgba8, pand<rgba8>> },
-	{ binoptp(pixelformat::rgb8, dseed::binary_operator::andop), binary_operation<rgb8, pand<rgb8>> },
-	{ binoptp(pixelformat::bgra8, dseed::binary_operator::andop), binary_operation<bgra8, pand<bgra8>> },
-	{ binoptp(pixelformat::bgr8, dseed::binary_operator::andop), binary_operation<bgr8, pand<bgr8>> },
+
 	{ binoptp(pixelformat::bgra4, dseed::binary_operator::andop), binary_operation<bgra4, pand<bgra4>> },
 	{ binoptp(pixelformat::bgr565, dseed::binary_operator::andop), binary_operation<bgr565, pand<bgr565>> },
-	{ binoptp(pixelformat::r8, dseed::binary_operator::andop), binary_operation<r8, pand<r8>> },
-	{ binoptp(pixelformat::yuva8, dseed::binary_operator::andop), binary_operation<yuva8, pand<yuva8>> },
-	{ binoptp(pixelformat::yuv8, dseed::binary_operator::andop), binary_operation<yuv8, pand<yuv8>> },
-	{ binoptp(pixelformat::hsva8, dseed::binary_operator::andop), binary_operation<hsva8, pand<hsva8>> },
-	{ binoptp(pixelformat::hsv8, dseed::binary_operator::andop), binary_operation<hsv8, pand<hsv8>> },
-
-	{ binoptp(pixelformat::rgba8, dseed::binary_operator::orop), binary_operation<rgba8, por<rgba8>> },
-	{ binoptp(pixelformat::rgb8, dseed::binary_operator::orop), binary_operation<rgb8, por<rgb8>> },
-	{ binoptp(pixelformat::bgra8, dseed::binary_operator::orop), binary_operation<bgra8, por<bgra8>> },
-	{ binoptp(pixelformat::bgr8, dseed::binary_operator::orop), binary_operation<bgr8, por<bgr8>> },
+
 	{ binoptp(pixelformat::bgra4, dseed::binary_operator::orop), binary_operation<bgra4, por<bgra4>> },
 	{ binoptp(pixelformat::bgr565, dseed::binary_operator::orop), binary_operation<bgr565, por<bgr565>> },
-	{ binoptp(pixelformat::r8, dseed::binary_operator::orop), binary_operation<r8, por<r8>> },
-	{ binoptp(pixelformat::yuva8, dseed::binary_operator::orop), binary_operation<yuva8, por<yuva8>> },
-	{ binoptp(pixelformat::yuv8, dseed::binary_operator::orop), binary_operation<yuv8, por<yuv8>> },
-	{ binoptp(pixelformat::hsva8, dseed::binary_operator::orop), binary_operation<hsva8, por <hsva8>> },
-	{ binoptp(pixelformat::hsv8, dseed::binary_operator::orop), binary_operation<hsv8, por <hsv8>> },
-
-	{ binoptp(pixelformat::rgba8, dseed::binary_operator::xorop), binary_operation<rgba8, pxor<rgba8>> },
-	{ binoptp(pixelformat::rgb8, dseed::binary_operator::xorop), binary_operation<rgb8, pxor<rgb8>> },
-	{ binoptp(pixelformat::bgra8, dseed::binary_operator::xorop), binary_operation<bgra8, pxor<bgra8>> },
-	{ binoptp(pixelformat::bgr8, dseed::binary_operator::xorop), binary_operation<bgr8, pxor<bgr8>> },
+
 	{ binoptp(pixelformat::bgra4, dseed::binary_operator::xorop), binary_operation<bgra4, pxor<bgra4>> },
 	{ binoptp(pixelformat::bgr565, dseed::binary_operator::xorop), binary_operation<bgr565, pxor<bgr565>> },
-	{ binoptp(pixelformat::r8, dseed::binary_operator::xorop), binary_operation<r8, pxor<r8>> },
-	{ binoptp(pixelformat::yuva8, dseed::binary_operator::xorop), binary_operation<yuva8, pxor<yuva8>> },
-	{ binoptp(pixelformat::yuv8, dseed::binary_operator::xorop), binary_operation<yuv8, pxor<yuv8>> },
-	{ binoptp(pixelformat::hsva8, dseed::binary_operator::xorop), binary_operation<hsva8, pxor<hsva8>> },
-	{ binoptp(pixelformat::hsv8, dseed::binary_operator::xorop), binary_operation<hsv8, pxor<hsv8>> },
 };
 
-dseed::error_t dseed::bitmaps::bitmap_binary_operation(dseed::bitmaps::bitmap* b1, dseed::bitmaps::bitmap* b2, dseed::binary_operator op, dseed::bitmaps::bitmap** bitmap)
+using rowbinoptp = std::tuple<elementtype, dseed::binary_operator, bool>;
+
+// Element-wise SIMD kernels for 8-bit per element and floating-point formats
+//  : Key is (element type, operator, saturate)
+std::map<rowbinoptp, binaryfn> g_rowbinops = {
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::add, false), binary8<add8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::subtract, false), binary8<subtract8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::multiply, false), binary8<multiply8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::divide, false), binary8<divide8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::andop, false), binary8<and8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::orop, false), binary8<or8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::xorop, false), binary8<xor8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::minimum, false), binary8<min8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::maximum, false), binary8<max8op> },
+
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::add, true), binary8<addsat8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::subtract, true), binary8<subtractsat8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::multiply, true), binary8<multiplysat8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::divide, true), binary8<divide8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::andop, true), binary8<and8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::orop, true), binary8<or8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::xorop, true), binary8<xor8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::minimum, true), binary8<min8op> },
+	{ rowbinoptp(elementtype::byte, dseed::binary_operator::maximum, true), binary8<max8op> },
+
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::add, false), binaryf<addfop> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::subtract, false), binaryf<subtractfop> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::multiply, false), binaryf<multiplyfop> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::divide, false), binaryf<dividefop> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::minimum, false), binaryf<minfop> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::maximum, false), binaryf<maxfop> },
+
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::add, true), binaryf<saturatef2op<addfop>> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::subtract, true), binaryf<saturatef2op<subtractfop>> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::multiply, true), binaryf<saturatef2op<multiplyfop>> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::divide, true), binaryf<saturatef2op<dividefop>> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::minimum, true), binaryf<saturatef2op<minfop>> },
+	{ rowbinoptp(elementtype::single, dseed::binary_operator::maximum, true), binaryf<saturatef2op<maxfop>> },
+};
+
+dseed::error_t dseed::bitmaps::bitmap_binary_operation(dseed::bitmaps::bitmap* b1, dseed::bitmaps::bitmap* b2, dseed::binary_operator op, dseed::bitmaps::bitmap** bitmap, bool saturate)
 {
 	if (b1 == nullptr || b2 == nullptr || bitmap == nullptr)
 		return dseed::error_invalid_args;
@@ -162,31 +134,55 @@ dseed::error_t dseed::bitmaps::bitmap_binary_operation(dseed::bitmaps::bitmap* b
 		|| b1->format() != b2->format())
 		return dseed::error_invalid_args;
 
-	dseed::autoref<dseed::bitmaps::bitmap> temp;
-	if (bitmap != nullptr)
+	const auto format = b1->format();
+	const auto element = format2element(format);
+
+	binaryfn rowop = nullptr;
+	binopfn pixelop;
+	if (element != elementtype::unknown)
 	{
-		if (dseed::failed(dseed::bitmaps::create_bitmap(b1->type(), b1->size(), b1->format(), nullptr, &temp)))
-			return dseed::error_fail;
+		auto found = g_rowbinops.find(rowbinoptp(element, op, saturate));
+		if (found == g_rowbinops.end())
+			return dseed::error_not_support;
+		rowop = found->second;
 	}
 	else
-		temp = b1;
+	{
+		if (saturate)
+			return dseed::error_not_support;
+
+		auto found = g_binops.find(binoptp(format, op));
+		if (found == g_binops.end())
+			return dseed::error_not_support;
+		pixelop = found->second;
+	}
+
+	dseed::autoref<dseed::bitmaps::bitmap> temp;
+	if (dseed::failed(dseed::bitmaps::create_bitmap(b1->type(), b1Size, format, nullptr, &temp)))
+		return dseed::error_fail;
 
 	uint8_t* destPtr, * src1Ptr, * src2Ptr;
 	b1->lock((void**)&src1Ptr);
-	b2->lock((void**)&src2Ptr);
+	if (b2 != b1)
+		b2->lock((void**)&src2Ptr);
+	else
+		src2Ptr = src1Ptr;
 	temp->lock((void**)&destPtr);
 
-	auto found = g_binops.find(binoptp(b1->format(), op));
-	if (found == g_binops.end())
-		return dseed::error_not_support;
-
-	if (!found->second(destPtr, src1Ptr, src2Ptr, b1->size()))
-		return dseed::error_fail;
+	bool succeed = true;
+	if (rowop != nullptr)
+		rowop(destPtr, src1Ptr, src2Ptr, calc_bitmap_total_size(format, b1Size) / element_size(element));
+	else
+		succeed = pixelop(destPtr, src1Ptr, src2Ptr, b1Size);
 
 	temp->unlock();
-	b2->unlock();
+	if (b2 != b1)
+		b2->unlock();
 	b1->unlock();
 
+	if (!succeed)
+		return dseed::error_fail;
+
 	*bitmap = temp.detach();
 
 	return dseed::error_good;
@@ -224,64 +220,78 @@ inline bool unary_operation(uint8_t* dest, const uint8_t* src, const dseed::size
 }
 
 std::map<unoptp, unopfn> g_unops = {
-	{ unoptp(pixelformat::rgbaf, dseed::unary_operator::negate), unary_operation<rgbaf, pnegate<rgbaf>> },
-	{ unoptp(pixelformat::rf, dseed::unary_operator::negate), unary_operation<rf, pnegate<rf>> },
-
-	{ unoptp(pixelformat::rgba8, dseed::unary_operator::notop), unary_operation<rgba8, pnot<rgba8>> },
-	{ unoptp(pixelformat::rgb8, dseed::unary_operator::notop), unary_operation<rgb8, pnot<rgb8>> },
-	{ unoptp(pixelformat::bgra8, dseed::unary_operator::notop), unary_operation<bgra8, pnot<bgra8>> },
-	{ unoptp(pixelformat::bgr8, dseed::unary_operator::notop), unary_operation<bgr8, pnot<bgr8>> },
 	{ unoptp(pixelformat::bgra4, dseed::unary_operator::notop), unary_operation<bgra4, pnot<bgra4>> },
 	{ unoptp(pixelformat::bgr565, dseed::unary_operator::notop), unary_operation<bgr565, pnot<bgr565>> },
-	{ unoptp(pixelformat::r8, dseed::unary_operator::notop), unary_operation<r8, pnot<r8>> },
-	{ unoptp(pixelformat::yuva8, dseed::unary_operator::notop), unary_operation<yuva8, pnot<yuva8>> },
-	{ unoptp(pixelformat::yuv8, dseed::unary_operator::notop), unary_operation<yuv8, pnot<yuv8>> },
-	{ unoptp(pixelformat::hsva8, dseed::unary_operator::notop), unary_operation<hsva8, pnot<hsva8>> },
-	{ unoptp(pixelformat::hsv8, dseed::unary_operator::notop), unary_operation<hsv8, pnot<hsv8>> },
-
-	{ unoptp(pixelformat::rgba8, dseed::unary_operator::invert), unary_operation<rgba8, pinvert<rgba8>> },
-	{ unoptp(pixelformat::rgb8, dseed::unary_operator::invert), unary_operation<rgb8, pinvert<rgb8>> },
-	{ unoptp(pixelformat::rgbaf, dseed::unary_operator::invert), unary_operation<rgbaf, pinvert<rgbaf>> },
-	{ unoptp(pixelformat::bgra8, dseed::unary_operator::invert), unary_operation<bgra8, pinvert<bgra8>> },
-	{ unoptp(pixelformat::bgr8, dseed::unary_operator::invert), unary_operation<bgr8, pinvert<bgr8>> },
+
 	{ unoptp(pixelformat::bgra4, dseed::unary_operator::invert), unary_operation<bgra4, pinvert<bgra4>> },
 	{ unoptp(pixelformat::bgr565, dseed::unary_operator::invert), unary_operation<bgr565, pinvert<bgr565>> },
-	{ unoptp(pixelformat::r8, dseed::unary_operator::invert), unary_operation<r8, pinvert<r8>> },
-	{ unoptp(pixelformat::rf, dseed::unary_operator::invert), unary_operation<rf, pinvert<rf>> },
-	{ unoptp(pixelformat::yuva8, dseed::unary_operator::invert), unary_operation<yuva8, pinvert<yuva8>> },
-	{ unoptp(pixelformat::yuv8, dseed::unary_operator::invert), unary_operation<yuv8, pinvert<yuv8>> },
-	{ unoptp(pixelformat::hsva8, dseed::unary_operator::invert), unary_operation<hsva8, pinvert<hsva8>> },
-	{ unoptp(pixelformat::hsv8, dseed::unary_operator::invert), unary_operation<hsv8, pinvert<hsv8>> },
 };
 
-dseed::error_t dseed::bitmaps::bitmap_unary_operation(dseed::bitmaps::bitmap* b, dseed::unary_operator op, dseed::bitmaps::bitmap** bitmap)
+using rowunoptp = std::tuple<elementtype, dseed::unary_operator, bool>;
+
+std::map<rowunoptp, unaryfn> g_rowunops = {
+	{ rowunoptp(elementtype::byte, dseed::unary_operator::notop, false), unary8<not8op> },
+	{ rowunoptp(elementtype::byte, dseed::unary_operator::invert, false), unary8<not8op> },
+
+	{ rowunoptp(elementtype::byte, dseed::unary_operator::notop, true), unary8<not8op> },
+	{ rowunoptp(elementtype::byte, dseed::unary_operator::invert, true), unary8<not8op> },
+
+	{ rowunoptp(elementtype::single, dseed::unary_operator::negate, false), unaryf<negatefop> },
+	{ rowunoptp(elementtype::single, dseed::unary_operator::invert, false), unaryf<invertfop> },
+
+	{ rowunoptp(elementtype::single, dseed::unary_operator::negate, true), unaryf<saturatef1op<negatefop>> },
+	{ rowunoptp(elementtype::single, dseed::unary_operator::invert, true), unaryf<saturatef1op<invertfop>> },
+};
+
+dseed::error_t dseed::bitmaps::bitmap_unary_operation(dseed::bitmaps::bitmap* b, dseed::unary_operator op, dseed::bitmaps::bitmap** bitmap, bool saturate)
 {
-	if (b == nullptr)
+	if (b == nullptr || bitmap == nullptr)
 		return dseed::error_invalid_args;
 
-	dseed::autoref<dseed::bitmaps::bitmap> temp;
-	if (bitmap != nullptr)
+	const auto format = b->format();
+	const auto size = b->size();
+	const auto element = format2element(format);
+
+	unaryfn rowop = nullptr;
+	unopfn pixelop;
+	if (element != elementtype::unknown)
 	{
-		if (dseed::failed(dseed::bitmaps::create_bitmap(b->type(), b->size(), b->format(), nullptr, &temp)))
-			return dseed::error_fail;
+		auto found = g_rowunops.find(rowunoptp(element, op, saturate));
+		if (found == g_rowunops.end())
+			return dseed::error_not_support;
+		rowop = found->second;
 	}
 	else
-		temp = b;
+	{
+		if (saturate)
+			return dseed::error_not_support;
+
+		auto found = g_unops.find(unoptp(format, op));
+		if (found == g_unops.end())
+			return dseed::error_not_support;
+		pixelop = found->second;
+	}
+
+	dseed::autoref<dseed::bitmaps::bitmap> temp;
+	if (dseed::failed(dseed::bitmaps::create_bitmap(b->type(), size, format, nullptr, &temp)))
+		return dseed::error_fail;
 
 	uint8_t* destPtr, * srcPtr;
 	b->lock((void**)&srcPtr);
 	temp->lock((void**)&destPtr);
 
-	auto found = g_unops.find(unoptp(b->format(), op));
-	if (found == g_unops.end())
-		return dseed::error_not_support;
-
-	if (!found->second(destPtr, srcPtr, b->size()))
-		return dseed::error_not_support;
+	bool succeed = true;
+	if (rowop != nullptr)
+		rowop(destPtr, srcPtr, calc_bitmap_total_size(format, size) / element_size(element));
+	else
+		succeed = pixelop(destPtr, srcPtr, size);
 
 	temp->unlock();
 	b->unlock();
 
+	if (!succeed)
+		return dseed::error_not_support;
+
 	*bitmap = temp.detach();
 
 	return error_good;
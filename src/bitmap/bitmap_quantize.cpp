@@ -0,0 +1,769 @@
+#include <dseed.h>
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include "parallel.hxx"
+
+#include "../libs/exoquant/exoquant.h"
+#include "../libs/exoquant/exoquant.c"
+
+using rgba8 = dseed::color::rgba8;
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Nearest Palette Entry Search
+//  : Palette is kept as float planes padded to multiple of 4, so 4 entries are compared at once.
+//  : Distance is squared euclidean distance of RGBA, ties go to lower index.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+class __palette_search
+{
+public:
+	void set(const std::vector<rgba8>& palette)
+	{
+		// Padded entries are too far to be nearest
+		const size_t padded = (palette.size() + 3) / 4 * 4;
+		for (auto& plane : _planes)
+			plane.assign(padded, 1.0e+6f);
+		for (size_t i = 0; i < palette.size(); ++i)
+			for (int c = 0; c < 4; ++c)
+				_planes[c][i] = palette[i][c];
+		_count = palette.size();
+	}
+
+	inline int nearest(const float* color) const noexcept
+	{
+#if ARCH_X86SET && !DONT_USE_SSE
+		const __m128 r = _mm_set1_ps(color[0]), g = _mm_set1_ps(color[1]), b = _mm_set1_ps(color[2]), a = _mm_set1_ps(color[3]);
+		const __m128i step = _mm_set1_epi32(4);
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128(), index = _mm_setr_epi32(0, 1, 2, 3);
+		for (size_t i = 0; i < _planes[0].size(); i += 4)
+		{
+			const __m128 dr = _mm_sub_ps(_mm_loadu_ps(_planes[0].data() + i), r);
+			const __m128 dg = _mm_sub_ps(_mm_loadu_ps(_planes[1].data() + i), g);
+			const __m128 db = _mm_sub_ps(_mm_loadu_ps(_planes[2].data() + i), b);
+			const __m128 da = _mm_sub_ps(_mm_loadu_ps(_planes[3].data() + i), a);
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+				_mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+
+			const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestIndex));
+			index = _mm_add_epi32(index, step);
+		}
+
+		float distances[4];
+		int32_t indices[4];
+		_mm_storeu_ps(distances, best);
+		_mm_storeu_si128((__m128i*)indices, bestIndex);
+
+		int found = indices[0];
+		float foundDistance = distances[0];
+		for (int i = 1; i < 4; ++i)
+		{
+			if (distances[i] < foundDistance || (distances[i] == foundDistance && indices[i] < found))
+			{
+				found = indices[i];
+				foundDistance = distances[i];
+			}
+		}
+		return found;
+#else
+		int found = 0;
+		float foundDistance = FLT_MAX;
+		for (size_t i = 0; i < _count; ++i)
+		{
+			const float d = distance(color, i);
+			if (d < foundDistance)
+			{
+				found = (int)i;
+				foundDistance = d;
+			}
+		}
+		return found;
+#endif
+	}
+
+	// Nearest entry with distances(not squared) of nearest and second nearest
+	inline int nearest2(const float* color, float& first, float& second) const noexcept
+	{
+		int found = 0;
+		first = second = FLT_MAX;
+		for (size_t i = 0; i < _count; ++i)
+		{
+			const float d = distance(color, i);
+			if (d < first)
+			{
+				second = first;
+				first = d;
+				found = (int)i;
+			}
+			else if (d < second)
+				second = d;
+		}
+		first = std::sqrt(first);
+		second = second == FLT_MAX ? FLT_MAX : std::sqrt(second);
+		return found;
+	}
+
+private:
+	inline float distance(const float* color, size_t i) const noexcept
+	{
+		const float dr = _planes[0][i] - color[0], dg = _planes[1][i] - color[1];
+		const float db = _planes[2][i] - color[2], da = _planes[3][i] - color[3];
+		return dr * dr + dg * dg + db * db + da * da;
+	}
+
+private:
+	std::vector<float> _planes[4];
+	size_t _count = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Palette Building
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Unique color with its count in samples
+struct __quantize_color
+{
+	rgba8 color;
+	uint32_t weight;
+};
+
+std::vector<__quantize_color> __quantize_histogram(std::vector<rgba8>& samples)
+{
+	std::sort(samples.begin(), samples.end(), [](const rgba8& c1, const rgba8& c2) { return c1.color < c2.color; });
+
+	std::vector<__quantize_color> colors;
+	for (const auto& sample : samples)
+	{
+		if (!colors.empty() && colors.back().color.color == sample.color)
+			++colors.back().weight;
+		else
+			colors.push_back({ sample, 1 });
+	}
+	return colors;
+}
+
+struct __median_cut_box
+{
+	size_t begin, end;
+	// Weighted squared error to mean of box
+	double error;
+	// Channel of largest variance
+	int axis;
+	rgba8 mean;
+};
+
+__median_cut_box __make_median_cut_box(const std::vector<__quantize_color>& colors, size_t begin, size_t end) noexcept
+{
+	double sum[4] = { 0, }, square[4] = { 0, }, weight = 0;
+	for (size_t i = begin; i < end; ++i)
+	{
+		const double w = colors[i].weight;
+		for (int c = 0; c < 4; ++c)
+		{
+			const double v = colors[i].color[c];
+			sum[c] += v * w;
+			square[c] += v * v * w;
+		}
+		weight += w;
+	}
+
+	__median_cut_box box = { begin, end, 0, 0, rgba8() };
+	double largest = -1;
+	for (int c = 0; c < 4; ++c)
+	{
+		const double variance = square[c] - sum[c] * sum[c] / weight;
+		box.error += variance;
+		if (variance > largest)
+		{
+			largest = variance;
+			box.axis = c;
+		}
+		box.mean[c] = (uint8_t)dseed::clamp<int>((int)std::lround(sum[c] / weight), 255);
+	}
+	return box;
+}
+
+// Splits box of largest error at weighted median of its largest variance channel
+std::vector<rgba8> __median_cut(std::vector<__quantize_color>& colors, size_t count)
+{
+	std::vector<__median_cut_box> boxes;
+	boxes.push_back(__make_median_cut_box(colors, 0, colors.size()));
+
+	while (boxes.size() < count)
+	{
+		size_t target = boxes.size();
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			if (boxes[i].end - boxes[i].begin > 1 && boxes[i].error > 0
+				&& (target == boxes.size() || boxes[i].error > boxes[target].error))
+				target = i;
+		}
+		if (target == boxes.size())
+			break;
+
+		const __median_cut_box box = boxes[target];
+		const int axis = box.axis;
+		std::sort(colors.begin() + box.begin, colors.begin() + box.end,
+			[axis](const __quantize_color& c1, const __quantize_color& c2) { return c1.color[axis] < c2.color[axis]; });
+
+		uint64_t total = 0, cumulative = 0;
+		for (size_t i = box.begin; i < box.end; ++i)
+			total += colors[i].weight;
+		size_t split = box.begin + 1;
+		for (size_t i = box.begin; i < box.end; ++i)
+		{
+			cumulative += colors[i].weight;
+			if (cumulative * 2 >= total)
+			{
+				split = i + 1;
+				break;
+			}
+		}
+		split = dseed::minimum(dseed::maximum(split, box.begin + 1), box.end - 1);
+
+		boxes[target] = __make_median_cut_box(colors, box.begin, split);
+		boxes.push_back(__make_median_cut_box(colors, split, box.end));
+	}
+
+	std::vector<rgba8> palette(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i)
+		palette[i] = boxes[i].mean;
+	return palette;
+}
+
+// Moves each entry to mean of colors nearest to it until palette settles
+void __kmeans_refine(const std::vector<__quantize_color>& colors, std::vector<rgba8>& palette, size_t threads)
+{
+	constexpr int MAX_ITERATIONS = 8;
+	constexpr size_t CHUNK_COLORS = 16384;
+
+	const size_t chunks = (colors.size() + CHUNK_COLORS - 1) / CHUNK_COLORS;
+	std::vector<double> sums(chunks * palette.size() * 5);
+	__palette_search search;
+
+	for (int iteration = 0; iteration < MAX_ITERATIONS; ++iteration)
+	{
+		search.set(palette);
+		std::fill(sums.begin(), sums.end(), 0.0);
+
+		// Every chunk accumulates to its own sums
+		dseed::bitmaps::parallel::for_each(chunks, [&](size_t chunk)
+			{
+				double* chunkSums = sums.data() + chunk * palette.size() * 5;
+				const size_t end = dseed::minimum(colors.size(), (chunk + 1) * CHUNK_COLORS);
+				for (size_t i = chunk * CHUNK_COLORS; i < end; ++i)
+				{
+					const auto& color = colors[i].color;
+					const float values[4] = { (float)color.r, (float)color.g, (float)color.b, (float)color.a };
+					double* entry = chunkSums + search.nearest(values) * 5;
+					const double w = colors[i].weight;
+					for (int c = 0; c < 4; ++c)
+						entry[c] += values[c] * w;
+					entry[4] += w;
+				}
+			}, threads);
+
+		bool changed = false;
+		for (size_t i = 0; i < palette.size(); ++i)
+		{
+			double entry[5] = { 0, };
+			for (size_t chunk = 0; chunk < chunks; ++chunk)
+				for (int c = 0; c < 5; ++c)
+					entry[c] += sums[(chunk * palette.size() + i) * 5 + c];
+			// Entry nearest to no color is kept
+			if (entry[4] == 0)
+				continue;
+
+			rgba8 mean;
+			for (int c = 0; c < 4; ++c)
+				mean[c] = (uint8_t)dseed::clamp<int>((int)std::lround(entry[c] / entry[4]), 255);
+			if (mean.color != palette[i].color)
+			{
+				palette[i] = mean;
+				changed = true;
+			}
+		}
+		if (!changed)
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Bitmap Quantizer
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr int16_t QUANTIZE_CACHE_UNKNOWN = -1;
+// Cell whose colors can have different nearest entries
+constexpr int16_t QUANTIZE_CACHE_AMBIGUOUS = -2;
+// Cache cell is 8x8x8 colors(5 bits per channel)
+constexpr int QUANTIZE_CACHE_SHIFT = 3;
+constexpr size_t QUANTIZE_CACHE_SIZE = 1 << (3 * (8 - QUANTIZE_CACHE_SHIFT));
+
+static const uint8_t __bayer8[8][8] = {
+	{  0, 32,  8, 40,  2, 34, 10, 42 },
+	{ 48, 16, 56, 24, 50, 18, 58, 26 },
+	{ 12, 44,  4, 36, 14, 46,  6, 38 },
+	{ 60, 28, 52, 20, 62, 30, 54, 22 },
+	{  3, 35, 11, 43,  1, 33,  9, 41 },
+	{ 51, 19, 59, 27, 49, 17, 57, 25 },
+	{ 15, 47,  7, 39, 13, 45,  5, 37 },
+	{ 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+// RGBA8 pixels of bitmap; bitmap is converted if needed, and copied if it cannot be locked
+class __rgba_pixels
+{
+public:
+	~__rgba_pixels()
+	{
+		if (_locked)
+			_bitmap->unlock();
+	}
+
+public:
+	dseed::error_t open(dseed::bitmaps::bitmap* original) noexcept
+	{
+		if (auto err = dseed::bitmaps::reformat_bitmap(original, dseed::color::pixelformat::rgba8, &_bitmap); dseed::failed(err))
+			return err;
+		_size = _bitmap->size();
+
+		void* ptr;
+		if (dseed::succeeded(_bitmap->lock(&ptr)))
+		{
+			_locked = true;
+			_pixels = reinterpret_cast<const rgba8*>(ptr);
+			return dseed::error_good;
+		}
+
+		const size_t plane = (size_t)_size.width * _size.height;
+		try { _copied.resize(plane * _size.depth); }
+		catch (...) { return dseed::error_out_of_memory; }
+		for (int z = 0; z < _size.depth; ++z)
+		{
+			if (auto err = _bitmap->copy_pixels(_copied.data() + plane * z, z); dseed::failed(err))
+				return err;
+		}
+		_pixels = _copied.data();
+		return dseed::error_good;
+	}
+
+	inline const rgba8* pixels() const noexcept { return _pixels; }
+	inline const dseed::size3i& size() const noexcept { return _size; }
+
+private:
+	dseed::autoref<dseed::bitmaps::bitmap> _bitmap;
+	dseed::size3i _size;
+	const rgba8* _pixels = nullptr;
+	std::vector<rgba8> _copied;
+	bool _locked = false;
+};
+
+class __bitmap_quantizer : public dseed::bitmaps::bitmap_quantizer
+{
+public:
+	__bitmap_quantizer(const dseed::bitmaps::quantize_options& options)
+		: _refCount(1), _options(options), _spread(0)
+	{ }
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t feed_pixels(const rgba8* pixels, size_t count) noexcept override
+	{
+		if (pixels == nullptr && count > 0)
+			return dseed::error_invalid_args;
+
+		// Samples are picked evenly over pixels
+		const size_t picks = (_options.sample_limit != 0 && count > _options.sample_limit) ? _options.sample_limit : count;
+		try { _samples.reserve(_samples.size() + picks); }
+		catch (...) { return dseed::error_out_of_memory; }
+		for (size_t i = 0; i < picks; ++i)
+			_samples.push_back(normalize(pixels[picks == count ? i : (size_t)((uint64_t)i * count / picks)]));
+
+		return dseed::error_good;
+	}
+
+	virtual dseed::error_t feed(dseed::bitmaps::bitmap* bitmap) noexcept override
+	{
+		if (bitmap == nullptr)
+			return dseed::error_invalid_args;
+
+		__rgba_pixels pixels;
+		if (auto err = pixels.open(bitmap); dseed::failed(err))
+			return err;
+		const auto& size = pixels.size();
+		return feed_pixels(pixels.pixels(), (size_t)size.width * size.height * size.depth);
+	}
+
+	virtual dseed::error_t build() noexcept override
+	{
+		if (_samples.empty())
+			return dseed::error_invalid_op;
+
+		std::vector<rgba8> palette;
+		try
+		{
+			switch (_options.method)
+			{
+			case dseed::bitmaps::quantize_method::median_cut:
+			case dseed::bitmaps::quantize_method::kmeans:
+				{
+					auto colors = __quantize_histogram(_samples);
+					palette = __median_cut(colors, _options.colors);
+					if (_options.method == dseed::bitmaps::quantize_method::kmeans)
+						__kmeans_refine(colors, palette, threads());
+				}
+				break;
+
+			case dseed::bitmaps::quantize_method::exoquant:
+				{
+					exq_data* exq = exq_init();
+					if (exq == nullptr)
+						return dseed::error_out_of_memory;
+					if (!_options.alpha)
+						exq_no_transparency(exq);
+					exq_feed(exq, (uint8_t*)_samples.data(), (int)_samples.size());
+					exq_quantize_hq(exq, _options.colors);
+					palette.resize(dseed::minimum(exq->numColors, _options.colors));
+					exq_get_palette(exq, (uint8_t*)palette.data(), (int)palette.size());
+					exq_free(exq);
+				}
+				break;
+
+			default:
+				return dseed::error_invalid_args;
+			}
+		}
+		catch (...) { return dseed::error_out_of_memory; }
+
+		std::vector<rgba8>().swap(_samples);
+		return set_palette(palette.data(), palette.size());
+	}
+
+	virtual dseed::error_t set_palette(const rgba8* palette, size_t count) noexcept override
+	{
+		if (palette == nullptr || count == 0 || count > 256)
+			return dseed::error_invalid_args;
+
+		try
+		{
+			_palette.resize(count);
+			for (size_t i = 0; i < count; ++i)
+				_palette[i] = _options.alpha ? palette[i] : rgba8(palette[i].r, palette[i].g, palette[i].b, 255);
+			_search.set(_palette);
+			if (_cache == nullptr)
+				_cache.reset(new std::atomic<int16_t>[QUANTIZE_CACHE_SIZE]);
+		}
+		catch (...)
+		{
+			_palette.clear();
+			return dseed::error_out_of_memory;
+		}
+		for (size_t i = 0; i < QUANTIZE_CACHE_SIZE; ++i)
+			_cache[i].store(QUANTIZE_CACHE_UNKNOWN, std::memory_order_relaxed);
+
+		// Ordered dither spreads colors as far as average gap between palette entries
+		double gaps = 0;
+		for (size_t i = 0; i < count && count > 1; ++i)
+		{
+			int nearest = INT32_MAX;
+			for (size_t j = 0; j < count; ++j)
+			{
+				if (i == j)
+					continue;
+				const int dr = _palette[i].r - _palette[j].r, dg = _palette[i].g - _palette[j].g, db = _palette[i].b - _palette[j].b;
+				nearest = dseed::minimum(nearest, dr * dr + dg * dg + db * db);
+			}
+			gaps += std::sqrt((double)nearest);
+		}
+		_spread = count > 1 ? (float)(gaps / count) : 0;
+
+		return dseed::error_good;
+	}
+
+public:
+	virtual size_t palette_size() noexcept override { return _palette.size(); }
+	virtual dseed::error_t copy_palette(rgba8* palette) noexcept override
+	{
+		if (palette == nullptr)
+			return dseed::error_invalid_args;
+		if (_palette.empty())
+			return dseed::error_invalid_op;
+		memcpy(palette, _palette.data(), sizeof(rgba8) * _palette.size());
+		return dseed::error_good;
+	}
+
+public:
+	virtual dseed::error_t map_pixels(const rgba8* pixels, const dseed::size2i& size, uint8_t* indices, size_t stride) noexcept override
+	{
+		if (pixels == nullptr || indices == nullptr || size.width <= 0 || size.height <= 0)
+			return dseed::error_invalid_args;
+		if (_palette.empty())
+			return dseed::error_invalid_op;
+		if (stride == 0)
+			stride = size.width;
+
+		switch (_options.dither)
+		{
+		case dseed::bitmaps::dither_method::none:
+		case dseed::bitmaps::dither_method::ordered:
+			{
+				// Rows do not depend on each other
+				constexpr int BAND_ROWS = 32;
+				const bool ordered = _options.dither == dseed::bitmaps::dither_method::ordered && _spread > 0;
+				const size_t bands = (size.height + BAND_ROWS - 1) / BAND_ROWS;
+				auto band = [&](size_t i)
+				{
+					const int end = dseed::minimum(size.height, (int)(i + 1) * BAND_ROWS);
+					for (int y = (int)i * BAND_ROWS; y < end; ++y)
+						map_row(pixels + (size_t)y * size.width, y, size.width, indices + y * stride, ordered);
+				};
+				if ((size_t)size.width * size.height >= (1 << 18))
+					dseed::bitmaps::parallel::for_each(bands, band, threads());
+				else
+				{
+					for (size_t i = 0; i < bands; ++i)
+						band(i);
+				}
+			}
+			return dseed::error_good;
+
+		case dseed::bitmaps::dither_method::floyd_steinberg:
+			return map_floyd_steinberg(pixels, size, indices, stride);
+
+		default:
+			return dseed::error_invalid_args;
+		}
+	}
+
+	virtual dseed::error_t map(dseed::bitmaps::bitmap* original, dseed::color::pixelformat format, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		if (original == nullptr || bitmap == nullptr)
+			return dseed::error_invalid_args;
+		if (format != dseed::color::pixelformat::bgra8_indexed8 && format != dseed::color::pixelformat::bgr8_indexed8)
+			return dseed::error_not_support;
+		if (_palette.empty())
+			return dseed::error_invalid_op;
+
+		__rgba_pixels pixels;
+		if (auto err = pixels.open(original); dseed::failed(err))
+			return err;
+		const auto& size = pixels.size();
+
+		const bool bgra = format == dseed::color::pixelformat::bgra8_indexed8;
+		std::vector<uint8_t> entries;
+		try
+		{
+			entries.reserve(_palette.size() * 4);
+			for (const auto& entry : _palette)
+			{
+				entries.insert(entries.end(), { entry.b, entry.g, entry.r });
+				if (bgra)
+					entries.push_back(entry.a);
+			}
+		}
+		catch (...) { return dseed::error_out_of_memory; }
+
+		dseed::autoref<dseed::bitmaps::palette> palette;
+		if (auto err = dseed::bitmaps::create_palette(entries.data(), bgra ? 32 : 24, _palette.size(), &palette); dseed::failed(err))
+			return err;
+
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (auto err = dseed::bitmaps::create_bitmap(original->type(), size, format, palette, &temp); dseed::failed(err))
+			return err;
+
+		uint8_t* ptr;
+		if (auto err = temp->lock((void**)&ptr); dseed::failed(err))
+			return err;
+		// Planes are contiguous in both formats
+		const auto err = map_pixels(pixels.pixels(), dseed::size2i(size.width, size.height * size.depth), ptr,
+			dseed::color::calc_bitmap_stride(format, size.width));
+		temp->unlock();
+		if (dseed::failed(err))
+			return err;
+
+		*bitmap = temp.detach();
+		return dseed::error_good;
+	}
+
+private:
+	inline size_t threads() const noexcept
+	{
+		return _options.threads > 0 ? (size_t)_options.threads : 0;
+	}
+
+	// Colour of fully transparent pixel is meaningless, and alpha is dropped if not used
+	inline rgba8 normalize(const rgba8& pixel) const noexcept
+	{
+		if (!_options.alpha)
+			return rgba8(pixel.r, pixel.g, pixel.b, 255);
+		if (pixel.a == 0)
+			return rgba8(0, 0, 0, 0);
+		return pixel;
+	}
+
+	inline int lookup(const float* color) const noexcept
+	{
+		int values[4];
+		for (int c = 0; c < 4; ++c)
+			values[c] = dseed::clamp<int>((int)(color[c] + 0.5f), 255);
+		const rgba8 pixel = normalize(rgba8((uint8_t)values[0], (uint8_t)values[1], (uint8_t)values[2], (uint8_t)values[3]));
+		const float normalized[4] = { (float)pixel.r, (float)pixel.g, (float)pixel.b, (float)pixel.a };
+
+		// Translucent colors are not cached
+		if (pixel.a != 255)
+			return _search.nearest(normalized);
+
+		const size_t cell = ((size_t)(pixel.r >> QUANTIZE_CACHE_SHIFT) << (2 * (8 - QUANTIZE_CACHE_SHIFT)))
+			| ((size_t)(pixel.g >> QUANTIZE_CACHE_SHIFT) << (8 - QUANTIZE_CACHE_SHIFT))
+			| (size_t)(pixel.b >> QUANTIZE_CACHE_SHIFT);
+		int16_t entry = _cache[cell].load(std::memory_order_relaxed);
+		if (entry == QUANTIZE_CACHE_UNKNOWN)
+		{
+			entry = fill_cell(pixel);
+			_cache[cell].store(entry, std::memory_order_relaxed);
+		}
+		return entry >= 0 ? entry : _search.nearest(normalized);
+	}
+
+	// Nearest entry of cell center is nearest of every color in cell,
+	// if second nearest is farther than nearest by more than cell diameter
+	int16_t fill_cell(const rgba8& pixel) const noexcept
+	{
+		constexpr float HALF = ((1 << QUANTIZE_CACHE_SHIFT) - 1) / 2.0f;
+		const float center[4] = {
+			(float)((pixel.r >> QUANTIZE_CACHE_SHIFT) << QUANTIZE_CACHE_SHIFT) + HALF,
+			(float)((pixel.g >> QUANTIZE_CACHE_SHIFT) << QUANTIZE_CACHE_SHIFT) + HALF,
+			(float)((pixel.b >> QUANTIZE_CACHE_SHIFT) << QUANTIZE_CACHE_SHIFT) + HALF,
+			255.0f,
+		};
+		const float radius = HALF * 1.7320508f;
+
+		float first, second;
+		const int found = _search.nearest2(center, first, second);
+		return second - first > 2 * radius + 0.01f ? (int16_t)found : QUANTIZE_CACHE_AMBIGUOUS;
+	}
+
+	void map_row(const rgba8* pixels, int y, int width, uint8_t* indices, bool ordered) const noexcept
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			const rgba8& pixel = pixels[x];
+			float color[4] = { (float)pixel.r, (float)pixel.g, (float)pixel.b, (float)pixel.a };
+			if (ordered)
+			{
+				const float offset = ((__bayer8[y & 7][x & 7] + 0.5f) / 64.0f - 0.5f) * _spread;
+				for (int c = 0; c < 3; ++c)
+					color[c] += offset;
+			}
+			indices[x] = (uint8_t)lookup(color);
+		}
+	}
+
+	// Serpentine scan; error of transparent pixels is not diffused
+	dseed::error_t map_floyd_steinberg(const rgba8* pixels, const dseed::size2i& size, uint8_t* indices, size_t stride) const noexcept
+	{
+		// Two rows of errors with one pixel margin on each side
+		std::vector<float> errors;
+		try { errors.resize((size_t)(size.width + 2) * 4 * 2); }
+		catch (...) { return dseed::error_out_of_memory; }
+
+		for (int y = 0; y < size.height; ++y)
+		{
+			float* current = errors.data() + (size_t)(y & 1) * (size.width + 2) * 4;
+			float* next = errors.data() + (size_t)((y + 1) & 1) * (size.width + 2) * 4;
+			std::fill(next, next + (size.width + 2) * 4, 0.0f);
+
+			const rgba8* row = pixels + (size_t)y * size.width;
+			uint8_t* indexRow = indices + y * stride;
+			const int direction = (y & 1) ? -1 : 1;
+			for (int i = 0; i < size.width; ++i)
+			{
+				const int x = direction > 0 ? i : size.width - 1 - i;
+				const rgba8& pixel = row[x];
+				float* error = current + (x + 1) * 4;
+
+				float color[4] = { (float)pixel.r, (float)pixel.g, (float)pixel.b, (float)pixel.a };
+				for (int c = 0; c < 3; ++c)
+					color[c] = dseed::clamp<float>(color[c] + error[c], 255);
+
+				const int index = lookup(color);
+				indexRow[x] = (uint8_t)index;
+				if (_options.alpha && pixel.a == 0)
+					continue;
+
+				const rgba8& entry = _palette[index];
+				for (int c = 0; c < 3; ++c)
+				{
+					const float diff = color[c] - entry[c];
+					current[(x + 1 + direction) * 4 + c] += diff * (7 / 16.0f);
+					next[(x + 1 - direction) * 4 + c] += diff * (3 / 16.0f);
+					next[(x + 1) * 4 + c] += diff * (5 / 16.0f);
+					next[(x + 1 + direction) * 4 + c] += diff * (1 / 16.0f);
+				}
+			}
+		}
+
+		return dseed::error_good;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::bitmaps::quantize_options _options;
+
+	std::vector<rgba8> _samples;
+
+	std::vector<rgba8> _palette;
+	__palette_search _search;
+	std::unique_ptr<std::atomic<int16_t>[]> _cache;
+	float _spread;
+};
+
+dseed::error_t dseed::bitmaps::create_bitmap_quantizer(const quantize_options& options, bitmap_quantizer** quantizer) noexcept
+{
+	if (quantizer == nullptr || options.colors < 2 || options.colors > 256)
+		return dseed::error_invalid_args;
+
+	*quantizer = new __bitmap_quantizer(options);
+	if (*quantizer == nullptr)
+		return dseed::error_out_of_memory;
+
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::quantize_bitmap(bitmap* original, const quantize_options& options, color::pixelformat format, bitmap** bitmap)
+{
+	if (original == nullptr || bitmap == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::autoref<bitmap_quantizer> quantizer;
+	if (auto err = create_bitmap_quantizer(options, &quantizer); dseed::failed(err))
+		return err;
+	if (auto err = quantizer->feed(original); dseed::failed(err))
+		return err;
+	if (auto err = quantizer->build(); dseed::failed(err))
+		return err;
+
+	return quantizer->map(original, format, bitmap);
+}
@@ -3,9 +3,6 @@
 #include <map>
 #include <tuple>
 
-#include "../libs/exoquant/exoquant.h"
-#include "../libs/exoquant/exoquant.c"
-
 //#if defined(USE_SQUISH)
 //#	include <squish.h>
 //#endif
@@ -101,50 +98,6 @@ inline int pixelconv_from_indexedcolor(PIXELCONV_ARGS) noexcept
 	return 0;
 }
 
-template<class TDest, class TSrc>
-inline int pixelconv_to_indexedcolor(PIXELCONV_ARGS) noexcept
-{
-	std::vector<uint8_t> conved;
-	conved.resize(calc_bitmap_plane_size(dseed::color::pixelformat::bgra8, dseed::size2i(size.width, size.height)) * size.depth);
-	pixelconv_plaincolor<bgra8, TSrc>(conved.data(), src, size, nullptr, nullptr);
-
-	if (typeid(TDest) == typeid(bgra8))
-		return pixelconv_to_indexedcolor<bgra8, bgra8>(dest, conved.data(), size, destPalette, nullptr);
-	else if (typeid(TDest) == typeid(bgr8))
-		return pixelconv_to_indexedcolor<bgr8, bgra8>(dest, conved.data(), size, destPalette, nullptr);
-	return 0;
-}
-
-template<>
-inline int pixelconv_to_indexedcolor<bgra8, bgra8>(PIXELCONV_ARGS) noexcept
-{
-	exq_data* pExq;
-	pExq = exq_init();
-	exq_feed(pExq, (uint8_t*)src, size.width * size.height * size.depth);
-	exq_quantize_hq(pExq, 256);
-	std::vector<bgra8> palette(256);
-	exq_get_palette(pExq, (uint8_t*)palette.data(), 256);
-	memcpy(destPalette, palette.data(), sizeof(bgra8) * 256);
-
-	exq_map_image_dither(pExq, size.width, size.height * size.depth, (uint8_t*)src, dest, 0);
-
-	exq_free(pExq);
-
-	return 256;
-}
-template<>
-inline int pixelconv_to_indexedcolor<bgr8, bgra8>(PIXELCONV_ARGS) noexcept
-{
-	std::vector<bgra8> palette(256);
-	size_t count = pixelconv_to_indexedcolor<bgra8, bgra8>(dest, src, size, (uint8_t*)palette.data(), nullptr);
-
-	bgr8* destPaletteBGR = (bgr8*)destPalette;
-	for (int i = 0; i < count; ++i)
-		destPaletteBGR[i] = (bgr8)palette[i];
-
-	return (int)count;
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Packed YCbCr series <-> BGR Conversions
@@ -695,38 +648,6 @@ std::map<pctp, pcfn> g_pixelconvs = {
 	{ pctp(pixelformat::hsva8, pixelformat::bgr8_indexed8), pixelconv_from_indexedcolor<hsva8, bgr8> },
 	{ pctp(pixelformat::hsv8, pixelformat::bgr8_indexed8), pixelconv_from_indexedcolor<hsv8, bgr8> },
 
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::rgba8), pixelconv_to_indexedcolor<bgra8, rgba8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::rgb8), pixelconv_to_indexedcolor<bgra8, rgb8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::rgbaf), pixelconv_to_indexedcolor<bgra8, rgbaf> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::bgra8), pixelconv_to_indexedcolor<bgra8, bgra8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::bgr8), pixelconv_to_indexedcolor<bgra8, bgr8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::bgra4), pixelconv_to_indexedcolor<bgra8, bgra4> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::bgr565), pixelconv_to_indexedcolor<bgra8, bgr565> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::r8), pixelconv_to_indexedcolor<bgra8, r8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::rf), pixelconv_to_indexedcolor<bgra8, rf> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::ra8), pixelconv_to_indexedcolor<bgra8, ra8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::raf), pixelconv_to_indexedcolor<bgra8, raf> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::yuva8), pixelconv_to_indexedcolor<bgra8, yuva8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::yuv8), pixelconv_to_indexedcolor<bgra8, yuv8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::hsva8), pixelconv_to_indexedcolor<bgra8, hsva8> },
-	{ pctp(pixelformat::bgra8_indexed8, pixelformat::hsv8), pixelconv_to_indexedcolor<bgra8, hsv8> },
-
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::rgba8), pixelconv_to_indexedcolor<bgr8, rgba8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::rgb8), pixelconv_to_indexedcolor<bgr8, rgb8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::rgbaf), pixelconv_to_indexedcolor<bgr8, rgbaf> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::bgra8), pixelconv_to_indexedcolor<bgr8, bgra8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::bgr8), pixelconv_to_indexedcolor<bgr8, bgr8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::bgra4), pixelconv_to_indexedcolor<bgr8, bgra4> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::bgr565), pixelconv_to_indexedcolor<bgr8, bgr565> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::r8), pixelconv_to_indexedcolor<bgr8, r8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::rf), pixelconv_to_indexedcolor<bgr8, rf> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::ra8), pixelconv_to_indexedcolor<bgr8, ra8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::raf), pixelconv_to_indexedcolor<bgr8, raf> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::yuva8), pixelconv_to_indexedcolor<bgr8, yuva8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::yuv8), pixelconv_to_indexedcolor<bgr8, yuv8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::hsva8), pixelconv_to_indexedcolor<bgr8, hsva8> },
-	{ pctp(pixelformat::bgr8_indexed8, pixelformat::hsv8), pixelconv_to_indexedcolor<bgr8, hsv8> },
-
 	////////////////////////////////////////////////////////////////////////////////////////
 	// Subsampled YUV Color Conversions
 	////////////////////////////////////////////////////////////////////////////////////////
@@ -833,23 +754,15 @@ dseed::error_t dseed::bitmaps::reformat_bitmap(dseed::bitmaps::bitmap* original,
 		return dseed::error_good;
 	}
 
-	bool isIndexedTarget = false;
-	int bpp = 0;
-	dseed::autoref<dseed::bitmaps::palette> tempPalette;
+	// Palette is built by quantizer
 	if (reformat == pixelformat::bgra8_indexed8 || reformat == pixelformat::bgr8_indexed8)
-	{
-		isIndexedTarget = true;
-		bpp = ((int)reformat & 0xff) * 8;
-
-		if (dseed::failed(dseed::bitmaps::create_palette(nullptr, bpp, 256, &tempPalette)))
-			return dseed::error_fail;
-	}
+		return dseed::bitmaps::quantize_bitmap(original, dseed::bitmaps::quantize_options(), reformat, bitmap);
 
 	dseed::size3i size = original->size();
 
 	dseed::autoref<dseed::bitmaps::bitmap> temp;
 	if (dseed::failed(dseed::bitmaps::create_bitmap(dseed::bitmaps::bitmaptype::bitmap2d, size, reformat
-		, tempPalette, &temp)))
+		, nullptr, &temp)))
 		return dseed::error_fail;
 
 	uint8_t* destPtr, * srcPtr, * destPalettePtr = nullptr, * srcPalettePtr = nullptr;
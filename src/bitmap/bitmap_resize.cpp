@@ -374,6 +374,10 @@ dseed::error_t dseed::bitmaps::resize_bitmap(dseed::bitmaps::bitmap* original, r
 	if (size.width == 0 || size.height == 0 || size.depth == 0)
 		return dseed::error_invalid_args;
 
+	auto found = g_resizes.find(rztp(resize_method, original->format()));
+	if (found == g_resizes.end())
+		return dseed::error_not_support;
+
 	dseed::autoref<dseed::bitmaps::bitmap> temp;
 	if (dseed::failed(dseed::bitmaps::create_bitmap(original->type(), size, original->format(), nullptr, &temp)))
 		return dseed::error_fail;
@@ -382,16 +386,14 @@ dseed::error_t dseed::bitmaps::resize_bitmap(dseed::bitmaps::bitmap* original, r
 	original->lock((void**)&srcPtr);
 	temp->lock((void**)&destPtr);
 
-	auto found = g_resizes.find(rztp(resize_method, original->format()));
-	if (found == g_resizes.end())
-		return dseed::error_not_support;
-
-	if (!found->second(destPtr, srcPtr, size, original->size()))
-		return dseed::error_not_support;
+	const bool processed = found->second(destPtr, srcPtr, size, original->size());
 
 	temp->unlock();
 	original->unlock();
 
+	if (!processed)
+		return dseed::error_not_support;
+
 	*bitmap = temp.detach();
 
 	return dseed::error_good;
@@ -0,0 +1,381 @@
+#include <dseed.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+#include <cstring>
+
+#include "common.hxx"
+
+using namespace dseed::color;
+using namespace dseed::bitmaps::rowkernel;
+using size2i = dseed::size2i;
+
+// Cache block size in pixels for transposing
+//  : Source block and destination block are kept in L1/L2 cache together.
+template<class TPixel> constexpr size_t transpose_block() noexcept { return sizeof(TPixel) >= 16 ? 32 : 64; }
+// Micro tile size in pixels transposed in SIMD registers
+template<class TPixel> constexpr size_t transpose_micro() noexcept
+{
+#if ARCH_X86SET && !DONT_USE_SSE
+	if constexpr (sizeof(TPixel) == 1 || sizeof(TPixel) == 2) return 8;
+#endif
+	if constexpr (sizeof(TPixel) == 4) return 4;
+	return 1;
+}
+
+template<class TPixel>
+inline void transpose_micro_tile(uint8_t* dest, ptrdiff_t destStride, const uint8_t* src, ptrdiff_t srcStride) noexcept
+{
+#if ARCH_X86SET && !DONT_USE_SSE
+	if constexpr (sizeof(TPixel) == 1)
+	{
+		const auto r0 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 0)), r1 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 1));
+		const auto r2 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 2)), r3 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 3));
+		const auto r4 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 4)), r5 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 5));
+		const auto r6 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 6)), r7 = _mm_loadl_epi64((const __m128i*)(src + srcStride * 7));
+
+		const auto a = _mm_unpacklo_epi8(r0, r1), b = _mm_unpacklo_epi8(r2, r3);
+		const auto c = _mm_unpacklo_epi8(r4, r5), d = _mm_unpacklo_epi8(r6, r7);
+
+		const auto e = _mm_unpacklo_epi16(a, b), f = _mm_unpackhi_epi16(a, b);
+		const auto g = _mm_unpacklo_epi16(c, d), h = _mm_unpackhi_epi16(c, d);
+
+		const __m128i cols[4] = {
+			_mm_unpacklo_epi32(e, g), _mm_unpackhi_epi32(e, g),
+			_mm_unpacklo_epi32(f, h), _mm_unpackhi_epi32(f, h),
+		};
+		for (int i = 0; i < 4; ++i)
+		{
+			_mm_storel_epi64((__m128i*)(dest + destStride * (i * 2)), cols[i]);
+			_mm_storel_epi64((__m128i*)(dest + destStride * (i * 2 + 1)), _mm_srli_si128(cols[i], 8));
+		}
+		return;
+	}
+	else if constexpr (sizeof(TPixel) == 2)
+	{
+		const auto r0 = _mm_loadu_si128((const __m128i*)(src + srcStride * 0)), r1 = _mm_loadu_si128((const __m128i*)(src + srcStride * 1));
+		const auto r2 = _mm_loadu_si128((const __m128i*)(src + srcStride * 2)), r3 = _mm_loadu_si128((const __m128i*)(src + srcStride * 3));
+		const auto r4 = _mm_loadu_si128((const __m128i*)(src + srcStride * 4)), r5 = _mm_loadu_si128((const __m128i*)(src + srcStride * 5));
+		const auto r6 = _mm_loadu_si128((const __m128i*)(src + srcStride * 6)), r7 = _mm_loadu_si128((const __m128i*)(src + srcStride * 7));
+
+		const auto a0 = _mm_unpacklo_epi16(r0, r1), a1 = _mm_unpackhi_epi16(r0, r1);
+		const auto b0 = _mm_unpacklo_epi16(r2, r3), b1 = _mm_unpackhi_epi16(r2, r3);
+		const auto c0 = _mm_unpacklo_epi16(r4, r5), c1 = _mm_unpackhi_epi16(r4, r5);
+		const auto d0 = _mm_unpacklo_epi16(r6, r7), d1 = _mm_unpackhi_epi16(r6, r7);
+
+		const __m128i e[4] = { _mm_unpacklo_epi32(a0, b0), _mm_unpackhi_epi32(a0, b0), _mm_unpacklo_epi32(a1, b1), _mm_unpackhi_epi32(a1, b1) };
+		const __m128i f[4] = { _mm_unpacklo_epi32(c0, d0), _mm_unpackhi_epi32(c0, d0), _mm_unpacklo_epi32(c1, d1), _mm_unpackhi_epi32(c1, d1) };
+		for (int i = 0; i < 4; ++i)
+		{
+			_mm_storeu_si128((__m128i*)(dest + destStride * (i * 2)), _mm_unpacklo_epi64(e[i], f[i]));
+			_mm_storeu_si128((__m128i*)(dest + destStride * (i * 2 + 1)), _mm_unpackhi_epi64(e[i], f[i]));
+		}
+		return;
+	}
+#endif
+	if constexpr (sizeof(TPixel) == 4)
+	{
+		const dseed::f32x4x4_t m(
+			loadf((const float*)(src + srcStride * 0)), loadf((const float*)(src + srcStride * 1)),
+			loadf((const float*)(src + srcStride * 2)), loadf((const float*)(src + srcStride * 3)));
+
+		const auto t = dseed::transpose(m);
+		storef((float*)(dest + destStride * 0), t._c1);
+		storef((float*)(dest + destStride * 1), t._c2);
+		storef((float*)(dest + destStride * 2), t._c3);
+		storef((float*)(dest + destStride * 3), t._c4);
+	}
+}
+
+// Transposes one plane. Negative strides flip the axis while transposing.
+//  : width, height are size of source plane.
+template<class TPixel>
+inline void transpose_plane(uint8_t* dest, ptrdiff_t destStride, const uint8_t* src, ptrdiff_t srcStride, size_t width, size_t height) noexcept
+{
+	constexpr size_t block = transpose_block<TPixel>();
+	constexpr size_t micro = transpose_micro<TPixel>();
+
+	for (size_t by = 0; by < height; by += block)
+	{
+		const size_t bh = dseed::minimum(block, height - by);
+		for (size_t bx = 0; bx < width; bx += block)
+		{
+			const size_t bw = dseed::minimum(block, width - bx);
+
+			size_t y = 0;
+			if constexpr (micro > 1)
+			{
+				for (; y + micro <= bh; y += micro)
+				{
+					size_t x = 0;
+					for (; x + micro <= bw; x += micro)
+						transpose_micro_tile<TPixel>(dest + (ptrdiff_t)(bx + x) * destStride + (by + y) * sizeof(TPixel), destStride,
+							src + (ptrdiff_t)(by + y) * srcStride + (bx + x) * sizeof(TPixel), srcStride);
+
+					for (; x < bw; ++x)
+						for (size_t yy = y; yy < y + micro; ++yy)
+							*(TPixel*)(dest + (ptrdiff_t)(bx + x) * destStride + (by + yy) * sizeof(TPixel))
+								= *(const TPixel*)(src + (ptrdiff_t)(by + yy) * srcStride + (bx + x) * sizeof(TPixel));
+				}
+			}
+
+			for (; y < bh; ++y)
+			{
+				const TPixel* srcPtr = (const TPixel*)(src + (ptrdiff_t)(by + y) * srcStride) + bx;
+				for (size_t x = 0; x < bw; ++x)
+					*(TPixel*)(dest + (ptrdiff_t)(bx + x) * destStride + (by + y) * sizeof(TPixel)) = *(srcPtr + x);
+			}
+		}
+	}
+}
+
+// Reverses pixel order of one row. dest and src must not overlap.
+template<class TPixel>
+inline void reverse_row(uint8_t* dest, const uint8_t* src, size_t width) noexcept
+{
+	size_t x = 0;
+	if constexpr (sizeof(TPixel) == 1 || sizeof(TPixel) == 2 || sizeof(TPixel) == 4)
+	{
+		static const dseed::i32x4_t mask = (sizeof(TPixel) == 1)
+			? dseed::i32x4_t(0x0c0d0e0f, 0x08090a0b, 0x04050607, 0x00010203)
+			: ((sizeof(TPixel) == 2)
+				? dseed::i32x4_t(0x0d0c0f0e, 0x09080b0a, 0x05040706, 0x01000302)
+				: dseed::i32x4_t(0x0f0e0d0c, 0x0b0a0908, 0x07060504, 0x03020100));
+		constexpr size_t perVector = sizeof(dseed::i32x4_t) / sizeof(TPixel);
+
+		const size_t rowBytes = width * sizeof(TPixel);
+		for (; x + perVector <= width; x += perVector)
+		{
+			const auto v = dseed::i32x4_t::shuffle8(load8(src + x * sizeof(TPixel)), mask);
+			store8(dest + rowBytes - (x + perVector) * sizeof(TPixel), v);
+		}
+	}
+
+	const TPixel* srcPtr = (const TPixel*)src;
+	TPixel* destPtr = (TPixel*)dest;
+	for (; x < width; ++x)
+		*(destPtr + (width - x - 1)) = *(srcPtr + x);
+}
+
+enum __ROTATION { __ROTATION_90, __ROTATION_180, __ROTATION_270, __ROTATION_TRANSPOSE };
+
+using rtfn = std::function<bool(uint8_t* dest, const uint8_t* src, const dseed::size3i& size)>;
+using rttp = std::tuple<__ROTATION, pixelformat>;
+
+template<class TPixel, __ROTATION rotation>
+inline bool bmprt(uint8_t* dest, const uint8_t* src, const dseed::size3i& size) noexcept
+{
+	const size_t srcStride = calc_bitmap_stride(type2format<TPixel>(), size.width);
+	const size_t srcDepth = calc_bitmap_plane_size(type2format<TPixel>(), size2i(size.width, size.height));
+
+	if constexpr (rotation == __ROTATION_180)
+	{
+		for (size_t z = 0; z < size.depth; ++z)
+		{
+			const size_t depthZ = z * srcDepth;
+			for (size_t y = 0; y < size.height; ++y)
+				reverse_row<TPixel>(dest + depthZ + (y * srcStride), src + depthZ + ((size.height - y - 1) * srcStride), size.width);
+		}
+	}
+	else
+	{
+		const size_t destStride = calc_bitmap_stride(type2format<TPixel>(), size.height);
+		const size_t destDepth = calc_bitmap_plane_size(type2format<TPixel>(), size2i(size.height, size.width));
+
+		for (size_t z = 0; z < size.depth; ++z)
+		{
+			uint8_t* destPlane = dest + z * destDepth;
+			const uint8_t* srcPlane = src + z * srcDepth;
+
+			switch (rotation)
+			{
+			case __ROTATION_90:
+				// dest(x, y) = src(y, height - x - 1)
+				transpose_plane<TPixel>(destPlane, destStride,
+					srcPlane + (size.height - 1) * srcStride, -(ptrdiff_t)srcStride, size.width, size.height);
+				break;
+			case __ROTATION_270:
+				// dest(x, y) = src(width - y - 1, x)
+				transpose_plane<TPixel>(destPlane + (size.width - 1) * destStride, -(ptrdiff_t)destStride,
+					srcPlane, srcStride, size.width, size.height);
+				break;
+			default:
+				transpose_plane<TPixel>(destPlane, destStride, srcPlane, srcStride, size.width, size.height);
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+#define __ROTATION_ENTRIES(rotation)\
+	{ rttp(rotation, pixelformat::rgba8), bmprt<rgba8, rotation> },\
+	{ rttp(rotation, pixelformat::rgb8), bmprt<rgb8, rotation> },\
+	{ rttp(rotation, pixelformat::rgbaf), bmprt<rgbaf, rotation> },\
+	{ rttp(rotation, pixelformat::bgra8), bmprt<bgra8, rotation> },\
+	{ rttp(rotation, pixelformat::bgr8), bmprt<bgr8, rotation> },\
+	{ rttp(rotation, pixelformat::bgra4), bmprt<bgra4, rotation> },\
+	{ rttp(rotation, pixelformat::bgr565), bmprt<bgr565, rotation> },\
+	{ rttp(rotation, pixelformat::r8), bmprt<r8, rotation> },\
+	{ rttp(rotation, pixelformat::rf), bmprt<rf, rotation> },\
+	{ rttp(rotation, pixelformat::yuva8), bmprt<yuva8, rotation> },\
+	{ rttp(rotation, pixelformat::yuv8), bmprt<yuv8, rotation> },\
+	{ rttp(rotation, pixelformat::hsva8), bmprt<hsva8, rotation> },\
+	{ rttp(rotation, pixelformat::hsv8), bmprt<hsv8, rotation> }
+
+std::map<rttp, rtfn> g_rotations = {
+	__ROTATION_ENTRIES(__ROTATION_90),
+	__ROTATION_ENTRIES(__ROTATION_180),
+	__ROTATION_ENTRIES(__ROTATION_270),
+	__ROTATION_ENTRIES(__ROTATION_TRANSPOSE),
+};
+
+dseed::error_t __internal_rotate(dseed::bitmaps::bitmap* original, __ROTATION rotation, dseed::bitmaps::bitmap** bitmap)
+{
+	if (original == nullptr || bitmap == nullptr)
+		return dseed::error_invalid_args;
+
+	auto found = g_rotations.find(rttp(rotation, original->format()));
+	if (found == g_rotations.end())
+		return dseed::error_not_support;
+
+	const auto size = original->size();
+	const dseed::size3i destSize = (rotation == __ROTATION_180) ? size : dseed::size3i(size.height, size.width, size.depth);
+
+	dseed::autoref<dseed::bitmaps::bitmap> temp;
+	if (dseed::failed(dseed::bitmaps::create_bitmap(original->type(), destSize, original->format(), nullptr, &temp)))
+		return dseed::error_fail;
+
+	uint8_t* destPtr, * srcPtr;
+	original->lock((void**)&srcPtr);
+	temp->lock((void**)&destPtr);
+
+	const bool succeed = found->second(destPtr, srcPtr, size);
+
+	temp->unlock();
+	original->unlock();
+
+	if (!succeed)
+		return dseed::error_fail;
+
+	*bitmap = temp.detach();
+
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::rotate_bitmap(dseed::bitmaps::bitmap* original, rotation rotation, dseed::bitmaps::bitmap** bitmap)
+{
+	switch (rotation)
+	{
+	case rotation::rotate90: return __internal_rotate(original, __ROTATION_90, bitmap);
+	case rotation::rotate180: return __internal_rotate(original, __ROTATION_180, bitmap);
+	case rotation::rotate270: return __internal_rotate(original, __ROTATION_270, bitmap);
+	default: return dseed::error_invalid_args;
+	}
+}
+
+dseed::error_t dseed::bitmaps::transpose_bitmap(dseed::bitmaps::bitmap* original, dseed::bitmaps::bitmap** bitmap)
+{
+	return __internal_rotate(original, __ROTATION_TRANSPOSE, bitmap);
+}
+
+using iptfn = std::function<bool(uint8_t* pixels, const dseed::size3i& size)>;
+using ipttp = std::tuple<dseed::bitmaps::inplace_transform, pixelformat>;
+
+template<class TPixel, dseed::bitmaps::inplace_transform transform>
+inline bool bmpipt(uint8_t* pixels, const dseed::size3i& size) noexcept
+{
+	const size_t stride = calc_bitmap_stride(type2format<TPixel>(), size.width);
+	const size_t depth = calc_bitmap_plane_size(type2format<TPixel>(), size2i(size.width, size.height));
+	const size_t rowBytes = size.width * sizeof(TPixel);
+
+	std::vector<uint8_t> row1(rowBytes), row2(rowBytes);
+
+	for (size_t z = 0; z < size.depth; ++z)
+	{
+		uint8_t* plane = pixels + z * depth;
+
+		if constexpr (transform == dseed::bitmaps::inplace_transform::flip_horizontal)
+		{
+			for (size_t y = 0; y < size.height; ++y)
+			{
+				memcpy(row1.data(), plane + y * stride, rowBytes);
+				reverse_row<TPixel>(plane + y * stride, row1.data(), size.width);
+			}
+		}
+		else
+		{
+			for (size_t y = 0; y < size.height / 2; ++y)
+			{
+				uint8_t* top = plane + y * stride;
+				uint8_t* bottom = plane + (size.height - y - 1) * stride;
+
+				memcpy(row1.data(), top, rowBytes);
+				if constexpr (transform == dseed::bitmaps::inplace_transform::rotate180)
+				{
+					reverse_row<TPixel>(top, bottom, size.width);
+					reverse_row<TPixel>(bottom, row1.data(), size.width);
+				}
+				else
+				{
+					memcpy(top, bottom, rowBytes);
+					memcpy(bottom, row1.data(), rowBytes);
+				}
+			}
+
+			if constexpr (transform == dseed::bitmaps::inplace_transform::rotate180)
+			{
+				if (size.height % 2 == 1)
+				{
+					uint8_t* middle = plane + (size.height / 2) * stride;
+					memcpy(row2.data(), middle, rowBytes);
+					reverse_row<TPixel>(middle, row2.data(), size.width);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+#define __INPLACE_ENTRIES(transform)\
+	{ ipttp(transform, pixelformat::rgba8), bmpipt<rgba8, transform> },\
+	{ ipttp(transform, pixelformat::rgb8), bmpipt<rgb8, transform> },\
+	{ ipttp(transform, pixelformat::rgbaf), bmpipt<rgbaf, transform> },\
+	{ ipttp(transform, pixelformat::bgra8), bmpipt<bgra8, transform> },\
+	{ ipttp(transform, pixelformat::bgr8), bmpipt<bgr8, transform> },\
+	{ ipttp(transform, pixelformat::bgra4), bmpipt<bgra4, transform> },\
+	{ ipttp(transform, pixelformat::bgr565), bmpipt<bgr565, transform> },\
+	{ ipttp(transform, pixelformat::r8), bmpipt<r8, transform> },\
+	{ ipttp(transform, pixelformat::rf), bmpipt<rf, transform> },\
+	{ ipttp(transform, pixelformat::yuva8), bmpipt<yuva8, transform> },\
+	{ ipttp(transform, pixelformat::yuv8), bmpipt<yuv8, transform> },\
+	{ ipttp(transform, pixelformat::hsva8), bmpipt<hsva8, transform> },\
+	{ ipttp(transform, pixelformat::hsv8), bmpipt<hsv8, transform> }
+
+std::map<ipttp, iptfn> g_inplaces = {
+	__INPLACE_ENTRIES(dseed::bitmaps::inplace_transform::rotate180),
+	__INPLACE_ENTRIES(dseed::bitmaps::inplace_transform::flip_horizontal),
+	__INPLACE_ENTRIES(dseed::bitmaps::inplace_transform::flip_vertical),
+};
+
+dseed::error_t dseed::bitmaps::transform_bitmap_inplace(dseed::bitmaps::bitmap* bitmap, inplace_transform transform)
+{
+	if (bitmap == nullptr)
+		return dseed::error_invalid_args;
+
+	auto found = g_inplaces.find(ipttp(transform, bitmap->format()));
+	if (found == g_inplaces.end())
+		return dseed::error_not_support;
+
+	uint8_t* ptr;
+	bitmap->lock((void**)&ptr);
+
+	const bool succeed = found->second(ptr, bitmap->size());
+
+	bitmap->unlock();
+
+	return succeed ? dseed::error_good : dseed::error_fail;
+}
@@ -0,0 +1,426 @@
+#include <dseed.h>
+
+#include <map>
+#include <tuple>
+#include <cmath>
+
+#include "common.hxx"
+#include "parallel.hxx"
+
+using namespace dseed::color;
+using namespace dseed::bitmaps::rowkernel;
+using size2i = dseed::size2i;
+using resize = dseed::bitmaps::resize;
+using edgemode = dseed::bitmaps::edgemode;
+
+// Destination rows processed by one parallel job
+#define WARP_TILE_ROWS								16
+
+struct warpcontext
+{
+	const uint8_t* src;
+	size_t srcStride;
+	int srcWidth, srcHeight;
+
+	uint8_t* dest;
+	size_t destStride;
+	int destWidth, destHeight;
+
+	// Destination to source mapping, (x, y, 1) * inverse
+	double inverse[3][3];
+	edgemode edge;
+	dseed::f32x4_t border;
+};
+
+template<class TElement, size_t elements>
+struct warppixel
+{
+	static inline dseed::f32x4_t load(const uint8_t* ptr) noexcept
+	{
+		if constexpr (std::is_same<TElement, float>::value)
+		{
+			float arr[4] = { 0, 0, 0, 0 };
+			memcpy(arr, ptr, sizeof(float) * elements);
+			if constexpr (elements == 1)
+				return dseed::f32x4_t(arr[0]);
+			else
+				return dseed::f32x4_t(arr[0], arr[1], arr[2], arr[3]);
+		}
+		else
+		{
+			if constexpr (elements == 1)
+				return dseed::f32x4_t((float)ptr[0]);
+			else if constexpr (elements == 3)
+				return dseed::f32x4_t((float)ptr[0], (float)ptr[1], (float)ptr[2], 0);
+			else
+				return dseed::f32x4_t((float)ptr[0], (float)ptr[1], (float)ptr[2], (float)ptr[3]);
+		}
+	}
+
+	static inline void store(uint8_t* ptr, const dseed::f32x4_t& v) noexcept
+	{
+		float arr[4];
+		if constexpr (std::is_same<TElement, float>::value)
+		{
+			memcpy(arr, &v, sizeof(arr));
+			memcpy(ptr, arr, sizeof(float) * elements);
+		}
+		else
+		{
+			const auto clamped = dseed::minimum(dseed::maximum(dseed::round(v), dseed::f32x4_t(0.0f)), dseed::f32x4_t(255.0f));
+			memcpy(arr, &clamped, sizeof(arr));
+			for (size_t i = 0; i < elements; ++i)
+				ptr[i] = (uint8_t)arr[i];
+		}
+	}
+};
+
+// Resolves coordinate out of bitmap by edge mode
+//  : Returns -1 if coordinate should be border color.
+inline int resolve_edge(int i, int n, edgemode edge) noexcept
+{
+	if (i >= 0 && i < n)
+		return i;
+
+	switch (edge)
+	{
+	case edgemode::clamp:
+		return i < 0 ? 0 : n - 1;
+	case edgemode::wrap:
+		{
+			const int r = i % n;
+			return r < 0 ? r + n : r;
+		}
+	case edgemode::mirror:
+		{
+			const int period = n * 2;
+			int r = i % period;
+			if (r < 0) r += period;
+			return r < n ? r : period - r - 1;
+		}
+	default:
+		return -1;
+	}
+}
+
+template<class TPixel>
+inline dseed::f32x4_t fetch_edge(const warpcontext& ctx, int x, int y) noexcept
+{
+	const int rx = resolve_edge(x, ctx.srcWidth, ctx.edge), ry = resolve_edge(y, ctx.srcHeight, ctx.edge);
+	if (rx < 0 || ry < 0)
+		return ctx.border;
+	return TPixel::load(ctx.src + (ry * ctx.srcStride) + (rx * sizeof(typename TPixel::element) * TPixel::elements));
+}
+
+template<class TElement, size_t elementsCount>
+struct warpformat : public warppixel<TElement, elementsCount>
+{
+	using element = TElement;
+	static constexpr size_t elements = elementsCount;
+	static constexpr size_t pixel_size = sizeof(TElement) * elementsCount;
+};
+
+// Coordinates larger than this are always out of bitmap
+constexpr float WARP_COORD_LIMIT = 16777216.0f;
+
+template<class TPixel>
+inline dseed::f32x4_t sample_nearest(const warpcontext& ctx, float sx, float sy) noexcept
+{
+	const int x = (int)std::floor(sx + 0.5f), y = (int)std::floor(sy + 0.5f);
+	if (x >= 0 && x < ctx.srcWidth && y >= 0 && y < ctx.srcHeight)
+		return TPixel::load(ctx.src + (y * ctx.srcStride) + (x * TPixel::pixel_size));
+	return fetch_edge<TPixel>(ctx, x, y);
+}
+
+template<class TPixel>
+inline dseed::f32x4_t sample_bilinear(const warpcontext& ctx, float sx, float sy) noexcept
+{
+	const float fx0 = std::floor(sx), fy0 = std::floor(sy);
+	const int x0 = (int)fx0, y0 = (int)fy0;
+	const float fx = sx - fx0, fy = sy - fy0;
+
+	dseed::f32x4_t p00, p10, p01, p11;
+	if (x0 >= 0 && x0 + 1 < ctx.srcWidth && y0 >= 0 && y0 + 1 < ctx.srcHeight)
+	{
+		const uint8_t* row0 = ctx.src + (y0 * ctx.srcStride) + (x0 * TPixel::pixel_size);
+		const uint8_t* row1 = row0 + ctx.srcStride;
+		p00 = TPixel::load(row0); p10 = TPixel::load(row0 + TPixel::pixel_size);
+		p01 = TPixel::load(row1); p11 = TPixel::load(row1 + TPixel::pixel_size);
+	}
+	else
+	{
+		p00 = fetch_edge<TPixel>(ctx, x0, y0); p10 = fetch_edge<TPixel>(ctx, x0 + 1, y0);
+		p01 = fetch_edge<TPixel>(ctx, x0, y0 + 1); p11 = fetch_edge<TPixel>(ctx, x0 + 1, y0 + 1);
+	}
+
+	const dseed::f32x4_t vfx(fx), vfy(fy);
+	const auto top = dseed::fmaf(p10 - p00, vfx, p00);
+	const auto bottom = dseed::fmaf(p11 - p01, vfx, p01);
+	return dseed::fmaf(bottom - top, vfy, top);
+}
+
+// Catmull-Rom spline weights
+inline void cubic_weights(float t, float* w) noexcept
+{
+	w[0] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+	w[1] = (1.5f * t - 2.5f) * t * t + 1.0f;
+	w[2] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+	w[3] = (0.5f * t - 0.5f) * t * t;
+}
+
+template<class TPixel>
+inline dseed::f32x4_t sample_bicubic(const warpcontext& ctx, float sx, float sy) noexcept
+{
+	const float fx0 = std::floor(sx), fy0 = std::floor(sy);
+	const int x0 = (int)fx0 - 1, y0 = (int)fy0 - 1;
+
+	float wx[4], wy[4];
+	cubic_weights(sx - fx0, wx);
+	cubic_weights(sy - fy0, wy);
+
+	const bool inside = x0 >= 0 && x0 + 3 < ctx.srcWidth && y0 >= 0 && y0 + 3 < ctx.srcHeight;
+
+	dseed::f32x4_t sum(0.0f);
+	for (int j = 0; j < 4; ++j)
+	{
+		dseed::f32x4_t row(0.0f);
+		if (inside)
+		{
+			const uint8_t* ptr = ctx.src + ((y0 + j) * ctx.srcStride) + (x0 * TPixel::pixel_size);
+			for (int i = 0; i < 4; ++i)
+				row = dseed::fmaf(TPixel::load(ptr + (i * TPixel::pixel_size)), dseed::f32x4_t(wx[i]), row);
+		}
+		else
+		{
+			for (int i = 0; i < 4; ++i)
+				row = dseed::fmaf(fetch_edge<TPixel>(ctx, x0 + i, y0 + j), dseed::f32x4_t(wx[i]), row);
+		}
+		sum = dseed::fmaf(row, dseed::f32x4_t(wy[j]), sum);
+	}
+
+	return sum;
+}
+
+// Process one destination row
+//  : Source coordinates are computed from row origin for each pixel,
+//    stepping incrementally accumulates float error on wide rows.
+template<class TPixel, dseed::f32x4_t(*sampler)(const warpcontext&, float, float), bool perspective>
+inline void warp_row(const warpcontext& ctx, int y) noexcept
+{
+	const auto& m = ctx.inverse;
+	const dseed::f32x4_t step((float)m[0][0], (float)m[0][1], (float)m[0][2], 0);
+	const dseed::f32x4_t origin((float)(y * m[1][0] + m[2][0]), (float)(y * m[1][1] + m[2][1]), (float)(y * m[1][2] + m[2][2]), 0);
+
+	uint8_t* destPtr = ctx.dest + (y * ctx.destStride);
+	for (int x = 0; x < ctx.destWidth; ++x, destPtr += TPixel::pixel_size)
+	{
+		const auto coord = dseed::fmaf(dseed::f32x4_t((float)x), step, origin);
+		float sx = coord.x(), sy = coord.y();
+		if constexpr (perspective)
+		{
+			const float w = coord.z();
+			if (w == 0)
+			{
+				TPixel::store(destPtr, ctx.border);
+				continue;
+			}
+			sx /= w;
+			sy /= w;
+		}
+
+		if (!(sx > -WARP_COORD_LIMIT && sx < WARP_COORD_LIMIT && sy > -WARP_COORD_LIMIT && sy < WARP_COORD_LIMIT))
+		{
+			TPixel::store(destPtr, ctx.edge == edgemode::constant ? ctx.border : fetch_edge<TPixel>(ctx,
+				sx > 0 ? ctx.srcWidth : -1, sy > 0 ? ctx.srcHeight : -1));
+			continue;
+		}
+
+		TPixel::store(destPtr, sampler(ctx, sx, sy));
+	}
+}
+
+using wpfn = void(*)(const warpcontext& ctx, int y);
+using wptp = std::tuple<resize, bool, pixelformat>;
+
+template<class TPixel, bool perspective>
+struct warpentries
+{
+	static constexpr wpfn nearest = warp_row<TPixel, sample_nearest<TPixel>, perspective>;
+	static constexpr wpfn bilinear = warp_row<TPixel, sample_bilinear<TPixel>, perspective>;
+	static constexpr wpfn bicubic = warp_row<TPixel, sample_bicubic<TPixel>, perspective>;
+};
+
+#define __WARP_ENTRIES(format, pixel, perspective)\
+	{ wptp(resize::nearest, perspective, format), warpentries<pixel, perspective>::nearest },\
+	{ wptp(resize::bilinear, perspective, format), warpentries<pixel, perspective>::bilinear },\
+	{ wptp(resize::bicubic, perspective, format), warpentries<pixel, perspective>::bicubic }
+#define __WARP_FORMAT_ENTRIES(format, pixel)\
+	__WARP_ENTRIES(format, pixel, false),\
+	__WARP_ENTRIES(format, pixel, true)
+
+using warp8x4 = warpformat<uint8_t, 4>;
+using warp8x3 = warpformat<uint8_t, 3>;
+using warp8x1 = warpformat<uint8_t, 1>;
+using warpfx4 = warpformat<float, 4>;
+using warpfx1 = warpformat<float, 1>;
+
+std::map<wptp, wpfn> g_warps = {
+	__WARP_FORMAT_ENTRIES(pixelformat::rgba8, warp8x4),
+	__WARP_FORMAT_ENTRIES(pixelformat::rgb8, warp8x3),
+	__WARP_FORMAT_ENTRIES(pixelformat::rgbaf, warpfx4),
+	__WARP_FORMAT_ENTRIES(pixelformat::bgra8, warp8x4),
+	__WARP_FORMAT_ENTRIES(pixelformat::bgr8, warp8x3),
+	__WARP_FORMAT_ENTRIES(pixelformat::r8, warp8x1),
+	__WARP_FORMAT_ENTRIES(pixelformat::rf, warpfx1),
+	__WARP_FORMAT_ENTRIES(pixelformat::yuva8, warp8x4),
+	__WARP_FORMAT_ENTRIES(pixelformat::yuv8, warp8x3),
+	__WARP_FORMAT_ENTRIES(pixelformat::hsva8, warp8x4),
+	__WARP_FORMAT_ENTRIES(pixelformat::hsv8, warp8x3),
+};
+
+// Converts normalized RGBA border to bytes of destination pixel type
+//  : Rows store raw channels, so border follows channel order of format(BGR, YUV, HSV).
+template<class TColor>
+inline dseed::f32x4_t warp_border(const dseed::f32x4_t& border) noexcept
+{
+	float arr[4];
+	memcpy(arr, &border, sizeof(arr));
+	const rgba8 rgba(
+		saturate8((int32_t)std::round(arr[0] * 255)),
+		saturate8((int32_t)std::round(arr[1] * 255)),
+		saturate8((int32_t)std::round(arr[2] * 255)),
+		saturate8((int32_t)std::round(arr[3] * 255)));
+	const TColor color = rgba;
+
+	uint8_t bytes[4] = { 0, 0, 0, 0 };
+	memcpy(bytes, &color, sizeof(TColor));
+	return dseed::f32x4_t((float)bytes[0], (float)bytes[1], (float)bytes[2], (float)bytes[3]);
+}
+
+inline dseed::f32x4_t warp_border(pixelformat format, const dseed::f32x4_t& border) noexcept
+{
+	switch (format)
+	{
+	case pixelformat::rgba8: return warp_border<rgba8>(border);
+	case pixelformat::rgb8: return warp_border<rgb8>(border);
+	case pixelformat::bgra8: return warp_border<bgra8>(border);
+	case pixelformat::bgr8: return warp_border<bgr8>(border);
+	case pixelformat::r8: return warp_border<r8>(border);
+	case pixelformat::yuva8: return warp_border<yuva8>(border);
+	case pixelformat::yuv8: return warp_border<yuv8>(border);
+	case pixelformat::hsva8: return warp_border<hsva8>(border);
+	case pixelformat::hsv8: return warp_border<hsv8>(border);
+	case pixelformat::rf:
+		{
+			float arr[4];
+			memcpy(arr, &border, sizeof(arr));
+			return dseed::f32x4_t(rf(rgbaf(arr[0], arr[1], arr[2], arr[3])).color);
+		}
+	default: return border;
+	}
+}
+
+// Inverts 3x3 homography in double precision
+inline bool invert_homography(const double m[3][3], double inv[3][3]) noexcept
+{
+	const double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	const double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	const double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+
+	const double det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+	if (std::fabs(det) < 1e-12)
+		return false;
+
+	const double invDet = 1.0 / det;
+	inv[0][0] = c00 * invDet;
+	inv[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+	inv[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+	inv[1][0] = c01 * invDet;
+	inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+	inv[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+	inv[2][0] = c02 * invDet;
+	inv[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+	inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+
+	return true;
+}
+
+dseed::error_t __internal_warp(dseed::bitmaps::bitmap* original, const dseed::f32x4x4_t& matrix, resize interpolation, edgemode edge,
+	const dseed::size2i& size, dseed::bitmaps::bitmap** bitmap, const dseed::color::colorv& border, bool perspective)
+{
+	if (original == nullptr || bitmap == nullptr || size.width <= 0 || size.height <= 0)
+		return dseed::error_invalid_args;
+
+	const auto format = original->format();
+	auto found = g_warps.find(wptp(interpolation, perspective, format));
+	if (found == g_warps.end())
+		return dseed::error_not_support;
+
+	const double forward[3][3] = {
+		{ matrix.m11(), matrix.m12(), perspective ? matrix.m14() : 0 },
+		{ matrix.m21(), matrix.m22(), perspective ? matrix.m24() : 0 },
+		{ matrix.m41(), matrix.m42(), perspective ? matrix.m44() : 1 },
+	};
+
+	warpcontext ctx;
+	if (!invert_homography(forward, ctx.inverse))
+		return dseed::error_invalid_args;
+
+	const auto srcSize = original->size();
+	const dseed::size3i destSize(size.width, size.height, srcSize.depth);
+
+	dseed::autoref<dseed::bitmaps::bitmap> temp;
+	if (dseed::failed(dseed::bitmaps::create_bitmap(original->type(), destSize, format, nullptr, &temp)))
+		return dseed::error_fail;
+
+	ctx.srcStride = calc_bitmap_stride(format, srcSize.width);
+	ctx.srcWidth = srcSize.width;
+	ctx.srcHeight = srcSize.height;
+	ctx.destStride = calc_bitmap_stride(format, destSize.width);
+	ctx.destWidth = destSize.width;
+	ctx.destHeight = destSize.height;
+	ctx.edge = edge;
+	ctx.border = warp_border(format, border.vector);
+
+	const size_t srcDepth = calc_bitmap_plane_size(format, size2i(srcSize.width, srcSize.height));
+	const size_t destDepth = calc_bitmap_plane_size(format, size2i(destSize.width, destSize.height));
+
+	const uint8_t* srcPtr;
+	uint8_t* destPtr;
+	original->lock((void**)&srcPtr);
+	temp->lock((void**)&destPtr);
+
+	const auto fn = found->second;
+	const size_t tilesPerPlane = (destSize.height + WARP_TILE_ROWS - 1) / WARP_TILE_ROWS;
+	dseed::bitmaps::parallel::for_each(tilesPerPlane * destSize.depth, [&](size_t tile)
+		{
+			const size_t z = tile / tilesPerPlane;
+			warpcontext planeCtx = ctx;
+			planeCtx.src = srcPtr + (z * srcDepth);
+			planeCtx.dest = destPtr + (z * destDepth);
+
+			const int yBegin = (int)((tile % tilesPerPlane) * WARP_TILE_ROWS);
+			const int yEnd = dseed::minimum(yBegin + WARP_TILE_ROWS, ctx.destHeight);
+			for (int y = yBegin; y < yEnd; ++y)
+				fn(planeCtx, y);
+		});
+
+	temp->unlock();
+	original->unlock();
+
+	*bitmap = temp.detach();
+
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::warp_affine_bitmap(bitmap* original, const f32x4x4_t& matrix, resize interpolation, edgemode edge,
+	const size2i& size, bitmap** bitmap, const color::colorv& border)
+{
+	return __internal_warp(original, matrix, interpolation, edge, size, bitmap, border, false);
+}
+
+dseed::error_t dseed::bitmaps::warp_perspective_bitmap(bitmap* original, const f32x4x4_t& matrix, resize interpolation, edgemode edge,
+	const size2i& size, bitmap** bitmap, const color::colorv& border)
+{
+	return __internal_warp(original, matrix, interpolation, edge, size, bitmap, border, true);
+}
@@ -0,0 +1,456 @@
+#ifndef __DSEED_INTERNAL_BITMAP_COMMON_HXX__
+#define __DSEED_INTERNAL_BITMAP_COMMON_HXX__
+
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Row Kernels
+//  : 8-bit per element formats are processed as plain byte rows,
+//    floating-point formats are processed as plain float rows.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+namespace dseed::bitmaps::rowkernel
+{
+	enum class elementtype
+	{
+		unknown,
+		byte,
+		single,
+	};
+
+	inline elementtype format2element(dseed::color::pixelformat format) noexcept
+	{
+		switch (format)
+		{
+		case dseed::color::pixelformat::rgba8:
+		case dseed::color::pixelformat::rgb8:
+		case dseed::color::pixelformat::bgra8:
+		case dseed::color::pixelformat::bgr8:
+		case dseed::color::pixelformat::r8:
+		case dseed::color::pixelformat::yuva8:
+		case dseed::color::pixelformat::yuv8:
+		case dseed::color::pixelformat::hsva8:
+		case dseed::color::pixelformat::hsv8:
+			return elementtype::byte;
+
+		case dseed::color::pixelformat::rgbaf:
+		case dseed::color::pixelformat::rf:
+			return elementtype::single;
+
+		default:
+			return elementtype::unknown;
+		}
+	}
+
+	// Elements per pixel
+	inline size_t format2elements(dseed::color::pixelformat format) noexcept
+	{
+		switch (format2element(format))
+		{
+		case elementtype::byte: return (int)format & 0xff;
+		case elementtype::single: return ((int)format & 0xff) / sizeof(float);
+		default: return 0;
+		}
+	}
+
+	inline size_t element_size(elementtype type) noexcept
+	{
+		switch (type)
+		{
+		case elementtype::byte: return sizeof(uint8_t);
+		case elementtype::single: return sizeof(float);
+		default: return 0;
+		}
+	}
+
+	// Unaligned vector load/store
+	inline i32x4_t load8(const uint8_t* ptr) noexcept
+	{
+#if !DONT_USE_SSE
+		return _mm_loadu_si128((const __m128i*)ptr);
+#elif !DONT_USE_NEON
+		return vreinterpretq_s32_u8(vld1q_u8(ptr));
+#else
+		int arr[4];
+		memcpy(arr, ptr, sizeof(arr));
+		return i32x4_t(arr[0], arr[1], arr[2], arr[3]);
+#endif
+	}
+	inline void store8(uint8_t* ptr, const i32x4_t& v) noexcept
+	{
+#if !DONT_USE_SSE
+		_mm_storeu_si128((__m128i*)ptr, v);
+#elif !DONT_USE_NEON
+		vst1q_u8(ptr, vreinterpretq_u8_s32(v));
+#else
+		const int arr[4] = { v._x, v._y, v._z, v._w };
+		memcpy(ptr, arr, sizeof(arr));
+#endif
+	}
+	inline f32x4_t loadf(const float* ptr) noexcept
+	{
+#if !DONT_USE_SSE
+		return _mm_loadu_ps(ptr);
+#elif !DONT_USE_NEON
+		return vld1q_f32(ptr);
+#else
+		return f32x4_t(ptr[0], ptr[1], ptr[2], ptr[3]);
+#endif
+	}
+	inline void storef(float* ptr, const f32x4_t& v) noexcept
+	{
+#if !DONT_USE_SSE
+		_mm_storeu_ps(ptr, v);
+#elif !DONT_USE_NEON
+		vst1q_f32(ptr, v);
+#else
+		ptr[0] = v._x; ptr[1] = v._y; ptr[2] = v._z; ptr[3] = v._w;
+#endif
+	}
+	// Loads/stores only 12 bytes of the vector; last lane is zero on load.
+	inline i32x4_t load8x12(const uint8_t* ptr) noexcept
+	{
+		uint8_t temp[16] = { 0, };
+		memcpy(temp, ptr, 12);
+		return load8(temp);
+	}
+	inline void store8x12(uint8_t* ptr, const i32x4_t& v) noexcept
+	{
+		uint8_t temp[16];
+		store8(temp, v);
+		memcpy(ptr, temp, 12);
+	}
+
+	// Byte Element Operators
+	struct add8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return add8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return (uint8_t)(v1 + v2); }
+	};
+	struct subtract8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return subtract8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return (uint8_t)(v1 - v2); }
+	};
+	struct multiply8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return multiply8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return (uint8_t)(v1 * v2); }
+	};
+	struct divide8op
+	{
+		static constexpr bool vectorizable = false;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return v1; }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return v2 != 0 ? (uint8_t)(v1 / v2) : 0; }
+	};
+	struct and8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return and32(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return v1 & v2; }
+	};
+	struct or8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return or32(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return v1 | v2; }
+	};
+	struct xor8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return xor32(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return v1 ^ v2; }
+	};
+	struct min8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return minvu8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return v1 < v2 ? v1 : v2; }
+	};
+	struct max8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return maxvu8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return v1 > v2 ? v1 : v2; }
+	};
+	struct addsat8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return addsat8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return dseed::color::saturate8(v1 + v2); }
+	};
+	struct subtractsat8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return subtractsat8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return dseed::color::saturate8(v1 - v2); }
+	};
+	struct multiplysat8op
+	{
+		static constexpr bool vectorizable = true;
+		static inline i32x4_t vector(const i32x4_t& v1, const i32x4_t& v2) noexcept { return multiplysat8(v1, v2); }
+		static inline uint8_t scalar(uint8_t v1, uint8_t v2) noexcept { return dseed::color::saturate8(v1 * v2); }
+	};
+	// ~x and (255 - x) are same for byte elements
+	struct not8op
+	{
+		static inline i32x4_t vector(const i32x4_t& v) noexcept { return not32(v); }
+		static inline uint8_t scalar(uint8_t v) noexcept { return (uint8_t)~v; }
+	};
+
+	// Floating-point Element Operators
+	struct addfop
+	{
+		static inline f32x4_t vector(const f32x4_t& v1, const f32x4_t& v2) noexcept { return addfv(v1, v2); }
+		static inline float scalar(float v1, float v2) noexcept { return v1 + v2; }
+	};
+	struct subtractfop
+	{
+		static inline f32x4_t vector(const f32x4_t& v1, const f32x4_t& v2) noexcept { return subtractfv(v1, v2); }
+		static inline float scalar(float v1, float v2) noexcept { return v1 - v2; }
+	};
+	struct multiplyfop
+	{
+		static inline f32x4_t vector(const f32x4_t& v1, const f32x4_t& v2) noexcept { return multiplyfv(v1, v2); }
+		static inline float scalar(float v1, float v2) noexcept { return v1 * v2; }
+	};
+	struct dividefop
+	{
+		static inline f32x4_t vector(const f32x4_t& v1, const f32x4_t& v2) noexcept { return dividefv(v1, v2); }
+		static inline float scalar(float v1, float v2) noexcept { return v1 / v2; }
+	};
+	struct minfop
+	{
+		static inline f32x4_t vector(const f32x4_t& v1, const f32x4_t& v2) noexcept { return minimum(v1, v2); }
+		static inline float scalar(float v1, float v2) noexcept { return v1 < v2 ? v1 : v2; }
+	};
+	struct maxfop
+	{
+		static inline f32x4_t vector(const f32x4_t& v1, const f32x4_t& v2) noexcept { return maximum(v1, v2); }
+		static inline float scalar(float v1, float v2) noexcept { return v1 > v2 ? v1 : v2; }
+	};
+	struct negatefop
+	{
+		static inline f32x4_t vector(const f32x4_t& v) noexcept { return negatefv(v); }
+		static inline float scalar(float v) noexcept { return -v; }
+	};
+	struct invertfop
+	{
+		static inline f32x4_t vector(const f32x4_t& v) noexcept { return subtractfv(f32x4_t(1.0f), v); }
+		static inline float scalar(float v) noexcept { return 1.0f - v; }
+	};
+
+	// Clamps result of floating-point operator to [0, 1]
+	template<class TOp>
+	struct saturatef2op
+	{
+		static inline f32x4_t vector(const f32x4_t& v1, const f32x4_t& v2) noexcept { return minimum(maximum(TOp::vector(v1, v2), f32x4_t(0.0f)), f32x4_t(1.0f)); }
+		static inline float scalar(float v1, float v2) noexcept { return dseed::color::saturatef(TOp::scalar(v1, v2)); }
+	};
+	template<class TOp>
+	struct saturatef1op
+	{
+		static inline f32x4_t vector(const f32x4_t& v) noexcept { return minimum(maximum(TOp::vector(v), f32x4_t(0.0f)), f32x4_t(1.0f)); }
+		static inline float scalar(float v) noexcept { return dseed::color::saturatef(TOp::scalar(v)); }
+	};
+
+	// count: elements count (not pixels count)
+	using binaryfn = void(*)(void* dest, const void* src1, const void* src2, size_t count);
+	using unaryfn = void(*)(void* dest, const void* src, size_t count);
+
+	template<class TOp>
+	inline void binary8(void* dest, const void* src1, const void* src2, size_t count) noexcept
+	{
+		auto destPtr = reinterpret_cast<uint8_t*>(dest);
+		auto src1Ptr = reinterpret_cast<const uint8_t*>(src1);
+		auto src2Ptr = reinterpret_cast<const uint8_t*>(src2);
+
+		size_t x = 0;
+		if constexpr (TOp::vectorizable)
+		{
+			for (; x + 16 <= count; x += 16)
+				store8(destPtr + x, TOp::vector(load8(src1Ptr + x), load8(src2Ptr + x)));
+		}
+		for (; x < count; ++x)
+			destPtr[x] = TOp::scalar(src1Ptr[x], src2Ptr[x]);
+	}
+
+	template<class TOp>
+	inline void unary8(void* dest, const void* src, size_t count) noexcept
+	{
+		auto destPtr = reinterpret_cast<uint8_t*>(dest);
+		auto srcPtr = reinterpret_cast<const uint8_t*>(src);
+
+		size_t x = 0;
+		for (; x + 16 <= count; x += 16)
+			store8(destPtr + x, TOp::vector(load8(srcPtr + x)));
+		for (; x < count; ++x)
+			destPtr[x] = TOp::scalar(srcPtr[x]);
+	}
+
+	template<class TOp>
+	inline void binaryf(void* dest, const void* src1, const void* src2, size_t count) noexcept
+	{
+		auto destPtr = reinterpret_cast<float*>(dest);
+		auto src1Ptr = reinterpret_cast<const float*>(src1);
+		auto src2Ptr = reinterpret_cast<const float*>(src2);
+
+		size_t x = 0;
+		for (; x + 4 <= count; x += 4)
+			storef(destPtr + x, TOp::vector(loadf(src1Ptr + x), loadf(src2Ptr + x)));
+		for (; x < count; ++x)
+			destPtr[x] = TOp::scalar(src1Ptr[x], src2Ptr[x]);
+	}
+
+	template<class TOp>
+	inline void unaryf(void* dest, const void* src, size_t count) noexcept
+	{
+		auto destPtr = reinterpret_cast<float*>(dest);
+		auto srcPtr = reinterpret_cast<const float*>(src);
+
+		size_t x = 0;
+		for (; x + 4 <= count; x += 4)
+			storef(destPtr + x, TOp::vector(loadf(srcPtr + x)));
+		for (; x < count; ++x)
+			destPtr[x] = TOp::scalar(srcPtr[x]);
+	}
+
+	// Lookup table for one element of each pixel
+	//  : offset is element index of src[0] in its row.
+	inline void lookup8(uint8_t* dest, const uint8_t* src, size_t count, size_t offset, size_t elements, size_t element, const uint8_t* table) noexcept
+	{
+		if (dest != src)
+			memcpy(dest, src, count);
+
+		size_t x = (element + elements - (offset % elements)) % elements;
+		for (; x < count; x += elements)
+			dest[x] = table[src[x]];
+	}
+
+	// Deinterleave/Interleave
+	//  : 16 pixels are gathered per element by byte shuffle, then 4x4 transposed as 32-bit lanes.
+	//  : planes must have elements count pointers, and none of them can be null.
+	inline void deinterleave8(uint8_t* const* planes, const uint8_t* src, size_t count, size_t elements) noexcept
+	{
+		size_t x = 0;
+		if (elements == 4)
+		{
+			static const i32x4_t mask(0x0c080400, 0x0d090501, 0x0e0a0602, 0x0f0b0703);
+			for (; x + 16 <= count; x += 16)
+			{
+				const auto srcPtr = src + (x * 4);
+				const f32x4x4_t m(
+					reinterpretitof(i32x4_t::shuffle8(load8(srcPtr), mask)),
+					reinterpretitof(i32x4_t::shuffle8(load8(srcPtr + 16), mask)),
+					reinterpretitof(i32x4_t::shuffle8(load8(srcPtr + 32), mask)),
+					reinterpretitof(i32x4_t::shuffle8(load8(srcPtr + 48), mask)));
+				const auto t = transpose(m);
+				store8(planes[0] + x, reinterpretftoi(t._c1));
+				store8(planes[1] + x, reinterpretftoi(t._c2));
+				store8(planes[2] + x, reinterpretftoi(t._c3));
+				store8(planes[3] + x, reinterpretftoi(t._c4));
+			}
+		}
+		else if (elements == 3)
+		{
+			static const i32x4_t mask(0x09060300, 0x0a070401, 0x0b080502, 0x0f0f0f0f);
+			for (; x + 16 <= count; x += 16)
+			{
+				const auto srcPtr = src + (x * 3);
+				i32x4_t v[4];
+				for (int i = 0; i < 4; ++i)
+				{
+					v[i] = i32x4_t::shuffle8(load8x12(srcPtr + (i * 12)), mask);
+				}
+				const auto t = transpose(f32x4x4_t(reinterpretitof(v[0]), reinterpretitof(v[1]), reinterpretitof(v[2]), reinterpretitof(v[3])));
+				store8(planes[0] + x, reinterpretftoi(t._c1));
+				store8(planes[1] + x, reinterpretftoi(t._c2));
+				store8(planes[2] + x, reinterpretftoi(t._c3));
+			}
+		}
+
+		for (; x < count; ++x)
+			for (size_t e = 0; e < elements; ++e)
+				planes[e][x] = src[x * elements + e];
+	}
+
+	inline void interleave8(uint8_t* dest, const uint8_t* const* planes, size_t count, size_t elements) noexcept
+	{
+		size_t x = 0;
+		if (elements == 4)
+		{
+			static const i32x4_t mask(0x0c080400, 0x0d090501, 0x0e0a0602, 0x0f0b0703);
+			for (; x + 16 <= count; x += 16)
+			{
+				const auto t = transpose(f32x4x4_t(
+					reinterpretitof(load8(planes[0] + x)), reinterpretitof(load8(planes[1] + x)),
+					reinterpretitof(load8(planes[2] + x)), reinterpretitof(load8(planes[3] + x))));
+				const auto destPtr = dest + (x * 4);
+				store8(destPtr, i32x4_t::shuffle8(reinterpretftoi(t._c1), mask));
+				store8(destPtr + 16, i32x4_t::shuffle8(reinterpretftoi(t._c2), mask));
+				store8(destPtr + 32, i32x4_t::shuffle8(reinterpretftoi(t._c3), mask));
+				store8(destPtr + 48, i32x4_t::shuffle8(reinterpretftoi(t._c4), mask));
+			}
+		}
+		else if (elements == 3)
+		{
+			static const i32x4_t mask(0x01080400, 0x06020905, 0x0b07030a, 0x0f0f0f0f);
+			for (; x + 16 <= count; x += 16)
+			{
+				const auto t = transpose(f32x4x4_t(
+					reinterpretitof(load8(planes[0] + x)), reinterpretitof(load8(planes[1] + x)),
+					reinterpretitof(load8(planes[2] + x)), f32x4_t(0.0f)));
+				const f32x4_t* columns[4] = { &t._c1, &t._c2, &t._c3, &t._c4 };
+				const auto destPtr = dest + (x * 3);
+				for (int i = 0; i < 4; ++i)
+				{
+					store8x12(destPtr + (i * 12), i32x4_t::shuffle8(reinterpretftoi(*columns[i]), mask));
+				}
+			}
+		}
+
+		for (; x < count; ++x)
+			for (size_t e = 0; e < elements; ++e)
+				dest[x * elements + e] = planes[e][x];
+	}
+
+	inline void deinterleavef(float* const* planes, const float* src, size_t count) noexcept
+	{
+		size_t x = 0;
+		for (; x + 4 <= count; x += 4)
+		{
+			const auto srcPtr = src + (x * 4);
+			const auto t = transpose(f32x4x4_t(loadf(srcPtr), loadf(srcPtr + 4), loadf(srcPtr + 8), loadf(srcPtr + 12)));
+			storef(planes[0] + x, t._c1);
+			storef(planes[1] + x, t._c2);
+			storef(planes[2] + x, t._c3);
+			storef(planes[3] + x, t._c4);
+		}
+		for (; x < count; ++x)
+			for (size_t e = 0; e < 4; ++e)
+				planes[e][x] = src[x * 4 + e];
+	}
+
+	inline void interleavef(float* dest, const float* const* planes, size_t count) noexcept
+	{
+		size_t x = 0;
+		for (; x + 4 <= count; x += 4)
+		{
+			const auto t = transpose(f32x4x4_t(loadf(planes[0] + x), loadf(planes[1] + x), loadf(planes[2] + x), loadf(planes[3] + x)));
+			const auto destPtr = dest + (x * 4);
+			storef(destPtr, t._c1);
+			storef(destPtr + 4, t._c2);
+			storef(destPtr + 8, t._c3);
+			storef(destPtr + 12, t._c4);
+		}
+		for (; x < count; ++x)
+			for (size_t e = 0; e < 4; ++e)
+				dest[x * 4 + e] = planes[e][x];
+	}
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <dseed.h>
 
+#include "../../libs/DecodeTargetHelper.hxx"
+
 #if COMPILER_MSVC
 #	pragma pack (push, 1)
 #else
@@ -20,7 +22,8 @@ struct ASTCHeader {
 #	pragma pack ()
 #endif
 
-dseed::error_t dseed::bitmaps::create_astc_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+dseed::error_t __read_astc_header (dseed::io::stream* stream, dseed::size3i& size, dseed::color::pixelformat& format,
+	dseed::bitmaps::bitmaptype& type) noexcept
 {
 	ASTCHeader header = {};
 	if (sizeof (ASTCHeader) != stream->read (&header, sizeof (ASTCHeader)))
@@ -29,12 +32,14 @@ dseed::error_t dseed::bitmaps::create_astc_bitmap_decoder (dseed::io::stream* st
 	if (header.magic != 0x5CA1AB13)
 		return dseed::error_not_support_file_format;
 
-	dseed::size3i size (
-		header.xSize[2] | (header.xSize[1] << 8) | (header.xSize[0] << 16),
-		header.ySize[2] | (header.ySize[1] << 8) | (header.ySize[0] << 16),
-		header.ySize[2] | (header.ySize[1] << 8) | (header.ySize[0] << 16));
+	// Sizes are 24-bit little-endian
+	size = dseed::size3i (
+		header.xSize[0] | (header.xSize[1] << 8) | (header.xSize[2] << 16),
+		header.ySize[0] | (header.ySize[1] << 8) | (header.ySize[2] << 16),
+		header.zSize[0] | (header.zSize[1] << 8) | (header.zSize[2] << 16));
+	if (size.width == 0 || size.height == 0 || size.depth == 0)
+		return dseed::error_not_support_file_format;
 
-	dseed::color::pixelformat format;
 	if (header.blockDimX == 4 && header.blockDimY == 4) format = dseed::color::pixelformat::astc4x4;
 	else if (header.blockDimX == 5 && header.blockDimY == 4) format = dseed::color::pixelformat::astc5x4;
 	else if (header.blockDimX == 5 && header.blockDimY == 5) format = dseed::color::pixelformat::astc5x5;
@@ -46,12 +51,11 @@ dseed::error_t dseed::bitmaps::create_astc_bitmap_decoder (dseed::io::stream* st
 	else if (header.blockDimX == 10 && header.blockDimY == 5) format = dseed::color::pixelformat::astc10x5;
 	else if (header.blockDimX == 10 && header.blockDimY == 6) format = dseed::color::pixelformat::astc10x6;
 	else if (header.blockDimX == 10 && header.blockDimY == 8) format = dseed::color::pixelformat::astc10x8;
-	else if (header.blockDimX == 10 && header.blockDimY == 10) format = dseed::color::pixelformat::astc10x8;
+	else if (header.blockDimX == 10 && header.blockDimY == 10) format = dseed::color::pixelformat::astc10x10;
 	else if (header.blockDimX == 12 && header.blockDimY == 10) format = dseed::color::pixelformat::astc12x10;
 	else if (header.blockDimX == 12 && header.blockDimY == 12) format = dseed::color::pixelformat::astc12x12;
 	else return dseed::error_not_support;
 
-	dseed::bitmaps::bitmaptype type;
 	if (size.depth == 1)
 		type = dseed::bitmaps::bitmaptype::bitmap2d;
 	else if (size.depth == 6)
@@ -59,20 +63,66 @@ dseed::error_t dseed::bitmaps::create_astc_bitmap_decoder (dseed::io::stream* st
 	else
 		type = dseed::bitmaps::bitmaptype::bitmap3d;
 
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::create_astc_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	dseed::size3i size;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	if (auto err = __read_astc_header (stream, size, format, type); dseed::failed (err))
+		return err;
+
 	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
+	if (dseed::succeeded (__reference_blob_bitmap (stream, stream->position (), type, size, format, &bitmap)))
+		return create_bitmap_array (arraytype::mipmap, bitmap, decoder);
+
 	if (dseed::failed (dseed::bitmaps::create_bitmap (type, size, format, nullptr, &bitmap)))
 		return dseed::error_fail;
 
-	void* ptr;
-	if (dseed::failed (bitmap->lock (&ptr)))
-		return dseed::error_fail;
+	if (auto err = __decode_into_bitmap (bitmap, [&](const __decode_target& target) { return __read_decode_target (stream, target); });
+		dseed::failed (err))
+		return err;
+	
+	return create_bitmap_array(arraytype::mipmap, bitmap, decoder);
+}
 
-	size_t totalImageSize = dseed::color::calc_bitmap_plane_size (format, size2i (size.width, size.height)) * size.depth;
+dseed::error_t dseed::bitmaps::probe_astc_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
 
-	if (totalImageSize != stream->read (ptr, totalImageSize))
-		return dseed::error_io;
+	dseed::size3i size;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	if (auto err = __read_astc_header (stream, size, format, type); dseed::failed (err))
+		return err;
 
-	bitmap->unlock ();
-	
-	return create_bitmap_array(arraytype::mipmap, bitmap, decoder);
+	*info = dseed::bitmaps::bitmap_info (type, size, format, arraytype::mipmap, 1);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_astc_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::size3i size;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	if (auto err = __read_astc_header (stream, size, format, type); dseed::failed (err))
+		return err;
+
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	if (auto err = __read_decode_target (stream, target); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (type, size, format, arraytype::mipmap, 1);
+	return dseed::error_good;
 }
\ No newline at end of file
@@ -1,14 +1,18 @@
 #include <dseed.h>
 
 #include "../../libs/DDSHelper.hxx"
+#include "../../libs/DecodeTargetHelper.hxx"
 
-dseed::error_t dseed::bitmaps::create_dds_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+// Reads header and normalizes it
+//  : Depth of header becomes count of volume slices, cubemap faces or array slices; slices is 1 for volume.
+//  : Count of mip levels is at least 1.
+dseed::error_t __read_dds_header (dseed::io::stream* stream, DDS_HEADER& header, dseed::color::pixelformat& format,
+	dseed::bitmaps::bitmaptype& type, uint32_t& slices) noexcept
 {
 	uint32_t magic;
 	if (sizeof (uint32_t) != stream->read (&magic, sizeof (uint32_t)) || magic != DDS_MAGIC)
 		return dseed::error_not_support;
 
-	DDS_HEADER header;
 	if (sizeof (DDS_HEADER) != stream->read (&header, sizeof (DDS_HEADER)))
 		return dseed::error_fail;
 
@@ -38,7 +42,7 @@ dseed::error_t dseed::bitmaps::create_dds_bitmap_decoder (dseed::io::stream* str
 			dimension = 2;
 	}
 
-	dseed::color::pixelformat format = dseed::color::pixelformat::unknown;
+	format = dseed::color::pixelformat::unknown;
 	if (header.ddspf.flags & DDS_RGB)
 	{
 		switch (header.ddspf.RGBBitCount)
@@ -190,42 +194,202 @@ dseed::error_t dseed::bitmaps::create_dds_bitmap_decoder (dseed::io::stream* str
 		}
 	}
 
-	dseed::bitmaps::bitmaptype type = dseed::bitmaps::bitmaptype::bitmap2d;
+	const uint32_t arraySize = bc7HeaderLoaded ? bc7Header.arraySize : 1;
+	const bool cube = (header.caps2 & DDS_CUBEMAP) || (bc7HeaderLoaded && (bc7Header.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE));
+
+	type = dseed::bitmaps::bitmaptype::bitmap2d;
+	slices = 1;
 	if (dimension == 3)
-		type = dseed::bitmaps::bitmaptype::bitmap2d;
-	else
 	{
-		if (header.caps2 & DDS_CUBEMAP)
+		type = dseed::bitmaps::bitmaptype::bitmap3d;
+		if (header.depth == 0)
+			header.depth = 1;
+	}
+	else if (cube)
+	{
+		if (arraySize > 1)
+			return dseed::error_not_support;
+		type = dseed::bitmaps::bitmaptype::bitmap2dcube;
+		header.depth = slices = 6;
+	}
+	else if (arraySize > 1)
+	{
+		type = dseed::bitmaps::bitmaptype::bitmap3d;
+		header.depth = slices = arraySize;
+	}
+	else header.depth = 1;
+
+	if (header.width == 0 || header.height == 0)
+		return dseed::error_fail;
+	if (header.mipMapCount == 0)
+		header.mipMapCount = 1;
+	if (header.mipMapCount > 32)
+		return dseed::error_fail;
+
+	return dseed::error_good;
+}
+
+dseed::size3i __dds_mip_size (const DDS_HEADER& header, uint32_t slices, uint32_t mip) noexcept
+{
+	return __dds_level_size (dseed::size3i (header.width, header.height, header.depth), mip, slices == 1);
+}
+
+// Frame Loader for DDS
+//  : Slices of cubemap and array are stored one by one with their whole mip chain,
+//    so a level of them is gathered from every slice.
+class __dds_frame_loader : public dseed::bitmaps::bitmap_frame_loader
+{
+public:
+	static dseed::error_t create (dseed::io::stream* stream, const DDS_HEADER& header, dseed::color::pixelformat format,
+		dseed::bitmaps::bitmaptype type, uint32_t slices, dseed::bitmaps::bitmap_frame_loader** loader) noexcept
+	{
+		std::vector<size_t> offsets;
+		size_t offset = stream->position ();
+		try
 		{
-			type = dseed::bitmaps::bitmaptype::bitmap2dcube;
-			header.depth = 6;
+			offsets.reserve (header.mipMapCount);
+			for (uint32_t mip = 0; mip < header.mipMapCount; ++mip)
+			{
+				offsets.push_back (offset);
+				auto currentSize = __dds_mip_size (header, slices, mip);
+				offset += dseed::color::calc_bitmap_plane_size (format, dseed::size2i (currentSize.width, currentSize.height))
+					* (slices == 1 ? currentSize.depth : 1);
+			}
 		}
-		else header.depth = 1;
+		catch (...) { return dseed::error_out_of_memory; }
+
+		const size_t sliceStride = offset - stream->position ();
+		*loader = new (std::nothrow) __dds_frame_loader (stream, header, format, type, slices, std::move (offsets), sliceStride);
+		if (*loader == nullptr)
+			return dseed::error_out_of_memory;
+
+		return dseed::error_good;
 	}
 
-	std::vector<dseed::bitmaps::bitmap*> bitmaps;
-	bitmaps.resize (1 + header.mipMapCount);
+private:
+	__dds_frame_loader (dseed::io::stream* stream, const DDS_HEADER& header, dseed::color::pixelformat format,
+		dseed::bitmaps::bitmaptype type, uint32_t slices, std::vector<size_t>&& offsets, size_t sliceStride) noexcept
+		: _refCount (1), _stream (stream), _header (header), _format (format), _type (type), _slices (slices)
+		, _offsets (std::move (offsets)), _sliceStride (sliceStride)
+	{ }
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
 
-	for (uint32_t mip = 0; mip <= header.mipMapCount; ++mip)
+public:
+	virtual dseed::error_t load (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
 	{
-		int halfmaker = (int)powf (2, mip);
-		dseed::size3i currentSize (header.width / halfmaker, header.height / halfmaker, header.depth / halfmaker);
-		if (currentSize.width <= 0) currentSize.width = 1;
-		if (currentSize.height <= 0) currentSize.height = 1;
-		if (currentSize.depth <= 0) currentSize.depth = 1;
+		auto currentSize = __dds_mip_size (_header, _slices, (uint32_t)index);
+		size_t bytes = dseed::color::calc_bitmap_plane_size (_format, dseed::size2i (currentSize.width, currentSize.height));
+
+		// Mip of 2D or volume is contiguous in file, so it can be referenced in place
+		if (_slices == 1 && dseed::succeeded (__reference_blob_bitmap (_stream, _offsets[index], _type, currentSize, _format, bitmap)))
+			return dseed::error_good;
 
-		std::vector<uint8_t> buf;
-		buf.resize (dseed::color::calc_bitmap_plane_size (format, size2i (currentSize.width, currentSize.height)));
-		stream->read (buf.data (), buf.size ());
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed (dseed::bitmaps::create_bitmap (_type, currentSize, _format, nullptr, &temp)))
+			return dseed::error_fail;
 
-		if (dseed::failed (dseed::bitmaps::create_bitmap (type, currentSize, format, nullptr, &bitmaps[mip])))
+		uint8_t* ptr;
+		if (dseed::failed (temp->lock ((void**)&ptr)))
 			return dseed::error_fail;
 
-		void* ptr;
-		bitmaps[mip]->lock (&ptr);
-		memcpy (ptr, buf.data (), buf.size ());
-		bitmaps[mip]->unlock ();
+		const size_t readCount = _slices == 1 ? 1 : _slices;
+		const size_t readBytes = _slices == 1 ? bytes * currentSize.depth : bytes;
+		for (size_t slice = 0; slice < readCount; ++slice)
+		{
+			if (!_stream->seek (dseed::io::seekorigin::begin, _offsets[index] + _sliceStride * slice)
+				|| _stream->read (ptr + readBytes * slice, readBytes) != readBytes)
+			{
+				temp->unlock ();
+				return dseed::error_io;
+			}
+		}
+		temp->unlock ();
+
+		*bitmap = temp.detach ();
+		return dseed::error_good;
 	}
 
-	return create_bitmap_array(arraytype::plain, bitmaps, decoder);
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::stream> _stream;
+	DDS_HEADER _header;
+	dseed::color::pixelformat _format;
+	dseed::bitmaps::bitmaptype _type;
+	uint32_t _slices;
+	std::vector<size_t> _offsets;
+	size_t _sliceStride;
+};
+
+dseed::error_t dseed::bitmaps::create_dds_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	DDS_HEADER header;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	uint32_t slices;
+	if (auto err = __read_dds_header (stream, header, format, type, slices); dseed::failed (err))
+		return err;
+
+	// Each mip is read from stream on first access
+	dseed::autoref<dseed::bitmaps::bitmap_frame_loader> loader;
+	if (auto err = __dds_frame_loader::create (stream, header, format, type, slices, &loader); dseed::failed (err))
+		return err;
+
+	return create_lazy_bitmap_array (arraytype::plain, header.mipMapCount, loader, header.mipMapCount, decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_dds_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	DDS_HEADER header;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	uint32_t slices;
+	if (auto err = __read_dds_header (stream, header, format, type, slices); dseed::failed (err))
+		return err;
+
+	*info = dseed::bitmaps::bitmap_info (type, dseed::size3i (header.width, header.height, header.depth), format,
+		arraytype::plain, header.mipMapCount);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_dds_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	DDS_HEADER header;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	uint32_t slices;
+	if (auto err = __read_dds_header (stream, header, format, type, slices); dseed::failed (err))
+		return err;
+
+	// Top mip only; slices of cubemap and array are not contiguous in file
+	if (slices > 1)
+		return dseed::error_not_support;
+
+	const dseed::size3i size = __dds_mip_size (header, slices, 0);
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	// Rows in file are laid out as library bitmap rows
+	if (auto err = __read_decode_target (stream, target, false, __bitmap_row_padding (format, size.width, target)); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (type, size, format);
+	return dseed::error_good;
 }
\ No newline at end of file
@@ -1,20 +1,17 @@
 #include <dseed.h>
 
 #include "../../libs/DIBHelper.hxx"
+#include "../../libs/DecodeTargetHelper.hxx"
 
-dseed::error_t dseed::bitmaps::create_dib_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+dseed::error_t __read_dib_header (dseed::io::stream* stream, bitmap_file_header& fileHeader, bitmap_info_header& infoHeader,
+	dseed::color::pixelformat& format) noexcept
 {
-	if (stream == nullptr || decoder == nullptr)
-		return dseed::error_invalid_args;
-
-	bitmap_file_header fileHeader;
 	if (stream->read (&fileHeader, sizeof (fileHeader)) != sizeof (fileHeader))
 		return dseed::error_fail;
 
 	if (memcmp (&fileHeader.bfType, "BM", 2) != 0)
 		return dseed::error_fail;
 
-	bitmap_info_header infoHeader;
 	if (stream->read (&infoHeader, sizeof (infoHeader)) != sizeof (infoHeader))
 		return dseed::error_fail;
 
@@ -24,7 +21,6 @@ dseed::error_t dseed::bitmaps::create_dib_bitmap_decoder (dseed::io::stream* str
 	if (infoHeader.biCompression != bitmap_compression_rgb)
 		return dseed::error_not_support;
 
-	dseed::color::pixelformat format;
 	switch (infoHeader.biBitCount)
 	{
 	case 8:
@@ -39,6 +35,27 @@ dseed::error_t dseed::bitmaps::create_dib_bitmap_decoder (dseed::io::stream* str
 	default: return dseed::error_not_support;
 	}
 
+	return dseed::error_good;
+}
+
+// Rows in file are bottom-up and aligned to 4 bytes
+dseed::error_t __read_dib_pixels (dseed::io::stream* stream, const bitmap_info_header& infoHeader, const __decode_target& target) noexcept
+{
+	const size_t fileStride = ((infoHeader.biBitCount * infoHeader.biWidth + 31) / 32) * 4;
+	return __read_decode_target (stream, target, true, fileStride > target.rowBytes ? fileStride - target.rowBytes : 0);
+}
+
+dseed::error_t dseed::bitmaps::create_dib_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	if (stream == nullptr || decoder == nullptr)
+		return dseed::error_invalid_args;
+
+	bitmap_file_header fileHeader;
+	bitmap_info_header infoHeader;
+	dseed::color::pixelformat format;
+	if (auto err = __read_dib_header (stream, fileHeader, infoHeader, format); dseed::failed (err))
+		return err;
+
 	dseed::autoref<dseed::bitmaps::palette> palette;
 	if (infoHeader.biClrUsed > 0)
 	{
@@ -49,23 +66,58 @@ dseed::error_t dseed::bitmaps::create_dib_bitmap_decoder (dseed::io::stream* str
 
 	//stream->seek (dseed::seekorigin_begin, fileHeader.bfOffBits);
 
-	size_t stride = dseed::color::calc_bitmap_stride (format, infoHeader.biWidth);
-
 	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
 	if (dseed::failed (dseed::bitmaps::create_bitmap (bitmaptype::bitmap2d, dseed::size3i (infoHeader.biWidth, infoHeader.biHeight, 1),
 		format, palette, &bitmap)))
 		return dseed::error_fail;
 
-	uint8_t* ptr;
-	bitmap->lock ((void**)&ptr);
-
-	for (auto y = 0; y < infoHeader.biHeight; ++y)
-	{
-		void* target = ptr + ((infoHeader.biHeight - y - 1) * stride);
-		stream->read (target, stride);
-	}
-
-	bitmap->unlock ();
+	if (auto err = __decode_into_bitmap (bitmap, [&](const __decode_target& target) { return __read_dib_pixels (stream, infoHeader, target); });
+		dseed::failed (err))
+		return err;
 	
 	return create_bitmap_array(arraytype::plain, bitmap, decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_dib_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	bitmap_file_header fileHeader;
+	bitmap_info_header infoHeader;
+	dseed::color::pixelformat format;
+	if (auto err = __read_dib_header (stream, fileHeader, infoHeader, format); dseed::failed (err))
+		return err;
+
+	*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, dseed::size3i (infoHeader.biWidth, infoHeader.biHeight, 1), format);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_dib_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	bitmap_file_header fileHeader;
+	bitmap_info_header infoHeader;
+	dseed::color::pixelformat format;
+	if (auto err = __read_dib_header (stream, fileHeader, infoHeader, format); dseed::failed (err))
+		return err;
+
+	// Palette cannot be delivered with raw pixels
+	if (infoHeader.biClrUsed > 0)
+		return dseed::error_not_support;
+
+	const dseed::size3i size (infoHeader.biWidth, infoHeader.biHeight, 1);
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	if (auto err = __read_dib_pixels (stream, infoHeader, target); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, size, format);
+	return dseed::error_good;
 }
\ No newline at end of file
@@ -4,145 +4,408 @@
 #	include <gif_lib.h>
 #endif
 
-dseed::error_t dseed::bitmaps::create_gif_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
-{
+#include "../parallel.hxx"
+#include "../../libs/AnimationHelper.hxx"
+
 #if defined(USE_GIF)
-	int err;
-	auto pgif = DGifOpen (stream, [](GifFileType* file, GifByteType* buf, int len) -> int
-		{
-			return (int) reinterpret_cast<dseed::io::stream*>(file->UserData)->read (buf, len);
-		}, &err
-	);
-	if (pgif == nullptr)
-		return dseed::error_fail;
+dseed::error_t __skip_gif_sub_blocks (dseed::io::stream* stream) noexcept
+{
+	while (true)
+	{
+		uint8_t blockSize;
+		if (1 != stream->read (&blockSize, 1))
+			return dseed::error_io;
+		if (blockSize == 0)
+			return dseed::error_good;
+		if (!stream->seek (dseed::io::seekorigin::current, blockSize))
+			return dseed::error_io;
+	}
+}
+
+// Position and drawing of image read by scan
+//  : Offset is where records of image(Graphic Control Extension and others) start.
+struct __gif_frame_info
+{
+	size_t offset;
+	int left, top, width, height;
+	int disposal;
+	bool transparent;
+};
 
-	if (DGifSlurp (pgif) != GIF_OK)
+// Reads screen size and counts Image Descriptors by skipping over LZW data without decompression
+dseed::error_t __scan_gif (dseed::io::stream* stream, int& width, int& height, size_t& imageCount,
+	std::vector<__gif_frame_info>* frames = nullptr) noexcept
+{
+	// Header(6) + Logical Screen Descriptor(7)
+	uint8_t header[13];
+	if (sizeof (header) != stream->read (header, sizeof (header))
+		|| (memcmp (header, GIF87_STAMP, GIF_STAMP_LEN) != 0 && memcmp (header, GIF89_STAMP, GIF_STAMP_LEN) != 0))
 		return dseed::error_fail;
 
-	dseed::size3i size (pgif->SWidth, pgif->SHeight, 1);
-	size_t imageCount = pgif->ImageCount;
+	width = header[6] | (header[7] << 8);
+	height = header[8] | (header[9] << 8);
+	if (header[10] & 0x80)
+		stream->seek (dseed::io::seekorigin::current, 3 * (2 << (header[10] & 0x07)));
 
-	std::vector<dseed::color::bgra8> palette;
-	if (pgif->SColorMap)
+	imageCount = 0;
+	__gif_frame_info frame = { stream->position (), 0, 0, 0, 0, DISPOSAL_UNSPECIFIED, false };
+	while (true)
 	{
-		palette.resize (pgif->SColorMap->ColorCount);
-		//memcpy (palette.data (), pgif->SColorMap->Colors, palette.size () * sizeof (dseed::bgra));
-		for (int i = 0; i < palette.size (); ++i)
+		uint8_t introducer;
+		if (1 != stream->read (&introducer, 1))
+			return dseed::error_io;
+
+		if (introducer == TERMINATOR_INTRODUCER)
+			break;
+		else if (introducer == EXTENSION_INTRODUCER)
 		{
-			palette[i].b = pgif->SColorMap->Colors[i].Blue;
-			palette[i].g = pgif->SColorMap->Colors[i].Green;
-			palette[i].r = pgif->SColorMap->Colors[i].Red;
-			palette[i].a = 255;
+			uint8_t label;
+			if (1 != stream->read (&label, 1))
+				return dseed::error_io;
+			// Graphic Control Extension: size(4), packed fields, delay time(2), transparent color index
+			uint8_t control[5];
+			if (label == GRAPHICS_EXT_FUNC_CODE && frames != nullptr)
+			{
+				if (sizeof (control) != stream->read (control, sizeof (control)))
+					return dseed::error_io;
+				if (control[0] < 4)
+					return dseed::error_fail;
+				frame.disposal = (control[1] >> 2) & 0x7;
+				frame.transparent = (control[1] & 0x01) != 0;
+				if (!stream->seek (dseed::io::seekorigin::current, control[0] - 4))
+					return dseed::error_io;
+			}
+			if (auto err = __skip_gif_sub_blocks (stream); dseed::failed (err))
+				return err;
 		}
+		else if (introducer == DESCRIPTOR_INTRODUCER)
+		{
+			uint8_t descriptor[9];
+			if (sizeof (descriptor) != stream->read (descriptor, sizeof (descriptor)))
+				return dseed::error_io;
+			size_t skip = 1;
+			if (descriptor[8] & 0x80)
+				skip += 3 * (2 << (descriptor[8] & 0x07));
+			if (!stream->seek (dseed::io::seekorigin::current, skip))
+				return dseed::error_io;
+			if (auto err = __skip_gif_sub_blocks (stream); dseed::failed (err))
+				return err;
+			++imageCount;
+
+			if (frames != nullptr)
+			{
+				frame.left = descriptor[0] | (descriptor[1] << 8);
+				frame.top = descriptor[2] | (descriptor[3] << 8);
+				frame.width = descriptor[4] | (descriptor[5] << 8);
+				frame.height = descriptor[6] | (descriptor[7] << 8);
+				try { frames->push_back (frame); }
+				catch (...) { return dseed::error_out_of_memory; }
+			}
+			frame = { stream->position (), 0, 0, 0, 0, DISPOSAL_UNSPECIFIED, false };
+		}
+		else
+			return dseed::error_fail;
 	}
 
-	for (int i = 0; i < pgif->ExtensionBlockCount; ++i)
+	return imageCount > 0 ? dseed::error_good : dseed::error_fail;
+}
+
+inline bool __gif_covers_screen (const __gif_frame_info& frame, int width, int height) noexcept
+{
+	return frame.left <= 0 && frame.top <= 0 && frame.left + frame.width >= width && frame.top + frame.height >= height;
+}
+
+// Frame after disposal of whole screen to background starts from background filled canvas.
+// Opaque frame covering whole screen does not read canvas, unless it restores canvas before it on disposal.
+std::vector<bool> __gif_key_frames (const std::vector<__gif_frame_info>& frames, int width, int height)
+{
+	std::vector<bool> keys (frames.size ());
+	for (size_t i = 0; i < frames.size (); ++i)
 	{
-		if (pgif->ExtensionBlocks[i].Function == GRAPHICS_EXT_FUNC_CODE)
-		{
-			if (pgif->ExtensionBlocks[i].Bytes[3] != NO_TRANSPARENT_COLOR)
-				palette[pgif->ExtensionBlocks[i].Bytes[3]].a = 0;
-			break;
-		}
+		keys[i] = i == 0
+			|| (frames[i - 1].disposal == DISPOSE_BACKGROUND && __gif_covers_screen (frames[i - 1], width, height))
+			|| (!frames[i].transparent && frames[i].disposal != DISPOSE_PREVIOUS && __gif_covers_screen (frames[i], width, height));
 	}
+	return keys;
+}
 
-	dseed::autoref<dseed::bitmaps::palette> globalPaletteObj;
-	if (dseed::failed (dseed::bitmaps::create_palette (palette.data (), 32, palette.size (), &globalPaletteObj)))
-		return dseed::error_fail;
+// Decodes frames progressively with record-level giflib API
+//  : Reader is moved to Image records found in scan, so decoding starts at key frame or cached canvas.
+class __gif_frame_loader : public __animation_frame_loader
+{
+public:
+	__gif_frame_loader (dseed::io::stream* stream, const std::vector<__gif_frame_info>& frames, const std::vector<bool>& keys,
+		size_t cacheSize)
+		: __animation_frame_loader (keys, cacheSize), _stream (stream), _origin (stream->position ()), _gif (nullptr)
+		, _frames (frames)
+	{ }
+	~__gif_frame_loader ()
+	{
+		close ();
+	}
 
-	std::vector<dseed::bitmaps::bitmap*> _bitmaps (imageCount);
-	std::vector<uint8_t> raster (size.width * size.height);
-	for (int z = 0; z < imageCount; ++z)
+public:
+	dseed::error_t open () noexcept
 	{
-		auto& savedImage = pgif->SavedImages[z];
+		close ();
 
-		dseed::autoref<dseed::bitmaps::palette> localPaletteObj = globalPaletteObj;
+		if (!_stream->seek (dseed::io::seekorigin::begin, _origin))
+			return dseed::error_io;
 
-		std::vector<dseed::color::bgra8> innerPalette;
-		dseed::color::bgra8* usingPalette = palette.data ();
-		size_t usingPaletteSize = palette.size ();
-		bool paletteChanged = false;
-		if (pgif->SavedImages[z].ImageDesc.ColorMap)
-		{
-			innerPalette.resize (savedImage.ImageDesc.ColorMap->ColorCount);
-			//memcpy (innerPalette.data (), savedImage.ImageDesc.ColorMap->Colors, innerPalette.size ());
-			for (int i = 0; i < palette.size (); ++i)
+		int err;
+		_gif = DGifOpen (_stream.get (), [](GifFileType* file, GifByteType* buf, int len) -> int
 			{
-				innerPalette[i].b = savedImage.ImageDesc.ColorMap->Colors[i].Blue;
-				innerPalette[i].g = savedImage.ImageDesc.ColorMap->Colors[i].Green;
-				innerPalette[i].r = savedImage.ImageDesc.ColorMap->Colors[i].Red;
-				innerPalette[i].a = 255;
-			}
-			usingPalette = innerPalette.data ();
-			usingPaletteSize = innerPalette.size ();
-			paletteChanged = true;
+				return (int)reinterpret_cast<dseed::io::stream*>(file->UserData)->read (buf, len);
+			}, &err
+		);
+		if (_gif == nullptr)
+			return dseed::error_fail;
+
+		try { _canvas.assign ((size_t)_gif->SWidth * _gif->SHeight, 0); }
+		catch (...) { return dseed::error_out_of_memory; }
+
+		return dseed::error_good;
+	}
+
+protected:
+	// giflib does not read ahead between records, so stream can be moved to any record
+	virtual dseed::error_t seek (size_t index, bool keyCanvas) noexcept override
+	{
+		if (_gif == nullptr)
+		{
+			if (auto err = open (); dseed::failed (err))
+				return err;
 		}
 
-		int transparent = -1;
-		int delayTime;
-		for (int i = 0; i < savedImage.ExtensionBlockCount; ++i)
+		if (keyCanvas)
 		{
-			if (savedImage.ExtensionBlocks[i].Function == GRAPHICS_EXT_FUNC_CODE)
+			const bool disposed = index > 0 && _frames[index - 1].disposal == DISPOSE_BACKGROUND;
+			std::fill (_canvas.begin (), _canvas.end (), disposed ? (uint8_t)_gif->SBackGroundColor : 0);
+		}
+
+		if (!_stream->seek (dseed::io::seekorigin::begin, _frames[index].offset))
+			return dseed::error_io;
+		return dseed::error_good;
+	}
+
+	virtual dseed::error_t step (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		int delayTime = 0, transparent = NO_TRANSPARENT_COLOR, disposal = DISPOSAL_UNSPECIFIED;
+
+		while (true)
+		{
+			GifRecordType recordType;
+			if (DGifGetRecordType (_gif, &recordType) != GIF_OK)
+				return dseed::error_fail;
+
+			if (recordType == EXTENSION_RECORD_TYPE)
 			{
-				delayTime = (savedImage.ExtensionBlocks[i].Bytes[1] | (savedImage.ExtensionBlocks[i].Bytes[2] << 8)) * 10;
-				if (savedImage.ExtensionBlocks[i].Bytes[3] != NO_TRANSPARENT_COLOR)
+				int code;
+				GifByteType* ext;
+				if (DGifGetExtension (_gif, &code, &ext) != GIF_OK)
+					return dseed::error_fail;
+				if (code == GRAPHICS_EXT_FUNC_CODE && ext != nullptr && ext[0] >= 4)
 				{
-					usingPalette[transparent = savedImage.ExtensionBlocks[i].Bytes[3]].a = 0;
-					paletteChanged = true;
+					disposal = (ext[1] >> 2) & 0x7;
+					delayTime = (ext[2] | (ext[3] << 8)) * 10;
+					transparent = (ext[1] & 0x01) ? ext[4] : NO_TRANSPARENT_COLOR;
 				}
-				int disposal = (savedImage.ExtensionBlocks[i].Bytes[0] >> 2) & 0x7;
-				switch (disposal)
+				while (ext != nullptr)
 				{
-				case DISPOSE_BACKGROUND:
-					for (int y = 0; y < size.height; ++y)
-					{
-						for (int x = 0; x < size.width; ++x)
-							*(raster.data () + (y * size.width) + x) = pgif->SBackGroundColor;
-					}
-					break;
+					if (DGifGetExtensionNext (_gif, &ext) != GIF_OK)
+						return dseed::error_fail;
 				}
-				break;
 			}
+			else if (recordType == IMAGE_DESC_RECORD_TYPE)
+				break;
+			else
+				return dseed::error_fail;
 		}
 
-		for (int y = savedImage.ImageDesc.Top; y < savedImage.ImageDesc.Top + savedImage.ImageDesc.Height; ++y)
+		if (DGifGetImageDesc (_gif) != GIF_OK)
+			return dseed::error_fail;
+
+		const GifImageDesc& desc = _gif->Image;
+		const int screenWidth = _gif->SWidth, screenHeight = _gif->SHeight;
+
+		std::vector<uint8_t> line (dseed::maximum (desc.Width, 0));
+		std::vector<uint8_t> previous;
+		if (disposal == DISPOSE_PREVIOUS)
+			previous = _canvas;
+
+		// Interlaced rows are stored in 4 passes
+		static const int interlacedOffset[] = { 0, 4, 2, 1 }, interlacedJump[] = { 8, 8, 4, 2 };
+		const int passes = desc.Interlace ? 4 : 1;
+		for (int pass = 0; pass < passes; ++pass)
 		{
-			for (int x = savedImage.ImageDesc.Left; x < savedImage.ImageDesc.Left + savedImage.ImageDesc.Width; ++x)
+			const int begin = desc.Interlace ? interlacedOffset[pass] : 0;
+			const int jump = desc.Interlace ? interlacedJump[pass] : 1;
+			for (int row = begin; row < desc.Height; row += jump)
 			{
-				uint8_t value = *(savedImage.RasterBits + ((y - savedImage.ImageDesc.Top) * savedImage.ImageDesc.Width) + (x - savedImage.ImageDesc.Left));
-				if (!(/*value == pgif->SBackGroundColor || */value == transparent))
-					*(raster.data () + (y * size.width) + x) = value;
+				if (DGifGetLine (_gif, line.data (), desc.Width) != GIF_OK)
+					return dseed::error_fail;
+
+				const int y = desc.Top + row;
+				if (y < 0 || y >= screenHeight)
+					continue;
+				uint8_t* dest = _canvas.data () + (size_t)y * screenWidth;
+				for (int x = dseed::maximum (0, -desc.Left); x < desc.Width && desc.Left + x < screenWidth; ++x)
+				{
+					if (line[x] != transparent)
+						dest[desc.Left + x] = line[x];
+				}
 			}
 		}
 
-		if (paletteChanged)
+		if (bitmap != nullptr)
 		{
-			localPaletteObj.release ();
-			if (dseed::failed (dseed::bitmaps::create_palette (usingPalette, 32, usingPaletteSize, &localPaletteObj)))
-				return dseed::error_fail;
+			if (auto err = materialize (desc, transparent, delayTime, bitmap); dseed::failed (err))
+				return err;
+		}
+
+		// Disposal is applied after frame is shown
+		if (disposal == DISPOSE_BACKGROUND)
+		{
+			for (int y = dseed::maximum (0, desc.Top); y < desc.Top + desc.Height && y < screenHeight; ++y)
+				for (int x = dseed::maximum (0, desc.Left); x < desc.Left + desc.Width && x < screenWidth; ++x)
+					_canvas[(size_t)y * screenWidth + x] = (uint8_t)_gif->SBackGroundColor;
+		}
+		else if (disposal == DISPOSE_PREVIOUS)
+			_canvas.swap (previous);
+
+		return dseed::error_good;
+	}
+
+private:
+	void close () noexcept
+	{
+		if (_gif)
+		{
+			int err;
+			DGifCloseFile (_gif, &err);
+			_gif = nullptr;
+		}
+	}
+
+	dseed::error_t materialize (const GifImageDesc& desc, int transparent, int delayTime, dseed::bitmaps::bitmap** bitmap) noexcept
+	{
+		const ColorMapObject* colorMap = desc.ColorMap ? desc.ColorMap : _gif->SColorMap;
+
+		std::vector<dseed::color::bgra8> palette (colorMap ? colorMap->ColorCount : 256);
+		for (size_t i = 0; colorMap && i < palette.size (); ++i)
+		{
+			palette[i].b = colorMap->Colors[i].Blue;
+			palette[i].g = colorMap->Colors[i].Green;
+			palette[i].r = colorMap->Colors[i].Red;
+			palette[i].a = 255;
 		}
+		if (transparent >= 0 && transparent < (int)palette.size ())
+			palette[transparent].a = 0;
 
-		if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, size, dseed::color::pixelformat::bgra8_indexed8,
-			localPaletteObj, &_bitmaps[z])))
+		dseed::autoref<dseed::bitmaps::palette> paletteObj;
+		if (dseed::failed (dseed::bitmaps::create_palette (palette.data (), 32, palette.size (), &paletteObj)))
+			return dseed::error_fail;
+
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d,
+			dseed::size3i (_gif->SWidth, _gif->SHeight, 1), dseed::color::pixelformat::bgra8_indexed8,
+			paletteObj, &temp)))
 			return dseed::error_fail;
 
 		dseed::autoref<dseed::attributes> attr;
-		_bitmaps[z]->extra_info(&attr);
-		attr->set_int64(dseed::attrkey_duration, dseed::timespan::from_milliseconds(delayTime).ticks());
+		temp->extra_info (&attr);
+		attr->set_int64 (dseed::attrkey_duration, dseed::timespan::from_milliseconds (delayTime).ticks ());
 
 		void* ptr;
-		if (dseed::failed (_bitmaps[z]->lock (&ptr)))
+		if (dseed::failed (temp->lock (&ptr)))
 			return dseed::error_fail;
+		memcpy (ptr, _canvas.data (), _canvas.size ());
+		temp->unlock ();
 
-		memcpy (ptr, raster.data (), raster.size ());
+		*bitmap = temp.detach ();
+		return dseed::error_good;
+	}
 
-		_bitmaps[z]->unlock ();
+private:
+	dseed::autoref<dseed::io::stream> _stream;
+	size_t _origin;
+	GifFileType* _gif;
+	std::vector<__gif_frame_info> _frames;
+};
+#endif
+
+dseed::error_t dseed::bitmaps::create_gif_bitmap_decoder_with_options (dseed::io::stream* stream,
+	const dseed::bitmaps::animation_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+#if defined(USE_GIF)
+	if (stream == nullptr || decoder == nullptr || options.threads < 0 || options.cache_size < 0)
+		return dseed::error_invalid_args;
+
+	// Frames are found without LZW decompression, then decoded on first access
+	const size_t origin = stream->position ();
+	int width, height;
+	size_t imageCount;
+	std::vector<__gif_frame_info> frames;
+	if (auto err = __scan_gif (stream, width, height, imageCount, &frames); dseed::failed (err))
+		return err;
+	stream->seek (dseed::io::seekorigin::begin, origin);
+
+	std::vector<bool> keys;
+	try { keys = __gif_key_frames (frames, width, height); }
+	catch (...) { return dseed::error_out_of_memory; }
+
+	if (options.parallel)
+	{
+		dseed::autoref<dseed::blob> blob;
+		if (auto err = __animation_stream_blob (stream, &blob); dseed::failed (err))
+			return err;
+
+		std::vector<dseed::autoref<dseed::bitmaps::bitmap>> bitmaps;
+		if (auto err = __animation_decode_parallel (blob, keys, (size_t)options.threads,
+			[&](dseed::io::stream* runStream, dseed::bitmaps::bitmap_frame_loader** loader) -> dseed::error_t
+			{
+				runStream->seek (dseed::io::seekorigin::begin, origin);
+				*loader = new __gif_frame_loader (runStream, frames, keys, 0);
+				return *loader != nullptr ? dseed::error_good : dseed::error_out_of_memory;
+			}, bitmaps); dseed::failed (err))
+			return err;
+
+		return create_bitmap_array (arraytype::plain, bitmaps, decoder);
 	}
 
-	DGifCloseFile (pgif, &err);
+	dseed::autoref<__gif_frame_loader> loader;
+	loader.attach (new __gif_frame_loader (stream, frames, keys, (size_t)options.cache_size));
+	if (loader == nullptr)
+		return dseed::error_out_of_memory;
+	if (auto err = loader->open (); dseed::failed (err))
+		return err;
+
+	return create_lazy_bitmap_array (arraytype::plain, imageCount, loader, (size_t)options.cache_size, decoder);
+#else
+	return dseed::error_not_support;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::create_gif_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	return create_gif_bitmap_decoder_with_options (stream, dseed::bitmaps::animation_decoder_options (), decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_gif_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_GIF)
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	int width, height;
+	size_t imageCount;
+	if (auto err = __scan_gif (stream, width, height, imageCount); dseed::failed (err))
+		return err;
 
-	return create_bitmap_array(arraytype::plain, _bitmaps, decoder);
+	*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, dseed::size3i (width, height, 1),
+		dseed::color::pixelformat::bgra8_indexed8, dseed::bitmaps::arraytype::plain, imageCount);
+	return dseed::error_good;
 #else
 	return dseed::error_not_support;
 #endif
-}
\ No newline at end of file
+}
@@ -2,10 +2,71 @@
 
 #include "../../libs/ICOHelper.hxx"
 
-dseed::error_t __create_ico_cur_bitmap_decoder (dseed::io::stream* stream, bool ico, dseed::bitmaps::bitmap_array** decoder) noexcept
+class __ico_cur_frame_loader : public dseed::bitmaps::bitmap_frame_loader
 {
-	dseed::error_t err;
+public:
+	__ico_cur_frame_loader (dseed::io::stream* stream, bool ico, std::vector<IcoCurEntry>&& entries)
+		: _refCount (1), _stream (stream), _ico (ico), _entries (std::move (entries))
+	{ }
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t load (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		dseed::error_t err;
+		const IcoCurEntry& entry = _entries[index];
+
+		if (!_stream->seek (dseed::io::seekorigin::begin, entry.offset))
+			return dseed::error_io;
+
+		std::vector<uint8_t> bytes (entry.bytes);
+		if (entry.bytes != _stream->read (bytes.data (), entry.bytes))
+			return dseed::error_io;
+		dseed::autoref<dseed::io::stream> bytesStream;
+		if (dseed::failed (err = dseed::io::create_fixed_memorystream (bytes.data (), bytes.size (), &bytesStream)))
+			return err;
+
+		dseed::autoref<dseed::bitmaps::bitmap_array> inner_decoder;
+		if (dseed::failed (dseed::bitmaps::create_dib_bitmap_decoder (bytesStream, &inner_decoder)))
+		{
+			bytesStream->seek (dseed::io::seekorigin::begin, 0);
+			if (dseed::failed (dseed::bitmaps::create_png_bitmap_decoder (bytesStream, &inner_decoder)))
+				return dseed::error_not_support_file_format;
+		}
+
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed (inner_decoder->at (0, &temp)))
+			return dseed::error_fail;
 
+		if (!_ico)
+		{
+			dseed::autoref<dseed::attributes> attr;
+			temp->extra_info (&attr);
+			attr->set_size (dseed::attrkey_cursor_hotspot, entry.cur_hotspot_x, entry.cur_hotspot_y);
+		}
+
+		*bitmap = temp.detach ();
+		return dseed::error_good;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::stream> _stream;
+	bool _ico;
+	std::vector<IcoCurEntry> _entries;
+};
+
+dseed::error_t __create_ico_cur_bitmap_decoder (dseed::io::stream* stream, bool ico, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
 	IcoCurHeader header;
 	if (sizeof (IcoCurHeader) != stream->read (&header, sizeof (IcoCurHeader)))
 		return dseed::error_io;
@@ -17,7 +78,8 @@ dseed::error_t __create_ico_cur_bitmap_decoder (dseed::io::stream* stream, bool
 		|| (!ico && header.image_type != ICO_CUR_IMAGE_TYPE_CURSOR))
 		return dseed::error_not_support_file_format;
 
-	std::vector<dseed::bitmaps::bitmap*> bitmaps;
+	// Entries are collected by skipping image data; images are decoded on first access
+	std::vector<IcoCurEntry> entries;
 	for (auto i = 0; i < header.images; ++i)
 	{
 		IcoCurEntry entry;
@@ -30,36 +92,22 @@ dseed::error_t __create_ico_cur_bitmap_decoder (dseed::io::stream* stream, bool
 		if (entry.offset != stream->position ())
 			return dseed::error_not_support_file_format;
 
-		std::vector<uint8_t> bytes (entry.bytes);
-		if (entry.bytes != stream->read (bytes.data (), entry.bytes))
+		if (!stream->seek (dseed::io::seekorigin::current, entry.bytes))
 			return dseed::error_io;
-		dseed::autoref<dseed::io::stream> bytesStream;
-		if (dseed::failed (err = dseed::io::create_fixed_memorystream (bytes.data (), bytes.size (), &bytesStream)))
-			return err;
-
-		dseed::autoref<dseed::bitmaps::bitmap_array> inner_decoder;
-		if (dseed::failed (dseed::bitmaps::create_dib_bitmap_decoder (bytesStream, &inner_decoder)))
-		{
-			bytesStream->seek (dseed::io::seekorigin::begin, 0);
-			if (dseed::failed (dseed::bitmaps::create_png_bitmap_decoder (bytesStream, &inner_decoder)))
-				return dseed::error_not_support_file_format;
-		}
 
-		dseed::autoref<dseed::bitmaps::bitmap> bitmap;
-		if (dseed::failed (inner_decoder->at (0, &bitmap)))
-			return dseed::error_fail;
+		entries.push_back (entry);
+	}
 
-		if (!ico)
-		{
-			dseed::autoref<dseed::attributes> attr;
-			bitmap->extra_info (&attr);
-			attr->set_size (dseed::attrkey_cursor_hotspot, entry.cur_hotspot_x, entry.cur_hotspot_y);
-		}
+	if (entries.empty ())
+		return dseed::error_not_support_file_format;
 
-		bitmaps.push_back (bitmap.detach ());
-	}
+	const size_t count = entries.size ();
+	dseed::autoref<dseed::bitmaps::bitmap_frame_loader> loader;
+	loader.attach (new __ico_cur_frame_loader (stream, ico, std::move (entries)));
+	if (loader == nullptr)
+		return dseed::error_out_of_memory;
 
-	return create_bitmap_array(dseed::bitmaps::arraytype::plain, bitmaps, decoder);
+	return create_lazy_bitmap_array (dseed::bitmaps::arraytype::plain, count, loader, count, decoder);
 }
 
 dseed::error_t dseed::bitmaps::create_ico_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
@@ -69,4 +117,68 @@ dseed::error_t dseed::bitmaps::create_ico_bitmap_decoder (dseed::io::stream* str
 dseed::error_t dseed::bitmaps::create_cur_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
 {
 	return __create_ico_cur_bitmap_decoder (stream, false, decoder);
+}
+
+dseed::error_t __probe_ico_cur_bitmap (dseed::io::stream* stream, bool ico, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	IcoCurHeader header;
+	if (sizeof (IcoCurHeader) != stream->read (&header, sizeof (IcoCurHeader)))
+		return dseed::error_io;
+
+	if (header.reserved != 0)
+		return dseed::error_not_support_file_format;
+
+	if ((ico && header.image_type != ICO_CUR_IMAGE_TYPE_ICON)
+		|| (!ico && header.image_type != ICO_CUR_IMAGE_TYPE_CURSOR))
+		return dseed::error_not_support_file_format;
+
+	if (header.images == 0)
+		return dseed::error_not_support_file_format;
+
+	// Size is largest image in file, format is first image's format
+	dseed::bitmaps::bitmap_info result;
+	for (auto i = 0; i < header.images; ++i)
+	{
+		IcoCurEntry entry;
+		if (sizeof (IcoCurEntry) != stream->read (&entry, sizeof (IcoCurEntry)))
+			return dseed::error_io;
+
+		if (!(entry.reserved == 0 || entry.reserved == 255))
+			return dseed::error_not_support_file_format;
+
+		if (entry.offset != stream->position ())
+			return dseed::error_not_support_file_format;
+
+		dseed::bitmaps::bitmap_info inner;
+		if (dseed::failed (dseed::bitmaps::probe_dib_bitmap (stream, &inner)))
+		{
+			stream->seek (dseed::io::seekorigin::begin, entry.offset);
+			if (dseed::failed (dseed::bitmaps::probe_png_bitmap (stream, &inner)))
+				return dseed::error_not_support_file_format;
+		}
+
+		if (i == 0)
+			result.format = inner.format;
+		result.size.width = dseed::maximum (result.size.width, inner.size.width);
+		result.size.height = dseed::maximum (result.size.height, inner.size.height);
+
+		if (!stream->seek (dseed::io::seekorigin::begin, (size_t)entry.offset + entry.bytes))
+			return dseed::error_io;
+	}
+
+	*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, dseed::size3i (result.size.width, result.size.height, 1),
+		result.format, dseed::bitmaps::arraytype::plain, header.images);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::probe_ico_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	return __probe_ico_cur_bitmap (stream, true, info);
+}
+dseed::error_t dseed::bitmaps::probe_cur_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	return __probe_ico_cur_bitmap (stream, false, info);
 }
\ No newline at end of file
@@ -10,12 +10,9 @@
 /* position 45: "\xff\x52" */
 #define J2K_CODESTREAM_MAGIC "\xff\x4f\xff\x51"
 
-dseed::error_t dseed::bitmaps::create_jpeg2000_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
-{
 #if defined(USE_JPEG2000)
-	if (stream == nullptr || decoder == nullptr)
-		return dseed::error_invalid_args;
-
+dseed::error_t __open_jpeg2000_stream (dseed::io::stream* stream, opj_codec_t** codec, opj_stream_t** jp2stream) noexcept
+{
 	uint8_t sig[12];
 	if (12 != stream->read (sig, 12))
 		return dseed::error_fail;
@@ -44,6 +41,11 @@ dseed::error_t dseed::bitmaps::create_jpeg2000_bitmap_decoder (dseed::io::stream
 	}
 
 	opj_stream_t* opjStream = opj_stream_default_create (1);
+	if (opjStream == nullptr)
+	{
+		opj_destroy_codec (dec);
+		return dseed::error_out_of_memory;
+	}
 
 	opj_stream_set_user_data (opjStream, stream, [](void* p_user_data) {});
 	opj_stream_set_user_data_length (opjStream, stream->length ());
@@ -70,44 +72,138 @@ dseed::error_t dseed::bitmaps::create_jpeg2000_bitmap_decoder (dseed::io::stream
 		return stream->position () - lastPos;
 		});
 
-	opj_image_t* image;
-	if (!opj_read_header (opjStream, dec, &image))
+	*codec = dec;
+	*jp2stream = opjStream;
+
+	return dseed::error_good;
+}
+#endif
+
+#if defined(USE_JPEG2000)
+// Dimension at resolution level, same as component dimension computed by openjpeg
+inline OPJ_UINT32 __jpeg2000_reduce (OPJ_UINT32 v, OPJ_UINT32 level) noexcept
+{
+	return (OPJ_UINT32)(((uint64_t)v + (1ull << level) - 1) >> level);
+}
+
+// Highest resolution level keeping image at least minimum size
+OPJ_UINT32 __jpeg2000_reduce_level (const opj_image_t* image, const dseed::size2i& minimum) noexcept
+{
+	for (OPJ_UINT32 level = 32; level > 0; --level)
 	{
-		opj_stream_destroy (opjStream);
-		opj_destroy_codec (dec);
-		return dseed::error_fail;
+		if (__jpeg2000_reduce (image->x1, level) - __jpeg2000_reduce (image->x0, level) >= (OPJ_UINT32)minimum.width
+			&& __jpeg2000_reduce (image->y1, level) - __jpeg2000_reduce (image->y0, level) >= (OPJ_UINT32)minimum.height)
+			return level;
 	}
+	return 0;
+}
+
+// Component sample to 8-bit
+//  : Signed sample is moved to unsigned range, deeper sample keeps its most significant bits.
+inline uint8_t __jpeg2000_sample (const opj_image_comp_t& comp, OPJ_INT32 value) noexcept
+{
+	if (comp.sgnd)
+		value += 1 << (comp.prec - 1);
+	if (comp.prec > 8)
+		value >>= comp.prec - 8;
+	else if (comp.prec < 8)
+		value <<= 8 - comp.prec;
+	return (uint8_t)dseed::clamp<OPJ_INT32> (value, 255);
+}
+
+// Reads header, applies resolution level, region and threads, then decodes
+dseed::error_t __decode_jpeg2000_image (dseed::io::stream* stream, const dseed::bitmaps::jpeg2000_decoder_options& options,
+	opj_image_t** decoded) noexcept
+{
+	if (options.reduce_level < 0 || options.threads < 0)
+		return dseed::error_invalid_args;
+
+	opj_codec_t* dec;
+	opj_stream_t* opjStream;
+	if (auto err = __open_jpeg2000_stream (stream, &dec, &opjStream); dseed::failed (err))
+		return err;
 
-	if (!opj_decode (dec, opjStream, image))
+	auto failed = [&](opj_image_t* image, dseed::error_t err)
 	{
-		opj_image_destroy (image);
+		if (image != nullptr)
+			opj_image_destroy (image);
 		opj_stream_destroy (opjStream);
 		opj_destroy_codec (dec);
-		return dseed::error_fail;
+		return err;
+	};
+
+	// Thread pool must be set before header is read
+	if (opj_has_thread_support ())
+		opj_codec_set_threads (dec, options.threads == 0 ? opj_get_num_cpus () : options.threads);
+
+	opj_image_t* image;
+	if (!opj_read_header (opjStream, dec, &image))
+		return failed (nullptr, dseed::error_fail);
+
+	OPJ_UINT32 level = (OPJ_UINT32)options.reduce_level;
+	if (options.minimum_size.width > 0 || options.minimum_size.height > 0)
+		level = __jpeg2000_reduce_level (image, options.minimum_size);
+	// Fails if every component does not have more resolutions than level
+	while (!opj_set_decoded_resolution_factor (dec, level))
+	{
+		if (level == 0)
+			return failed (image, dseed::error_fail);
+		--level;
 	}
 
-	if (!opj_end_decompress (dec, opjStream))
+	if (options.region.width > 0 && options.region.height > 0)
 	{
-		opj_image_destroy (image);
-		opj_stream_destroy (opjStream);
-		opj_destroy_codec (dec);
-		return dseed::error_fail;
+		const auto& region = options.region;
+		const OPJ_UINT32 left = __jpeg2000_reduce (image->x0, level), top = __jpeg2000_reduce (image->y0, level);
+		const OPJ_UINT32 width = __jpeg2000_reduce (image->x1, level) - left, height = __jpeg2000_reduce (image->y1, level) - top;
+		if (region.x < 0 || region.y < 0
+			|| (OPJ_UINT32)(region.x + region.width) > width
+			|| (OPJ_UINT32)(region.y + region.height) > height)
+			return failed (image, dseed::error_invalid_args);
+
+		// Decode area is in full resolution reference grid
+		const auto toGrid = [level](OPJ_UINT32 reduced, OPJ_UINT32 limit) { return (OPJ_INT32)dseed::minimum<uint64_t> ((uint64_t)reduced << level, limit); };
+		if (!opj_set_decode_area (dec, image,
+			toGrid (left + region.x, image->x1), toGrid (top + region.y, image->y1),
+			toGrid (left + region.x + region.width, image->x1), toGrid (top + region.y + region.height, image->y1)))
+			return failed (image, dseed::error_fail);
 	}
 
+	if (!opj_decode (dec, opjStream, image) || !opj_end_decompress (dec, opjStream))
+		return failed (image, dseed::error_fail);
+
 	opj_stream_destroy (opjStream);
 	opj_destroy_codec (dec);
 
-	color::pixelformat format;
+	*decoded = image;
+	return dseed::error_good;
+}
+#endif
+
+dseed::error_t __create_jpeg2000_bitmap_decoder_internal (dseed::io::stream* stream, const dseed::bitmaps::jpeg2000_decoder_options& options,
+	dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+#if defined(USE_JPEG2000)
+	if (stream == nullptr || decoder == nullptr)
+		return dseed::error_invalid_args;
+
+	opj_image_t* image;
+	if (auto err = __decode_jpeg2000_image (stream, options, &image); dseed::failed (err))
+		return err;
+
+	dseed::color::pixelformat format;
 	switch (image->numcomps)
 	{
-	case 1: format = color::pixelformat::r8; break;
-	case 3: format = color::pixelformat::rgb8; break;
-	case 4: format = color::pixelformat::rgba8; break;
+	case 1: format = dseed::color::pixelformat::r8; break;
+	case 3: format = dseed::color::pixelformat::rgb8; break;
+	case 4: format = dseed::color::pixelformat::rgba8; break;
 	default:
+		opj_image_destroy (image);
 		return dseed::error_not_support;
 	}
 
-	dseed::size3i size (image->x1 - image->x0, image->y1 - image->y0, 1);
+	// Components are already reduced and cropped to decoded area
+	dseed::size3i size (image->comps[0].w, image->comps[0].h, 1);
 
 	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
 	if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, size, format, nullptr, &bitmap)))
@@ -130,11 +226,22 @@ dseed::error_t dseed::bitmaps::create_jpeg2000_bitmap_decoder (dseed::io::stream
 	{
 		uint8_t* linePtr = ptr + (stride * y);
 
-		for (auto x = 0; x < size.width; ++x)
+		for (uint32_t z = 0; z < image->numcomps; ++z)
 		{
-			auto offset = x * image->numcomps;
-			for (uint32_t z = 0; z < image->numcomps; ++z)
-				linePtr[offset + z] = image->comps[z].data[y * size.width + x];
+			// Subsampled component is stretched to first component
+			const opj_image_comp_t& comp = image->comps[z];
+			const OPJ_INT32* compLine = comp.data + (size_t)dseed::minimum<OPJ_UINT32> ((OPJ_UINT32)y * comp.h / size.height, comp.h - 1) * comp.w;
+			if (comp.w == (OPJ_UINT32)size.width)
+			{
+				for (auto x = 0; x < size.width; ++x)
+					linePtr[x * image->numcomps + z] = __jpeg2000_sample (comp, compLine[x]);
+			}
+			else
+			{
+				for (auto x = 0; x < size.width; ++x)
+					linePtr[x * image->numcomps + z] = __jpeg2000_sample (comp,
+						compLine[dseed::minimum<OPJ_UINT32> ((OPJ_UINT32)x * comp.w / size.width, comp.w - 1)]);
+			}
 		}
 	}
 
@@ -142,7 +249,62 @@ dseed::error_t dseed::bitmaps::create_jpeg2000_bitmap_decoder (dseed::io::stream
 
 	opj_image_destroy (image);
 
-	return create_bitmap_array(arraytype::plain, bitmap, decoder);
+	return create_bitmap_array(dseed::bitmaps::arraytype::plain, bitmap, decoder);
+#else
+	return dseed::error_not_support;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::create_jpeg2000_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	return __create_jpeg2000_bitmap_decoder_internal (stream, dseed::bitmaps::jpeg2000_decoder_options (), decoder);
+}
+
+dseed::error_t dseed::bitmaps::create_jpeg2000_bitmap_decoder_with_options (dseed::io::stream* stream,
+	const dseed::bitmaps::jpeg2000_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	return __create_jpeg2000_bitmap_decoder_internal (stream, options, decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_jpeg2000_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_JPEG2000)
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	opj_codec_t* dec;
+	opj_stream_t* opjStream;
+	if (auto err = __open_jpeg2000_stream (stream, &dec, &opjStream); dseed::failed (err))
+		return err;
+
+	// Reads main header(SIZ, COD, ...) only, tiles are not decoded
+	opj_image_t* image;
+	if (!opj_read_header (opjStream, dec, &image))
+	{
+		opj_stream_destroy (opjStream);
+		opj_destroy_codec (dec);
+		return dseed::error_fail;
+	}
+
+	opj_stream_destroy (opjStream);
+	opj_destroy_codec (dec);
+
+	color::pixelformat format;
+	switch (image->numcomps)
+	{
+	case 1: format = color::pixelformat::r8; break;
+	case 3: format = color::pixelformat::rgb8; break;
+	case 4: format = color::pixelformat::rgba8; break;
+	default:
+		opj_image_destroy (image);
+		return dseed::error_not_support;
+	}
+
+	dseed::size3i size (image->x1 - image->x0, image->y1 - image->y0, 1);
+	opj_image_destroy (image);
+
+	*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, size, format);
+	return dseed::error_good;
 #else
 	return dseed::error_not_support;
 #endif
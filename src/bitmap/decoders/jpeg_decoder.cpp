@@ -1,5 +1,7 @@
 #include <dseed.h>
 
+#include "../../libs/DecodeTargetHelper.hxx"
+
 #if defined (USE_JPEG)
 #	include <jpeglib.h>
 
@@ -65,12 +67,31 @@ void jpeg_stream_src (j_decompress_ptr cinfo, dseed::io::stream* stream)
 }
 #endif
 
-dseed::error_t __create_jpeg_bitmap_decoder_internal (dseed::io::stream* stream, bool yuv, dseed::bitmaps::bitmap_array** decoder)
-{
 #if defined(USE_JPEG)
-	if (stream == nullptr || decoder == nullptr)
-		return dseed::error_invalid_args;
+// Decoded area in scaled output
+//  : left is offset in cropped scanline, which starts at iMCU boundary.
+struct __jpeg_crop
+{
+	JDIMENSION left, top;
+	JDIMENSION width, height;
+};
+
+// Largest IDCT reduction keeping image at least minimum size
+unsigned __jpeg_scale_denominator (const jpeg_decompress_struct& cinfo, const dseed::size2i& minimum) noexcept
+{
+	for (unsigned denominator = 8; denominator > 1; denominator /= 2)
+	{
+		if ((cinfo.image_width + denominator - 1) / denominator >= (JDIMENSION)minimum.width
+			&& (cinfo.image_height + denominator - 1) / denominator >= (JDIMENSION)minimum.height)
+			return denominator;
+	}
+	return 1;
+}
 
+// Reads header and starts decompression, cinfo is destroyed on failure
+dseed::error_t __start_jpeg_decompress (dseed::io::stream* stream, const dseed::bitmaps::jpeg_decoder_options& options,
+	jpeg_decompress_struct& cinfo, jpeg_error_mgr& jerr, __jpeg_crop& crop, dseed::size3i& size, dseed::color::pixelformat& pixelFormat) noexcept
+{
 	uint8_t sig[3];
 	stream->read (sig, 3);
 	stream->seek (dseed::io::seekorigin::begin, 0);
@@ -78,8 +99,9 @@ dseed::error_t __create_jpeg_bitmap_decoder_internal (dseed::io::stream* stream,
 	if (sig[0] != 0xff || sig[1] != 0xd8 || sig[2] != 0xff)
 		return dseed::error_fail;
 
-	struct jpeg_decompress_struct cinfo;
-	struct jpeg_error_mgr jerr;
+	unsigned denominator = options.scale_denominator;
+	if (denominator != 1 && denominator != 2 && denominator != 4 && denominator != 8)
+		return dseed::error_invalid_args;
 
 	cinfo.err = jpeg_std_error (&jerr);
 	jerr.error_exit = [](j_common_ptr cinfo) {};
@@ -89,47 +111,121 @@ dseed::error_t __create_jpeg_bitmap_decoder_internal (dseed::io::stream* stream,
 
 	int r = jpeg_read_header (&cinfo, 1);
 	if (r != JPEG_HEADER_OK)
+	{
+		jpeg_destroy_decompress (&cinfo);
 		return dseed::error_fail;
+	}
 
+	const bool yuv = options.yuv;
 	if (yuv && cinfo.jpeg_color_space == JCS_YCbCr)
 		cinfo.out_color_space = JCS_YCbCr;
 
+	if (options.minimum_size.width > 0 || options.minimum_size.height > 0)
+		denominator = __jpeg_scale_denominator (cinfo, options.minimum_size);
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = denominator;
+
 	jpeg_start_decompress (&cinfo);
 
-	dseed::size3i size (cinfo.output_width, cinfo.output_height, 1);
-	dseed::color::pixelformat pixelFormat;
+	crop.left = crop.top = 0;
+	crop.width = cinfo.output_width;
+	crop.height = cinfo.output_height;
+	if (options.region.width > 0 && options.region.height > 0)
+	{
+		const auto& region = options.region;
+		if (region.x < 0 || region.y < 0
+			|| (JDIMENSION)(region.x + region.width) > cinfo.output_width
+			|| (JDIMENSION)(region.y + region.height) > cinfo.output_height)
+		{
+			jpeg_destroy_decompress (&cinfo);
+			return dseed::error_out_of_range;
+		}
+
+		// Crop is widened to iMCU boundary by libjpeg, remainder is cut per scanline
+		JDIMENSION xoffset = region.x, width = region.width;
+		if (xoffset != 0 || width != cinfo.output_width)
+			jpeg_crop_scanline (&cinfo, &xoffset, &width);
+
+		crop.left = region.x - xoffset;
+		crop.top = region.y;
+		crop.width = region.width;
+		crop.height = region.height;
+	}
+
+	size = dseed::size3i (crop.width, crop.height, 1);
 	switch (cinfo.output_components)
 	{
 	case 3: pixelFormat = (!yuv) ? dseed::color::pixelformat::rgb8 : dseed::color::pixelformat::yuv8; break;
 	case 4: pixelFormat = (!yuv) ? dseed::color::pixelformat::rgba8 : dseed::color::pixelformat::yuva8; break;
 	case 1: pixelFormat = dseed::color::pixelformat::r8; break;
-	default: return dseed::error_not_support;
+	default:
+		jpeg_destroy_decompress (&cinfo);
+		return dseed::error_not_support;
 	}
 
-	size_t stride = dseed::color::calc_bitmap_stride (pixelFormat, size.width);
+	return dseed::error_good;
+}
 
-	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
-	if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, size, pixelFormat, nullptr, &bitmap)))
-		return dseed::error_fail;
+// Reads scanlines of crop straight into target, then finishes decompression
+//  : Scanlines wider than crop go through a row buffer.
+//  : Caller destroys cinfo whether or not reading succeeded.
+dseed::error_t __read_jpeg_pixels (jpeg_decompress_struct& cinfo, const __jpeg_crop& crop, const __decode_target& target) noexcept
+{
+	if (crop.top > 0)
+		jpeg_skip_scanlines (&cinfo, crop.top);
 
-	uint8_t* ptr;
-	bitmap->lock ((void**)&ptr);
+	const size_t components = cinfo.output_components;
+	std::vector<JSAMPLE> scanline;
+	if (crop.width != cinfo.output_width)
+	{
+		try { scanline.resize (cinfo.output_width * components); }
+		catch (...) { return dseed::error_out_of_memory; }
+	}
 
-	while (cinfo.output_scanline < cinfo.output_height)
+	for (JDIMENSION y = 0; y < crop.height; ++y)
 	{
-		unsigned char* buffer_array[1];
-		buffer_array[0] = ptr + (cinfo.output_scanline * stride);
+		JSAMPROW buffer_array[1];
+		buffer_array[0] = scanline.empty () ? target.row (y) : scanline.data ();
 		if (jpeg_read_scanlines (&cinfo, buffer_array, 1) != 1)
-		{
-			jpeg_skip_scanlines (&cinfo, 1);
-			break;
-		}
+			return dseed::error_fail;
+		if (!scanline.empty ())
+			memcpy (target.row (y), scanline.data () + crop.left * components, crop.width * components);
 	}
 
-	bitmap->unlock ();
+	// Rows below region are never decoded
+	if (cinfo.output_scanline == cinfo.output_height)
+		jpeg_finish_decompress (&cinfo);
+
+	return dseed::error_good;
+}
+#endif
+
+dseed::error_t __create_jpeg_bitmap_decoder_internal (dseed::io::stream* stream, const dseed::bitmaps::jpeg_decoder_options& options,
+	dseed::bitmaps::bitmap_array** decoder)
+{
+#if defined(USE_JPEG)
+	if (stream == nullptr || decoder == nullptr)
+		return dseed::error_invalid_args;
+
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	__jpeg_crop crop;
+	dseed::size3i size;
+	dseed::color::pixelformat pixelFormat;
+	if (auto err = __start_jpeg_decompress (stream, options, cinfo, jerr, crop, size, pixelFormat); dseed::failed (err))
+		return err;
+
+	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
+	if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, size, pixelFormat, nullptr, &bitmap)))
+	{
+		jpeg_destroy_decompress (&cinfo);
+		return dseed::error_fail;
+	}
 
-	jpeg_finish_decompress (&cinfo);
+	auto err = __decode_into_bitmap (bitmap, [&](const __decode_target& target) { return __read_jpeg_pixels (cinfo, crop, target); });
 	jpeg_destroy_decompress (&cinfo);
+	if (dseed::failed (err))
+		return err;
 
 	return create_bitmap_array(dseed::bitmaps::arraytype::plain, bitmap, decoder);
 #else
@@ -139,10 +235,106 @@ dseed::error_t __create_jpeg_bitmap_decoder_internal (dseed::io::stream* stream,
 
 dseed::error_t dseed::bitmaps::create_jpeg_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
 {
-	return __create_jpeg_bitmap_decoder_internal (stream, false, decoder);
+	return __create_jpeg_bitmap_decoder_internal (stream, dseed::bitmaps::jpeg_decoder_options (), decoder);
 }
 
 dseed::error_t dseed::bitmaps::create_jpeg_bitmap_decoder_yuv (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
 {
-	return __create_jpeg_bitmap_decoder_internal (stream, true, decoder);
+	dseed::bitmaps::jpeg_decoder_options options;
+	options.yuv = true;
+	return __create_jpeg_bitmap_decoder_internal (stream, options, decoder);
+}
+
+dseed::error_t dseed::bitmaps::create_jpeg_bitmap_decoder_with_options (dseed::io::stream* stream,
+	const dseed::bitmaps::jpeg_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	return __create_jpeg_bitmap_decoder_internal (stream, options, decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_jpeg_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_JPEG)
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	uint8_t sig[3];
+	if (stream->read (sig, 3) != 3)
+		return dseed::error_fail;
+	stream->seek (dseed::io::seekorigin::begin, 0);
+
+	if (sig[0] != 0xff || sig[1] != 0xd8 || sig[2] != 0xff)
+		return dseed::error_fail;
+
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+
+	cinfo.err = jpeg_std_error (&jerr);
+	jerr.error_exit = [](j_common_ptr cinfo) {};
+	jpeg_create_decompress (&cinfo);
+
+	jpeg_stream_src (&cinfo, stream);
+
+	// Reads markers until SOS only, entropy-coded data is not touched
+	if (jpeg_read_header (&cinfo, 1) != JPEG_HEADER_OK)
+	{
+		jpeg_destroy_decompress (&cinfo);
+		return dseed::error_fail;
+	}
+	jpeg_calc_output_dimensions (&cinfo);
+
+	dseed::size3i size (cinfo.output_width, cinfo.output_height, 1);
+	dseed::color::pixelformat pixelFormat;
+	switch (cinfo.output_components)
+	{
+	case 3: pixelFormat = dseed::color::pixelformat::rgb8; break;
+	case 4: pixelFormat = dseed::color::pixelformat::rgba8; break;
+	case 1: pixelFormat = dseed::color::pixelformat::r8; break;
+	default:
+		jpeg_destroy_decompress (&cinfo);
+		return dseed::error_not_support;
+	}
+
+	jpeg_destroy_decompress (&cinfo);
+
+	*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, size, pixelFormat);
+	return dseed::error_good;
+#else
+	return dseed::error_not_support_file_format;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::decode_jpeg_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_JPEG)
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	__jpeg_crop crop;
+	dseed::size3i size;
+	dseed::color::pixelformat pixelFormat;
+	if (auto err = __start_jpeg_decompress (stream, dseed::bitmaps::jpeg_decoder_options (), cinfo, jerr, crop, size, pixelFormat);
+		dseed::failed (err))
+		return err;
+
+	__decode_target target;
+	if (auto err = __prepare_decode_target (pixelFormat, size, pixels, stride, length, target); dseed::failed (err))
+	{
+		jpeg_destroy_decompress (&cinfo);
+		return err;
+	}
+
+	auto err = __read_jpeg_pixels (cinfo, crop, target);
+	jpeg_destroy_decompress (&cinfo);
+	if (dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, size, pixelFormat);
+	return dseed::error_good;
+#else
+	return dseed::error_not_support_file_format;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include <dseed.h>
+
+#include <vector>
+
+#include "../../libs/DecodeTargetHelper.hxx"
+#include "../../libs/KTX2Helper.hxx"
+
+dseed::error_t __read_ktx2_header (dseed::io::stream* stream, KTX2Header& header, std::vector<KTX2LevelIndex>& levels,
+	dseed::color::pixelformat& format, dseed::bitmaps::bitmaptype& type, dseed::size3i& size) noexcept
+{
+	if (stream->read (&header, sizeof (header)) != sizeof (header))
+		return dseed::error_fail;
+
+	if (memcmp (header.identifier, KTX2FileIdentifier, 12) != 0)
+		return dseed::error_fail;
+
+	// Formats without Vulkan format(Basis Universal) need transcoder
+	auto found = __ktx2_find_format (header.vkFormat);
+	if (found == nullptr || !__ktx2_supercompression_supported (header.supercompressionScheme))
+		return dseed::error_not_support;
+	format = found->format;
+
+	if (header.pixelWidth == 0 || header.faceCount == 0)
+		return dseed::error_fail;
+	if (header.pixelHeight == 0)
+		header.pixelHeight = 1;
+	if (header.levelCount == 0)
+		header.levelCount = 1;
+	if (header.levelCount > 32)
+		return dseed::error_fail;
+
+	const uint32_t layers = header.layerCount == 0 ? 1 : header.layerCount;
+	type = dseed::bitmaps::bitmaptype::bitmap2d;
+	if (header.pixelDepth > 0)
+	{
+		if (layers > 1 || header.faceCount > 1)
+			return dseed::error_not_support;
+		type = dseed::bitmaps::bitmaptype::bitmap3d;
+		size = dseed::size3i (header.pixelWidth, header.pixelHeight, header.pixelDepth);
+	}
+	else
+	{
+		if (layers == 1 && header.faceCount == 6)
+			type = dseed::bitmaps::bitmaptype::bitmap2dcube;
+		else if (layers > 1)
+			type = dseed::bitmaps::bitmaptype::bitmap3d;
+		size = dseed::size3i (header.pixelWidth, header.pixelHeight, layers * header.faceCount);
+	}
+
+	// Level index follows header
+	try { levels.resize (header.levelCount); }
+	catch (...) { return dseed::error_out_of_memory; }
+	const size_t indexLength = sizeof (KTX2LevelIndex) * header.levelCount;
+	if (stream->read (levels.data (), indexLength) != indexLength)
+		return dseed::error_fail;
+
+	return dseed::error_good;
+}
+
+// Reads a mip level into target
+//  : Supercompressed level in blob stream is inflated from blob memory without reading.
+//  : Tightly packed rows of level data are spread to padded bitmap rows(rgb8, bgr8).
+dseed::error_t __read_ktx2_level (dseed::io::stream* stream, const KTX2Header& header, const KTX2LevelIndex& level,
+	size_t width, const __decode_target& bitmapTarget) noexcept
+{
+	__decode_target target = bitmapTarget;
+	target.rowBytes = __ktx2_row_bytes (*__ktx2_find_format (header.vkFormat), width, bitmapTarget.rowBytes);
+
+	if (header.supercompressionScheme == KTX2_SUPERCOMPRESSION_NONE)
+	{
+		if (!stream->seek (dseed::io::seekorigin::begin, (size_t)level.byteOffset))
+			return dseed::error_io;
+		return __read_decode_target (stream, target);
+	}
+
+	const size_t total = target.rowBytes * target.rows * target.depth;
+	if (level.uncompressedByteLength != total)
+		return dseed::error_fail;
+
+	const uint8_t* compressed = nullptr;
+	dseed::autoref<dseed::blob> blob;
+	std::vector<uint8_t> read;
+	if (auto blobStream = dynamic_cast<dseed::io::blobstream*> (stream); blobStream != nullptr
+		&& dseed::succeeded (blobStream->blob (&blob)) && level.byteOffset + level.byteLength <= blob->size ())
+	{
+		compressed = (const uint8_t*)blob->ptr () + level.byteOffset;
+	}
+	else
+	{
+		try { read.resize ((size_t)level.byteLength); }
+		catch (...) { return dseed::error_out_of_memory; }
+		if (!stream->seek (dseed::io::seekorigin::begin, (size_t)level.byteOffset)
+			|| stream->read (read.data (), read.size ()) != read.size ())
+			return dseed::error_io;
+		compressed = read.data ();
+	}
+
+	if (target.packed ())
+		return __ktx2_decompress (header.supercompressionScheme, compressed, (size_t)level.byteLength, target.pixels, total)
+			? dseed::error_good : dseed::error_fail;
+
+	std::vector<uint8_t> temp;
+	try { temp.resize (total); }
+	catch (...) { return dseed::error_out_of_memory; }
+	if (!__ktx2_decompress (header.supercompressionScheme, compressed, (size_t)level.byteLength, temp.data (), total))
+		return dseed::error_fail;
+	for (size_t z = 0; z < target.depth; ++z)
+		for (size_t y = 0; y < target.rows; ++y)
+			memcpy (target.row (y, z), temp.data () + ((z * target.rows) + y) * target.rowBytes, target.rowBytes);
+
+	return dseed::error_good;
+}
+
+class __ktx2_frame_loader : public dseed::bitmaps::bitmap_frame_loader
+{
+public:
+	__ktx2_frame_loader (dseed::io::stream* stream, const KTX2Header& header, std::vector<KTX2LevelIndex>&& levels,
+		size_t baseLevel, dseed::color::pixelformat format, dseed::bitmaps::bitmaptype type, const dseed::size3i& size)
+		: _refCount (1), _stream (stream), _header (header), _levels (std::move (levels)), _baseLevel (baseLevel)
+		, _format (format), _type (type), _size (size)
+	{ }
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t load (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		const size_t levelIndex = _baseLevel + index;
+		if (levelIndex >= _levels.size ())
+			return dseed::error_io;
+
+		const auto& level = _levels[levelIndex];
+		const dseed::size3i currentSize = __ktx2_level_size (_size, levelIndex, _header.pixelDepth > 0);
+
+		// Blob memory can be referenced only if level data rows are laid out as bitmap rows
+		if (_header.supercompressionScheme == KTX2_SUPERCOMPRESSION_NONE
+			&& __ktx2_level_length (*__ktx2_find_format (_header.vkFormat), currentSize) == dseed::color::calc_bitmap_total_size (_format, currentSize)
+			&& dseed::succeeded (__reference_blob_bitmap (_stream, (size_t)level.byteOffset, _type, currentSize, _format, bitmap)))
+			return dseed::error_good;
+
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed (dseed::bitmaps::create_bitmap (_type, currentSize, _format, nullptr, &temp)))
+			return dseed::error_fail;
+
+		if (auto err = __decode_into_bitmap (temp, [&](const __decode_target& target) { return __read_ktx2_level (_stream, _header, level, currentSize.width, target); });
+			dseed::failed (err))
+			return err;
+
+		*bitmap = temp.detach ();
+		return dseed::error_good;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::stream> _stream;
+	KTX2Header _header;
+	std::vector<KTX2LevelIndex> _levels;
+	size_t _baseLevel;
+	dseed::color::pixelformat _format;
+	dseed::bitmaps::bitmaptype _type;
+	dseed::size3i _size;
+};
+
+dseed::error_t dseed::bitmaps::create_ktx2_bitmap_decoder_with_options (dseed::io::stream* stream,
+	const dseed::bitmaps::ktx2_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	if (stream == nullptr || decoder == nullptr || options.base_level < 0 || options.level_count < 0)
+		return dseed::error_invalid_args;
+
+	KTX2Header header;
+	std::vector<KTX2LevelIndex> levels;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	dseed::size3i size;
+	if (auto err = __read_ktx2_header (stream, header, levels, format, type, size); dseed::failed (err))
+		return err;
+
+	const size_t baseLevel = (size_t)options.base_level;
+	if (baseLevel >= header.levelCount)
+		return dseed::error_out_of_range;
+	size_t levelCount = header.levelCount - baseLevel;
+	if (options.level_count > 0)
+		levelCount = dseed::minimum (levelCount, (size_t)options.level_count);
+
+	// Only requested levels are read, each on first access
+	dseed::autoref<dseed::bitmaps::bitmap_frame_loader> loader;
+	loader.attach (new __ktx2_frame_loader (stream, header, std::move (levels), baseLevel, format, type, size));
+	if (loader == nullptr)
+		return dseed::error_out_of_memory;
+
+	return create_lazy_bitmap_array (arraytype::mipmap, levelCount, loader, levelCount, decoder);
+}
+
+dseed::error_t dseed::bitmaps::create_ktx2_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	return create_ktx2_bitmap_decoder_with_options (stream, dseed::bitmaps::ktx2_decoder_options (), decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_ktx2_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	KTX2Header header;
+	std::vector<KTX2LevelIndex> levels;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	dseed::size3i size;
+	if (auto err = __read_ktx2_header (stream, header, levels, format, type, size); dseed::failed (err))
+		return err;
+
+	*info = dseed::bitmaps::bitmap_info (type, size, format, arraytype::mipmap, header.levelCount);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_ktx2_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	KTX2Header header;
+	std::vector<KTX2LevelIndex> levels;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	dseed::size3i size;
+	if (auto err = __read_ktx2_header (stream, header, levels, format, type, size); dseed::failed (err))
+		return err;
+
+	// Top mip level, which is last in file
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	if (auto err = __read_ktx2_level (stream, header, levels[0], size.width, target); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (type, size, format, arraytype::mipmap, header.levelCount);
+	return dseed::error_good;
+}
@@ -1,5 +1,7 @@
 #include <dseed.h>
 
+#include "../../libs/DecodeTargetHelper.hxx"
+
 struct KTXHeader
 {
 	uint8_t identifier[12];
@@ -80,15 +82,17 @@ const uint8_t KTXFileIdentifier[12] = {
 #define GL_UNSIGNED_INT								0x1405
 #define GL_FLOAT									0x1406
 
-dseed::error_t dseed::bitmaps::create_ktx_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+// cubeFaces tells whether imageSize of each level covers one face only(non-array cubemap)
+dseed::error_t __read_ktx_header (dseed::io::stream* stream, KTXHeader& header, dseed::color::pixelformat& format,
+	dseed::bitmaps::bitmaptype& type, bool* cubeFaces = nullptr) noexcept
 {
-	KTXHeader header;
-	stream->read (&header, sizeof (header));
+	if (stream->read (&header, sizeof (header)) != sizeof (header))
+		return dseed::error_fail;
 
 	if (memcmp (header.identifier, KTXFileIdentifier, 12) != 0)
 		return dseed::error_fail;
 
-	dseed::color::pixelformat format;
+	format = dseed::color::pixelformat::unknown;
 	if (header.glType == 0)	//< Compressed Texture
 	{
 		switch (header.glInternalFormat)
@@ -153,52 +157,218 @@ dseed::error_t dseed::bitmaps::create_ktx_bitmap_decoder (dseed::io::stream* str
 			break;
 		}
 	}
+	if (format == dseed::color::pixelformat::unknown)
+		return dseed::error_not_support;
 
 	if (header.numberOfMipmapLevels == 0)
 	{
 		header.numberOfMipmapLevels = 1;
 	}
+	if (cubeFaces != nullptr)
+		*cubeFaces = header.numberOfArrayElements == 0 && header.numberOfFaces == 6;
 	if (header.numberOfArrayElements == 0)
 		header.numberOfArrayElements = 1;
 	if (header.numberOfFaces == 0)
 		header.numberOfFaces = 1;
 
-	dseed::bitmaps::bitmaptype type = dseed::bitmaps::bitmaptype::bitmap2d;
+	type = dseed::bitmaps::bitmaptype::bitmap2d;
 	if (header.numberOfArrayElements == 1 && header.numberOfFaces == 6)
 		type = dseed::bitmaps::bitmaptype::bitmap2dcube;
 	else if (header.numberOfArrayElements > 1 && header.numberOfFaces == 1)
 		type = dseed::bitmaps::bitmaptype::bitmap3d;
 
-	dseed::size3i size (header.pixelWidth, header.pixelHeight, header.numberOfArrayElements * header.numberOfFaces);
-
-	size_t imageOffset = sizeof (header) + header.bytesOfKeyValueData + 4;
-	stream->seek (dseed::io::seekorigin::begin, imageOffset);
+	return dseed::error_good;
+}
 
-	std::vector<dseed::bitmaps::bitmap*> bitmaps (header.numberOfMipmapLevels);
-	for (uint32_t mipLevel = 0; mipLevel < header.numberOfMipmapLevels; ++mipLevel)
+// Reads a mip level, 32-bit words of opposite-endian file are swapped
+//  : Rows in file are laid out as library bitmap rows, padding is bytes skipped after each row.
+//  : Non-zero faceStride reads each face of non-array cubemap from its own 4-byte aligned offset.
+dseed::error_t __read_ktx_level (dseed::io::stream* stream, size_t offset, bool reversed, const __decode_target& target,
+	size_t padding, size_t faceStride = 0) noexcept
+{
+	if (faceStride != 0)
 	{
-		dseed::size3i currentSize = dseed::color::calc_mipmap_size (mipLevel, size, false);
-		size_t imageSize = dseed::color::calc_bitmap_total_size (format, currentSize);
-		std::vector<uint8_t> pixels (imageSize);
-		size_t read = stream->read (pixels.data (), imageSize);
+		for (size_t z = 0; z < target.depth; ++z)
+		{
+			__decode_target face = target;
+			face.pixels = target.row (0, z);
+			face.depth = 1;
+			if (auto err = __read_ktx_level (stream, offset + z * faceStride, reversed, face, padding); dseed::failed (err))
+				return err;
+		}
+		return dseed::error_good;
+	}
+
+	if (!stream->seek (dseed::io::seekorigin::begin, offset))
+		return dseed::error_io;
 
-		if (header.endianness == KTX_ENDIAN_REF_REV)
+	if (auto err = __read_decode_target (stream, target, false, padding); dseed::failed (err))
+		return err;
+
+	if (reversed)
+	{
+		for (size_t z = 0; z < target.depth; ++z)
 		{
-			for (int i = 0; i < pixels.size (); i += 4)
+			for (size_t y = 0; y < target.rows; ++y)
 			{
-				uint8_t a = pixels[i + 0], b = pixels[i + 1], c = pixels[i + 2], d = pixels[i + 3];
-				pixels[i + 0] = d; pixels[i + 1] = c; pixels[i + 2] = b; pixels[i + 3] = a;
+				uint8_t* pixels = target.row (y, z);
+				for (size_t i = 0; i + 4 <= target.rowBytes; i += 4)
+				{
+					uint8_t a = pixels[i + 0], b = pixels[i + 1], c = pixels[i + 2], d = pixels[i + 3];
+					pixels[i + 0] = d; pixels[i + 1] = c; pixels[i + 2] = b; pixels[i + 3] = a;
+				}
 			}
 		}
+	}
+
+	return dseed::error_good;
+}
+
+class __ktx_frame_loader : public dseed::bitmaps::bitmap_frame_loader
+{
+public:
+	__ktx_frame_loader (dseed::io::stream* stream, const KTXHeader& header, bool cubeFaces, dseed::color::pixelformat format, dseed::bitmaps::bitmaptype type)
+		: _refCount (1), _stream (stream), _format (format), _type (type)
+		, _size (header.pixelWidth, header.pixelHeight, header.numberOfArrayElements * header.numberOfFaces)
+		, _reversed (header.endianness == KTX_ENDIAN_REF_REV)
+	{
+		// Each mip level is led by its imageSize, so only 4 bytes are read per level here
+		//  : imageSize of non-array cubemap is of one face, and each face is padded to 4 bytes.
+		size_t offset = sizeof (header) + header.bytesOfKeyValueData;
+		for (uint32_t mipLevel = 0; mipLevel < header.numberOfMipmapLevels; ++mipLevel)
+		{
+			uint32_t imageSize = 0;
+			if (!stream->seek (dseed::io::seekorigin::begin, offset) || 4 != stream->read (&imageSize, 4))
+				break;
+			if (_reversed)
+				imageSize = (imageSize >> 24) | ((imageSize >> 8) & 0xff00) | ((imageSize << 8) & 0xff0000) | (imageSize << 24);
+
+			const size_t paddedSize = ((size_t)imageSize + 3) & ~(size_t)3;
+			_offsets.push_back (offset + 4);
+			_faceStrides.push_back (cubeFaces ? paddedSize : 0);
+			offset += 4 + (cubeFaces ? header.numberOfFaces * paddedSize : paddedSize);
+		}
+	}
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t load (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		if (index >= _offsets.size ())
+			return dseed::error_io;
+
+		dseed::size3i currentSize = dseed::color::calc_mipmap_size ((int)index, _size, false);
 
-		if (dseed::failed (dseed::bitmaps::create_bitmap (type, currentSize, format, nullptr, &bitmaps[mipLevel])))
+		// Faces without padding between them are read as one
+		size_t faceStride = _faceStrides[index];
+		if (faceStride == dseed::color::calc_bitmap_plane_size (_format, dseed::size2i (currentSize.width, currentSize.height)))
+			faceStride = 0;
+
+		// Opposite-endian levels need swapping, others are referenced in place
+		if (!_reversed && faceStride == 0
+			&& dseed::succeeded (__reference_blob_bitmap (_stream, _offsets[index], _type, currentSize, _format, bitmap)))
+			return dseed::error_good;
+
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed (dseed::bitmaps::create_bitmap (_type, currentSize, _format, nullptr, &temp)))
 			return dseed::error_fail;
 
-		void* ptr;
-		bitmaps[mipLevel]->lock (&ptr);
-		memcpy (ptr, pixels.data (), pixels.size ());
-		bitmaps[mipLevel]->unlock ();
+		if (auto err = __decode_into_bitmap (temp, [&](const __decode_target& target) { return __read_ktx_level (_stream, _offsets[index], _reversed, target,
+			__bitmap_row_padding (_format, currentSize.width, target), faceStride); });
+			dseed::failed (err))
+			return err;
+
+		*bitmap = temp.detach ();
+		return dseed::error_good;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::stream> _stream;
+	dseed::color::pixelformat _format;
+	dseed::bitmaps::bitmaptype _type;
+	dseed::size3i _size;
+	bool _reversed;
+	std::vector<size_t> _offsets;
+	std::vector<size_t> _faceStrides;
+};
+
+dseed::error_t dseed::bitmaps::create_ktx_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	KTXHeader header;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	bool cubeFaces;
+	if (auto err = __read_ktx_header (stream, header, format, type, &cubeFaces); dseed::failed (err))
+		return err;
+
+	// Each mip level is read from stream on first access
+	dseed::autoref<dseed::bitmaps::bitmap_frame_loader> loader;
+	loader.attach (new __ktx_frame_loader (stream, header, cubeFaces, format, type));
+	if (loader == nullptr)
+		return dseed::error_out_of_memory;
+
+	return create_lazy_bitmap_array (arraytype::mipmap, header.numberOfMipmapLevels, loader, header.numberOfMipmapLevels, decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_ktx_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	KTXHeader header;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	if (auto err = __read_ktx_header (stream, header, format, type); dseed::failed (err))
+		return err;
+
+	*info = dseed::bitmaps::bitmap_info (type, dseed::size3i (header.pixelWidth, header.pixelHeight, header.numberOfArrayElements * header.numberOfFaces),
+		format, arraytype::mipmap, header.numberOfMipmapLevels);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_ktx_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	KTXHeader header;
+	dseed::color::pixelformat format;
+	dseed::bitmaps::bitmaptype type;
+	bool cubeFaces;
+	if (auto err = __read_ktx_header (stream, header, format, type, &cubeFaces); dseed::failed (err))
+		return err;
+
+	// Top mip level, skipping its imageSize
+	const dseed::size3i size (header.pixelWidth, header.pixelHeight, header.numberOfArrayElements * header.numberOfFaces);
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	// Faces of non-array cubemap are padded to 4 bytes one by one
+	size_t faceStride = 0;
+	if (cubeFaces)
+	{
+		const size_t faceSize = dseed::color::calc_bitmap_plane_size (format, dseed::size2i (size.width, size.height));
+		if ((faceSize & 3) != 0)
+			faceStride = (faceSize + 3) & ~(size_t)3;
 	}
 
-	return create_bitmap_array(arraytype::mipmap, bitmaps, decoder);
+	if (auto err = __read_ktx_level (stream, sizeof (header) + header.bytesOfKeyValueData + 4,
+		header.endianness == KTX_ENDIAN_REF_REV, target, __bitmap_row_padding (format, size.width, target), faceStride); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (type, size, format, arraytype::mipmap, header.numberOfMipmapLevels);
+	return dseed::error_good;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include <dseed.h>
 
+#include "../../libs/DecodeTargetHelper.hxx"
+
 #define PKM_HEADER_SIZE 16
 
 #if COMPILER_MSVC
@@ -26,31 +28,76 @@ struct PKMHeader
 #	pragma pack ()
 #endif
 
-dseed::error_t dseed::bitmaps::create_pkm_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+dseed::error_t __read_pkm_header (dseed::io::stream* stream, int& width, int& height) noexcept
 {
 	PKMHeader header;
-	stream->read (&header, sizeof (header));
+	if (stream->read (&header, sizeof (header)) != sizeof (header))
+		return dseed::error_fail;
 
 	if (strcmp (header.aName, "PKM 10") != 0)
 		return dseed::error_fail;
 
-	int width = (header.iWidthMSB << 8) | header.iWidthLSB;
-	int height = (header.iHeightMSB << 8) | header.iHeightLSB;
+	width = (header.iWidthMSB << 8) | header.iWidthLSB;
+	height = (header.iHeightMSB << 8) | header.iHeightLSB;
 
-	size_t totalSize = dseed::color::calc_bitmap_total_size (dseed::color::pixelformat::etc1, dseed::size3i (width, height, 1));
-	std::vector<uint8_t> pixels (totalSize);
+	return dseed::error_good;
+}
 
-	stream->read (pixels.data (), totalSize);
+dseed::error_t dseed::bitmaps::create_pkm_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	int width, height;
+	if (auto err = __read_pkm_header (stream, width, height); dseed::failed (err))
+		return err;
 
 	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
+	if (dseed::succeeded (__reference_blob_bitmap (stream, stream->position (), bitmaptype::bitmap2d, dseed::size3i (width, height, 1),
+		dseed::color::pixelformat::etc1, &bitmap)))
+		return create_bitmap_array (arraytype::mipmap, bitmap, decoder);
+
 	if (dseed::failed (dseed::bitmaps::create_bitmap (bitmaptype::bitmap2d, dseed::size3i (width, height, 1),
 		dseed::color::pixelformat::etc1, nullptr, &bitmap)))
 		return dseed::error_fail;
 
-	void* ptr;
-	bitmap->lock (&ptr);
-	memcpy (ptr, pixels.data (), pixels.size ());
-	bitmap->unlock ();
+	if (auto err = __decode_into_bitmap (bitmap, [&](const __decode_target& target) { return __read_decode_target (stream, target); });
+		dseed::failed (err))
+		return err;
 
 	return create_bitmap_array(arraytype::mipmap, bitmap, decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_pkm_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	int width, height;
+	if (auto err = __read_pkm_header (stream, width, height); dseed::failed (err))
+		return err;
+
+	*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, dseed::size3i (width, height, 1),
+		dseed::color::pixelformat::etc1, arraytype::mipmap, 1);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_pkm_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	int width, height;
+	if (auto err = __read_pkm_header (stream, width, height); dseed::failed (err))
+		return err;
+
+	const dseed::size3i size (width, height, 1);
+	__decode_target target;
+	if (auto err = __prepare_decode_target (dseed::color::pixelformat::etc1, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	if (auto err = __read_decode_target (stream, target); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, size, dseed::color::pixelformat::etc1, arraytype::mipmap, 1);
+	return dseed::error_good;
 }
\ No newline at end of file
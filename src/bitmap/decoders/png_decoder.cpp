@@ -4,56 +4,28 @@
 #	include <png.h>
 #endif
 
+#include "../../libs/DecodeTargetHelper.hxx"
+
 constexpr int PNG_BYTES_TO_CHECK = 8;
 
-dseed::error_t dseed::bitmaps::create_png_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
-{
 #if defined(USE_PNG)
-	if (stream == nullptr || decoder == nullptr)
-		return dseed::error_invalid_args;
-
-	png_byte pngsig[PNG_BYTES_TO_CHECK];
-	if (PNG_BYTES_TO_CHECK != stream->read (pngsig, PNG_BYTES_TO_CHECK))
-		return dseed::error_invalid_args;
-
-	if (0 != png_sig_cmp (pngsig, (png_size_t)0, PNG_BYTES_TO_CHECK))
-		return dseed::error_invalid_args;
-
-	png_structp png = png_create_read_struct (PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-	if (png == nullptr)
-		return dseed::error_out_of_memory;
-	png_infop info = png_create_info_struct (png);
-	if (info == nullptr)
-	{
-		png_destroy_read_struct (&png, nullptr, nullptr);
-		return dseed::error_out_of_memory;
-	}
+// libpng read state, destroyed with reader
+struct __png_reader
+{
+	png_structp png = nullptr;
+	png_infop info = nullptr;
 
-	if (setjmp (png_jmpbuf (png)))
+	~__png_reader ()
 	{
-		png_destroy_read_struct (&png, nullptr, nullptr);
-		return dseed::error_out_of_memory;
+		if (png != nullptr)
+			png_destroy_read_struct (&png, info != nullptr ? &info : nullptr, nullptr);
 	}
+};
 
-	png_set_read_fn (png, stream, [](png_structp png, png_bytep buf, size_t size)
-		{
-			reinterpret_cast<dseed::io::stream*> (png_get_io_ptr (png))->read (buf, size);
-		});
-
-	png_set_crc_action (png, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
-	png_set_check_for_invalid_index (png, 0);
-	png_set_keep_unknown_chunks (png, PNG_HANDLE_CHUNK_ALWAYS, nullptr, 0);
-	png_set_benign_errors (png, 1);
-
-	png_voidp user_chunkp = png_get_user_chunk_ptr (png);
-	png_set_read_user_chunk_fn (png, user_chunkp, [](png_structp png, png_unknown_chunkp chunk)
-		{
-			return 1;
-		});
-
-	png_set_sig_bytes (png, PNG_BYTES_TO_CHECK);
-	png_read_info (png, info);
-
+// Expands palette and low bit depth to 8-bit channels, format is decoded pixel format
+//  : Must be called after png_read_info, under caller's error handler.
+dseed::error_t __set_png_transforms (png_structp png, png_infop info, dseed::size3i& size, dseed::color::pixelformat& format) noexcept
+{
 	auto colorType = png_get_color_type (png, info);
 	switch (colorType)
 	{
@@ -78,15 +50,15 @@ dseed::error_t dseed::bitmaps::create_png_bitmap_decoder (dseed::io::stream* str
 	if (bitDepth == 16)
 		png_set_strip_16 (png);
 
+	png_set_interlace_handling (png);
 	png_read_update_info (png, info);
 
-	dseed::size3i size (png_get_image_width (png, info), png_get_image_height (png, info), 1);
+	size = dseed::size3i (png_get_image_width (png, info), png_get_image_height (png, info), 1);
 
 	bitDepth = png_get_bit_depth (png, info);
 	colorType = png_get_color_type (png, info);
 	auto channels = png_get_channels (png, info);
 
-	dseed::color::pixelformat format;
 	switch (channels)
 	{
 	case 1:
@@ -101,20 +73,14 @@ dseed::error_t dseed::bitmaps::create_png_bitmap_decoder (dseed::io::stream* str
 				format = dseed::color::pixelformat::bgr8_indexed8;
 		}
 		else
-		{
-			png_destroy_read_struct (&png, nullptr, nullptr);
 			return dseed::error_not_support;
-		}
 		break;
 
 	case 2:
 		if (colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
 			format = dseed::color::pixelformat::ra8;
 		else
-		{
-			png_destroy_read_struct(&png, nullptr, nullptr);
 			return dseed::error_not_support;
-		}
 		break;
 
 	case 3:
@@ -125,25 +91,267 @@ dseed::error_t dseed::bitmaps::create_png_bitmap_decoder (dseed::io::stream* str
 		if (bitDepth == 8)
 			format = dseed::color::pixelformat::rgba8;
 		else
-		{
-			png_destroy_read_struct (&png, nullptr, nullptr);
 			return dseed::error_not_support;
-		}
 		break;
 
 	default:
-		png_destroy_read_struct (&png, nullptr, nullptr);
 		return dseed::error_not_support;
 	}
 
-	size_t stride = dseed::color::calc_bitmap_stride (format, size.width);
-	size_t totalBytes = stride * size.height;
+	return dseed::error_good;
+}
+
+// Reads header and sets up transforms, format is decoded pixel format
+dseed::error_t __read_png_header (dseed::io::stream* stream, __png_reader& reader, dseed::size3i& size,
+	dseed::color::pixelformat& format) noexcept
+{
+	png_byte pngsig[PNG_BYTES_TO_CHECK];
+	if (PNG_BYTES_TO_CHECK != stream->read (pngsig, PNG_BYTES_TO_CHECK))
+		return dseed::error_invalid_args;
+
+	if (0 != png_sig_cmp (pngsig, (png_size_t)0, PNG_BYTES_TO_CHECK))
+		return dseed::error_invalid_args;
+
+	png_structp png = reader.png = png_create_read_struct (PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	if (png == nullptr)
+		return dseed::error_out_of_memory;
+	png_infop info = reader.info = png_create_info_struct (png);
+	if (info == nullptr)
+		return dseed::error_out_of_memory;
+
+	if (setjmp (png_jmpbuf (png)))
+		return dseed::error_out_of_memory;
+
+	png_set_read_fn (png, stream, [](png_structp png, png_bytep buf, size_t size)
+		{
+			reinterpret_cast<dseed::io::stream*> (png_get_io_ptr (png))->read (buf, size);
+		});
+
+	png_set_crc_action (png, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
+	png_set_check_for_invalid_index (png, 0);
+	png_set_keep_unknown_chunks (png, PNG_HANDLE_CHUNK_ALWAYS, nullptr, 0);
+	png_set_benign_errors (png, 1);
+
+	png_voidp user_chunkp = png_get_user_chunk_ptr (png);
+	png_set_read_user_chunk_fn (png, user_chunkp, [](png_structp png, png_unknown_chunkp chunk)
+		{
+			return 1;
+		});
+
+	png_set_sig_bytes (png, PNG_BYTES_TO_CHECK);
+	png_read_info (png, info);
+
+	return __set_png_transforms (png, info, size, format);
+}
+
+// Reads every row straight into target
+dseed::error_t __read_png_pixels (__png_reader& reader, const __decode_target& target) noexcept
+{
+	std::vector<png_bytep> rows (target.rows);
+	for (size_t y = 0; y < target.rows; ++y)
+		rows[y] = target.row (y);
+
+	if (setjmp (png_jmpbuf (reader.png)))
+		return dseed::error_fail;
+
+	png_read_image (reader.png, rows.data ());
+	return dseed::error_good;
+}
+#endif
+
+#if defined(USE_PNG)
+// Streaming decoder on libpng progressive reader
+//  : Rows of interlaced image are combined in image buffer, then sent when no later pass touches them.
+class __png_stream_decoder : public dseed::bitmaps::bitmap_stream_decoder
+{
+public:
+	__png_stream_decoder (dseed::bitmaps::bitmap_row_sink* sink)
+		: _refCount (1), _sink (sink), _result (dseed::error_good), _completed (false)
+		, _rowBytes (0), _height (0), _width (0), _emitted (0)
+	{ }
+
+	dseed::error_t initialize () noexcept
+	{
+		// Abort by row sink is normal cancel, so errors and warnings are not printed
+		_reader.png = png_create_read_struct (PNG_LIBPNG_VER_STRING, nullptr,
+			[](png_structp png, png_const_charp) { png_longjmp (png, 1); },
+			[](png_structp, png_const_charp) { });
+		if (_reader.png == nullptr)
+			return dseed::error_out_of_memory;
+		_reader.info = png_create_info_struct (_reader.png);
+		if (_reader.info == nullptr)
+			return dseed::error_out_of_memory;
+
+		if (setjmp (png_jmpbuf (_reader.png)))
+			return dseed::error_fail;
+
+		png_set_crc_action (_reader.png, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
+		png_set_check_for_invalid_index (_reader.png, 0);
+		png_set_benign_errors (_reader.png, 1);
+		png_set_progressive_read_fn (_reader.png, this, info_callback, row_callback, end_callback);
+
+		return dseed::error_good;
+	}
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t push (const void* data, size_t length) noexcept override
+	{
+		if (data == nullptr && length > 0)
+			return dseed::error_invalid_args;
+		if (dseed::failed (_result))
+			return _result;
+		if (_completed || length == 0)
+			return dseed::error_good;
+
+		if (setjmp (png_jmpbuf (_reader.png)))
+		{
+			if (dseed::succeeded (_result))
+				_result = dseed::error_fail;
+			return _result;
+		}
+
+		png_process_data (_reader.png, _reader.info, (png_bytep)data, length);
+		return _result;
+	}
+
+	virtual bool completed () noexcept override { return _completed; }
+
+private:
+	// Stops libpng by its error path; called only from callbacks
+	void abort (dseed::error_t err) noexcept
+	{
+		_result = err;
+		png_error (_reader.png, "stopped by row sink");
+	}
+
+	bool allocate_image () noexcept
+	{
+		try { _image.resize (_rowBytes * _height); }
+		catch (...) { return false; }
+		return true;
+	}
+
+	// Adam7 pass which writes row last
+	int last_pass (size_t y) const noexcept
+	{
+		static const int startRow[] = { 0, 0, 4, 0, 2, 0, 1 }, rowStep[] = { 8, 8, 8, 4, 4, 2, 2 }, startColumn[] = { 0, 4, 0, 2, 0, 1, 0 };
+		for (int pass = 6; pass > 0; --pass)
+			if (y >= (size_t)startRow[pass] && (y - startRow[pass]) % rowStep[pass] == 0 && _width > (size_t)startColumn[pass])
+				return pass;
+		return 0;
+	}
+
+	// Sends finished rows in top-down order
+	dseed::error_t flush (int pass, size_t received) noexcept
+	{
+		for (; _emitted < _height; ++_emitted)
+		{
+			const int last = last_pass (_emitted);
+			if (last > pass || (last == pass && _emitted > received))
+				break;
+			if (auto err = _sink->row (_emitted, _image.data () + _emitted * _rowBytes, _rowBytes); dseed::failed (err))
+				return err;
+		}
+		return dseed::error_good;
+	}
+
+	static void info_callback (png_structp png, png_infop info)
+	{
+		auto self = reinterpret_cast<__png_stream_decoder*> (png_get_progressive_ptr (png));
+
+		dseed::size3i size;
+		dseed::color::pixelformat format;
+		if (auto err = __set_png_transforms (png, info, size, format); dseed::failed (err))
+			self->abort (err);
+
+		self->_width = size.width;
+		self->_height = size.height;
+		self->_rowBytes = png_get_rowbytes (png, info);
+		if (png_get_interlace_type (png, info) != PNG_INTERLACE_NONE && !self->allocate_image ())
+			self->abort (dseed::error_out_of_memory);
+
+		if (auto err = self->_sink->begin (dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, size, format)); dseed::failed (err))
+			self->abort (err);
+	}
+
+	static void row_callback (png_structp png, png_bytep row, png_uint_32 rowNumber, int pass)
+	{
+		auto self = reinterpret_cast<__png_stream_decoder*> (png_get_progressive_ptr (png));
+		if (row == nullptr)
+			return;
+
+		dseed::error_t err;
+		if (self->_image.empty ())
+			err = self->_sink->row (rowNumber, row, self->_rowBytes);
+		else
+		{
+			png_progressive_combine_row (png, self->_image.data () + rowNumber * self->_rowBytes, row);
+			err = self->flush (pass, rowNumber);
+		}
+
+		if (dseed::failed (err))
+			self->abort (err);
+	}
+
+	static void end_callback (png_structp png, png_infop info)
+	{
+		auto self = reinterpret_cast<__png_stream_decoder*> (png_get_progressive_ptr (png));
+
+		dseed::error_t err = dseed::error_good;
+		if (!self->_image.empty ())
+			err = self->flush (6, self->_height);
+		if (dseed::succeeded (err))
+			err = self->_sink->end ();
+		if (dseed::failed (err))
+			self->abort (err);
+
+		self->_completed = true;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	__png_reader _reader;
+	dseed::autoref<dseed::bitmaps::bitmap_row_sink> _sink;
+	dseed::error_t _result;
+	bool _completed;
+
+	size_t _rowBytes, _height, _width;
+	std::vector<uint8_t> _image;
+	size_t _emitted;
+};
+#endif
+
+dseed::error_t dseed::bitmaps::create_png_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+#if defined(USE_PNG)
+	if (stream == nullptr || decoder == nullptr)
+		return dseed::error_invalid_args;
+
+	__png_reader reader;
+	dseed::size3i size;
+	dseed::color::pixelformat format;
+	if (auto err = __read_png_header (stream, reader, size, format); dseed::failed (err))
+		return err;
+
+	png_structp png = reader.png;
+	png_infop info = reader.info;
 
 	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
 	if (format == dseed::color::pixelformat::rgba8 || format == dseed::color::pixelformat::rgb8 ||
 		format == dseed::color::pixelformat::r8 || format == dseed::color::pixelformat::ra8)
 	{
-		create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, size, format, nullptr, &bitmap);
+		if (dseed::failed (create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, size, format, nullptr, &bitmap)))
+			return dseed::error_fail;
 	}
 	else if (format == dseed::color::pixelformat::bgr8_indexed8 || format == dseed::color::pixelformat::bgra8_indexed8)
 	{
@@ -197,24 +405,123 @@ dseed::error_t dseed::bitmaps::create_png_bitmap_decoder (dseed::io::stream* str
 		}
 	}
 
-	uint8_t* ptr;
-	if (dseed::failed (bitmap->lock ((void**)&ptr)))
-		return dseed::error_fail;
+	if (auto err = __decode_into_bitmap (bitmap, [&](const __decode_target& target) { return __read_png_pixels (reader, target); });
+		dseed::failed (err))
+		return err;
+
+	return create_bitmap_array(arraytype::plain, bitmap, decoder);
+#else
+	return dseed::error_not_support;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::probe_png_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_PNG)
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	png_byte pngsig[PNG_BYTES_TO_CHECK];
+	if (PNG_BYTES_TO_CHECK != stream->read (pngsig, PNG_BYTES_TO_CHECK))
+		return dseed::error_invalid_args;
+
+	if (0 != png_sig_cmp (pngsig, (png_size_t)0, PNG_BYTES_TO_CHECK))
+		return dseed::error_invalid_args;
+
+	// Walk chunks without libpng until IDAT; only IHDR and tRNS are needed
+	png_byte ihdr[8 + 13];
+	if (sizeof (ihdr) != stream->read (ihdr, sizeof (ihdr)) || memcmp (ihdr + 4, "IHDR", 4) != 0)
+		return dseed::error_not_support_file_format;
 
-	std::vector<png_bytep> rows;
-	rows.resize (size.height);
-	for (size_t i = 0; i < size.height; ++i)
+	const png_uint_32 width = png_get_uint_32 (ihdr + 8);
+	const png_uint_32 height = png_get_uint_32 (ihdr + 12);
+	const png_byte colorType = ihdr[17];
+	if (!stream->seek (dseed::io::seekorigin::current, png_get_uint_32 (ihdr) - 13 + 4))
+		return dseed::error_io;
+
+	bool hasTransparency = false;
+	while (true)
 	{
-		png_uint_32 q = (uint32_t)(i * stride);
-		rows[i] = ptr + (i * stride);
+		png_byte chunk[8];
+		if (sizeof (chunk) != stream->read (chunk, sizeof (chunk)))
+			return dseed::error_io;
+		if (memcmp (chunk + 4, "IDAT", 4) == 0 || memcmp (chunk + 4, "IEND", 4) == 0)
+			break;
+		if (memcmp (chunk + 4, "tRNS", 4) == 0)
+			hasTransparency = true;
+		if (!stream->seek (dseed::io::seekorigin::current, png_get_uint_32 (chunk) + 4))
+			return dseed::error_io;
 	}
-	png_read_image (png, rows.data ());
 
-	png_destroy_read_struct(&png, &info, nullptr);
+	// Same as decoded format: palette is expanded to RGB(A), 16-bit is stripped
+	dseed::color::pixelformat format;
+	switch (colorType)
+	{
+	case PNG_COLOR_TYPE_GRAY: format = dseed::color::pixelformat::r8; break;
+	case PNG_COLOR_TYPE_GRAY_ALPHA: format = dseed::color::pixelformat::ra8; break;
+	case PNG_COLOR_TYPE_RGB: format = dseed::color::pixelformat::rgb8; break;
+	case PNG_COLOR_TYPE_RGBA: format = dseed::color::pixelformat::rgba8; break;
+	case PNG_COLOR_TYPE_PALETTE:
+		format = hasTransparency ? dseed::color::pixelformat::rgba8 : dseed::color::pixelformat::rgb8;
+		break;
+	default:
+		return dseed::error_not_support_file_format;
+	}
 
-	bitmap->unlock ();
+	*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, dseed::size3i (width, height, 1), format);
+	return dseed::error_good;
+#else
+	return dseed::error_not_support;
+#endif
+}
 
-	return create_bitmap_array(arraytype::plain, bitmap, decoder);
+dseed::error_t dseed::bitmaps::decode_png_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_PNG)
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	__png_reader reader;
+	dseed::size3i size;
+	dseed::color::pixelformat format;
+	if (auto err = __read_png_header (stream, reader, size, format); dseed::failed (err))
+		return err;
+
+	if (format == dseed::color::pixelformat::bgr8_indexed8 || format == dseed::color::pixelformat::bgra8_indexed8)
+		return dseed::error_not_support;
+
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	if (auto err = __read_png_pixels (reader, target); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, size, format);
+	return dseed::error_good;
+#else
+	return dseed::error_not_support;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::create_png_stream_decoder (dseed::bitmaps::bitmap_row_sink* sink, dseed::bitmaps::bitmap_stream_decoder** decoder) noexcept
+{
+#if defined(USE_PNG)
+	if (sink == nullptr || decoder == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::autoref<__png_stream_decoder> temp;
+	temp.attach (new __png_stream_decoder (sink));
+	if (temp == nullptr)
+		return dseed::error_out_of_memory;
+
+	if (auto err = temp->initialize (); dseed::failed (err))
+		return err;
+
+	*decoder = temp.detach ();
+	return dseed::error_good;
 #else
 	return dseed::error_not_support;
 #endif
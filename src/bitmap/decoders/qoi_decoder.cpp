@@ -0,0 +1,208 @@
+#include <dseed.h>
+
+#include <vector>
+#include <cstring>
+
+#include "../../libs/DecodeTargetHelper.hxx"
+#include "../../libs/QOIHelper.hxx"
+
+dseed::error_t __read_qoi_header (dseed::io::stream* stream, __qoi_header& header) noexcept
+{
+	uint8_t bytes[QOI_HEADER_SIZE];
+	if (stream->read (bytes, sizeof (bytes)) != sizeof (bytes))
+		return dseed::error_fail;
+
+	if (!__qoi_parse_header (bytes, header))
+		return dseed::error_fail;
+
+	return dseed::error_good;
+}
+
+inline dseed::color::pixelformat __qoi_pixelformat (const __qoi_header& header) noexcept
+{
+	return header.channels == 4 ? dseed::color::pixelformat::rgba8 : dseed::color::pixelformat::rgb8;
+}
+
+// Writes same pixel count times
+//  : Runs are common in flat area, so 4-channel runs are stored 4 pixels at once.
+template<int Channels>
+inline uint8_t* __qoi_fill (uint8_t* dest, const __qoi_rgba& px, size_t count) noexcept
+{
+#if ARCH_X86SET && !DONT_USE_SSE
+	if constexpr (Channels == 4)
+	{
+		uint32_t value;
+		memcpy (&value, &px, sizeof (value));
+		const __m128i pixels = _mm_set1_epi32 ((int)value);
+		for (; count >= 4; count -= 4, dest += 16)
+			_mm_storeu_si128 ((__m128i*)dest, pixels);
+	}
+#endif
+	for (; count > 0; --count, dest += Channels)
+		memcpy (dest, &px, Channels);
+	return dest;
+}
+
+template<int Channels>
+dseed::error_t __decode_qoi_chunks (const uint8_t* data, size_t length, const __qoi_header& header, const __decode_target& target) noexcept
+{
+	if (length < sizeof (QOI_END_MARKER))
+		return dseed::error_fail;
+
+	// Chunks are at most 5 bytes and end marker follows them, so reading chunk never crosses buffer
+	const size_t chunksEnd = length - sizeof (QOI_END_MARKER);
+
+	__qoi_rgba index[64] = {};
+	__qoi_rgba px = { 0, 0, 0, 255 };
+	size_t run = 0, p = 0;
+
+	for (size_t y = 0; y < header.height; ++y)
+	{
+		uint8_t* dest = target.row (y);
+		for (size_t x = 0; x < header.width;)
+		{
+			if (run == 0)
+			{
+				if (p >= chunksEnd)
+					return dseed::error_fail;
+
+				const uint8_t b1 = data[p++];
+				run = 1;
+				if (b1 == QOI_OP_RGB)
+				{
+					px.r = data[p++];
+					px.g = data[p++];
+					px.b = data[p++];
+				}
+				else if (b1 == QOI_OP_RGBA)
+				{
+					px.r = data[p++];
+					px.g = data[p++];
+					px.b = data[p++];
+					px.a = data[p++];
+				}
+				else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX)
+				{
+					px = index[b1];
+				}
+				else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF)
+				{
+					px.r += ((b1 >> 4) & 0x03) - 2;
+					px.g += ((b1 >> 2) & 0x03) - 2;
+					px.b += (b1 & 0x03) - 2;
+				}
+				else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA)
+				{
+					const uint8_t b2 = data[p++];
+					const int vg = (b1 & 0x3f) - 32;
+					px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+					px.g += vg;
+					px.b += vg - 8 + (b2 & 0x0f);
+				}
+				else
+				{
+					run = (size_t)(b1 & 0x3f) + 1;
+				}
+
+				index[__qoi_hash (px)] = px;
+			}
+
+			// Run may continue to next row
+			const size_t count = dseed::minimum (run, header.width - x);
+			dest = __qoi_fill<Channels> (dest, px, count);
+			x += count;
+			run -= count;
+		}
+	}
+
+	return dseed::error_good;
+}
+
+dseed::error_t __read_qoi_pixels (dseed::io::stream* stream, const __qoi_header& header, const __decode_target& target) noexcept
+{
+	const size_t position = stream->position (), length = stream->length ();
+	if (position >= length)
+		return dseed::error_fail;
+
+	std::vector<uint8_t> data;
+	try
+	{
+		data.resize (length - position);
+	}
+	catch (...)
+	{
+		return dseed::error_out_of_memory;
+	}
+
+	size_t totalRead = 0;
+	while (totalRead != data.size ())
+	{
+		size_t read = stream->read (data.data () + totalRead, data.size () - totalRead);
+		if (read == 0)
+			return dseed::error_io;
+		totalRead += read;
+	}
+
+	return header.channels == 4
+		? __decode_qoi_chunks<4> (data.data (), data.size (), header, target)
+		: __decode_qoi_chunks<3> (data.data (), data.size (), header, target);
+}
+
+dseed::error_t dseed::bitmaps::create_qoi_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	if (stream == nullptr || decoder == nullptr)
+		return dseed::error_invalid_args;
+
+	__qoi_header header;
+	if (auto err = __read_qoi_header (stream, header); dseed::failed (err))
+		return err;
+
+	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
+	if (dseed::failed (dseed::bitmaps::create_bitmap (bitmaptype::bitmap2d, dseed::size3i (header.width, header.height, 1),
+		__qoi_pixelformat (header), nullptr, &bitmap)))
+		return dseed::error_fail;
+
+	if (auto err = __decode_into_bitmap (bitmap, [&](const __decode_target& target) { return __read_qoi_pixels (stream, header, target); });
+		dseed::failed (err))
+		return err;
+
+	return create_bitmap_array (arraytype::plain, bitmap, decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_qoi_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	__qoi_header header;
+	if (auto err = __read_qoi_header (stream, header); dseed::failed (err))
+		return err;
+
+	*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, dseed::size3i (header.width, header.height, 1),
+		__qoi_pixelformat (header), arraytype::plain, 1);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_qoi_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	__qoi_header header;
+	if (auto err = __read_qoi_header (stream, header); dseed::failed (err))
+		return err;
+
+	const dseed::size3i size (header.width, header.height, 1);
+	const auto format = __qoi_pixelformat (header);
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	if (auto err = __read_qoi_pixels (stream, header, target); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, size, format, arraytype::plain, 1);
+	return dseed::error_good;
+}
@@ -1,5 +1,7 @@
 #include <dseed.h>
 
+#include "../../libs/DecodeTargetHelper.hxx"
+
 #if COMPILER_MSVC
 #	pragma pack (push, 1)
 #else
@@ -35,12 +37,12 @@ struct TGAHeader
 #define TGA_LEFT	0x0
 #define TGA_RIGHT	0x1
 
-dseed::error_t dseed::bitmaps::create_tga_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+dseed::error_t __read_tga_header (dseed::io::stream* stream, TGAHeader& header) noexcept
 {
 	uint8_t headerBytes[18];
-	stream->read (headerBytes, 18);
+	if (stream->read (headerBytes, 18) != 18)
+		return dseed::error_fail;
 
-	TGAHeader header;
 	header.id_len = headerBytes[0];
 	header.map_t = headerBytes[1];
 	header.img_t = headerBytes[2];
@@ -63,31 +65,17 @@ dseed::error_t dseed::bitmaps::create_tga_bitmap_decoder (dseed::io::stream* str
 		header.depth != 24 && header.depth != 32)
 		return dseed::error_fail;
 
-	dseed::color::pixelformat format = dseed::color::pixelformat::unknown;
+	return dseed::error_good;
+}
 
-	std::vector<uint8_t> map;
-	size_t mapSize = header.map_len * header.map_entry / 8;
-	if (mapSize != 0)
+dseed::color::pixelformat __tga_format (const TGAHeader& header) noexcept
+{
+	if (header.map_len * header.map_entry / 8 != 0)
 	{
-		size_t mapOffset = 18 + header.id_len;
-		stream->seek (dseed::io::seekorigin::begin, mapOffset);
-
-		map.resize (mapSize);
-		stream->read (map.data (), mapSize);
-
-		if (header.map_entry != 24 && header.map_entry != 32)
-		{
-			std::vector<uint8_t> remap (map);
-			map.resize (header.map_len * 3);
-
-			// TODO
-			return dseed::error_not_support;
-		}
-
 		switch (header.map_entry)
 		{
-		case 24: format = dseed::color::pixelformat::bgr8_indexed8; break;
-		case 32: format = dseed::color::pixelformat::bgra8_indexed8; break;
+		case 24: return dseed::color::pixelformat::bgr8_indexed8;
+		case 32: return dseed::color::pixelformat::bgra8_indexed8;
 		}
 	}
 	else
@@ -96,33 +84,44 @@ dseed::error_t dseed::bitmaps::create_tga_bitmap_decoder (dseed::io::stream* str
 		{
 		case 15:
 		case 16:
-		case 24: format = dseed::color::pixelformat::bgr8; break;
-		case 32: format = dseed::color::pixelformat::bgra8; break;
+		case 24: return dseed::color::pixelformat::bgr8;
+		case 32: return dseed::color::pixelformat::bgra8;
 		}
 	}
+	return dseed::color::pixelformat::unknown;
+}
+
+// Reads raw or RLE encoded scanlines after color map
+//  : Each scanline is written to its row directly, bottom-up images are flipped on the fly.
+dseed::error_t __read_tga_pixels (dseed::io::stream* stream, const TGAHeader& header, const __decode_target& target) noexcept
+{
+	const size_t mapSize = header.map_len * header.map_entry / 8;
+	const uint8_t sample_bytes = header.depth / 8;
+	const size_t scanlineSize = dseed::minimum (target.rowBytes, (size_t)header.width * sample_bytes);
+	const bool bottomUp = header.vert == TGA_BOTTOM;
+
+	if (!stream->seek (dseed::io::seekorigin::begin, 18 + header.id_len + mapSize))
+		return dseed::error_io;
 
-	size_t scanlineSize = header.width * header.depth / 8;
-	std::vector<uint8_t> pixels (scanlineSize * header.height);
-	size_t scanlineOffset = 18 + header.id_len + mapSize;
-	stream->seek (dseed::io::seekorigin::begin, scanlineOffset);
 	if ((header.img_t & 0x8) == 0x8) //< RLE Encoded
 	{
+		uint8_t sample[4];
+		uint8_t repetition = 0;
+		uint8_t raw = 0;
+
 		for (int y = 0; y < header.height; ++y)
 		{
-			uint8_t packet_head;
-			const uint8_t sample_bytes = header.depth / 8;
-			std::vector<uint8_t> sample (sample_bytes);
-			uint8_t repetition = 0;
-			uint8_t raw = 0;
-
-			uint8_t* buf = pixels.data () + ((header.height - y - 1) * scanlineSize);
+			uint8_t* buf = target.row (bottomUp ? header.height - y - 1 : y);
 			for (int x = 0; x < header.width; ++x)
 			{
 				if (repetition == 0 && raw == 0) {
-					stream->read (&packet_head, 1);
+					uint8_t packet_head;
+					if (stream->read (&packet_head, 1) != 1)
+						return dseed::error_io;
 					if (packet_head & 0x80) {
 						repetition = 1 + (packet_head & 0x7f);
-						stream->read (sample.data (), sample_bytes);
+						if (stream->read (sample, sample_bytes) != sample_bytes)
+							return dseed::error_io;
 					}
 					else
 						raw = packet_head + 1;
@@ -133,9 +132,8 @@ dseed::error_t dseed::bitmaps::create_tga_bitmap_decoder (dseed::io::stream* str
 					--repetition;
 				}
 				else {
-					stream->read (sample.data (), sample_bytes);
-					for (uint8_t k = 0; k < sample_bytes; ++k)
-						buf[k] = sample[k];
+					if (stream->read (buf, sample_bytes) != sample_bytes)
+						return dseed::error_io;
 					--raw;
 				}
 				buf += sample_bytes;
@@ -147,16 +145,45 @@ dseed::error_t dseed::bitmaps::create_tga_bitmap_decoder (dseed::io::stream* str
 	}
 	else
 	{
-		stream->read (pixels.data (), pixels.size ());
+		const size_t padding = (size_t)header.width * sample_bytes - scanlineSize;
+		for (int y = 0; y < header.height; ++y)
+		{
+			if (stream->read (target.row (bottomUp ? header.height - y - 1 : y), scanlineSize) != scanlineSize)
+				return dseed::error_io;
+			if (padding > 0 && !stream->seek (dseed::io::seekorigin::current, padding))
+				return dseed::error_io;
+		}
 	}
 
-	if (header.depth == 24)
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::create_tga_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	TGAHeader header;
+	if (auto err = __read_tga_header (stream, header); dseed::failed (err))
+		return err;
+
+	dseed::color::pixelformat format = __tga_format (header);
+
+	std::vector<uint8_t> map;
+	size_t mapSize = header.map_len * header.map_entry / 8;
+	if (mapSize != 0)
 	{
-		std::vector<uint8_t> repixels (pixels);
-		size_t stride = dseed::color::calc_bitmap_stride (format, header.width);
-		pixels.resize (stride * header.height);
-		for (int y = 0; y < header.height; ++y)
-			memcpy (pixels.data () + (y * stride), repixels.data () + (y * scanlineSize), dseed::minimum (stride, scanlineSize));
+		size_t mapOffset = 18 + header.id_len;
+		stream->seek (dseed::io::seekorigin::begin, mapOffset);
+
+		map.resize (mapSize);
+		stream->read (map.data (), mapSize);
+
+		if (header.map_entry != 24 && header.map_entry != 32)
+		{
+			std::vector<uint8_t> remap (map);
+			map.resize (header.map_len * 3);
+
+			// TODO
+			return dseed::error_not_support;
+		}
 	}
 
 	dseed::autoref<dseed::bitmaps::palette> palette;
@@ -172,13 +199,54 @@ dseed::error_t dseed::bitmaps::create_tga_bitmap_decoder (dseed::io::stream* str
 		format, palette, &bitmap)))
 		return dseed::error_fail;
 
-	void* ptr;
-	if (bitmap->lock (&ptr))
-		return dseed::error_fail;
+	if (auto err = __decode_into_bitmap (bitmap, [&](const __decode_target& target) { return __read_tga_pixels (stream, header, target); });
+		dseed::failed (err))
+		return err;
 
-	memcpy (ptr, pixels.data (), pixels.size ());
+	return create_bitmap_array(arraytype::plain, bitmap, decoder);
+}
 
-	bitmap->unlock ();
+dseed::error_t dseed::bitmaps::probe_tga_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
 
-	return create_bitmap_array(arraytype::plain, bitmap, decoder);
+	TGAHeader header;
+	if (auto err = __read_tga_header (stream, header); dseed::failed (err))
+		return err;
+
+	dseed::color::pixelformat format = __tga_format (header);
+	if (format == dseed::color::pixelformat::unknown)
+		return dseed::error_not_support;
+
+	*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, dseed::size3i (header.width, header.height, 1), format);
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::bitmaps::decode_tga_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	TGAHeader header;
+	if (auto err = __read_tga_header (stream, header); dseed::failed (err))
+		return err;
+
+	// Only true-color images are delivered as raw pixels; color map needs palette
+	dseed::color::pixelformat format = __tga_format (header);
+	if ((format != dseed::color::pixelformat::bgr8 || header.depth != 24) && format != dseed::color::pixelformat::bgra8)
+		return dseed::error_not_support;
+
+	const dseed::size3i size (header.width, header.height, 1);
+	__decode_target target;
+	if (auto err = __prepare_decode_target (format, size, pixels, stride, length, target); dseed::failed (err))
+		return err;
+
+	if (auto err = __read_tga_pixels (stream, header, target); dseed::failed (err))
+		return err;
+
+	if (info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (bitmaptype::bitmap2d, size, format);
+	return dseed::error_good;
 }
\ No newline at end of file
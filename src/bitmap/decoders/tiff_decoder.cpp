@@ -3,15 +3,19 @@
 #if defined(USE_TIFF)
 #	include <tiff.h>
 #	include <tiffio.h>
+
+#	include <vector>
+
+#	include "../../libs/TIFFHelper.hxx"
+#	include "../parallel.hxx"
+
+constexpr size_t TIFF_PARALLEL_SEGMENTS_PER_THREAD = 4;
 #endif
 
-dseed::error_t dseed::bitmaps::create_tiff_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
-{
 #if defined(USE_TIFF)
-	if (stream == nullptr || decoder == nullptr)
-		return dseed::error_invalid_args;
-
-	auto tiff = TIFFClientOpen ("Stream", "r", stream,
+TIFF* __open_tiff_stream (dseed::io::stream* stream) noexcept
+{
+	return TIFFClientOpen ("Stream", "r", stream,
 		// Read
 		[] (thandle_t handle, tdata_t data, tsize_t sz) -> tsize_t
 		{
@@ -39,37 +43,330 @@ dseed::error_t dseed::bitmaps::create_tiff_bitmap_decoder (dseed::io::stream* st
 		// Unmap
 		[](thandle_t, tdata_t, toff_t) {}
 		);
-	if (tiff == nullptr)
-		return dseed::error_fail;
+}
+#endif
 
-	uint32_t width, height;
-	TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &width);
-	TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &height);
-	size_t stride = width * sizeof (uint32_t);
+#if defined(USE_TIFF)
+// Whether fourth sample is unassociated alpha
+//  : Without ExtraSamples tag, fourth sample is associated alpha as libtiff does.
+bool __tiff_unassociated_alpha (TIFF* tiff) noexcept
+{
+	uint16_t extraCount = 0, * extraTypes = nullptr;
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_EXTRASAMPLES, &extraCount, &extraTypes);
+	return extraCount >= 1 && extraTypes != nullptr && extraTypes[0] == EXTRASAMPLE_UNASSALPHA;
+}
+
+// Converts decoded 8-bit gray, RGB or RGBA rows to RGBA8
+//  : Alpha is copied as is, so unassociated alpha stays straight alpha of RGBA8.
+void __tiff_segment_to_rgba (const uint8_t* src, size_t srcRowBytes, size_t samplesPerPixel,
+	uint8_t* dest, size_t destStride, size_t columns, size_t rows) noexcept
+{
+	for (size_t y = 0; y < rows; ++y)
+	{
+		const uint8_t* s = src + y * srcRowBytes;
+		uint8_t* d = dest + y * destStride;
+		for (size_t x = 0; x < columns; ++x, s += samplesPerPixel, d += 4)
+		{
+			if (samplesPerPixel == 1)
+			{
+				d[0] = d[1] = d[2] = s[0];
+				d[3] = 255;
+			}
+			else
+			{
+				d[0] = s[0];
+				d[1] = s[1];
+				d[2] = s[2];
+				d[3] = samplesPerPixel == 4 ? s[3] : 255;
+			}
+		}
+	}
+}
+
+// Restores straight alpha from RGBA raster of libtiff RGBA interface, which premultiplies unassociated alpha
+void __tiff_unpremultiply (uint8_t* rgba, size_t pixels) noexcept
+{
+	for (size_t i = 0; i < pixels; ++i, rgba += 4)
+	{
+		const int a = rgba[3];
+		if (a == 0 || a == 255)
+			continue;
+		for (int c = 0; c < 3; ++c)
+			rgba[c] = (uint8_t)dseed::minimum (255, (rgba[c] * 255 + a / 2) / a);
+	}
+}
+
+// Decodes tiles(strips) on worker threads
+//  : Raw tiles(strips) are read by batch through libtiff, then decompressed and converted in parallel.
+//  : Only 8-bit contiguous gray/RGB(A) top-left image without compression or with LZW/deflate is handled here;
+//    returns false for others, and then libtiff RGBA interface decodes image.
+bool __read_tiff_parallel (TIFF* tiff, uint32_t width, uint32_t height, uint8_t* rgba) noexcept
+{
+	uint16_t bitsPerSample, samplesPerPixel, planar, photometric, sampleFormat, orientation, compression, predictor, fillOrder;
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_PLANARCONFIG, &planar);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLEFORMAT, &sampleFormat);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_ORIENTATION, &orientation);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_COMPRESSION, &compression);
+	// Predictor tag is known to LZW and deflate codecs only
+	predictor = PREDICTOR_NONE;
+	if (compression == COMPRESSION_LZW || compression == COMPRESSION_ADOBE_DEFLATE || compression == COMPRESSION_DEFLATE)
+		TIFFGetFieldDefaulted (tiff, TIFFTAG_PREDICTOR, &predictor);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_FILLORDER, &fillOrder);
+	if (!TIFFGetField (tiff, TIFFTAG_PHOTOMETRIC, &photometric))
+		return false;
+
+	if (bitsPerSample != 8 || planar != PLANARCONFIG_CONTIG || sampleFormat != SAMPLEFORMAT_UINT
+		|| orientation != ORIENTATION_TOPLEFT || fillOrder != FILLORDER_MSB2LSB
+		|| (predictor != PREDICTOR_NONE && predictor != PREDICTOR_HORIZONTAL))
+		return false;
+	if (!(compression == COMPRESSION_NONE || compression == COMPRESSION_LZW
+		|| compression == COMPRESSION_ADOBE_DEFLATE || compression == COMPRESSION_DEFLATE))
+		return false;
+	if (!((photometric == PHOTOMETRIC_MINISBLACK && samplesPerPixel == 1)
+		|| (photometric == PHOTOMETRIC_RGB && (samplesPerPixel == 3 || samplesPerPixel == 4))))
+		return false;
+
+	if (samplesPerPixel == 4)
+	{
+		uint16_t extraCount = 0, * extraTypes = nullptr;
+		TIFFGetFieldDefaulted (tiff, TIFFTAG_EXTRASAMPLES, &extraCount, &extraTypes);
+		if (extraCount > 1)
+			return false;
+	}
+
+	const bool tiled = TIFFIsTiled (tiff);
+	uint32_t segmentWidth, segmentHeight;
+	size_t across, count;
+	uint64_t* byteCounts = nullptr;
+	if (tiled)
+	{
+		if (!TIFFGetField (tiff, TIFFTAG_TILEWIDTH, &segmentWidth) || !TIFFGetField (tiff, TIFFTAG_TILELENGTH, &segmentHeight)
+			|| segmentWidth == 0 || segmentHeight == 0)
+			return false;
+		across = (width + segmentWidth - 1) / segmentWidth;
+		count = TIFFNumberOfTiles (tiff);
+		if (!TIFFGetField (tiff, TIFFTAG_TILEBYTECOUNTS, &byteCounts))
+			return false;
+	}
+	else
+	{
+		TIFFGetFieldDefaulted (tiff, TIFFTAG_ROWSPERSTRIP, &segmentHeight);
+		segmentWidth = width;
+		segmentHeight = dseed::minimum (segmentHeight, height);
+		across = 1;
+		count = TIFFNumberOfStrips (tiff);
+		if (!TIFFGetField (tiff, TIFFTAG_STRIPBYTECOUNTS, &byteCounts))
+			return false;
+	}
+	if (segmentHeight == 0 || byteCounts == nullptr
+		|| count < across * ((height + segmentHeight - 1) / segmentHeight))
+		return false;
+
+	const size_t rowBytes = (size_t)segmentWidth * samplesPerPixel;
+	const size_t rgbaStride = (size_t)width * 4;
+	const size_t threads = dseed::bitmaps::parallel::concurrency ();
+	const size_t batch = dseed::minimum (threads * TIFF_PARALLEL_SEGMENTS_PER_THREAD, count);
+
+	std::vector<std::vector<uint8_t>> raws, decodeds;
+	std::vector<uint8_t> results;
+	try
+	{
+		raws.resize (batch);
+		decodeds.resize (batch);
+		results.resize (batch);
+		for (auto& decoded : decodeds)
+			decoded.resize (rowBytes * segmentHeight);
+	}
+	catch (...) { return false; }
+
+	for (size_t first = 0; first < count; first += batch)
+	{
+		const size_t batchCount = dseed::minimum (batch, count - first);
+		for (size_t slot = 0; slot < batchCount; ++slot)
+		{
+			const size_t index = first + slot;
+			try { raws[slot].resize ((size_t)byteCounts[index]); }
+			catch (...) { return false; }
+
+			const tmsize_t read = tiled
+				? TIFFReadRawTile (tiff, (uint32)index, raws[slot].data (), (tmsize_t)raws[slot].size ())
+				: TIFFReadRawStrip (tiff, (uint32)index, raws[slot].data (), (tmsize_t)raws[slot].size ());
+			if (read != (tmsize_t)raws[slot].size ())
+				return false;
+		}
+
+		dseed::bitmaps::parallel::for_each (batchCount, [&](size_t slot)
+		{
+			const size_t index = first + slot;
+			const size_t x = (index % across) * segmentWidth, y = (index / across) * segmentHeight;
+			if (y >= height)
+			{
+				results[slot] = true;
+				return;
+			}
+
+			// Every tile is full size, but last strip has only remained rows
+			const size_t rows = tiled ? segmentHeight : dseed::minimum<size_t> (segmentHeight, height - y);
+			const size_t length = rowBytes * rows;
+			const std::vector<uint8_t>& raw = raws[slot];
+			uint8_t* decoded = decodeds[slot].data ();
+
+			bool result = true;
+			if (compression == COMPRESSION_LZW)
+				result = __tiff_lzw_decode (raw.data (), raw.size (), decoded, length);
+			else if (compression != COMPRESSION_NONE)
+				result = __tiff_inflate (raw.data (), raw.size (), decoded, length);
+			else if (raw.size () >= length)
+				memcpy (decoded, raw.data (), length);
+			else
+				result = false;
+
+			if (result)
+			{
+				if (predictor == PREDICTOR_HORIZONTAL)
+				{
+					for (size_t row = 0; row < rows; ++row)
+						__tiff_horizontal_acc8 (decoded + row * rowBytes, rowBytes, samplesPerPixel);
+				}
 
-	uint32* raster = (uint32_t*)_TIFFmalloc (stride * height);
+				__tiff_segment_to_rgba (decoded, rowBytes, samplesPerPixel,
+					rgba + y * rgbaStride + x * 4, rgbaStride,
+					dseed::minimum<size_t> (segmentWidth, width - x), dseed::minimum<size_t> (rows, height - y));
+			}
+			results[slot] = result;
+		}, threads);
 
-	if (!TIFFReadRGBAImage (tiff, width, height, raster, 0))
+		for (size_t slot = 0; slot < batchCount; ++slot)
+			if (!results[slot])
+				return false;
+	}
+
+	return true;
+}
+#endif
+
+#if defined(USE_TIFF)
+class __tiff_frame_loader : public dseed::bitmaps::bitmap_frame_loader
+{
+public:
+	__tiff_frame_loader (dseed::io::stream* stream, TIFF* tiff)
+		: _refCount (1), _stream (stream), _tiff (tiff)
+	{ }
+	~__tiff_frame_loader ()
+	{
+		TIFFClose (_tiff);
+	}
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t load (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		if (!TIFFSetDirectory (_tiff, (uint16_t)index))
+			return dseed::error_fail;
+
+		uint32_t width, height;
+		TIFFGetField (_tiff, TIFFTAG_IMAGEWIDTH, &width);
+		TIFFGetField (_tiff, TIFFTAG_IMAGELENGTH, &height);
+
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d,
+			dseed::size3i (width, height, 1), dseed::color::pixelformat::rgba8,
+			nullptr, &temp)))
+			return dseed::error_fail;
+
+		// RGBA8 rows are not padded, so raster is decoded into bitmap in top-down order directly
+		uint32_t* raster;
+		if (dseed::failed (temp->lock ((void**)&raster)))
+			return dseed::error_fail;
+
+		if (!__read_tiff_parallel (_tiff, width, height, (uint8_t*)raster))
+		{
+			if (!TIFFReadRGBAImageOriented (_tiff, width, height, raster, ORIENTATION_TOPLEFT, 0))
+			{
+				temp->unlock ();
+				return dseed::error_fail;
+			}
+			if (__tiff_unassociated_alpha (_tiff))
+				__tiff_unpremultiply ((uint8_t*)raster, (size_t)width * height);
+		}
+
+		temp->unlock ();
+
+		*bitmap = temp.detach ();
+		return dseed::error_good;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::stream> _stream;
+	TIFF* _tiff;
+};
+#endif
+
+dseed::error_t dseed::bitmaps::create_tiff_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+#if defined(USE_TIFF)
+	if (stream == nullptr || decoder == nullptr)
+		return dseed::error_invalid_args;
+
+	auto tiff = __open_tiff_stream (stream);
+	if (tiff == nullptr)
+		return dseed::error_fail;
+
+	// Every page(IFD) is a frame, decoded on first access
+	size_t pages = TIFFNumberOfDirectories (tiff);
+	if (pages == 0)
 	{
-		_TIFFfree (raster);
 		TIFFClose (tiff);
 		return dseed::error_fail;
 	}
 
-	TIFFClose (tiff);
+	dseed::autoref<dseed::bitmaps::bitmap_frame_loader> loader;
+	loader.attach (new __tiff_frame_loader (stream, tiff));
+	if (loader == nullptr)
+	{
+		TIFFClose (tiff);
+		return dseed::error_out_of_memory;
+	}
 
-	dseed::autoref<dseed::bitmaps::bitmap> bitmap;
-	if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d,
-		dseed::size3i (width, height, 1), dseed::color::pixelformat::rgba8,
-		nullptr, &bitmap)))
+	return create_lazy_bitmap_array (arraytype::plain, pages, loader, 8, decoder);
+#else
+	return dseed::error_not_support;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::probe_tiff_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_TIFF)
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	// Reads IFD chain only, strips and tiles are not read
+	auto tiff = __open_tiff_stream (stream);
+	if (tiff == nullptr)
 		return dseed::error_fail;
 
-	for (size_t y = 0; y < height; ++y)
-		bitmap->write_pixels (dseed::rect2i (0, (int32_t)y, width, 1), raster + ((height - y - 1) * width));
+	uint32_t width = 0, height = 0;
+	TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &width);
+	TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &height);
+	size_t pages = TIFFNumberOfDirectories (tiff);
 
-	_TIFFfree (raster);
+	TIFFClose (tiff);
 
-	return create_bitmap_array(arraytype::plain, bitmap, decoder);
+	*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, dseed::size3i (width, height, 1),
+		dseed::color::pixelformat::rgba8, dseed::bitmaps::arraytype::plain, pages);
+	return dseed::error_good;
 #else
 	return dseed::error_not_support;
 #endif
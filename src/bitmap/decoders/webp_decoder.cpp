@@ -5,101 +5,429 @@
 #	include <webp/demux.h>
 #endif
 
-dseed::error_t dseed::bitmaps::create_webp_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
-{
+#include "../parallel.hxx"
+#include "../../libs/AnimationHelper.hxx"
+#include "../../libs/DecodeTargetHelper.hxx"
+
 #if defined(USE_WEBP)
-	if (stream == nullptr || decoder == nullptr)
-		return dseed::error_invalid_args;
+// Pixel format of every decoded WebP
+//  : Alpha is from format flags only(VP8X ALPHA flag, or alpha bit of simple VP8L), not from frames,
+//    so probe, decoder and decode-into report same format.
+inline dseed::color::pixelformat __webp_pixel_format (uint32_t formatFlags) noexcept
+{
+	return (formatFlags & ALPHA_FLAG) != 0 ? dseed::color::pixelformat::rgba8 : dseed::color::pixelformat::rgb8;
+}
 
-	std::vector<uint8_t> bytes;
-	bytes.resize (stream->length ());
+// Position and drawing of frame read from demuxer
+struct __webp_frame_info
+{
+	int left, top, width, height;
+	int64_t duration;
+	bool alpha, blend, dispose;
+};
+
+// Same rule as WebPAnimDecoder; canvas before key frame is transparent
+//  : Opaque or non-blending frame covering whole canvas does not read canvas.
+//  : Frame after disposal of whole canvas, or of key frame, starts from transparent canvas.
+std::vector<bool> __webp_key_frames (const std::vector<__webp_frame_info>& frames, int width, int height)
+{
+	auto covers = [&](const __webp_frame_info& frame) { return frame.width == width && frame.height == height; };
 
-	size_t totalRead = 0;
-	while (totalRead != stream->length ())
+	std::vector<bool> keys (frames.size ());
+	for (size_t i = 0; i < frames.size (); ++i)
 	{
-		size_t read = stream->read (bytes.data () + totalRead, stream->length () - totalRead);
-		totalRead += read;
+		keys[i] = i == 0
+			|| ((!frames[i].alpha || !frames[i].blend) && covers (frames[i]))
+			|| (frames[i - 1].dispose && (covers (frames[i - 1]) || keys[i - 1]));
 	}
+	return keys;
+}
 
-	WebPData webpData = { bytes.data (), bytes.size () };
-	WebPDemuxer* demuxer = WebPDemux (&webpData);
-	if (demuxer == nullptr)
-		return dseed::error_fail;
-
-	auto width = WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_WIDTH),
-		height = WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_HEIGHT),
-		flags = WebPDemuxGetI (demuxer, WEBP_FF_FORMAT_FLAGS),
-		frameCount = WebPDemuxGetI (demuxer, WEBP_FF_FRAME_COUNT);
+// Non-premultiplied source-over, as in WebPAnimDecoder
+inline void __webp_blend_pixel (const uint8_t* src, uint8_t* dst) noexcept
+{
+	const uint32_t srcA = src[3];
+	if (srcA == 0)
+		return;
+	if (srcA == 255)
+	{
+		memcpy (dst, src, 4);
+		return;
+	}
 
-	WebPDecoderConfig config;
-	config.options.use_threads = 1;
+	const uint32_t dstFactorA = (dst[3] * (256 - srcA)) >> 8;
+	const uint32_t blendA = srcA + dstFactorA;
+	const uint32_t scale = (1u << 24) / blendA;
+	for (int c = 0; c < 3; ++c)
+		dst[c] = (uint8_t)(((src[c] * srcA + dst[c] * dstFactorA) * scale) >> 24);
+	dst[3] = (uint8_t)blendA;
+}
 
-	WebPInitDecoderConfig (&config);
+// Composites frames over RGBA canvas
+//  : Frame data is read from demuxer by index, so seeking needs no reader state.
+class __webp_frame_loader : public __animation_frame_loader
+{
+public:
+	__webp_frame_loader (dseed::blob* blob, WebPDemuxer* demuxer, const std::vector<__webp_frame_info>& frames,
+		const std::vector<bool>& keys, dseed::color::pixelformat format, size_t cacheSize)
+		: __animation_frame_loader (keys, cacheSize), _blob (blob), _demuxer (demuxer), _frames (frames), _format (format)
+		, _size (WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_WIDTH), WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_HEIGHT), 1)
+	{ }
+	~__webp_frame_loader ()
+	{
+		WebPDemuxDelete (_demuxer);
+	}
 
-	WebPIterator iter;
-	if (!WebPDemuxGetFrame (demuxer, frameCount, &iter))
-		return dseed::error_fail;
+protected:
+	virtual dseed::error_t seek (size_t index, bool keyCanvas) noexcept override
+	{
+		if (keyCanvas)
+		{
+			try { _canvas.assign ((size_t)_size.width * _size.height * 4, 0); }
+			catch (...) { return dseed::error_out_of_memory; }
+		}
+		return dseed::error_good;
+	}
 
-	dseed::size3i size (width, height, 1);
-	dseed::color::pixelformat format;
-	if (iter.has_alpha)
+	virtual dseed::error_t step (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
 	{
+		const auto& frame = _frames[index];
+		const size_t frameStride = (size_t)frame.width * 4;
+		try { _decoded.resize (frameStride * frame.height); }
+		catch (...) { return dseed::error_out_of_memory; }
+
+		WebPIterator iter;
+		if (!WebPDemuxGetFrame (_demuxer, (int)index + 1, &iter))
+			return dseed::error_fail;
+
+		WebPDecoderConfig config;
+		WebPInitDecoderConfig (&config);
+		config.options.use_threads = 1;
 		config.output.colorspace = MODE_RGBA;
-		format = dseed::color::pixelformat::rgba8;
+		config.output.is_external_memory = 1;
+		config.output.u.RGBA.rgba = _decoded.data ();
+		config.output.u.RGBA.stride = (int)frameStride;
+		config.output.u.RGBA.size = _decoded.size ();
+		const auto status = WebPDecode (iter.fragment.bytes, iter.fragment.size, &config);
+		WebPDemuxReleaseIterator (&iter);
+		if (status != VP8_STATUS_OK)
+			return dseed::error_fail;
+
+		// Like WebPAnimDecoder, key frame and pixels in area disposed by previous frame are not blended
+		const size_t canvasStride = (size_t)_size.width * 4;
+		const bool blend = frame.blend && frame.alpha && !key (index);
+		const __webp_frame_info* disposed = (blend && _frames[index - 1].dispose) ? &_frames[index - 1] : nullptr;
+		for (int y = 0; y < frame.height; ++y)
+		{
+			const uint8_t* src = _decoded.data () + y * frameStride;
+			uint8_t* dest = _canvas.data () + (frame.top + y) * canvasStride + frame.left * 4;
+			if (blend)
+			{
+				const int canvasY = frame.top + y;
+				for (int x = 0; x < frame.width; ++x)
+				{
+					const int canvasX = frame.left + x;
+					if (disposed != nullptr && canvasX >= disposed->left && canvasX < disposed->left + disposed->width
+						&& canvasY >= disposed->top && canvasY < disposed->top + disposed->height)
+						memcpy (dest + x * 4, src + x * 4, 4);
+					else
+						__webp_blend_pixel (src + x * 4, dest + x * 4);
+				}
+			}
+			else
+				memcpy (dest, src, frameStride);
+		}
+
+		if (bitmap != nullptr)
+		{
+			if (auto err = materialize (frame, bitmap); dseed::failed (err))
+				return err;
+		}
+
+		// Disposal is applied after frame is shown
+		if (frame.dispose)
+		{
+			for (int y = 0; y < frame.height; ++y)
+				memset (_canvas.data () + (frame.top + y) * canvasStride + frame.left * 4, 0, frameStride);
+		}
+
+		return dseed::error_good;
 	}
-	else
+
+private:
+	dseed::error_t materialize (const __webp_frame_info& frame, dseed::bitmaps::bitmap** bitmap) noexcept
 	{
-		config.output.colorspace = MODE_RGB;
-		format = dseed::color::pixelformat::rgb8;
+		dseed::autoref<dseed::bitmaps::bitmap> temp;
+		if (dseed::failed (dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, _size, _format, nullptr, &temp)))
+			return dseed::error_fail;
+
+		dseed::autoref<dseed::attributes> attr;
+		temp->extra_info (&attr);
+		attr->set_int64 (dseed::attrkey_duration, dseed::timespan::from_milliseconds ((double)frame.duration).ticks ());
+
+		uint8_t* ptr;
+		if (dseed::failed (temp->lock ((void**)&ptr)))
+			return dseed::error_fail;
+		if (_format == dseed::color::pixelformat::rgba8)
+			memcpy (ptr, _canvas.data (), _canvas.size ());
+		else
+		{
+			// RGB rows are padded to 4 bytes
+			const size_t stride = dseed::color::calc_bitmap_stride (_format, _size.width);
+			for (int y = 0; y < _size.height; ++y)
+				for (int x = 0; x < _size.width; ++x)
+					memcpy (ptr + y * stride + x * 3, _canvas.data () + ((size_t)y * _size.width + x) * 4, 3);
+		}
+		temp->unlock ();
+
+		*bitmap = temp.detach ();
+		return dseed::error_good;
 	}
-	size_t stride = dseed::color::calc_bitmap_stride (format, width);
 
-	int index = 0;
-	std::vector<dseed::bitmaps::bitmap*> bitmaps;
-	bitmaps.resize (frameCount);
+private:
+	dseed::autoref<dseed::blob> _blob;
+	WebPDemuxer* _demuxer;
+	std::vector<__webp_frame_info> _frames;
+	dseed::color::pixelformat _format;
+	dseed::size3i _size;
+	std::vector<uint8_t> _decoded;
+};
+
+WebPDemuxer* __webp_demux (dseed::blob* blob) noexcept
+{
+	WebPData webpData = { (const uint8_t*)blob->ptr (), blob->size () };
+	return WebPDemux (&webpData);
+}
+#endif
+
+dseed::error_t dseed::bitmaps::create_webp_bitmap_decoder_with_options (dseed::io::stream* stream,
+	const dseed::bitmaps::animation_decoder_options& options, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+#if defined(USE_WEBP)
+	if (stream == nullptr || decoder == nullptr || options.threads < 0 || options.cache_size < 0)
+		return dseed::error_invalid_args;
+
+	// Blob is kept by loader, demuxer reads frames from it without copy
+	dseed::autoref<dseed::blob> blob;
+	if (auto err = __animation_stream_blob (stream, &blob); dseed::failed (err))
+		return err;
+
+	WebPDemuxer* demuxer = __webp_demux (blob);
+	if (demuxer == nullptr)
+		return dseed::error_fail;
 
-	do
+	const int width = (int)WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_WIDTH), height = (int)WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_HEIGHT);
+	const auto format = __webp_pixel_format (WebPDemuxGetI (demuxer, WEBP_FF_FORMAT_FLAGS));
+
+	std::vector<__webp_frame_info> frames;
+	WebPIterator iter;
+	if (WebPDemuxGetFrame (demuxer, 1, &iter))
 	{
-		if (WebPDecode (iter.fragment.bytes, iter.fragment.size, &config) == VP8_STATUS_OK)
+		do
 		{
-			timespan duration = dseed::timespan::from_milliseconds (iter.duration);
+			const __webp_frame_info frame = {
+				iter.x_offset, iter.y_offset, iter.width, iter.height, iter.duration, iter.has_alpha != 0,
+				iter.blend_method == WEBP_MUX_BLEND, iter.dispose_method == WEBP_MUX_DISPOSE_BACKGROUND
+			};
+			if (frame.left + frame.width > width || frame.top + frame.height > height)
+				break;
 
-			dseed::autoref<dseed::bitmaps::bitmap> bitmap;
-			dseed::bitmaps::create_bitmap (dseed::bitmaps::bitmaptype::bitmap2d, size, format, nullptr, &bitmap);
-			
-			uint8_t* ptr;
-			if (dseed::failed (bitmap->lock ((void**)&ptr)))
-				continue;
+			try { frames.push_back (frame); }
+			catch (...) { break; }
+		} while (WebPDemuxNextFrame (&iter));
+		WebPDemuxReleaseIterator (&iter);
+	}
+	if (frames.size () != WebPDemuxGetI (demuxer, WEBP_FF_FRAME_COUNT) || frames.empty ())
+	{
+		WebPDemuxDelete (demuxer);
+		return dseed::error_fail;
+	}
 
-			if (format == color::pixelformat::rgba8)
-			{
-				memcpy (ptr, config.output.u.RGBA.rgba, stride * height);
-			}
-			else
+	std::vector<bool> keys;
+	try { keys = __webp_key_frames (frames, width, height); }
+	catch (...)
+	{
+		WebPDemuxDelete (demuxer);
+		return dseed::error_out_of_memory;
+	}
+
+	dseed::autoref<__webp_frame_loader> loader;
+	loader.attach (new __webp_frame_loader (blob, demuxer, frames, keys, format, options.parallel ? 0 : (size_t)options.cache_size));
+	if (loader == nullptr)
+	{
+		WebPDemuxDelete (demuxer);
+		return dseed::error_out_of_memory;
+	}
+
+	if (options.parallel)
+	{
+		// Loader of first run uses demuxer made above
+		std::atomic<bool> firstTaken (false);
+		std::vector<dseed::autoref<dseed::bitmaps::bitmap>> bitmaps;
+		if (auto err = __animation_decode_parallel (blob, keys, (size_t)options.threads,
+			[&](dseed::io::stream*, dseed::bitmaps::bitmap_frame_loader** runLoader) -> dseed::error_t
 			{
-				for (size_t y = 0; y < height; ++y)
+				if (!firstTaken.exchange (true))
 				{
-					memcpy (ptr + (y * stride),
-						config.output.u.RGBA.rgba + (y * config.output.u.RGBA.stride),
-						config.output.u.RGBA.stride);
+					*runLoader = loader;
+					loader->retain ();
+					return dseed::error_good;
 				}
-			}
 
-			bitmap->unlock ();
+				WebPDemuxer* runDemuxer = __webp_demux (blob);
+				if (runDemuxer == nullptr)
+					return dseed::error_fail;
+				*runLoader = new __webp_frame_loader (blob, runDemuxer, frames, keys, format, 0);
+				if (*runLoader == nullptr)
+				{
+					WebPDemuxDelete (runDemuxer);
+					return dseed::error_out_of_memory;
+				}
+				return dseed::error_good;
+			}, bitmaps); dseed::failed (err))
+			return err;
+
+		return create_bitmap_array (arraytype::plain, bitmaps, decoder);
+	}
+
+	return create_lazy_bitmap_array (arraytype::plain, frames.size (), loader, (size_t)options.cache_size, decoder);
+#else
+	return dseed::error_not_support;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::create_webp_bitmap_decoder (dseed::io::stream* stream, dseed::bitmaps::bitmap_array** decoder) noexcept
+{
+	return create_webp_bitmap_decoder_with_options (stream, dseed::bitmaps::animation_decoder_options (), decoder);
+}
+
+dseed::error_t dseed::bitmaps::probe_webp_bitmap (dseed::io::stream* stream, dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_WEBP)
+	if (stream == nullptr || info == nullptr)
+		return dseed::error_invalid_args;
+
+	uint8_t riff[12];
+	if (sizeof (riff) != stream->read (riff, sizeof (riff)) || memcmp (riff, "RIFF", 4) != 0 || memcmp (riff + 8, "WEBP", 4) != 0)
+		return dseed::error_fail;
 
-			dseed::autoref<dseed::attributes> attr;
-			bitmap->extra_info(&attr);
-			attr->set_int64(dseed::attrkey_duration, duration.ticks());
+	// Walk RIFF chunks instead of loading whole file to WebPDemux
+	//  : Alpha is from VP8X flags for extended format, same as decoder.
+	int width = 0, height = 0;
+	bool hasAlpha = false, animated = false;
+	size_t frameCount = 0;
+	while (true)
+	{
+		uint8_t chunk[8];
+		if (sizeof (chunk) != stream->read (chunk, sizeof (chunk)))
+			break;
+		const size_t chunkSize = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((size_t)chunk[7] << 24);
+		const size_t paddedSize = chunkSize + (chunkSize & 1);
 
-			bitmaps[index] = bitmap.detach();
+		uint8_t payload[10];
+		if (memcmp (chunk, "VP8X", 4) == 0)
+		{
+			if (chunkSize < 10 || 10 != stream->read (payload, 10))
+				return dseed::error_fail;
+			hasAlpha = (payload[0] & 0x10) != 0;
+			animated = (payload[0] & 0x02) != 0;
+			width = 1 + (payload[4] | (payload[5] << 8) | (payload[6] << 16));
+			height = 1 + (payload[7] | (payload[8] << 8) | (payload[9] << 16));
+			if (!animated)
+			{
+				frameCount = 1;
+				break;
+			}
+			stream->seek (dseed::io::seekorigin::current, paddedSize - 10);
 		}
-		++index;
-	} while (WebPDemuxNextFrame (&iter));
+		else if (memcmp (chunk, "VP8 ", 4) == 0 && width == 0)
+		{
+			if (chunkSize < 10 || 10 != stream->read (payload, 10))
+				return dseed::error_fail;
+			if (payload[3] != 0x9d || payload[4] != 0x01 || payload[5] != 0x2a)
+				return dseed::error_fail;
+			width = (payload[6] | (payload[7] << 8)) & 0x3fff;
+			height = (payload[8] | (payload[9] << 8)) & 0x3fff;
+			frameCount = 1;
+			break;
+		}
+		else if (memcmp (chunk, "VP8L", 4) == 0 && width == 0)
+		{
+			if (chunkSize < 5 || 5 != stream->read (payload, 5) || payload[0] != 0x2f)
+				return dseed::error_fail;
+			const uint32_t bits = payload[1] | (payload[2] << 8) | (payload[3] << 16) | ((uint32_t)payload[4] << 24);
+			width = 1 + (bits & 0x3fff);
+			height = 1 + ((bits >> 14) & 0x3fff);
+			hasAlpha = ((bits >> 28) & 1) != 0;
+			frameCount = 1;
+			break;
+		}
+		else
+		{
+			if (memcmp (chunk, "ANMF", 4) == 0)
+				++frameCount;
+			if (!stream->seek (dseed::io::seekorigin::current, paddedSize))
+				break;
+		}
+	}
+
+	if (width == 0 || height == 0 || frameCount == 0)
+		return dseed::error_fail;
+
+	*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, dseed::size3i (width, height, 1),
+		__webp_pixel_format (hasAlpha ? ALPHA_FLAG : 0), dseed::bitmaps::arraytype::plain, frameCount);
+	return dseed::error_good;
+#else
+	return dseed::error_not_support;
+#endif
+}
+
+dseed::error_t dseed::bitmaps::decode_webp_bitmap_into (dseed::io::stream* stream, void* pixels, size_t stride, size_t length,
+	dseed::bitmaps::bitmap_info* info) noexcept
+{
+#if defined(USE_WEBP)
+	if (stream == nullptr || pixels == nullptr)
+		return dseed::error_invalid_args;
+
+	std::vector<uint8_t> bytes (stream->length ());
+	if (bytes.size () != stream->read (bytes.data (), bytes.size ()))
+		return dseed::error_io;
+
+	WebPData webpData = { bytes.data (), bytes.size () };
+	WebPDemuxer* demuxer = WebPDemux (&webpData);
+	if (demuxer == nullptr)
+		return dseed::error_fail;
+
+	const dseed::size3i size (WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_WIDTH), WebPDemuxGetI (demuxer, WEBP_FF_CANVAS_HEIGHT), 1);
+
+	WebPIterator iter;
+	if (!WebPDemuxGetFrame (demuxer, 1, &iter))
+	{
+		WebPDemuxDelete (demuxer);
+		return dseed::error_fail;
+	}
+
+	// libwebp writes rows at caller stride; first frame smaller than canvas needs composition
+	dseed::error_t err = dseed::error_good;
+	const dseed::color::pixelformat format = __webp_pixel_format (WebPDemuxGetI (demuxer, WEBP_FF_FORMAT_FLAGS));
+	__decode_target target;
+	if (iter.width != size.width || iter.height != size.height)
+		err = dseed::error_not_support;
+	else if (dseed::succeeded (err = __prepare_decode_target (format, size, pixels, stride, length, target)))
+	{
+		uint8_t* decoded = format == dseed::color::pixelformat::rgba8
+			? WebPDecodeRGBAInto (iter.fragment.bytes, iter.fragment.size, target.pixels, length, (int)target.stride)
+			: WebPDecodeRGBInto (iter.fragment.bytes, iter.fragment.size, target.pixels, length, (int)target.stride);
+		if (decoded == nullptr)
+			err = dseed::error_fail;
+	}
 
 	WebPDemuxReleaseIterator (&iter);
 	WebPDemuxDelete (demuxer);
 
-	return create_bitmap_array(arraytype::plain, bitmaps, decoder);
+	if (dseed::succeeded (err) && info != nullptr)
+		*info = dseed::bitmaps::bitmap_info (dseed::bitmaps::bitmaptype::bitmap2d, size, format);
+	return err;
 #else
 	return dseed::error_not_support;
 #endif
@@ -1,12 +1,16 @@
 #include <dseed.h>
 
+#include <vector>
+
 #include "../../libs/DDSHelper.hxx"
+#include "../../libs/BCHelper.hxx"
+#include "../parallel.hxx"
 
 class __dds_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__dds_encoder(dseed::io::stream* stream)
-		: _refCount(1), _stream(stream)
+	__dds_encoder(dseed::io::bufferedstream* stream, const dseed::bitmaps::dds_encoder_options& options)
+		: _refCount(1), _stream(stream), _options(options)
 	{ }
 
 public:
@@ -42,6 +46,21 @@ public:
 		if (bitmap == nullptr) return dseed::error_invalid_args;
 		auto format = bitmap->format();
 
+		// Mip chain is generated from one source frame
+		if (_options.format != color::pixelformat::unknown)
+		{
+			if (_bitmaps.size() > 0)
+				return dseed::error_invalid_op;
+			if (format != color::pixelformat::rgba8 && format != color::pixelformat::rgbaf)
+				return dseed::error_not_support;
+			if (bitmap->type() == bitmaps::bitmaptype::bitmap3d && !_options.array)
+				return dseed::error_not_support;
+
+			try { _bitmaps.push_back(bitmap); }
+			catch (...) { return dseed::error_out_of_memory; }
+			return dseed::error_good;
+		}
+
 		bool found = false;
 		for (auto sf : support_formats)
 			if (sf == format)
@@ -52,27 +71,21 @@ public:
 		if (!found)
 			return dseed::error_not_support;
 
-		if (_bitmaps.size() == 0)
-			_bitmaps.push_back(bitmap);
-		else
+		if (_bitmaps.size() > 0)
 		{
 			if (_bitmaps[0]->format() != bitmap->format() || _bitmaps[0]->type() != bitmap->type())
 				return dseed::error_invalid_args;
 
-			auto mainSize = _bitmaps[0]->size();
-			int halfmaker = (int)pow(2, _bitmaps.size());
-			dseed::size3i currentSize(mainSize.width / halfmaker, mainSize.height / halfmaker, mainSize.depth / halfmaker);
-			if (currentSize.width <= 0) currentSize.width = 1;
-			if (currentSize.height <= 0) currentSize.height = 1;
-			if (currentSize.depth <= 0) currentSize.depth = 1;
-
+			auto currentSize = __dds_level_size(_bitmaps[0]->size(), _bitmaps.size(),
+				_bitmaps[0]->type() == bitmaps::bitmaptype::bitmap3d);
 			auto bitmapSize = bitmap->size();
-			if (currentSize.width != bitmapSize.width || currentSize.height != bitmapSize.height || currentSize.depth != bitmapSize.height)
+			if (currentSize.width != bitmapSize.width || currentSize.height != bitmapSize.height || currentSize.depth != bitmapSize.depth)
 				return dseed::error_invalid_args;
-
-			_bitmaps.push_back(bitmap);
 		}
 
+		try { _bitmaps.push_back(bitmap); }
+		catch (...) { return dseed::error_out_of_memory; }
+
 		return dseed::error_good;
 	}
 
@@ -81,99 +94,326 @@ public:
 		if (_bitmaps.size() <= 0)
 			return dseed::error_invalid_op;
 
-		_stream->write(&DDS_MAGIC, 4);
+		if (_options.format != dseed::color::pixelformat::unknown)
+			return commit_generated();
 
 		auto format = _bitmaps[0]->format();
 		dseed::size3i mainSize = _bitmaps[0]->size();
 		auto type = _bitmaps[0]->type();
 
-		DDS_HEADER header = {};
-		set_header(header, format, type, mainSize);
-		_stream->write(&header, sizeof(header));
-
-		if (format == dseed::color::pixelformat::bc6 || format == dseed::color::pixelformat::bc7
-			|| format == dseed::color::pixelformat::yuyv8
-			|| format == dseed::color::pixelformat::nv12
-			|| format == dseed::color::pixelformat::astc4x4
-			|| format == dseed::color::pixelformat::astc5x4
-			|| format == dseed::color::pixelformat::astc5x5
-			|| format == dseed::color::pixelformat::astc6x5
-			|| format == dseed::color::pixelformat::astc6x6
-			|| format == dseed::color::pixelformat::astc8x5
-			|| format == dseed::color::pixelformat::astc8x6
-			|| format == dseed::color::pixelformat::astc8x8
-			|| format == dseed::color::pixelformat::astc10x5
-			|| format == dseed::color::pixelformat::astc10x6
-			|| format == dseed::color::pixelformat::astc10x8
-			|| format == dseed::color::pixelformat::astc10x10
-			|| format == dseed::color::pixelformat::astc12x10
-			|| format == dseed::color::pixelformat::astc12x12)
+		if (auto err = write_header(format, type, mainSize, _bitmaps.size(), 1); dseed::failed(err))
+			return err;
+
+		// Faces of cubemap are stored one by one with their whole mip chain
+		const size_t faces = type == dseed::bitmaps::bitmaptype::bitmap2dcube ? (size_t)mainSize.depth : 1;
+		std::vector<uint8_t> pixels;
+		for (size_t face = 0; face < faces; ++face)
+		{
+			for (auto& bitmap : _bitmaps)
+			{
+				auto currentSize = bitmap->size();
+				const size_t planeSize = dseed::color::calc_bitmap_plane_size(format, dseed::size2i(currentSize.width, currentSize.height));
+				const size_t depth = faces > 1 ? 1 : (size_t)currentSize.depth;
+
+				try { pixels.resize(planeSize * depth); }
+				catch (...) { return dseed::error_out_of_memory; }
+				for (size_t d = 0; d < depth; ++d)
+					bitmap->copy_pixels(pixels.data() + (planeSize * d), faces > 1 ? face : d);
+
+				if (_stream->write(pixels.data(), pixels.size()) != pixels.size())
+					return dseed::error_io;
+			}
+		}
+
+		return _stream->commit();
+	}
+
+	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::mipmap; }
+
+private:
+	// Generates and stores every mip level from source frame
+	//  : Work of each level is split to bands of block rows in every slice; a band compresses its rows
+	//    and box-filters the same rows into next level, so source pixels are read once while they are in cache.
+	//  : Output is placed in file order of one buffer, then written at once.
+	dseed::error_t commit_generated() noexcept
+	{
+		using namespace dseed;
+
+		const auto format = _options.format;
+		const bool block = __bc_block_bytes(format) > 0;
+		if (!block && format != color::pixelformat::rgba8 && format != color::pixelformat::bgra8)
+			return dseed::error_not_support;
+
+		autoref<bitmaps::bitmap> source = _bitmaps[0];
+		if (source->format() != color::pixelformat::rgba8)
+		{
+			autoref<bitmaps::bitmap> converted;
+			if (auto err = bitmaps::reformat_bitmap(source, color::pixelformat::rgba8, &converted); dseed::failed(err))
+				return err;
+			source = converted;
+		}
+
+		const auto type = source->type();
+		const auto size = source->size();
+		const size_t slices = (size_t)size.depth;
+		const size_t arraySize = type == bitmaps::bitmaptype::bitmap3d ? slices : 1;
+
+		size_t levels = 1;
+		while ((size.width >> levels) > 0 || (size.height >> levels) > 0)
+			++levels;
+		if (_options.mip_levels > 0)
+			levels = minimum(levels, (size_t)_options.mip_levels);
+
+		const size_t threads = _options.threads <= 0 ? 0 : (size_t)_options.threads;
+
+		std::vector<size3i> sizes(levels);
+		std::vector<size_t> offsets(levels);
+		size_t sliceStride = 0;
+		for (size_t level = 0; level < levels; ++level)
+		{
+			sizes[level] = __dds_level_size(size, level, false);
+			offsets[level] = sliceStride;
+			sliceStride += color::calc_bitmap_plane_size(format, size2i(sizes[level].width, sizes[level].height));
+		}
+
+		std::vector<uint8_t> output;
+		std::vector<autoref<bitmaps::bitmap>> resized;
+		std::vector<std::vector<uint8_t>> boxed;
+		try
+		{
+			output.resize(sliceStride * slices);
+			if (_options.mip_filter == bitmaps::resize::bilinear)
+				boxed.resize(levels);
+			else
+				resized.resize(levels);
+		}
+		catch (...) { return dseed::error_out_of_memory; }
+
+		// Filters other than box cannot be fused, so every level is resized from source first
+		if (_options.mip_filter != bitmaps::resize::bilinear)
+		{
+			resized[0] = source;
+			std::atomic<bool> failed(false);
+			bitmaps::parallel::for_each(levels - 1, [&](size_t i)
+			{
+				if (dseed::failed(bitmaps::resize_bitmap(source, _options.mip_filter, sizes[i + 1], &resized[i + 1])))
+					failed = true;
+			}, threads);
+			if (failed)
+				return dseed::error_fail;
+		}
+
+		// Source level and resized levels are read in place
+		std::vector<uint8_t*> locked(levels, nullptr);
+		std::vector<bitmaps::bitmap*> lockedBitmaps;
+		auto unlock = [&]()
 		{
-			DDS_HEADER_DXT10 bc7header = {};
-			if (type == dseed::bitmaps::bitmaptype::bitmap2d || type == dseed::bitmaps::bitmaptype::bitmap2dcube)
-				bc7header.resourceDimension = 3;
-			else if (type == dseed::bitmaps::bitmaptype::bitmap3d)
-				bc7header.resourceDimension = 4;
+			for (auto bitmap : lockedBitmaps)
+				bitmap->unlock();
+		};
 
-			switch (format)
+		for (size_t level = 0; level < levels; ++level)
+		{
+			bool succeeded = true;
+			if (level == 0 || !resized.empty())
 			{
-			case dseed::color::pixelformat::bc6: bc7header.dxgiFormat = DXGI_FORMAT_BC6H_SF16; break;
-			case dseed::color::pixelformat::bc7: bc7header.dxgiFormat = DXGI_FORMAT_BC7_UNORM; break;
-
-			case dseed::color::pixelformat::yuva8: bc7header.dxgiFormat = DXGI_FORMAT_YUY2; break;
-			case dseed::color::pixelformat::nv12: bc7header.dxgiFormat = DXGI_FORMAT_NV12; break;
-
-			case dseed::color::pixelformat::astc4x4: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_4X4_UNORM; break;
-			case dseed::color::pixelformat::astc5x4: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_5X4_UNORM; break;
-			case dseed::color::pixelformat::astc5x5: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_5X5_UNORM; break;
-			case dseed::color::pixelformat::astc6x5: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_6X5_UNORM; break;
-			case dseed::color::pixelformat::astc6x6: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_6X6_UNORM; break;
-			case dseed::color::pixelformat::astc8x5: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_8X5_UNORM; break;
-			case dseed::color::pixelformat::astc8x6: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_8X6_UNORM; break;
-			case dseed::color::pixelformat::astc8x8: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_8X8_UNORM; break;
-			case dseed::color::pixelformat::astc10x5: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_10X5_UNORM; break;
-			case dseed::color::pixelformat::astc10x6: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_10X6_UNORM; break;
-			case dseed::color::pixelformat::astc10x8: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_10X8_UNORM; break;
-			case dseed::color::pixelformat::astc10x10: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_10X10_UNORM; break;
-			case dseed::color::pixelformat::astc12x10: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_12X10_UNORM; break;
-			case dseed::color::pixelformat::astc12x12: bc7header.dxgiFormat = DXGI_FORMAT_ASTC_12X12_UNORM; break;
-
-			default: return dseed::error_fail;
+				bitmaps::bitmap* bitmap = level == 0 ? source.get() : resized[level].get();
+				succeeded = dseed::succeeded(bitmap->lock((void**)&locked[level]));
+				if (succeeded)
+				{
+					try { lockedBitmaps.push_back(bitmap); }
+					catch (...) { bitmap->unlock(); succeeded = false; }
+				}
+			}
+			else
+			{
+				try
+				{
+					boxed[level].resize((size_t)sizes[level].width * sizes[level].height * 4 * slices);
+					locked[level] = boxed[level].data();
+				}
+				catch (...) { succeeded = false; }
 			}
 
-			_stream->write(&bc7header, sizeof(bc7header));
+			if (!succeeded)
+			{
+				unlock();
+				return dseed::error_fail;
+			}
 		}
 
-		size_t currentMip = 0;
-		for (auto& bitmap : _bitmaps)
+		constexpr size_t bandRows = 16;
+		for (size_t level = 0; level < levels; ++level)
 		{
-			auto mainSize = bitmap->size();
-			int halfmaker = (int)pow(2, currentMip++);
-			dseed::size3i currentSize(mainSize.width / halfmaker, mainSize.height / halfmaker, mainSize.depth / halfmaker);
-			size_t stride = dseed::color::calc_bitmap_stride(format, currentSize.width);
+			const size3i current = sizes[level];
+			const size_t stride = (size_t)current.width * 4, planeSize = stride * current.height;
+			const size_t bands = (current.height + bandRows - 1) / bandRows;
+			const bool downsample = !boxed.empty() && level + 1 < levels;
+
+			bitmaps::parallel::for_each(bands * slices, [&](size_t job)
+			{
+				const size_t slice = job / bands, band = job % bands;
+				const int y0 = (int)(band * bandRows), y1 = minimum((int)(y0 + bandRows), current.height);
+				const uint8_t* pixels = locked[level] + planeSize * slice;
+				uint8_t* dest = output.data() + sliceStride * slice + offsets[level];
+
+				if (block)
+				{
+					const size_t blockBytes = __bc_block_bytes(format);
+					const int blocksPerRow = (current.width + 3) / 4;
+					uint8_t rgba[64];
+					for (int by = y0 / 4; by * 4 < y1; ++by)
+					{
+						for (int bx = 0; bx < blocksPerRow; ++bx)
+						{
+							__bc_fetch_block(pixels, stride, current.width, current.height, bx, by, rgba);
+							__bc_encode_block(format, rgba, dest + (by * (size_t)blocksPerRow + bx) * blockBytes);
+						}
+					}
+				}
+				else
+				{
+					for (int y = y0; y < y1; ++y)
+					{
+						const uint8_t* src = pixels + stride * y;
+						uint8_t* dst = dest + stride * y;
+						if (format == color::pixelformat::rgba8)
+							memcpy(dst, src, stride);
+						else
+						{
+							for (int x = 0; x < current.width; ++x)
+							{
+								dst[x * 4 + 0] = src[x * 4 + 2];
+								dst[x * 4 + 1] = src[x * 4 + 1];
+								dst[x * 4 + 2] = src[x * 4 + 0];
+								dst[x * 4 + 3] = src[x * 4 + 3];
+							}
+						}
+					}
+				}
+
+				if (!downsample)
+					return;
+
+				// Rows of next level whose first source row is in this band
+				const size3i next = sizes[level + 1];
+				const size_t nextStride = (size_t)next.width * 4;
+				uint8_t* nextPixels = locked[level + 1] + nextStride * next.height * slice;
+				for (int ny = y0 / 2; ny < next.height && ny * 2 < y1; ++ny)
+				{
+					const uint8_t* row0 = pixels + stride * (ny * 2);
+					const uint8_t* row1 = pixels + stride * minimum(ny * 2 + 1, current.height - 1);
+					uint8_t* dst = nextPixels + nextStride * ny;
+					for (int nx = 0; nx < next.width; ++nx)
+					{
+						const int x0 = nx * 2 * 4, x1 = minimum(nx * 2 + 1, current.width - 1) * 4;
+						for (int c = 0; c < 4; ++c)
+							dst[nx * 4 + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+					}
+				}
+			}, threads);
+		}
+
+		unlock();
+
+		if (auto err = write_header(format, type, size, levels, arraySize); dseed::failed(err))
+			return err;
+		if (_stream->write(output.data(), output.size()) != output.size())
+			return dseed::error_io;
+
+		return _stream->commit();
+	}
 
-			std::vector<uint8_t> pixels;
-			pixels.resize(stride * currentSize.height * currentSize.depth);
-			for (int d = 0; d < currentSize.depth; ++d)
-				bitmap->copy_pixels(pixels.data() + (stride * currentSize.height * d), d);
+	dseed::error_t write_header(dseed::color::pixelformat format, dseed::bitmaps::bitmaptype type, const dseed::size3i& size,
+		size_t levels, size_t arraySize) noexcept
+	{
+		DDS_HEADER header = {};
+		set_header(header, format, type, size, levels);
 
-			_stream->write(pixels.data(), pixels.size());
+		// Slices of texture array are described only by DX10 header
+		const bool array = arraySize > 1;
+		if (array)
+		{
+			type = dseed::bitmaps::bitmaptype::bitmap2d;
+			header.flags &= ~DDS_HEADER_FLAGS_VOLUME;
+			header.caps2 = 0;
+			header.depth = 0;
+			header.ddspf = {};
+			header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+			header.ddspf.flags = DDS_FOURCC;
+			header.ddspf.fourCC = make_fourcc('D', 'X', '1', '0');
+		}
+
+		if (_stream->write(&DDS_MAGIC, 4) != 4 || _stream->write(&header, sizeof(header)) != sizeof(header))
+			return dseed::error_io;
+
+		if (header.ddspf.fourCC == make_fourcc('D', 'X', '1', '0'))
+		{
+			DDS_HEADER_DXT10 dx10Header = {};
+			dx10Header.dxgiFormat = dxgi_format(format);
+			if (dx10Header.dxgiFormat == DXGI_FORMAT_UNKNOWN)
+				return dseed::error_not_support;
+			dx10Header.resourceDimension = type == dseed::bitmaps::bitmaptype::bitmap3d ? 4 : 3;
+			dx10Header.miscFlag = type == dseed::bitmaps::bitmaptype::bitmap2dcube ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+			dx10Header.arraySize = (uint32_t)arraySize;
+
+			if (_stream->write(&dx10Header, sizeof(dx10Header)) != sizeof(dx10Header))
+				return dseed::error_io;
 		}
 
-		_stream->flush();
 		return dseed::error_good;
 	}
 
+	static uint32_t dxgi_format(dseed::color::pixelformat format) noexcept
+	{
+		switch (format)
+		{
+		case dseed::color::pixelformat::bc1: return DXGI_FORMAT_BC1_UNORM;
+		case dseed::color::pixelformat::bc2: return DXGI_FORMAT_BC2_UNORM;
+		case dseed::color::pixelformat::bc3: return DXGI_FORMAT_BC3_UNORM;
+		case dseed::color::pixelformat::bc4: return DXGI_FORMAT_BC4_UNORM;
+		case dseed::color::pixelformat::bc5: return DXGI_FORMAT_BC5_UNORM;
+		case dseed::color::pixelformat::bc6: return DXGI_FORMAT_BC6H_SF16;
+		case dseed::color::pixelformat::bc7: return DXGI_FORMAT_BC7_UNORM;
+
+		case dseed::color::pixelformat::rgba8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+		case dseed::color::pixelformat::bgra8: return DXGI_FORMAT_B8G8R8A8_UNORM;
+		case dseed::color::pixelformat::bgra4: return DXGI_FORMAT_B4G4R4A4_UNORM;
+
+		case dseed::color::pixelformat::yuva8: return DXGI_FORMAT_AYUV;
+		case dseed::color::pixelformat::yuyv8: return DXGI_FORMAT_YUY2;
+		case dseed::color::pixelformat::nv12: return DXGI_FORMAT_NV12;
+
+		case dseed::color::pixelformat::r8: return DXGI_FORMAT_R8_UNORM;
+		case dseed::color::pixelformat::rf: return DXGI_FORMAT_R32_FLOAT;
+
+		case dseed::color::pixelformat::astc4x4: return DXGI_FORMAT_ASTC_4X4_UNORM;
+		case dseed::color::pixelformat::astc5x4: return DXGI_FORMAT_ASTC_5X4_UNORM;
+		case dseed::color::pixelformat::astc5x5: return DXGI_FORMAT_ASTC_5X5_UNORM;
+		case dseed::color::pixelformat::astc6x5: return DXGI_FORMAT_ASTC_6X5_UNORM;
+		case dseed::color::pixelformat::astc6x6: return DXGI_FORMAT_ASTC_6X6_UNORM;
+		case dseed::color::pixelformat::astc8x5: return DXGI_FORMAT_ASTC_8X5_UNORM;
+		case dseed::color::pixelformat::astc8x6: return DXGI_FORMAT_ASTC_8X6_UNORM;
+		case dseed::color::pixelformat::astc8x8: return DXGI_FORMAT_ASTC_8X8_UNORM;
+		case dseed::color::pixelformat::astc10x5: return DXGI_FORMAT_ASTC_10X5_UNORM;
+		case dseed::color::pixelformat::astc10x6: return DXGI_FORMAT_ASTC_10X6_UNORM;
+		case dseed::color::pixelformat::astc10x8: return DXGI_FORMAT_ASTC_10X8_UNORM;
+		case dseed::color::pixelformat::astc10x10: return DXGI_FORMAT_ASTC_10X10_UNORM;
+		case dseed::color::pixelformat::astc12x10: return DXGI_FORMAT_ASTC_12X10_UNORM;
+		case dseed::color::pixelformat::astc12x12: return DXGI_FORMAT_ASTC_12X12_UNORM;
+
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
 private:
-	void set_header(DDS_HEADER& header, dseed::color::pixelformat format, dseed::bitmaps::bitmaptype type, const dseed::size3i& size)
+	void set_header(DDS_HEADER& header, dseed::color::pixelformat format, dseed::bitmaps::bitmaptype type, const dseed::size3i& size, size_t levels)
 	{
 		using namespace dseed;
 		header.size = sizeof(DDS_HEADER);
 		header.width = size.width;
 		header.height = size.height;
-		header.caps = 0x1000;
-		if (_bitmaps.size() > 1)
-			header.mipMapCount = (uint32_t)(_bitmaps.size() - 1);
+		header.caps = DDS_SURFACE_FLAGS_TEXTURE;
 		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
 		switch (format)
 		{
@@ -209,6 +449,8 @@ private:
 			break;
 		case color::pixelformat::bc6:
 		case color::pixelformat::bc7:
+		case color::pixelformat::yuyv8:
+		case color::pixelformat::nv12:
 		case color::pixelformat::astc4x4:
 		case color::pixelformat::astc5x4:
 		case color::pixelformat::astc5x5:
@@ -351,25 +593,35 @@ private:
 			header.ddspf.ABitMask = 0x00000000;
 			break;
 		}
+		if (levels > 1)
+		{
+			header.flags |= DDS_HEADER_FLAGS_MIPMAP;
+			header.mipMapCount = (uint32_t)levels;
+			header.caps |= DDS_SURFACE_FLAGS_MIPMAP;
+		}
 		switch (type)
 		{
 		case dseed::bitmaps::bitmaptype::bitmap2d:
 			break;
 
 		case dseed::bitmaps::bitmaptype::bitmap2dcube:
+			header.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
 			header.caps2 = DDS_CUBEMAP_ALLFACES;
 			break;
 
 		case dseed::bitmaps::bitmaptype::bitmap3d:
 			header.flags |= DDS_HEADER_FLAGS_VOLUME;
+			header.depth = size.depth;
+			header.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+			header.caps2 = DDS_FLAGS_VOLUME;
 			break;
 		}
 	}
-	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::mipmap; }
 
 private:
 	std::atomic<int32_t> _refCount;
-	dseed::autoref<dseed::io::stream> _stream;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
+	dseed::bitmaps::dds_encoder_options _options;
 
 	std::vector<dseed::autoref<dseed::bitmaps::bitmap>> _bitmaps;
 };
@@ -379,10 +631,22 @@ dseed::error_t dseed::bitmaps::create_dds_bitmap_encoder(dseed::io::stream* stre
 	if (stream == nullptr || encoder == nullptr)
 		return dseed::error_invalid_args;
 
-	*encoder = new __dds_encoder(stream);
+	dseed::bitmaps::dds_encoder_options ddsOptions;
+	if (options != nullptr)
+	{
+		if (options->options_size != sizeof(dseed::bitmaps::dds_encoder_options))
+			return dseed::error_invalid_args;
+		ddsOptions = *reinterpret_cast<const dseed::bitmaps::dds_encoder_options*>(options);
+	}
+
+	// Header pieces are gathered in buffer with head of pixels
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed(err))
+		return err;
+
+	*encoder = new __dds_encoder(buffered, ddsOptions);
 	if (*encoder == nullptr)
 		return dseed::error_out_of_memory;
-	return dseed::error_good;
 
 	return dseed::error_good;
-}
\ No newline at end of file
+}
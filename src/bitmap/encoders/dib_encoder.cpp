@@ -16,7 +16,7 @@
 class __dib_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__dib_encoder (dseed::io::stream* stream)
+	__dib_encoder (dseed::io::bufferedstream* stream)
 		: _refCount (1), _stream (stream)
 	{ }
 
@@ -114,13 +114,12 @@ public:
 public:
 	virtual dseed::error_t commit () noexcept override
 	{
-		_stream->flush ();
-		return dseed::error_good;
+		return _stream->commit ();
 	}
 
 private:
 	std::atomic<int32_t> _refCount;
-	dseed::autoref<dseed::io::stream> _stream;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
 };
 
 dseed::error_t dseed::bitmaps::create_dib_bitmap_encoder (dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
@@ -128,7 +127,12 @@ dseed::error_t dseed::bitmaps::create_dib_bitmap_encoder (dseed::io::stream* str
 	if (stream == nullptr || encoder == nullptr)
 		return dseed::error_invalid_args;
 
-	*encoder = new __dib_encoder (stream);
+	// Headers and rows are gathered in buffer
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream (stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed (err))
+		return err;
+
+	*encoder = new __dib_encoder (buffered);
 	if (*encoder == nullptr)
 		return dseed::error_out_of_memory;
 
@@ -3,17 +3,124 @@
 #if defined(USE_GIF) && defined(USE_BITMAP_ENCODERS)
 #	include <gif_lib.h>
 #	include <vector>
+#	include <memory>
+
+#	include "../parallel.hxx"
+
+// Index 255 is kept for transparency of quantized frames
+constexpr int GIF_QUANTIZE_COLORS = 255;
+
+struct __gif_frame
+{
+	dseed::size3i size;
+	dseed::timespan duration;
+
+	std::vector<uint8_t> indices;
+	std::vector<dseed::color::rgb8> palette;
+	int transparent;
+	bool opaque;
+
+	// Truecolor pixels(RGBA order) waiting quantization
+	std::vector<uint8_t> pixels;
+};
+
+// GIF colour table size must be power of two
+ColorMapObject* __make_gif_color_map(const std::vector<dseed::color::rgb8>& palette) noexcept
+{
+	int count = 2;
+	while (count < (int)palette.size())
+		count <<= 1;
+
+	std::vector<GifColorType> colors(count);
+	for (size_t i = 0; i < palette.size(); ++i)
+	{
+		colors[i].Red = palette[i].r;
+		colors[i].Green = palette[i].g;
+		colors[i].Blue = palette[i].b;
+	}
+	return GifMakeMapObject(count, colors.data());
+}
+
+// Forces pixels opaque for quantizer, returns whether frame was opaque
+bool __make_gif_frame_opaque(__gif_frame& frame, std::vector<uint8_t>& transparentMask) noexcept
+{
+	const size_t count = frame.pixels.size() / 4;
+	bool opaque = true;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (frame.pixels[i * 4 + 3] >= 128)
+			continue;
+		if (opaque)
+		{
+			opaque = false;
+			transparentMask.assign(count, 0);
+		}
+		transparentMask[i] = 1;
+	}
+	for (size_t i = 0; i < count; ++i)
+		frame.pixels[i * 4 + 3] = 255;
+	return opaque;
+}
+
+// Maps truecolor frame to palette; palette is made from frame itself when global quantizer is not given
+//  : Ordered dither keeps static area stable across frames, which frame differencing relies on.
+dseed::error_t __quantize_gif_frame(__gif_frame& frame, dseed::bitmaps::bitmap_quantizer* globalQuantizer,
+	const dseed::bitmaps::quantize_options& options) noexcept
+{
+	std::vector<uint8_t> transparentMask;
+	frame.opaque = __make_gif_frame_opaque(frame, transparentMask);
+
+	const auto pixels = reinterpret_cast<const dseed::color::rgba8*>(frame.pixels.data());
+	const size_t count = frame.pixels.size() / 4;
+
+	dseed::autoref<dseed::bitmaps::bitmap_quantizer> frameQuantizer;
+	dseed::bitmaps::bitmap_quantizer* quantizer = globalQuantizer;
+	if (quantizer == nullptr)
+	{
+		if (auto err = dseed::bitmaps::create_bitmap_quantizer(options, &frameQuantizer); dseed::failed(err))
+			return err;
+		if (auto err = frameQuantizer->feed_pixels(pixels, count); dseed::failed(err))
+			return err;
+		if (auto err = frameQuantizer->build(); dseed::failed(err))
+			return err;
+		quantizer = frameQuantizer;
+	}
+
+	std::vector<dseed::color::rgba8> palette(quantizer->palette_size());
+	quantizer->copy_palette(palette.data());
+
+	frame.indices.resize(count);
+	if (auto err = quantizer->map_pixels(pixels, dseed::size2i(frame.size.width, frame.size.height), frame.indices.data(), 0);
+		dseed::failed(err))
+		return err;
+
+	frame.palette.resize(palette.size());
+	for (size_t i = 0; i < frame.palette.size(); ++i)
+		frame.palette[i] = dseed::color::rgb8(palette[i].r, palette[i].g, palette[i].b);
+	frame.transparent = (int)frame.palette.size();
+	frame.palette.push_back(dseed::color::rgb8(0, 0, 0));
+
+	if (!frame.opaque)
+	{
+		for (size_t i = 0; i < count; ++i)
+			if (transparentMask[i])
+				frame.indices[i] = (uint8_t)frame.transparent;
+	}
+
+	std::vector<uint8_t>().swap(frame.pixels);
+	return dseed::error_good;
+}
 
 class __gif_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__gif_encoder(dseed::io::stream* stream)
-		: _refCount(1), _stream(stream), _pgif(nullptr), _isFirst(true), _transparent(-1)
+	__gif_encoder(dseed::io::bufferedstream* stream, const dseed::bitmaps::gif_encoder_options& options)
+		: _refCount(1), _stream(stream), _options(options), _pgif(nullptr), _isFirst(true), _canvasValid(false)
 	{
 		int err;
 		_pgif = EGifOpen(stream, [](GifFileType* file, const GifByteType* buf, int len) -> int
 			{
-				return (int) reinterpret_cast<dseed::io::stream*>(file->UserData)->write(buf, len);
+				return (int) reinterpret_cast<dseed::io::bufferedstream*>(file->UserData)->write(buf, len);
 			}, &err
 		);
 		if (_pgif == nullptr)
@@ -41,163 +148,406 @@ public:
 		if (_pgif == nullptr) return dseed::error_fail;
 		if (bitmap == nullptr)
 			return dseed::error_invalid_args;
-		if ((!(bitmap->format() == dseed::color::pixelformat::bgr8_indexed8 || bitmap->format() == dseed::color::pixelformat::bgra8_indexed8))
-			|| (bitmap->size().depth > 1))
+
+		const auto format = bitmap->format();
+		const auto size = bitmap->size();
+		const bool indexed = (format == dseed::color::pixelformat::bgr8_indexed8 || format == dseed::color::pixelformat::bgra8_indexed8);
+		if (!(indexed || format == dseed::color::pixelformat::rgba8 || format == dseed::color::pixelformat::rgb8
+			|| format == dseed::color::pixelformat::bgra8 || format == dseed::color::pixelformat::bgr8)
+			|| (size.depth > 1))
 			return dseed::error_not_support;
 
-		auto size = bitmap->size();
-		ColorMapObject* cmo = nullptr;
+		std::unique_ptr<__gif_frame> frame(new (std::nothrow) __gif_frame());
+		if (frame == nullptr)
+			return dseed::error_out_of_memory;
+		frame->size = size;
 
-		if (_isFirst)
+		dseed::autoref<dseed::attributes> attr;
+		bitmap->extra_info(&attr);
+		if (attr == nullptr || dseed::failed(attr->get_int64(dseed::attrkey_duration, (int64_t*)&frame->duration)))
+			frame->duration = 0;
+
+		try
 		{
-			EGifSetGifVersion(_pgif, true);
+			if (indexed)
+			{
+				if (auto err = read_indexed_frame(bitmap, *frame); dseed::failed(err))
+					return err;
+			}
+			else
+				read_truecolor_frame(bitmap, *frame);
+
+			_pending.push_back(std::move(frame));
+		}
+		catch (...)
+		{
+			return dseed::error_out_of_memory;
+		}
 
-			if (bitmap->format() == dseed::color::pixelformat::bgr8_indexed8)
+		// Global palette needs every frame; otherwise frames are quantized in batches of worker count
+		if (!_options.global_palette && (indexed || _pending.size() >= batch_size()))
+			return flush();
+
+		return dseed::error_good;
+	}
+
+	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
+
+public:
+	virtual dseed::error_t commit() noexcept override
+	{
+		if (_pgif == nullptr) return dseed::error_fail;
+
+		if (auto err = flush(); dseed::failed(err))
+			return err;
+
+		return _stream->commit();
+	}
+
+public:
+	bool isInitialized() { return _pgif != nullptr; }
+
+private:
+	size_t batch_size() const noexcept
+	{
+		return _options.threads > 0 ? (size_t)_options.threads : dseed::bitmaps::parallel::concurrency();
+	}
+
+	dseed::error_t read_indexed_frame(dseed::bitmaps::bitmap* bitmap, __gif_frame& frame)
+	{
+		dseed::autoref<dseed::bitmaps::palette> paletteObj;
+		if (dseed::failed(bitmap->palette(&paletteObj)))
+			return dseed::error_fail;
+
+		size_t paletteSize = paletteObj->size();
+		if (paletteSize == 0 || paletteSize > 256)
+			return dseed::error_invalid_args;
+		frame.palette.resize(paletteSize);
+		frame.transparent = -1;
+		if (bitmap->format() == dseed::color::pixelformat::bgr8_indexed8)
+		{
+			std::vector<dseed::color::bgr8> tempPalette(256);
+			paletteObj->copy_palette(tempPalette.data());
+			for (size_t i = 0; i < paletteSize; ++i)
+				frame.palette[i] = dseed::color::rgb8(tempPalette[i].r, tempPalette[i].g, tempPalette[i].b);
+		}
+		else
+		{
+			std::vector<dseed::color::bgra8> tempPalette(256);
+			paletteObj->copy_palette(tempPalette.data());
+			for (size_t i = 0; i < paletteSize; ++i)
 			{
-				std::vector<dseed::color::bgr8> tempPalette(256);
-				dseed::autoref<dseed::bitmaps::palette> paletteObj;
-				bitmap->palette(&paletteObj);
-				paletteObj->copy_palette(tempPalette.data());
-				size_t paletteSize = paletteObj->size();
-				_palette.resize(paletteSize);
-				for (int i = 0; i < paletteSize; ++i)
-				{
-					_palette[i].b = tempPalette[i].b;
-					_palette[i].g = tempPalette[i].g;
-					_palette[i].r = tempPalette[i].r;
-				}
+				frame.palette[i] = dseed::color::rgb8(tempPalette[i].r, tempPalette[i].g, tempPalette[i].b);
+				if (frame.transparent == -1 && tempPalette[i].a != 255)
+					frame.transparent = (int)i;
+			}
+		}
+
+		frame.indices.resize((size_t)frame.size.width * frame.size.height);
+		if (dseed::failed(bitmap->copy_pixels(frame.indices.data(), 0)))
+			return dseed::error_fail;
+
+		frame.opaque = true;
+		for (auto index : frame.indices)
+		{
+			if (index >= paletteSize)
+				return dseed::error_invalid_args;
+			if (index == frame.transparent)
+				frame.opaque = false;
+		}
+
+		if (frame.transparent == -1 && paletteSize < 256)
+		{
+			frame.transparent = (int)paletteSize;
+			frame.palette.push_back(dseed::color::rgb8(0, 0, 0));
+		}
+
+		return dseed::error_good;
+	}
+
+	void read_truecolor_frame(dseed::bitmaps::bitmap* bitmap, __gif_frame& frame)
+	{
+		const auto format = bitmap->format();
+		const size_t width = frame.size.width, height = frame.size.height;
+		const size_t stride = dseed::color::calc_bitmap_stride(format, frame.size.width);
+		const size_t bpp = (format == dseed::color::pixelformat::rgba8 || format == dseed::color::pixelformat::bgra8) ? 4 : 3;
+		const bool bgr = (format == dseed::color::pixelformat::bgra8 || format == dseed::color::pixelformat::bgr8);
+
+		frame.pixels.resize(width * height * 4);
+
+		uint8_t* ptr;
+		bitmap->lock((void**)&ptr);
+		for (size_t y = 0; y < height; ++y)
+		{
+			const uint8_t* src = ptr + y * stride;
+			uint8_t* dest = frame.pixels.data() + y * width * 4;
+			for (size_t x = 0; x < width; ++x, src += bpp, dest += 4)
+			{
+				dest[0] = src[bgr ? 2 : 0];
+				dest[1] = src[1];
+				dest[2] = src[bgr ? 0 : 2];
+				dest[3] = bpp == 4 ? src[3] : 255;
 			}
-			else if (bitmap->format() == dseed::color::pixelformat::bgra8_indexed8)
+		}
+		bitmap->unlock();
+	}
+
+	dseed::error_t flush() noexcept
+	{
+		if (_pending.empty())
+			return dseed::error_good;
+
+		// Quantizers run on single thread when frames are already spread over workers
+		const size_t batch = dseed::minimum(batch_size(), _pending.size());
+		const auto options = quantize_options(batch > 1 ? 1 : 0);
+
+		// Frames share lookup cache of global quantizer
+		dseed::autoref<dseed::bitmaps::bitmap_quantizer> globalQuantizer;
+		if (_options.global_palette)
+		{
+			if (auto err = make_global_quantizer(options, &globalQuantizer); dseed::failed(err))
+				return err;
+		}
+
+		std::atomic<dseed::error_t> result(dseed::error_good);
+		dseed::bitmaps::parallel::for_each(_pending.size(), [&](size_t i)
 			{
-				std::vector<dseed::color::bgra8> tempPalette(256);
-				dseed::autoref<dseed::bitmaps::palette> paletteObj;
-				bitmap->palette(&paletteObj);
-				paletteObj->copy_palette(tempPalette.data());
-				size_t paletteSize = paletteObj->size();
-				_palette.resize(paletteSize);
-				for (int i = 0; i < paletteSize; ++i)
-				{
-					_palette[i].b = tempPalette[i].b;
-					_palette[i].g = tempPalette[i].g;
-					_palette[i].r = tempPalette[i].r;
-					if (_transparent == -1 && tempPalette[i].a != 255)
-						_transparent = i;
-				}
+				auto& frame = *_pending[i];
+				if (frame.pixels.empty())
+					return;
+				if (auto err = __quantize_gif_frame(frame, globalQuantizer, options); dseed::failed(err))
+					result = err;
+			}, batch);
+
+		dseed::error_t err = result;
+		for (auto& frame : _pending)
+		{
+			if (dseed::succeeded(err))
+				err = write_frame(*frame);
+		}
+		_pending.clear();
+
+		return err;
+	}
+
+	dseed::bitmaps::quantize_options quantize_options(int threads) const noexcept
+	{
+		return dseed::bitmaps::quantize_options(_options.quantize, _options.dither, GIF_QUANTIZE_COLORS,
+			dseed::bitmaps::quantize_options().sample_limit, false, threads);
+	}
+
+	dseed::error_t make_global_quantizer(const dseed::bitmaps::quantize_options& options,
+		dseed::bitmaps::bitmap_quantizer** quantizer) noexcept
+	{
+		dseed::autoref<dseed::bitmaps::bitmap_quantizer> temp;
+		if (auto err = dseed::bitmaps::create_bitmap_quantizer(options, &temp); dseed::failed(err))
+			return err;
+
+		// Transparent pixels are left out of histogram
+		std::vector<dseed::color::rgba8> opaque;
+		bool fed = false;
+		for (auto& frame : _pending)
+		{
+			if (frame->pixels.empty())
+				continue;
+			try
+			{
+				opaque.clear();
+				for (size_t i = 0; i < frame->pixels.size(); i += 4)
+					if (frame->pixels[i + 3] >= 128)
+						opaque.push_back(dseed::color::rgba8(frame->pixels[i], frame->pixels[i + 1], frame->pixels[i + 2]));
 			}
-			cmo = GifMakeMapObject((int)_palette.size(), (const GifColorType*)_palette.data());
-			EGifPutScreenDesc(_pgif, size.width, size.height, (int)_palette.size(), _transparent, cmo);
+			catch (...)
+			{
+				return dseed::error_out_of_memory;
+			}
+			if (!opaque.empty())
+			{
+				if (auto err = temp->feed_pixels(opaque.data(), opaque.size()); dseed::failed(err))
+					return err;
+				fed = true;
+			}
+		}
+
+		if (fed)
+		{
+			if (auto err = temp->build(); dseed::failed(err))
+				return err;
+		}
+		else
+		{
+			const dseed::color::rgba8 black(0, 0, 0);
+			if (auto err = temp->set_palette(&black, 1); dseed::failed(err))
+				return err;
+		}
+
+		*quantizer = temp.detach();
+		return dseed::error_good;
+	}
+
+	dseed::error_t write_frame(__gif_frame& frame) noexcept
+	{
+		ColorMapObject* cmo = nullptr;
+
+		if (_isFirst)
+		{
+			EGifSetGifVersion(_pgif, true);
+
+			_screen = frame.size;
+			_palette = frame.palette;
+			cmo = __make_gif_color_map(_palette);
+			EGifPutScreenDesc(_pgif, _screen.width, _screen.height, 8, 0, cmo);
+			GifFreeMapObject(cmo);
+			cmo = nullptr;
 
 			char netscape_extension[] = "NETSCAPE2.0";
-			EGifPutExtension(_pgif, APPLICATION_EXT_FUNC_CODE, 11, netscape_extension);
 			char animation_extension[] = { 1, 0, 0 };
-			EGifPutExtension(_pgif, APPLICATION_EXT_FUNC_CODE, 3, animation_extension);
+			EGifPutExtensionLeader(_pgif, APPLICATION_EXT_FUNC_CODE);
+			EGifPutExtensionBlock(_pgif, 11, netscape_extension);
+			EGifPutExtensionBlock(_pgif, 3, animation_extension);
+			EGifPutExtensionTrailer(_pgif);
+
+			_isFirst = false;
 		}
-		else
+		else if (frame.palette != _palette)
+			cmo = __make_gif_color_map(frame.palette);
+
+		int left = 0, top = 0, width = frame.size.width, height = frame.size.height;
+		int disposal = 3;
+		bool useTransparent = !frame.opaque;
+
+		if (_options.frame_differencing && frame.opaque
+			&& frame.size.width == _screen.width && frame.size.height == _screen.height)
 		{
-			std::vector<dseed::color::rgb8> tempPalette(256);
-			int transparent = -1;
-			if (bitmap->format() == dseed::color::pixelformat::bgr8_indexed8)
+			// Unchanged pixels are transparent, so canvas must be kept under this frame
+			disposal = 1;
+			if (_canvasValid)
 			{
-				std::vector<dseed::color::bgr8> tempTempPalette(256);
-				dseed::autoref<dseed::bitmaps::palette> paletteObj;
-				bitmap->palette(&paletteObj);
-				paletteObj->copy_palette(tempTempPalette.data());
-				size_t paletteSize = paletteObj->size();
-				tempPalette.resize(paletteSize);
-				for (int i = 0; i < paletteSize; ++i)
+				if (!diff_rect(frame, left, top, width, height))
 				{
-					tempPalette[i].b = tempTempPalette[i].b;
-					tempPalette[i].g = tempTempPalette[i].g;
-					tempPalette[i].r = tempTempPalette[i].r;
+					width = height = 1;
 				}
-			}
-			else if (bitmap->format() == dseed::color::pixelformat::bgra8_indexed8)
-			{
-				std::vector<dseed::color::bgra8> tempTempPalette(256);
-				dseed::autoref<dseed::bitmaps::palette> paletteObj;
-				bitmap->palette(&paletteObj);
-				paletteObj->copy_palette(tempTempPalette.data());
-				size_t paletteSize = paletteObj->size();
-				tempPalette.resize(paletteSize);
-				for (int i = 0; i < paletteSize; ++i)
+				if (frame.transparent != -1)
 				{
-					tempPalette[i].b = tempTempPalette[i].b;
-					tempPalette[i].g = tempTempPalette[i].g;
-					tempPalette[i].r = tempTempPalette[i].r;
-					if (transparent == -1 && tempTempPalette[i].a != 255)
-						transparent = i;
+					for (int y = top; y < top + height; ++y)
+					{
+						for (int x = left; x < left + width; ++x)
+						{
+							const size_t i = (size_t)y * _screen.width + x;
+							if (_canvas[i] == frame.palette[frame.indices[i]])
+								frame.indices[i] = (uint8_t)frame.transparent;
+							else
+								_canvas[i] = frame.palette[frame.indices[i]];
+						}
+					}
+					useTransparent = true;
 				}
+				else
+					update_canvas(frame, left, top, width, height);
 			}
-			for (int i = 0; i < tempPalette.size(); ++i)
+			else
 			{
-				if (_palette[i].r != tempPalette[i].r || _palette[i].g != tempPalette[i].g || _palette[i].b != tempPalette[i].b)
-				{
-					cmo = GifMakeMapObject((int)tempPalette.size(), (const GifColorType*)tempPalette.data());
-					_transparent = transparent;
-					break;
-				}
+				try { _canvas.resize((size_t)_screen.width * _screen.height); }
+				catch (...) { if (cmo) GifFreeMapObject(cmo); return dseed::error_out_of_memory; }
+				update_canvas(frame, left, top, width, height);
+				_canvasValid = true;
 			}
 		}
 
-		dseed::autoref<dseed::attributes> attr;
-		bitmap->extra_info(&attr);
-
-		dseed::timespan duration;
-		if (dseed::failed(attr->get_int64(dseed::attrkey_duration, (int64_t*)&duration)))
-			duration = 0;
-
-		int delay = (int)(duration.total_milliseconds() / 10);
-		char extension[] = { (3 << 2) | (_transparent != -1 ? 1 : 0),
-			(char)(delay % 256), (char)(delay / 256), (char)_transparent };
+		int delay = (int)(frame.duration.total_milliseconds() / 10);
+		const int transparent = useTransparent ? frame.transparent : -1;
+		char extension[] = { (char)((disposal << 2) | (transparent != -1 ? 1 : 0)),
+			(char)(delay % 256), (char)(delay / 256), (char)(transparent != -1 ? transparent : 0) };
 		EGifPutExtension(_pgif, GRAPHICS_EXT_FUNC_CODE, 4, extension);
 
-		EGifPutImageDesc(_pgif, 0, 0, size.width, size.height, false, cmo);
-
-		std::vector<uint8_t> pixels(size.width * size.height);
-		bitmap->copy_pixels(pixels.data(), 0);
+		EGifPutImageDesc(_pgif, left, top, width, height, false, cmo);
 
-		for (int y = 0; y < size.height; ++y)
-			EGifPutLine(_pgif, pixels.data() + (y * size.width), size.width);
+		for (int y = top; y < top + height; ++y)
+			EGifPutLine(_pgif, frame.indices.data() + ((size_t)y * frame.size.width + left), width);
 
 		if (cmo)
 			GifFreeMapObject(cmo);
-		cmo = nullptr;
 
-		_isFirst = false;
 		return dseed::error_good;
 	}
 
-	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
-
-public:
-	virtual dseed::error_t commit() noexcept override
+	// Bounding rectangle of pixels differ from canvas; false if nothing changed
+	bool diff_rect(const __gif_frame& frame, int& left, int& top, int& width, int& height) const noexcept
 	{
-		if (_pgif == nullptr) return dseed::error_fail;
+		int minX = _screen.width, minY = _screen.height, maxX = -1, maxY = -1;
+		for (int y = 0; y < _screen.height; ++y)
+		{
+			const size_t row = (size_t)y * _screen.width;
+			for (int x = 0; x < _screen.width; ++x)
+			{
+				if (_canvas[row + x] == frame.palette[frame.indices[row + x]])
+					continue;
+				minX = dseed::minimum(minX, x);
+				maxX = dseed::maximum(maxX, x);
+				minY = dseed::minimum(minY, y);
+				maxY = y;
+			}
+		}
 
-		EGifSpew(_pgif);
+		if (maxX < 0)
+		{
+			left = top = 0;
+			return false;
+		}
 
-		return dseed::error_good;
+		left = minX;
+		top = minY;
+		width = maxX - minX + 1;
+		height = maxY - minY + 1;
+		return true;
 	}
 
-public:
-	bool isInitialized() { return _pgif != nullptr; }
+	void update_canvas(const __gif_frame& frame, int left, int top, int width, int height) noexcept
+	{
+		for (int y = top; y < top + height; ++y)
+			for (int x = left; x < left + width; ++x)
+			{
+				const size_t i = (size_t)y * _screen.width + x;
+				_canvas[i] = frame.palette[frame.indices[i]];
+			}
+	}
 
 private:
 	std::atomic<int32_t> _refCount;
-	dseed::autoref<dseed::io::stream> _stream;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
+	dseed::bitmaps::gif_encoder_options _options;
 
 	GifFileType* _pgif;
 	bool _isFirst;
 
+	dseed::size3i _screen;
 	std::vector<dseed::color::rgb8> _palette;
-	int _transparent;
+
+	std::vector<std::unique_ptr<__gif_frame>> _pending;
+
+	// Displayed image after last frame which is not disposed
+	std::vector<dseed::color::rgb8> _canvas;
+	bool _canvasValid;
 };
 #endif
 
 dseed::error_t dseed::bitmaps::create_gif_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
 {
 #if defined(USE_GIF) && defined(USE_BITMAP_ENCODERS)
-	auto enc = new __gif_encoder(stream);
+	dseed::bitmaps::gif_encoder_options gifOptions;
+	if (options != nullptr)
+	{
+		if (options->options_size != sizeof(dseed::bitmaps::gif_encoder_options))
+			return dseed::error_invalid_args;
+		gifOptions = *reinterpret_cast<const dseed::bitmaps::gif_encoder_options*>(options);
+	}
+
+	// giflib writes codes of LZW stream in few bytes, so they are gathered
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed(err))
+		return err;
+
+	auto enc = new __gif_encoder(buffered, gifOptions);
 	if (enc == nullptr)
 		return dseed::error_out_of_memory;
 	if (!enc->isInitialized())
@@ -212,4 +562,4 @@ dseed::error_t dseed::bitmaps::create_gif_bitmap_encoder(dseed::io::stream* stre
 #else
 	return dseed::error_not_support;
 #endif
-}
\ No newline at end of file
+}
@@ -5,7 +5,7 @@
 class __ico_cur_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__ico_cur_encoder(dseed::io::stream* stream, bool ico, const dseed::bitmaps::png_encoder_options* options)
+	__ico_cur_encoder(dseed::io::bufferedstream* stream, bool ico, const dseed::bitmaps::png_encoder_options* options)
 		: _refCount(1), _stream(stream), _ico(ico)
 	{
 		if (options)
@@ -122,15 +122,13 @@ public:
 			_stream->write(bytes.data(), bytes.size());
 		}
 
-		_stream->flush();
-
-		return dseed::error_good;
+		return _stream->commit();
 	}
 	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
 
 private:
 	std::atomic<int32_t> _refCount;
-	dseed::autoref<dseed::io::stream> _stream;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
 	bool _ico;
 
 	std::vector<dseed::autoref<dseed::bitmaps::bitmap>> _bitmaps;
@@ -139,13 +137,24 @@ private:
 	dseed::bitmaps::png_encoder_options _options;
 };
 
-dseed::error_t dseed::bitmaps::create_ico_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
+// Entries and images are gathered in buffer
+inline dseed::error_t __create_ico_cur_encoder(dseed::io::stream* stream, bool ico, const dseed::bitmaps::bitmap_encoder_options* options,
+	dseed::bitmaps::bitmap_encoder** encoder) noexcept
 {
-	*encoder = new __ico_cur_encoder(stream, true, reinterpret_cast<const dseed::bitmaps::png_encoder_options*>(options));
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed(err))
+		return err;
+
+	*encoder = new __ico_cur_encoder(buffered, ico, reinterpret_cast<const dseed::bitmaps::png_encoder_options*>(options));
 	if (*encoder == nullptr)
 		return dseed::error_out_of_memory;
 	return dseed::error_good;
 }
+
+dseed::error_t dseed::bitmaps::create_ico_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
+{
+	return __create_ico_cur_encoder(stream, true, options, encoder);
+}
 dseed::error_t dseed::bitmaps::create_cur_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
 {
 	if (options != nullptr)
@@ -153,8 +162,5 @@ dseed::error_t dseed::bitmaps::create_cur_bitmap_encoder(dseed::io::stream* stre
 		if (options->option_type != dseed::bitmaps::bitmap_encoder_options_for_png)
 			return dseed::error_invalid_args;
 	}
-	*encoder = new __ico_cur_encoder(stream, false, reinterpret_cast<const dseed::bitmaps::png_encoder_options*>(options));
-	if (*encoder == nullptr)
-		return dseed::error_out_of_memory;
-	return dseed::error_good;
+	return __create_ico_cur_encoder(stream, false, options, encoder);
 }
\ No newline at end of file
@@ -2,19 +2,22 @@
 
 #if defined(USE_JPEG) && defined(USE_BITMAP_ENCODERS)
 #	include <jpeglib.h>
-#	include <assert.h>
+#	include <vector>
 
 constexpr int OUTPUT_BUF_SIZE = 4096;
 
-void jpeg_stream_dest (j_compress_ptr cinfo, dseed::io::stream* stream)
+// Failed write does not suspend libjpeg(returning FALSE from empty_output_buffer),
+// output is discarded instead and failure is reported after compression.
+struct morisot_destination_mgr
 {
-	struct morisot_destination_mgr
-	{
-		jpeg_destination_mgr pub;
-		dseed::io::stream* stream;
-		JOCTET buffer[OUTPUT_BUF_SIZE];
-	};
+	jpeg_destination_mgr pub;
+	dseed::io::stream* stream;
+	bool failed;
+	JOCTET buffer[OUTPUT_BUF_SIZE];
+};
 
+void jpeg_stream_dest (j_compress_ptr cinfo, dseed::io::stream* stream)
+{
 	morisot_destination_mgr* dest;
 
 	if (cinfo->dest == nullptr)
@@ -31,9 +34,8 @@ void jpeg_stream_dest (j_compress_ptr cinfo, dseed::io::stream* stream)
 	{
 		morisot_destination_mgr* dest = (morisot_destination_mgr*)cinfo->dest;
 
-		auto written = dest->stream->write (dest->buffer, OUTPUT_BUF_SIZE);
-		if (written != OUTPUT_BUF_SIZE)
-			return 0;
+		if (!dest->failed && dest->stream->write (dest->buffer, OUTPUT_BUF_SIZE) != OUTPUT_BUF_SIZE)
+			dest->failed = true;
 
 		dest->pub.next_output_byte = dest->buffer;
 		dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
@@ -46,21 +48,155 @@ void jpeg_stream_dest (j_compress_ptr cinfo, dseed::io::stream* stream)
 		size_t datacount = OUTPUT_BUF_SIZE - dest->pub.free_in_buffer;
 		size_t totalWritten = 0;
 
-		while (datacount > 0) {
+		while (!dest->failed && datacount > 0) {
 			auto written = dest->stream->write (dest->buffer + totalWritten, datacount);
-			assert (!(datacount > 0 && written == 0));
+			if (written == 0)
+			{
+				dest->failed = true;
+				break;
+			}
 			datacount -= written;
 			totalWritten += written;
 		}
 	};
 	dest->stream = stream;
+	dest->failed = false;
 }
 
+void __set_jpeg_sampling (jpeg_compress_struct& cinfo, dseed::bitmaps::jpeg_subsampling subsampling) noexcept
+{
+	cinfo.comp_info[0].h_samp_factor = subsampling == dseed::bitmaps::jpeg_subsampling::yuv444 ? 1 : 2;
+	cinfo.comp_info[0].v_samp_factor = subsampling == dseed::bitmaps::jpeg_subsampling::yuv420 ? 2 : 1;
+	for (int i = 1; i < cinfo.num_components; ++i)
+		cinfo.comp_info[i].h_samp_factor = cinfo.comp_info[i].v_samp_factor = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Raw YUV Input
+//  : Chroma subsampled pixels are already YCbCr at JPEG sampling,
+//    so planes are handed to libjpeg directly without colour conversion and downsampling.
+//  : libjpeg reads whole MCUs, so rows and columns beyond image are replicated from edge.
+//  : Library YUV is limited-range BT.601(Y 16-235, CbCr 16-240),
+//    so samples are expanded to full-range JFIF YCbCr while filling planes.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+class __jpeg_raw_writer
+{
+public:
+	__jpeg_raw_writer (jpeg_compress_struct& cinfo, dseed::color::pixelformat format, const uint8_t* pixels, size_t stride, const dseed::size3i& size)
+		: _cinfo (cinfo), _format (format), _pixels (pixels), _stride (stride), _width (size.width), _height (size.height)
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			_lumaRange[i] = dseed::color::saturate8 (((i - 16) * 255 + 109) / 219);
+			_chromaRange[i] = dseed::color::saturate8 (((i - 128) * 255 + (i >= 128 ? 112 : -112)) / 224 + 128);
+		}
+	}
+
+public:
+	bool prepare () noexcept
+	{
+		const int maxH = _cinfo.comp_info[0].h_samp_factor, maxV = _cinfo.comp_info[0].v_samp_factor;
+		const size_t mcus = (_width + maxH * DCTSIZE - 1) / (maxH * DCTSIZE);
+
+		try
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				const int h = c == 0 ? maxH : 1, v = c == 0 ? maxV : 1;
+				_planeWidth[c] = mcus * h * DCTSIZE;
+				_buffer[c].resize (_planeWidth[c] * v * DCTSIZE);
+				_rows[c].resize (v * DCTSIZE);
+				for (size_t r = 0; r < _rows[c].size (); ++r)
+					_rows[c][r] = _buffer[c].data () + r * _planeWidth[c];
+				_planes[c] = _rows[c].data ();
+			}
+		}
+		catch (...)
+		{
+			return false;
+		}
+
+		_chromaWidth = (_width + 1) / 2;
+		_chromaHeight = maxV == 2 ? (_height + 1) / 2 : _height;
+		return true;
+	}
+
+	void write () noexcept
+	{
+		const size_t lines = _rows[0].size ();
+		const size_t chromaLines = _rows[1].size ();
+		while (_cinfo.next_scanline < _cinfo.image_height)
+		{
+			const size_t top = _cinfo.next_scanline;
+			for (size_t r = 0; r < lines; ++r)
+				fill_luma (_rows[0][r], dseed::minimum (top + r, _height - 1));
+
+			const size_t chromaTop = top / (lines / chromaLines);
+			for (size_t r = 0; r < chromaLines; ++r)
+				fill_chroma (_rows[1][r], _rows[2][r], dseed::minimum (chromaTop + r, _chromaHeight - 1));
+
+			jpeg_write_raw_data (&_cinfo, _planes, (JDIMENSION)lines);
+		}
+	}
+
+private:
+	void fill_luma (uint8_t* dest, size_t y) noexcept
+	{
+		const uint8_t* src = _pixels + y * _stride;
+		const size_t step = _format == dseed::color::pixelformat::nv12 ? 1 : 2;
+		for (size_t x = 0; x < _width; ++x)
+			dest[x] = _lumaRange[src[x * step]];
+		memset (dest + _width, dest[_width - 1], _planeWidth[0] - _width);
+	}
+
+	void fill_chroma (uint8_t* cb, uint8_t* cr, size_t y) noexcept
+	{
+		const uint8_t* src;
+		size_t step, offset;
+		if (_format == dseed::color::pixelformat::nv12)
+		{
+			src = _pixels + _width * _height + y * _chromaWidth * 2;
+			step = 2;
+			offset = 0;
+		}
+		else
+		{
+			src = _pixels + y * _stride;
+			step = 4;
+			offset = 1;
+		}
+
+		for (size_t x = 0; x < _chromaWidth; ++x)
+		{
+			cb[x] = _chromaRange[src[x * step + offset]];
+			cr[x] = _chromaRange[src[x * step + offset + step / 2]];
+		}
+		memset (cb + _chromaWidth, cb[_chromaWidth - 1], _planeWidth[1] - _chromaWidth);
+		memset (cr + _chromaWidth, cr[_chromaWidth - 1], _planeWidth[2] - _chromaWidth);
+	}
+
+private:
+	jpeg_compress_struct& _cinfo;
+	dseed::color::pixelformat _format;
+	const uint8_t* _pixels;
+	size_t _stride;
+	size_t _width, _height, _chromaWidth, _chromaHeight;
+
+	uint8_t _lumaRange[256], _chromaRange[256];
+
+	size_t _planeWidth[3];
+	std::vector<uint8_t> _buffer[3];
+	std::vector<JSAMPROW> _rows[3];
+	JSAMPARRAY _planes[3];
+};
+
 class __jpeg_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__jpeg_encoder (dseed::io::stream* stream, int quality)
-		: _refCount (1), _stream (stream), _quality (quality), _cinfo ({}), _jerr ({})
+	__jpeg_encoder (dseed::io::bufferedstream* stream, const dseed::bitmaps::jpeg_encoder_options& options)
+		: _refCount (1), _stream (stream), _options (options), _cinfo ({}), _jerr ({})
 		, _already_encoded (false)
 	{
 
@@ -97,6 +233,8 @@ public:
 			format != dseed::color::pixelformat::bgra8 &&
 			format != dseed::color::pixelformat::r8 &&
 			format != dseed::color::pixelformat::yuv8 &&
+			format != dseed::color::pixelformat::nv12 &&
+			format != dseed::color::pixelformat::yuyv8 &&
 			format != dseed::color::pixelformat::bgr565)
 			return dseed::error_not_support;
 
@@ -131,6 +269,8 @@ public:
 				_cinfo.input_components = 1;
 				break;
 			case dseed::color::pixelformat::yuv8:
+			case dseed::color::pixelformat::nv12:
+			case dseed::color::pixelformat::yuyv8:
 				_cinfo.in_color_space = JCS_YCbCr;
 				_cinfo.input_components = 3;
 				break;
@@ -142,23 +282,56 @@ public:
 
 		jpeg_set_defaults (&_cinfo);
 
-		jpeg_set_quality (&_cinfo, _quality, true);
+		jpeg_set_quality (&_cinfo, _options.quality, true);
+		_cinfo.dct_method = _options.fast_dct ? JDCT_IFAST : JDCT_ISLOW;
+		_cinfo.optimize_coding = _options.optimize_coding;
 
-		jpeg_start_compress (&_cinfo, true);
+		const bool raw = (format == dseed::color::pixelformat::nv12 || format == dseed::color::pixelformat::yuyv8);
+		if (raw)
+		{
+			__set_jpeg_sampling (_cinfo, format == dseed::color::pixelformat::nv12
+				? dseed::bitmaps::jpeg_subsampling::yuv420 : dseed::bitmaps::jpeg_subsampling::yuv422);
+			_cinfo.raw_data_in = true;
+		}
+		else if (_cinfo.jpeg_color_space == JCS_YCbCr)
+			__set_jpeg_sampling (_cinfo, _options.subsampling);
+
+		if (_options.progressive)
+			jpeg_simple_progression (&_cinfo);
 
-		int stride = dseed::color::calc_bitmap_stride (bitmap->format (), size.width);
 		uint8_t* ptr;
 		bitmap->lock ((void**)&ptr);
-		while (_cinfo.next_scanline < _cinfo.image_height)
+
+		// NV12 luma plane has no stride entry, its rows are packed
+		size_t stride = format == dseed::color::pixelformat::nv12
+			? size.width : dseed::color::calc_bitmap_stride (format, size.width);
+
+		__jpeg_raw_writer rawWriter (_cinfo, format, ptr, stride, size);
+		if (raw && !rawWriter.prepare ())
+		{
+			bitmap->unlock ();
+			jpeg_destroy_compress (&_cinfo);
+			return dseed::error_out_of_memory;
+		}
+
+		jpeg_start_compress (&_cinfo, true);
+
+		if (raw)
+			rawWriter.write ();
+		else
 		{
-			JSAMPROW rows[1];
-			rows[0] = ptr + stride * _cinfo.next_scanline;
+			while (_cinfo.next_scanline < _cinfo.image_height)
+			{
+				JSAMPROW rows[1];
+				rows[0] = ptr + stride * _cinfo.next_scanline;
 
-			jpeg_write_scanlines (&_cinfo, rows, 1);
+				jpeg_write_scanlines (&_cinfo, rows, 1);
+			}
 		}
 		bitmap->unlock ();
 
 		jpeg_finish_compress (&_cinfo);
+		const bool failed = ((morisot_destination_mgr*)_cinfo.dest)->failed;
 		jpeg_destroy_compress (&_cinfo);
 
 		memset (&_jerr, 0, sizeof (_jerr));
@@ -169,21 +342,20 @@ public:
 
 		_already_encoded = true;
 
-		return dseed::error_good;
+		return failed ? dseed::error_io : dseed::error_good;
 	}
 	virtual dseed::bitmaps::arraytype type () noexcept override { return dseed::bitmaps::arraytype::plain; }
 
 public:
 	virtual dseed::error_t commit () noexcept override
 	{
-		_stream->flush ();
-		return dseed::error_good;
+		return _stream->commit ();
 	}
 
 private:
 	std::atomic<int32_t> _refCount;
-	dseed::autoref<dseed::io::stream> _stream;
-	int _quality;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
+	dseed::bitmaps::jpeg_encoder_options _options;
 	jpeg_compress_struct _cinfo;
 	jpeg_error_mgr _jerr;
 
@@ -202,7 +374,12 @@ dseed::error_t dseed::bitmaps::create_jpeg_bitmap_encoder (dseed::io::stream* st
 		jpegOptions = *reinterpret_cast<const dseed::bitmaps::jpeg_encoder_options*>(options);
 	}
 
-	*encoder = new __jpeg_encoder (stream, jpegOptions.quality);
+	// Output buffer of libjpeg is small, so its flushes are gathered
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream (stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed (err))
+		return err;
+
+	*encoder = new __jpeg_encoder (buffered, jpegOptions);
 	if (*encoder == nullptr)
 		return dseed::error_out_of_memory;
 
@@ -0,0 +1,249 @@
+#include <dseed.h>
+
+#include <vector>
+
+#include "../../libs/KTX2Helper.hxx"
+#include "../parallel.hxx"
+
+class __ktx2_encoder : public dseed::bitmaps::bitmap_encoder
+{
+public:
+	__ktx2_encoder(dseed::io::bufferedstream* stream, const dseed::bitmaps::ktx2_encoder_options& options)
+		: _refCount(1), _stream(stream), _options(options), _format(nullptr)
+	{ }
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t encode_frame(dseed::bitmaps::bitmap* bitmap) noexcept override
+	{
+		if (bitmap == nullptr)
+			return dseed::error_invalid_args;
+
+		auto format = __ktx2_find_format(bitmap->format());
+		if (format == nullptr)
+			return dseed::error_not_support;
+
+		if (_bitmaps.size() == 0)
+		{
+			_format = format;
+		}
+		else
+		{
+			if (_bitmaps[0]->format() != bitmap->format() || _bitmaps[0]->type() != bitmap->type())
+				return dseed::error_invalid_args;
+
+			auto expected = __ktx2_level_size(_bitmaps[0]->size(), _bitmaps.size(), volume());
+			auto size = bitmap->size();
+			if (expected.width != size.width || expected.height != size.height || expected.depth != size.depth)
+				return dseed::error_invalid_args;
+		}
+
+		try { _bitmaps.push_back(bitmap); }
+		catch (...) { return dseed::error_out_of_memory; }
+
+		return dseed::error_good;
+	}
+
+	virtual dseed::error_t commit() noexcept override
+	{
+		if (_bitmaps.size() <= 0)
+			return dseed::error_invalid_op;
+
+		const uint32_t scheme = (uint32_t)_options.supercompression;
+		const size_t levelCount = _bitmaps.size();
+		const auto type = _bitmaps[0]->type();
+		const auto size = _bitmaps[0]->size();
+		if (type == dseed::bitmaps::bitmaptype::bitmap2d && size.depth > 1)
+			return dseed::error_not_support;
+
+		KTX2Header header = {};
+		memcpy(header.identifier, KTX2FileIdentifier, sizeof(KTX2FileIdentifier));
+		header.vkFormat = _format->vkFormat;
+		header.typeSize = _format->typeSize;
+		header.pixelWidth = size.width;
+		header.pixelHeight = size.height;
+		header.pixelDepth = volume() ? size.depth : 0;
+		header.layerCount = (type == dseed::bitmaps::bitmaptype::bitmap3d && _options.array) ? size.depth : 0;
+		header.faceCount = type == dseed::bitmaps::bitmaptype::bitmap2dcube ? 6 : 1;
+		header.levelCount = (uint32_t)levelCount;
+		header.supercompressionScheme = scheme;
+
+		std::vector<uint32_t> dfd;
+		std::vector<KTX2LevelIndex> levels(levelCount);
+		std::vector<std::vector<uint8_t>> compressed(levelCount);
+		try
+		{
+			__ktx2_make_dfd(*_format, dfd);
+		}
+		catch (...)
+		{
+			return dseed::error_out_of_memory;
+		}
+
+		// Supercompression is done level by level, so levels are compressed on worker threads
+		std::atomic<bool> failed(false);
+		if (scheme != KTX2_SUPERCOMPRESSION_NONE)
+		{
+			dseed::bitmaps::parallel::for_each(levelCount, [&](size_t i)
+			{
+				auto& bitmap = _bitmaps[i];
+				const size_t total = __ktx2_level_length(*_format, bitmap->size());
+
+				uint8_t* pixels;
+				if (dseed::failed(bitmap->lock((void**)&pixels)))
+				{
+					failed = true;
+					return;
+				}
+				try
+				{
+					std::vector<uint8_t> packed;
+					const uint8_t* data = __ktx2_pack_level(*_format, bitmap->size(), pixels, packed);
+					if (!__ktx2_supercompress(scheme, data, total, _options.compression_level, compressed[i]))
+						failed = true;
+				}
+				catch (...)
+				{
+					failed = true;
+				}
+				bitmap->unlock();
+
+				levels[i].byteLength = compressed[i].size();
+				levels[i].uncompressedByteLength = total;
+			}, _options.threads <= 0 ? 0 : (size_t)_options.threads);
+			if (failed)
+				return dseed::error_fail;
+		}
+		else
+		{
+			for (size_t i = 0; i < levelCount; ++i)
+			{
+				levels[i].byteLength = levels[i].uncompressedByteLength = __ktx2_level_length(*_format, _bitmaps[i]->size());
+			}
+		}
+
+		// Levels are placed from smallest, so head of file has every low mip
+		const size_t dfdOffset = sizeof(KTX2Header) + sizeof(KTX2LevelIndex) * levelCount;
+		header.dfdByteOffset = (uint32_t)dfdOffset;
+		header.dfdByteLength = (uint32_t)(dfd.size() * sizeof(uint32_t));
+
+		const size_t alignment = scheme == KTX2_SUPERCOMPRESSION_NONE ? __lcm(_format->bytesPerBlock, 4) : 1;
+		size_t offset = dfdOffset + header.dfdByteLength;
+		for (size_t i = levelCount; i > 0; --i)
+		{
+			offset = (offset + alignment - 1) / alignment * alignment;
+			levels[i - 1].byteOffset = offset;
+			offset += (size_t)levels[i - 1].byteLength;
+		}
+
+		if (_stream->write(&header, sizeof(header)) != sizeof(header)
+			|| _stream->write(levels.data(), sizeof(KTX2LevelIndex) * levelCount) != sizeof(KTX2LevelIndex) * levelCount
+			|| _stream->write(dfd.data(), header.dfdByteLength) != header.dfdByteLength)
+			return dseed::error_io;
+
+		size_t written = dfdOffset + header.dfdByteLength;
+		const uint8_t padding[16] = {};
+		for (size_t i = levelCount; i > 0; --i)
+		{
+			const auto& level = levels[i - 1];
+			const size_t padLength = (size_t)level.byteOffset - written;
+			if (padLength > 0 && _stream->write(padding, padLength) != padLength)
+				return dseed::error_io;
+
+			if (scheme != KTX2_SUPERCOMPRESSION_NONE)
+			{
+				if (_stream->write(compressed[i - 1].data(), compressed[i - 1].size()) != compressed[i - 1].size())
+					return dseed::error_io;
+			}
+			else
+			{
+				auto& bitmap = _bitmaps[i - 1];
+				uint8_t* pixels;
+				if (dseed::failed(bitmap->lock((void**)&pixels)))
+					return dseed::error_fail;
+				std::vector<uint8_t> packed;
+				const uint8_t* data;
+				try { data = __ktx2_pack_level(*_format, bitmap->size(), pixels, packed); }
+				catch (...)
+				{
+					bitmap->unlock();
+					return dseed::error_out_of_memory;
+				}
+				const size_t length = _stream->write(data, (size_t)level.byteLength);
+				bitmap->unlock();
+				if (length != level.byteLength)
+					return dseed::error_io;
+			}
+			written = (size_t)(level.byteOffset + level.byteLength);
+		}
+
+		return _stream->commit();
+	}
+
+	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::mipmap; }
+
+private:
+	// 3D frames are array layers when array option is set, so only others are halved per level
+	bool volume() const noexcept
+	{
+		return _bitmaps[0]->type() == dseed::bitmaps::bitmaptype::bitmap3d && !_options.array;
+	}
+
+	static size_t __lcm(size_t a, size_t b) noexcept
+	{
+		size_t x = a, y = b;
+		while (y != 0)
+		{
+			const size_t t = x % y;
+			x = y;
+			y = t;
+		}
+		return a / x * b;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
+	dseed::bitmaps::ktx2_encoder_options _options;
+
+	const __ktx2_format* _format;
+	std::vector<dseed::autoref<dseed::bitmaps::bitmap>> _bitmaps;
+};
+
+dseed::error_t dseed::bitmaps::create_ktx2_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
+{
+	if (stream == nullptr || encoder == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::bitmaps::ktx2_encoder_options ktx2Options;
+	if (options != nullptr)
+	{
+		if (options->options_size != sizeof(dseed::bitmaps::ktx2_encoder_options))
+			return dseed::error_invalid_args;
+		ktx2Options = *reinterpret_cast<const dseed::bitmaps::ktx2_encoder_options*>(options);
+	}
+
+	// Schemes whose library is not linked
+	if (!__ktx2_supercompression_supported((uint32_t)ktx2Options.supercompression))
+		return dseed::error_not_support;
+
+	// Header, level index, DFD, padding and small levels are gathered in buffer
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed(err))
+		return err;
+
+	*encoder = new __ktx2_encoder(buffered, ktx2Options);
+	if (*encoder == nullptr)
+		return dseed::error_out_of_memory;
+
+	return dseed::error_good;
+}
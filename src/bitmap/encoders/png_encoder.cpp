@@ -7,23 +7,217 @@
 
 #include <vector>
 
+#include "../parallel.hxx"
+
 #if defined(USE_PNG) && defined(USE_BITMAP_ENCODERS)
+constexpr size_t PNG_PARALLEL_BAND_BYTES = 256 * 1024;
+constexpr size_t PNG_DEFLATE_WINDOW_BYTES = 32 * 1024;
+
+int __png_filter_mask(dseed::bitmaps::png_filter filter) noexcept
+{
+	switch (filter)
+	{
+	case dseed::bitmaps::png_filter::none: return PNG_FILTER_NONE;
+	case dseed::bitmaps::png_filter::sub: return PNG_FILTER_SUB;
+	case dseed::bitmaps::png_filter::up: return PNG_FILTER_UP;
+	case dseed::bitmaps::png_filter::average: return PNG_FILTER_AVG;
+	case dseed::bitmaps::png_filter::paeth: return PNG_FILTER_PAETH;
+	default: return PNG_ALL_FILTERS;
+	}
+}
+
+int __png_zlib_strategy(dseed::bitmaps::png_strategy strategy) noexcept
+{
+	switch (strategy)
+	{
+	case dseed::bitmaps::png_strategy::filtered: return Z_FILTERED;
+	case dseed::bitmaps::png_strategy::huffman_only: return Z_HUFFMAN_ONLY;
+	case dseed::bitmaps::png_strategy::rle: return Z_RLE;
+	case dseed::bitmaps::png_strategy::fixed: return Z_FIXED;
+	default: return Z_DEFAULT_STRATEGY;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Parallel IDAT
+//  : Image is split to row bands, each band is filtered and raw-deflated on its own thread.
+//  : Band is primed with last 32KB of previous band and ends with sync flush(last one with finish),
+//    so concatenated bands are one valid deflate stream; adler32 is combined from bands.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+inline uint8_t __png_paeth(int a, int b, int c) noexcept
+{
+	const int p = a + b - c;
+	const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return (uint8_t)a;
+	if (pb <= pc) return (uint8_t)b;
+	return (uint8_t)c;
+}
+
+// Writes filter type byte and filtered row to out, prev is nullptr for first row
+void __png_filter_row(int type, const uint8_t* row, const uint8_t* prev, size_t bytes, size_t bpp, uint8_t* out) noexcept
+{
+	out[0] = (uint8_t)type;
+	uint8_t* dest = out + 1;
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		const int a = i >= bpp ? row[i - bpp] : 0;
+		const int b = prev ? prev[i] : 0;
+		const int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+		switch (type)
+		{
+		case 0: dest[i] = row[i]; break;
+		case 1: dest[i] = (uint8_t)(row[i] - a); break;
+		case 2: dest[i] = (uint8_t)(row[i] - b); break;
+		case 3: dest[i] = (uint8_t)(row[i] - ((a + b) >> 1)); break;
+		case 4: dest[i] = (uint8_t)(row[i] - __png_paeth(a, b, c)); break;
+		}
+	}
+}
+
+// Same heuristic as libpng: minimum sum of absolute values as signed bytes
+void __png_filter_row_adaptive(const uint8_t* row, const uint8_t* prev, size_t bytes, size_t bpp, uint8_t* out, uint8_t* scratch) noexcept
+{
+	size_t bestCost = SIZE_MAX;
+	for (int type = 0; type < 5; ++type)
+	{
+		uint8_t* candidate = (type == 0) ? out : scratch;
+		__png_filter_row(type, row, prev, bytes, bpp, candidate);
+
+		size_t cost = 0;
+		for (size_t i = 1; i <= bytes; ++i)
+			cost += (size_t)abs((int8_t)candidate[i]);
+
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			if (candidate != out)
+				memcpy(out, candidate, bytes + 1);
+		}
+	}
+}
+
+struct __png_band
+{
+	size_t firstRow, rows;
+	std::vector<uint8_t> filtered;
+	std::vector<uint8_t> compressed;
+	uLong adler;
+	bool succeeded;
+};
+
+dseed::error_t __png_deflate_bands(const uint8_t* pixels, size_t stride, size_t rowBytes, size_t bpp, size_t height,
+	const dseed::bitmaps::png_encoder_options& options, std::vector<__png_band>& bands) noexcept
+{
+	const size_t rowsPerBand = dseed::maximum<size_t>(1, PNG_PARALLEL_BAND_BYTES / (rowBytes + 1));
+	const size_t threads = options.threads > 0 ? (size_t)options.threads : dseed::bitmaps::parallel::concurrency();
+	const int filter = __png_filter_mask(options.filter);
+
+	try
+	{
+		bands.resize((height + rowsPerBand - 1) / rowsPerBand);
+		for (size_t i = 0; i < bands.size(); ++i)
+		{
+			bands[i].firstRow = i * rowsPerBand;
+			bands[i].rows = dseed::minimum(rowsPerBand, height - bands[i].firstRow);
+			bands[i].filtered.resize(bands[i].rows * (rowBytes + 1));
+		}
+	}
+	catch (...)
+	{
+		return dseed::error_out_of_memory;
+	}
+
+	// Filter needs only previous raw row, so bands are independent
+	dseed::bitmaps::parallel::for_each(bands.size(), [&](size_t i)
+		{
+			auto& band = bands[i];
+			std::vector<uint8_t> scratch;
+			band.succeeded = true;
+			if (filter == PNG_ALL_FILTERS)
+			{
+				try { scratch.resize(rowBytes + 1); }
+				catch (...) { band.succeeded = false; return; }
+			}
+
+			for (size_t r = 0; r < band.rows; ++r)
+			{
+				const size_t y = band.firstRow + r;
+				const uint8_t* row = pixels + y * stride;
+				const uint8_t* prev = y > 0 ? row - stride : nullptr;
+				uint8_t* out = band.filtered.data() + r * (rowBytes + 1);
+				switch (filter)
+				{
+				case PNG_FILTER_NONE: __png_filter_row(0, row, prev, rowBytes, bpp, out); break;
+				case PNG_FILTER_SUB: __png_filter_row(1, row, prev, rowBytes, bpp, out); break;
+				case PNG_FILTER_UP: __png_filter_row(2, row, prev, rowBytes, bpp, out); break;
+				case PNG_FILTER_AVG: __png_filter_row(3, row, prev, rowBytes, bpp, out); break;
+				case PNG_FILTER_PAETH: __png_filter_row(4, row, prev, rowBytes, bpp, out); break;
+				default: __png_filter_row_adaptive(row, prev, rowBytes, bpp, out, scratch.data()); break;
+				}
+			}
+			band.adler = adler32(adler32(0, nullptr, 0), band.filtered.data(), (uInt)band.filtered.size());
+		}, threads);
+
+	dseed::bitmaps::parallel::for_each(bands.size(), [&](size_t i)
+		{
+			auto& band = bands[i];
+			if (!band.succeeded)
+				return;
+			band.succeeded = false;
+
+			z_stream zs = {};
+			if (deflateInit2(&zs, options.compression_level, Z_DEFLATED, -15, 8, __png_zlib_strategy(options.strategy)) != Z_OK)
+				return;
+
+			if (i > 0)
+			{
+				const auto& previous = bands[i - 1].filtered;
+				const size_t dictionary = dseed::minimum(previous.size(), PNG_DEFLATE_WINDOW_BYTES);
+				deflateSetDictionary(&zs, previous.data() + previous.size() - dictionary, (uInt)dictionary);
+			}
+
+			try { band.compressed.resize(deflateBound(&zs, (uLong)band.filtered.size()) + 16); }
+			catch (...) { deflateEnd(&zs); return; }
+
+			zs.next_in = band.filtered.data();
+			zs.avail_in = (uInt)band.filtered.size();
+			zs.next_out = band.compressed.data();
+			zs.avail_out = (uInt)band.compressed.size();
+
+			const bool last = (i == bands.size() - 1);
+			const int result = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+			if ((last && result == Z_STREAM_END) || (!last && result == Z_OK && zs.avail_in == 0))
+			{
+				band.compressed.resize(zs.total_out);
+				band.succeeded = true;
+			}
+			deflateEnd(&zs);
+		}, threads);
+
+	for (const auto& band : bands)
+		if (!band.succeeded)
+			return dseed::error_fail;
+
+	return dseed::error_good;
+}
+
 class __png_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__png_encoder(png_structp png, png_infop info, dseed::io::stream* stream)
-		: _refCount(1), _png(png), _info(info), _stream(stream)
+	__png_encoder(png_structp png, png_infop info, dseed::io::bufferedstream* stream, const dseed::bitmaps::png_encoder_options& options)
+		: _refCount(1), _png(png), _info(info), _stream(stream), _options(options)
 		, _alreadyEncoded(false)
 	{
+		// Chunk lengths, types and CRCs are written separately, so they are gathered in buffered stream
+		//  : Gathered bytes are written on commit, not on flush of libpng.
 		png_set_write_fn(png, stream,
 			[](png_structp png, png_bytep buf, size_t size)
 			{
-				reinterpret_cast<dseed::io::stream*> (png_get_io_ptr(png))->write(buf, size);
+				reinterpret_cast<dseed::io::bufferedstream*> (png_get_io_ptr(png))->write(buf, size);
 			},
-			[](png_structp png)
-			{
-				reinterpret_cast<dseed::io::stream*> (png_get_io_ptr(png))->flush();
-			}
+			[](png_structp png) { }
 			);
 	}
 	~__png_encoder()
@@ -69,20 +263,21 @@ public:
 		for (int y = 0; y < size.height; ++y)
 			pixelsRows[y] = pixels.data() + y * stride;
 
+		bool bgr = false;
+		size_t bpp = 1;
 		if (format == dseed::color::pixelformat::bgr8_indexed8)
 		{
-			std::vector<uint8_t> palette;
-			palette.resize(256 * 3);
-
 			dseed::autoref<dseed::bitmaps::palette> paletteObj;
 			if (dseed::failed(bitmap->palette(&paletteObj)))
 				return dseed::error_fail;
 
-			size_t paletteSize = paletteObj->size() / 3;
+			size_t paletteSize = paletteObj->size();
+			std::vector<uint8_t> palette;
+			palette.resize(dseed::maximum<size_t>(256, paletteSize) * 3);
 			if (dseed::failed(paletteObj->copy_palette(palette.data())))
 				return dseed::error_fail;
 
-			for (auto i = 0; i < paletteSize / 3; ++i)
+			for (size_t i = 0; i < paletteSize; ++i)
 			{
 				uint8_t temp = palette[i * 3 + 0];
 				palette[i * 3 + 0] = palette[i * 3 + 2];
@@ -91,14 +286,7 @@ public:
 
 			png_set_IHDR(_png, _info, size.width, size.height, 8, PNG_COLOR_TYPE_PALETTE,
 				PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-			png_set_PLTE(_png, _info, (png_const_colorp)palette.data(), (int)paletteSize / 3);
-			png_set_rows(_png, _info, pixelsRows.data());
-
-			png_write_png(_png, _info, PNG_TRANSFORM_IDENTITY, nullptr);
-			png_write_flush(_png);
-
-			_alreadyEncoded = true;
-			return dseed::error_good;
+			png_set_PLTE(_png, _info, (png_const_colorp)palette.data(), (int)paletteSize);
 		}
 		else if (format == dseed::color::pixelformat::bgra8_indexed8)
 		{
@@ -131,31 +319,24 @@ public:
 				PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 			png_set_tRNS(_png, _info, alpha.data(), (int)alpha.size(), nullptr);
 			png_set_PLTE(_png, _info, (png_const_colorp)newPalette.data(), (int)newPalette.size() / 3);
-			png_set_rows(_png, _info, pixelsRows.data());
-
-			png_write_png(_png, _info, PNG_TRANSFORM_IDENTITY, nullptr);
-			png_write_flush(_png);
-
-			_alreadyEncoded = true;
-			return dseed::error_good;
 		}
-		else if (format == dseed::color::pixelformat::rgba8 || format == dseed::color::pixelformat::bgra8
-			|| format == dseed::color::pixelformat::rgb8 || format == dseed::color::pixelformat::bgr8
-			|| format == dseed::color::pixelformat::r8 || format == dseed::color::pixelformat::ra8)
+		else
 		{
 			int colorType = 0;
 			switch (format)
 			{
 			case dseed::color::pixelformat::bgra8:
-				png_set_bgr(_png);
+				bgr = true;
 			case dseed::color::pixelformat::rgba8:
 				colorType = PNG_COLOR_TYPE_RGBA;
+				bpp = 4;
 				break;
 
 			case dseed::color::pixelformat::bgr8:
-				png_set_bgr(_png);
+				bgr = true;
 			case dseed::color::pixelformat::rgb8:
 				colorType = PNG_COLOR_TYPE_RGB;
+				bpp = 3;
 				break;
 
 			case dseed::color::pixelformat::r8:
@@ -164,37 +345,89 @@ public:
 
 			case dseed::color::pixelformat::ra8:
 				colorType = PNG_COLOR_TYPE_GRAY_ALPHA;
+				bpp = 2;
 				break;
 			}
 
 			png_set_IHDR(_png, _info, size.width, size.height, 8, colorType,
 				PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-			png_write_info(_png, _info);
-			png_set_swap(_png);
-			
-			png_set_rows(_png, _info, pixelsRows.data());
+		}
 
-			png_write_png(_png, _info, PNG_TRANSFORM_IDENTITY, nullptr);
+		_alreadyEncoded = true;
 
-			_alreadyEncoded = true;
-			return dseed::error_good;
-		}
+		if (_options.threads != 1)
+			return encode_parallel(pixels, stride, size.width * bpp, bpp, size.height, bgr);
+
+		png_set_rows(_png, _info, pixelsRows.data());
+		png_write_png(_png, _info, bgr ? PNG_TRANSFORM_BGR : PNG_TRANSFORM_IDENTITY, nullptr);
 
-		return dseed::error_not_support;
+		return dseed::error_good;
 	}
 	virtual dseed::error_t commit() noexcept override
 	{
-		png_write_flush(_png);
+		return _stream->commit();
+	}
+	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
+
+private:
+	// Writes header chunks by libpng, then IDAT chunks of deflated bands
+	dseed::error_t encode_parallel(std::vector<uint8_t>& pixels, size_t stride, size_t rowBytes, size_t bpp, size_t height, bool bgr) noexcept
+	{
+		if (bgr)
+		{
+			dseed::bitmaps::parallel::for_each(height, [&](size_t y)
+				{
+					uint8_t* row = pixels.data() + y * stride;
+					for (size_t i = 0; i + 2 < rowBytes; i += bpp)
+					{
+						uint8_t temp = row[i + 0];
+						row[i + 0] = row[i + 2];
+						row[i + 2] = temp;
+					}
+				}, _options.threads > 0 ? (size_t)_options.threads : 0);
+		}
+
+		std::vector<__png_band> bands;
+		if (auto err = __png_deflate_bands(pixels.data(), stride, rowBytes, bpp, height, _options, bands); dseed::failed(err))
+			return err;
+
+		uLong adler = adler32(0, nullptr, 0);
+		for (const auto& band : bands)
+			adler = adler32_combine(adler, band.adler, (z_off_t)band.filtered.size());
+
+		// zlib header: deflate with 32KB window, FLEVEL from compression level, FCHECK makes it multiple of 31
+		const int level = _options.compression_level < 0 ? 6 : _options.compression_level;
+		const uint8_t cmf = 0x78;
+		uint8_t flg = (uint8_t)((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+		flg += (uint8_t)(31 - ((cmf * 256 + flg) % 31));
+		const uint8_t zlibHeader[2] = { cmf, flg };
+		const uint8_t zlibTrailer[4] = { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler };
+
+		png_write_info(_png, _info);
+		for (size_t i = 0; i < bands.size(); ++i)
+		{
+			const bool first = (i == 0), last = (i == bands.size() - 1);
+			const auto& compressed = bands[i].compressed;
+			png_write_chunk_start(_png, (png_const_bytep)"IDAT",
+				(png_uint_32)(compressed.size() + (first ? sizeof(zlibHeader) : 0) + (last ? sizeof(zlibTrailer) : 0)));
+			if (first)
+				png_write_chunk_data(_png, zlibHeader, sizeof(zlibHeader));
+			png_write_chunk_data(_png, compressed.data(), compressed.size());
+			if (last)
+				png_write_chunk_data(_png, zlibTrailer, sizeof(zlibTrailer));
+			png_write_chunk_end(_png);
+		}
+		png_write_chunk(_png, (png_const_bytep)"IEND", nullptr, 0);
 
 		return dseed::error_good;
 	}
-	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
 
 private:
 	std::atomic<int32_t> _refCount;
 	png_structp _png;
 	png_infop _info;
-	dseed::autoref<dseed::io::stream> _stream;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
+	dseed::bitmaps::png_encoder_options _options;
 
 	bool _alreadyEncoded;
 };
@@ -221,10 +454,24 @@ dseed::error_t dseed::bitmaps::create_png_bitmap_encoder(dseed::io::stream* stre
 		return dseed::error_out_of_memory;
 	}
 
-	png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_ALL_FILTERS);
-	png_set_compression_level(png, Z_BEST_COMPRESSION);
+	if (pngOptions.compression_level < Z_DEFAULT_COMPRESSION || pngOptions.compression_level > Z_BEST_COMPRESSION || pngOptions.threads < 0)
+	{
+		png_destroy_write_struct(&png, &info);
+		return dseed::error_invalid_args;
+	}
+
+	png_set_filter(png, PNG_FILTER_TYPE_BASE, __png_filter_mask(pngOptions.filter));
+	png_set_compression_level(png, pngOptions.compression_level);
+	png_set_compression_strategy(png, __png_zlib_strategy(pngOptions.strategy));
+
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed(err))
+	{
+		png_destroy_write_struct(&png, &info);
+		return err;
+	}
 
-	*encoder = new __png_encoder(png, info, stream);
+	*encoder = new __png_encoder(png, info, buffered, pngOptions);
 	if (*encoder == nullptr)
 	{
 		png_destroy_write_struct(&png, &info);
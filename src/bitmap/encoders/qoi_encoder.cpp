@@ -0,0 +1,232 @@
+#include <dseed.h>
+
+#include <vector>
+#include <cstring>
+
+#include "../../libs/QOIHelper.hxx"
+
+// Counts pixels equal to px from src
+//  : Runs are common in flat area, so 4-channel pixels are compared 4 at once.
+template<int Channels>
+inline size_t __qoi_count_same (const uint8_t* src, size_t count, const __qoi_rgba& px) noexcept
+{
+	size_t same = 0;
+#if ARCH_X86SET && !DONT_USE_SSE
+	if constexpr (Channels == 4)
+	{
+		uint32_t value;
+		memcpy (&value, &px, sizeof (value));
+		const __m128i pixels = _mm_set1_epi32 ((int)value);
+		for (; same + 4 <= count; same += 4)
+		{
+			const __m128i loaded = _mm_loadu_si128 ((const __m128i*)(src + same * 4));
+			if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (loaded, pixels)) != 0xffff)
+				break;
+		}
+	}
+#endif
+	for (; same < count; ++same)
+	{
+		const uint8_t* s = src + same * Channels;
+		if (s[0] != px.r || s[1] != px.g || s[2] != px.b || (Channels == 4 && s[3] != px.a))
+			break;
+	}
+	return same;
+}
+
+template<int Channels>
+size_t __encode_qoi_chunks (const uint8_t* pixels, size_t stride, const __qoi_header& header, uint8_t* out) noexcept
+{
+	__qoi_rgba index[64] = {};
+	__qoi_rgba prev = { 0, 0, 0, 255 };
+	__qoi_rgba px = prev;
+	size_t run = 0, p = 0;
+
+	auto flushRun = [&]()
+	{
+		for (; run >= QOI_MAXIMUM_RUN; run -= QOI_MAXIMUM_RUN)
+			out[p++] = QOI_OP_RUN | (QOI_MAXIMUM_RUN - 1);
+		if (run > 0)
+			out[p++] = QOI_OP_RUN | (uint8_t)(run - 1);
+		run = 0;
+	};
+
+	for (size_t y = 0; y < header.height; ++y)
+	{
+		const uint8_t* src = pixels + y * stride;
+		for (size_t x = 0; x < header.width;)
+		{
+			const size_t same = __qoi_count_same<Channels> (src, header.width - x, prev);
+			if (same > 0)
+			{
+				// Run may continue to next row
+				run += same;
+				src += same * Channels;
+				x += same;
+				continue;
+			}
+
+			px.r = src[0];
+			px.g = src[1];
+			px.b = src[2];
+			if constexpr (Channels == 4)
+				px.a = src[3];
+			src += Channels;
+			++x;
+
+			flushRun ();
+
+			const int hash = __qoi_hash (px);
+			if (index[hash] == px)
+			{
+				out[p++] = QOI_OP_INDEX | (uint8_t)hash;
+			}
+			else
+			{
+				index[hash] = px;
+
+				if (px.a == prev.a)
+				{
+					const int8_t vr = (int8_t)(px.r - prev.r);
+					const int8_t vg = (int8_t)(px.g - prev.g);
+					const int8_t vb = (int8_t)(px.b - prev.b);
+					const int8_t vgr = vr - vg;
+					const int8_t vgb = vb - vg;
+
+					if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+					{
+						out[p++] = QOI_OP_DIFF | (uint8_t)((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+					}
+					else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8)
+					{
+						out[p++] = QOI_OP_LUMA | (uint8_t)(vg + 32);
+						out[p++] = (uint8_t)((vgr + 8) << 4 | (vgb + 8));
+					}
+					else
+					{
+						out[p++] = QOI_OP_RGB;
+						out[p++] = px.r;
+						out[p++] = px.g;
+						out[p++] = px.b;
+					}
+				}
+				else
+				{
+					out[p++] = QOI_OP_RGBA;
+					out[p++] = px.r;
+					out[p++] = px.g;
+					out[p++] = px.b;
+					out[p++] = px.a;
+				}
+			}
+			prev = px;
+		}
+	}
+	flushRun ();
+
+	return p;
+}
+
+class __qoi_encoder : public dseed::bitmaps::bitmap_encoder
+{
+public:
+	__qoi_encoder (dseed::io::bufferedstream* stream)
+		: _refCount (1), _stream (stream), _alreadyEncoded (false)
+	{ }
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t encode_frame (dseed::bitmaps::bitmap* bitmap) noexcept override
+	{
+		if (_alreadyEncoded)
+			return dseed::error_invalid_op;
+
+		auto size = bitmap->size ();
+		if (size.depth > 1)
+			return dseed::error_not_support;
+
+		auto format = bitmap->format ();
+		if (!(format == dseed::color::pixelformat::rgba8 || format == dseed::color::pixelformat::rgb8))
+			return dseed::error_not_support;
+
+		__qoi_header header;
+		header.width = (uint32_t)size.width;
+		header.height = (uint32_t)size.height;
+		header.channels = format == dseed::color::pixelformat::rgba8 ? 4 : 3;
+		header.colorspace = 0;
+		if (header.width == 0 || header.height == 0 || header.height >= QOI_MAXIMUM_PIXELS / header.width)
+			return dseed::error_not_support;
+
+		// Worst case is every pixel stored as full RGBA chunk
+		std::vector<uint8_t> encoded;
+		try
+		{
+			encoded.resize (QOI_HEADER_SIZE + (size_t)header.width * header.height * (header.channels + 1) + sizeof (QOI_END_MARKER));
+		}
+		catch (...)
+		{
+			return dseed::error_out_of_memory;
+		}
+
+		uint8_t headerBytes[QOI_HEADER_SIZE];
+		__qoi_make_header (header, headerBytes);
+		memcpy (encoded.data (), headerBytes, sizeof (headerBytes));
+
+		const size_t stride = dseed::color::calc_bitmap_stride (format, size.width);
+		uint8_t* pixelsPtr;
+		if (dseed::failed (bitmap->lock ((void**)&pixelsPtr)))
+			return dseed::error_fail;
+		const size_t chunksLength = header.channels == 4
+			? __encode_qoi_chunks<4> (pixelsPtr, stride, header, encoded.data () + QOI_HEADER_SIZE)
+			: __encode_qoi_chunks<3> (pixelsPtr, stride, header, encoded.data () + QOI_HEADER_SIZE);
+		bitmap->unlock ();
+
+		memcpy (encoded.data () + QOI_HEADER_SIZE + chunksLength, QOI_END_MARKER, sizeof (QOI_END_MARKER));
+
+		const size_t total = QOI_HEADER_SIZE + chunksLength + sizeof (QOI_END_MARKER);
+		if (_stream->write (encoded.data (), total) != total)
+			return dseed::error_io;
+
+		_alreadyEncoded = true;
+
+		return dseed::error_good;
+	}
+	virtual dseed::bitmaps::arraytype type () noexcept override { return dseed::bitmaps::arraytype::plain; }
+
+public:
+	virtual dseed::error_t commit () noexcept override
+	{
+		return _stream->commit ();
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
+	bool _alreadyEncoded;
+};
+
+dseed::error_t dseed::bitmaps::create_qoi_bitmap_encoder (dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
+{
+	if (stream == nullptr || encoder == nullptr)
+		return dseed::error_invalid_args;
+
+	// Whole image is written in one call, so nothing is gathered
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream (stream, 0, &buffered); dseed::failed (err))
+		return err;
+
+	*encoder = new __qoi_encoder (buffered);
+	if (*encoder == nullptr)
+		return dseed::error_out_of_memory;
+
+	return dseed::error_good;
+}
@@ -4,27 +4,55 @@
 #	include <tiff.h>
 #	include <tiffio.h>
 
+#	include <vector>
+
+#	include "../../libs/TIFFHelper.hxx"
+#	include "../parallel.hxx"
+
+constexpr size_t TIFF_PARALLEL_SEGMENTS_PER_THREAD = 4;
+
+// Copies one tile(strip) from bitmap
+//  : Tiles on right and bottom edge are padded with zero to full tile size.
+void __fill_tiff_segment(const uint8_t* pixels, size_t stride, const dseed::size3i& size, size_t pixelBytes,
+	size_t x, size_t y, size_t segmentWidth, size_t segmentHeight, uint8_t* dest) noexcept
+{
+	const size_t rowBytes = segmentWidth * pixelBytes;
+	const size_t copyBytes = (dseed::minimum<size_t>(segmentWidth, size.width - x)) * pixelBytes;
+	const size_t copyRows = dseed::minimum<size_t>(segmentHeight, size.height - y);
+	for (size_t row = 0; row < segmentHeight; ++row)
+	{
+		uint8_t* destRow = dest + row * rowBytes;
+		if (row < copyRows)
+		{
+			memcpy(destRow, pixels + (y + row) * stride + x * pixelBytes, copyBytes);
+			memset(destRow + copyBytes, 0, rowBytes - copyBytes);
+		}
+		else
+			memset(destRow, 0, rowBytes);
+	}
+}
+
 class __tiff_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__tiff_encoder(dseed::io::stream* stream)
-		: _refCount(1), _stream(stream), _tiff(nullptr), _writtenBitmap(false)
+	__tiff_encoder(dseed::io::bufferedstream* stream, const dseed::bitmaps::tiff_encoder_options& options)
+		: _refCount(1), _stream(stream), _tiff(nullptr), _writtenBitmap(false), _options(options)
 	{
 		_tiff = TIFFClientOpen("Stream", "w", stream,
 			// Read
 			[](thandle_t handle, tdata_t data, tsize_t sz) -> tsize_t
 			{
-				return reinterpret_cast<dseed::io::stream*>(handle)->read(data, sz);
+				return reinterpret_cast<dseed::io::bufferedstream*>(handle)->read(data, sz);
 			},
 			// Write
 				[](thandle_t handle, tdata_t data, tsize_t sz) -> tsize_t
 			{
-				return reinterpret_cast<dseed::io::stream*>(handle)->write(data, sz);
+				return reinterpret_cast<dseed::io::bufferedstream*>(handle)->write(data, sz);
 			},
 				// Seek
 				[](thandle_t handle, toff_t offset, int origin) -> toff_t
 			{
-				auto stream = reinterpret_cast<dseed::io::stream*>(handle);
+				auto stream = reinterpret_cast<dseed::io::bufferedstream*>(handle);
 				if (!stream->seek((dseed::io::seekorigin)origin, offset))
 					return -1;
 				return stream->position();
@@ -32,7 +60,7 @@ public:
 				// Close
 				[](thandle_t handle) -> int { return 1; },
 				// Size
-				[](thandle_t handle) -> toff_t { return reinterpret_cast<dseed::io::stream*>(handle)->length(); },
+				[](thandle_t handle) -> toff_t { return reinterpret_cast<dseed::io::bufferedstream*>(handle)->length(); },
 				// Map
 				[](thandle_t, tdata_t*, toff_t*) -> int { return 0; },
 				// Unmap
@@ -67,6 +95,7 @@ public:
 		const auto format = bitmap->format();
 		
 		int photometric, samplesPerPixel, bitsPerSample, sampleFormat;
+		bool alpha = false;
 		switch (format)
 		{
 		case dseed::color::pixelformat::rgb8:
@@ -81,6 +110,7 @@ public:
 			samplesPerPixel = 4;
 			bitsPerSample = 8;
 			sampleFormat = SAMPLEFORMAT_UINT;
+			alpha = true;
 			break;
 
 		case dseed::color::pixelformat::rgbaf:
@@ -88,6 +118,7 @@ public:
 			samplesPerPixel = 4;
 			bitsPerSample = 32;
 			sampleFormat = SAMPLEFORMAT_IEEEFP;
+			alpha = true;
 			break;
 
 		case dseed::color::pixelformat::r8:
@@ -115,6 +146,26 @@ public:
 			return dseed::error_not_support;
 		}
 
+		int compression;
+		switch (_options.compression)
+		{
+		case dseed::bitmaps::tiff_compression::none: compression = COMPRESSION_NONE; break;
+		case dseed::bitmaps::tiff_compression::lzw: compression = COMPRESSION_LZW; break;
+		case dseed::bitmaps::tiff_compression::deflate: compression = COMPRESSION_ADOBE_DEFLATE; break;
+#	if defined(COMPRESSION_ZSTD)
+		case dseed::bitmaps::tiff_compression::zstd:
+			if (!TIFFIsCODECConfigured(COMPRESSION_ZSTD))
+				return dseed::error_not_support;
+			compression = COMPRESSION_ZSTD;
+			break;
+#	endif
+		default: return dseed::error_not_support;
+		}
+
+		int predictor = PREDICTOR_NONE;
+		if (_options.predictor && compression != COMPRESSION_NONE)
+			predictor = sampleFormat == SAMPLEFORMAT_IEEEFP ? PREDICTOR_FLOATINGPOINT : PREDICTOR_HORIZONTAL;
+
 		const auto size = bitmap->size();
 		const auto stride = dseed::color::calc_bitmap_stride(format, size.width);
 		TIFFSetField(_tiff, TIFFTAG_IMAGEWIDTH, size.width);
@@ -124,50 +175,204 @@ public:
 		TIFFSetField(_tiff, TIFFTAG_BITSPERSAMPLE, bitsPerSample);
 		TIFFSetField(_tiff, TIFFTAG_SAMPLESPERPIXEL, samplesPerPixel);
 		TIFFSetField(_tiff, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-		TIFFSetField(_tiff, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+		TIFFSetField(_tiff, TIFFTAG_COMPRESSION, compression);
 		TIFFSetField(_tiff, TIFFTAG_SAMPLEFORMAT, sampleFormat);
 		TIFFSetField(_tiff, TIFFTAG_THRESHHOLDING, 1);
-		TIFFSetField(_tiff, TIFFTAG_XRESOLUTION, 96);
-		TIFFSetField(_tiff, TIFFTAG_YRESOLUTION, 96);
+		TIFFSetField(_tiff, TIFFTAG_XRESOLUTION, 96.0);
+		TIFFSetField(_tiff, TIFFTAG_YRESOLUTION, 96.0);
 		TIFFSetField(_tiff, TIFFTAG_RESOLUTIONUNIT, 2);
+		if (predictor != PREDICTOR_NONE)
+			TIFFSetField(_tiff, TIFFTAG_PREDICTOR, predictor);
+		if (alpha)
+		{
+			uint16_t extraSample = EXTRASAMPLE_UNASSALPHA;
+			TIFFSetField(_tiff, TIFFTAG_EXTRASAMPLES, 1, &extraSample);
+		}
+		// Pixels are stored as is, not subsampled
+		if (photometric == PHOTOMETRIC_YCBCR)
+			TIFFSetField(_tiff, TIFFTAG_YCBCRSUBSAMPLING, 1, 1);
+#	if defined(COMPRESSION_ZSTD)
+		if (compression == COMPRESSION_ZSTD && _options.compression_level >= 0)
+			TIFFSetField(_tiff, TIFFTAG_ZSTD_LEVEL, _options.compression_level);
+#	endif
 
-		uint32 rowsPerStrip = size.height;
-		rowsPerStrip = TIFFDefaultStripSize(_tiff, rowsPerStrip);
-		TIFFSetField(_tiff, TIFFTAG_ROWSPERSTRIP, rowsPerStrip);
-		TIFFSetupStrips(_tiff);
-
-		bool error = false;
-		uint8_t* ptr;
-		bitmap->lock(reinterpret_cast<void**>(&ptr));
-		for (auto y = 0; y < size.height; ++y)
+		size_t segmentWidth, segmentHeight, across, down;
+		if (_options.tiled)
 		{
-			const auto offset = y * stride;
-			if (TIFFWriteScanline(_tiff, ptr + offset, y, 0) != 1)
-			{
-				error = true;
-				break;
-			}
+			segmentWidth = (size_t)_options.tile_width;
+			segmentHeight = (size_t)_options.tile_height;
+			TIFFSetField(_tiff, TIFFTAG_TILEWIDTH, (uint32)segmentWidth);
+			TIFFSetField(_tiff, TIFFTAG_TILELENGTH, (uint32)segmentHeight);
+			across = (size.width + segmentWidth - 1) / segmentWidth;
+		}
+		else
+		{
+			uint32 rowsPerStrip = _options.rows_per_strip > 0
+				? (uint32)_options.rows_per_strip
+				: TIFFDefaultStripSize(_tiff, 0);
+			rowsPerStrip = dseed::minimum<uint32>(rowsPerStrip, size.height);
+			TIFFSetField(_tiff, TIFFTAG_ROWSPERSTRIP, rowsPerStrip);
+			segmentWidth = size.width;
+			segmentHeight = rowsPerStrip;
+			across = 1;
 		}
+		down = (size.height + segmentHeight - 1) / segmentHeight;
+
+		uint8_t* ptr;
+		if (dseed::failed(bitmap->lock(reinterpret_cast<void**>(&ptr))))
+			return dseed::error_fail;
+
+		const __tiff_segments segments = { ptr, stride, size, (size_t)(samplesPerPixel * bitsPerSample / 8),
+			(size_t)samplesPerPixel, (size_t)(bitsPerSample / 8), predictor,
+			_options.tiled, segmentWidth, segmentHeight, across, across * down };
+		auto err = compression == COMPRESSION_NONE || compression == COMPRESSION_LZW || compression == COMPRESSION_ADOBE_DEFLATE
+			? encode_parallel(segments, compression)
+			: encode_serial(segments);
 		bitmap->unlock();
 
-		return !error ? dseed::error_good : dseed::error_fail;
+		if (dseed::succeeded(err))
+			_writtenBitmap = true;
+		return err;
 	}
 	virtual dseed::error_t commit() noexcept override
 	{
 		if (!_writtenBitmap)
 			return dseed::error_invalid_op;
 		
-		_stream->flush();
-		return dseed::error_good;
+		// Directory is written here, not on close
+		if (!TIFFFlush(_tiff))
+			return dseed::error_io;
+		return _stream->commit();
 	}
 	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
 
+private:
+	struct __tiff_segments
+	{
+		const uint8_t* pixels;
+		size_t stride;
+		dseed::size3i size;
+		size_t pixelBytes, samplesPerPixel, bytesPerSample;
+		int predictor;
+		bool tiled;
+		size_t width, height, across, count;
+
+		inline size_t x(size_t index) const noexcept { return (index % across) * width; }
+		inline size_t y(size_t index) const noexcept { return (index / across) * height; }
+		// Last strip has only remained rows, but every tile is full size
+		inline size_t rows(size_t index) const noexcept
+		{
+			return tiled ? height : dseed::minimum<size_t>(height, size.height - y(index));
+		}
+		inline size_t bytes(size_t index) const noexcept { return width * rows(index) * pixelBytes; }
+	};
+
+	bool write_raw(size_t index, const void* data, size_t length) noexcept
+	{
+		return (_options.tiled
+			? TIFFWriteRawTile(_tiff, (uint32)index, const_cast<void*>(data), (tmsize_t)length)
+			: TIFFWriteRawStrip(_tiff, (uint32)index, const_cast<void*>(data), (tmsize_t)length)) != -1;
+	}
+
+	// Codec in libtiff encodes tiles(strips) one by one
+	dseed::error_t encode_serial(const __tiff_segments& segments) noexcept
+	{
+		std::vector<uint8_t> raw;
+		try { raw.resize(segments.width * segments.height * segments.pixelBytes); }
+		catch (...) { return dseed::error_out_of_memory; }
+
+		for (size_t i = 0; i < segments.count; ++i)
+		{
+			__fill_tiff_segment(segments.pixels, segments.stride, segments.size, segments.pixelBytes,
+				segments.x(i), segments.y(i), segments.width, segments.rows(i), raw.data());
+			const auto written = _options.tiled
+				? TIFFWriteEncodedTile(_tiff, (uint32)i, raw.data(), (tmsize_t)segments.bytes(i))
+				: TIFFWriteEncodedStrip(_tiff, (uint32)i, raw.data(), (tmsize_t)segments.bytes(i));
+			if (written == -1)
+				return dseed::error_fail;
+		}
+
+		return dseed::error_good;
+	}
+
+	// Tiles(strips) are predicted and compressed on worker threads by batch, then written in order
+	//  : Batch keeps memory bounded for large images.
+	dseed::error_t encode_parallel(const __tiff_segments& segments, int compression) noexcept
+	{
+		const size_t threads = _options.threads > 0 ? (size_t)_options.threads : dseed::bitmaps::parallel::concurrency();
+		const size_t batch = dseed::minimum(threads * TIFF_PARALLEL_SEGMENTS_PER_THREAD, segments.count);
+		const size_t segmentBytes = segments.width * segments.height * segments.pixelBytes;
+		const size_t rowBytes = segments.width * segments.pixelBytes;
+
+		std::vector<std::vector<uint8_t>> raws, encodeds, temps;
+		std::vector<uint8_t> results;
+		try
+		{
+			raws.resize(batch);
+			encodeds.resize(batch);
+			temps.resize(batch);
+			results.resize(batch);
+			for (size_t i = 0; i < batch; ++i)
+			{
+				raws[i].resize(segmentBytes);
+				if (segments.predictor == PREDICTOR_FLOATINGPOINT)
+					temps[i].resize(rowBytes);
+			}
+		}
+		catch (...) { return dseed::error_out_of_memory; }
+
+		for (size_t first = 0; first < segments.count; first += batch)
+		{
+			const size_t count = dseed::minimum(batch, segments.count - first);
+			dseed::bitmaps::parallel::for_each(count, [&](size_t slot)
+			{
+				const size_t index = first + slot;
+				const size_t rows = segments.rows(index);
+				uint8_t* raw = raws[slot].data();
+				__fill_tiff_segment(segments.pixels, segments.stride, segments.size, segments.pixelBytes,
+					segments.x(index), segments.y(index), segments.width, rows, raw);
+
+				for (size_t row = 0; row < rows; ++row)
+				{
+					if (segments.predictor == PREDICTOR_HORIZONTAL)
+						__tiff_horizontal_diff8(raw + row * rowBytes, rowBytes, segments.samplesPerPixel);
+					else if (segments.predictor == PREDICTOR_FLOATINGPOINT)
+						__tiff_floating_point_diff(raw + row * rowBytes, rowBytes, segments.samplesPerPixel,
+							segments.bytesPerSample, temps[slot].data());
+				}
+
+				bool result = true;
+				if (compression == COMPRESSION_LZW)
+					result = __tiff_lzw_encode(raw, segments.bytes(index), encodeds[slot]);
+				else if (compression == COMPRESSION_ADOBE_DEFLATE)
+					result = __tiff_deflate(raw, segments.bytes(index), _options.compression_level, encodeds[slot]);
+				results[slot] = result;
+			}, threads);
+
+			for (size_t slot = 0; slot < count; ++slot)
+			{
+				if (!results[slot])
+					return dseed::error_fail;
+
+				const size_t index = first + slot;
+				const bool written = compression == COMPRESSION_NONE
+					? write_raw(index, raws[slot].data(), segments.bytes(index))
+					: write_raw(index, encodeds[slot].data(), encodeds[slot].size());
+				if (!written)
+					return dseed::error_io;
+			}
+		}
+
+		return dseed::error_good;
+	}
+
 private:
 	std::atomic<int32_t> _refCount;
-	dseed::autoref<dseed::io::stream> _stream;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
 
 	TIFF* _tiff;
 	bool _writtenBitmap;
+	dseed::bitmaps::tiff_encoder_options _options;
 };
 
 #endif
@@ -175,7 +380,23 @@ private:
 dseed::error_t dseed::bitmaps::create_tiff_bitmap_encoder(dseed::io::stream* stream, const dseed::bitmaps::bitmap_encoder_options* options, dseed::bitmaps::bitmap_encoder** encoder)
 {
 #if defined(USE_TIFF) && defined(USE_BITMAP_ENCODERS)
-	*encoder = new __tiff_encoder(stream);
+	dseed::bitmaps::tiff_encoder_options tiffOptions;
+	if (options != nullptr)
+	{
+		if (options->options_size != sizeof(dseed::bitmaps::tiff_encoder_options))
+			return dseed::error_invalid_args;
+		tiffOptions = *reinterpret_cast<const dseed::bitmaps::tiff_encoder_options*>(options);
+	}
+	if (tiffOptions.tiled && (tiffOptions.tile_width <= 0 || tiffOptions.tile_height <= 0
+		|| tiffOptions.tile_width % 16 != 0 || tiffOptions.tile_height % 16 != 0))
+		return dseed::error_invalid_args;
+
+	// Tags and directory entries are written in small pieces, so they are gathered
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed(err))
+		return err;
+
+	*encoder = new __tiff_encoder(buffered, tiffOptions);
 	if (*encoder == nullptr)
 		return dseed::error_out_of_memory;
 
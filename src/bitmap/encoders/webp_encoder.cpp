@@ -5,22 +5,56 @@
 #	include <webp/mux.h>
 #	include <functional>
 
-class __webp_encoder : public dseed::bitmaps::bitmap_encoder
+WebPPreset __webp_preset(dseed::bitmaps::webp_preset preset) noexcept
 {
-public:
-	__webp_encoder(dseed::io::stream* stream, int quality, bool lossless)
-		: _refCount(1), _stream(stream), _config({}), _anim(nullptr)
+	switch (preset)
 	{
-		memset(&_config, 0, sizeof(_config));
-
-		WebPConfigInit(&_config);
+	case dseed::bitmaps::webp_preset::picture: return WEBP_PRESET_PICTURE;
+	case dseed::bitmaps::webp_preset::photo: return WEBP_PRESET_PHOTO;
+	case dseed::bitmaps::webp_preset::drawing: return WEBP_PRESET_DRAWING;
+	case dseed::bitmaps::webp_preset::icon: return WEBP_PRESET_ICON;
+	case dseed::bitmaps::webp_preset::text: return WEBP_PRESET_TEXT;
+	default: return WEBP_PRESET_DEFAULT;
+	}
+}
 
-		_config.quality = (float)quality;
-		_config.lossless = lossless;
-		_config.method = 6;
+bool __make_webp_config(const dseed::bitmaps::webp_encoder_options& options, WebPConfig& config) noexcept
+{
+	if (!WebPConfigPreset(&config, __webp_preset(options.preset), (float)options.quality))
+		return false;
 
-		_config.thread_level = 1;
+	config.lossless = options.lossless;
+	switch (options.preset)
+	{
+	case dseed::bitmaps::webp_preset::none: config.method = 6; break;
+	case dseed::bitmaps::webp_preset::realtime:
+		config.method = 2;
+		config.pass = 1;
+		config.alpha_filtering = 0;
+		break;
+	default: break;
 	}
+	if (options.method >= 0)
+		config.method = options.method;
+
+	if (options.lossless_level >= 0 && !WebPConfigLosslessPreset(&config, options.lossless_level))
+		return false;
+
+	config.thread_level = options.multithread ? 1 : 0;
+	config.alpha_compression = options.alpha_compression ? 1 : 0;
+	if (options.alpha_filtering >= 0)
+		config.alpha_filtering = options.alpha_filtering;
+	config.alpha_quality = options.alpha_quality;
+
+	return WebPValidateConfig(&config) != 0;
+}
+
+class __webp_encoder : public dseed::bitmaps::bitmap_encoder
+{
+public:
+	__webp_encoder(dseed::io::bufferedstream* stream, const WebPConfig& config)
+		: _refCount(1), _stream(stream), _config(config), _anim(nullptr)
+	{ }
 	~__webp_encoder()
 	{
 		if (_anim)
@@ -110,25 +144,23 @@ public:
 	{
 		WebPAnimEncoderAdd(_anim, nullptr, 0, &_config);
 		WebPData webpData = {};
-		if (WebPAnimEncoderAssemble(_anim, &webpData))
-		{
-			size_t totalWritten = 0;
-			while (totalWritten != webpData.size)
-			{
-				auto written = _stream->write(webpData.bytes + totalWritten, webpData.size - totalWritten);
-				totalWritten += written;
-			}
-		}
-		else return dseed::error_fail;
+		if (!WebPAnimEncoderAssemble(_anim, &webpData))
+			return dseed::error_fail;
 
-		_stream->flush();
-		return dseed::error_good;
+		// Assembled file is written in one call
+		const size_t written = _stream->write(webpData.bytes, webpData.size);
+		const size_t length = webpData.size;
+		WebPDataClear(&webpData);
+		if (written != length)
+			return dseed::error_io;
+
+		return _stream->commit();
 	}
 	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
 
 private:
 	std::atomic<int32_t> _refCount;
-	dseed::autoref<dseed::io::stream> _stream;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
 	WebPConfig _config;
 	WebPAnimEncoder* _anim;
 };
@@ -144,7 +176,17 @@ dseed::error_t dseed::bitmaps::create_webp_bitmap_encoder(dseed::io::stream* str
 			return dseed::error_invalid_args;
 		webpOptions = *reinterpret_cast<const webp_encoder_options*>(options);
 	}
-	*encoder = new __webp_encoder(stream, webpOptions.quality, webpOptions.lossless);
+
+	WebPConfig config;
+	memset(&config, 0, sizeof(config));
+	if (!__make_webp_config(webpOptions, config))
+		return dseed::error_invalid_args;
+
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, 0, &buffered); dseed::failed(err))
+		return err;
+
+	*encoder = new __webp_encoder(buffered, config);
 	if (*encoder == nullptr)
 		return dseed::error_out_of_memory;
 
@@ -19,8 +19,9 @@ using IWICImagingFactoryP = IWICImagingFactory2;
 class __wic_encoder : public dseed::bitmaps::bitmap_encoder
 {
 public:
-	__wic_encoder(IWICImagingFactoryP* factory, IWICBitmapEncoder* encoder, const dseed::bitmaps::wic_encoder_options* options)
-		: _refCount(1), _factory(factory), _encoder(encoder)
+	__wic_encoder(IWICImagingFactoryP* factory, IWICBitmapEncoder* encoder, dseed::io::bufferedstream* stream,
+		const dseed::bitmaps::wic_encoder_options* options)
+		: _refCount(1), _factory(factory), _encoder(encoder), _stream(stream)
 	{
 		if (options)
 		{
@@ -228,7 +229,7 @@ public:
 		if (FAILED(_encoder->Commit()))
 			return dseed::error_fail;
 
-		return dseed::error_good;
+		return _stream->commit();
 	}
 	virtual dseed::bitmaps::arraytype type() noexcept override { return dseed::bitmaps::arraytype::plain; }
 
@@ -236,6 +237,7 @@ private:
 	std::atomic<int32_t> _refCount;
 	Microsoft::WRL::ComPtr<IWICImagingFactoryP> _factory;
 	Microsoft::WRL::ComPtr<IWICBitmapEncoder> _encoder;
+	dseed::autoref<dseed::io::bufferedstream> _stream;
 
 	bool _haveOptions;
 	dseed::bitmaps::wic_encoder_options _options;
@@ -276,8 +278,12 @@ dseed::error_t dseed::bitmaps::create_wic_bitmap_encoder(dseed::io::stream* stre
 		break;
 	} while (true);
 
+	dseed::autoref<dseed::io::bufferedstream> buffered;
+	if (auto err = dseed::io::create_buffered_stream(stream, dseed::io::default_stream_buffer_size, &buffered); dseed::failed(err))
+		return err;
+
 	Microsoft::WRL::ComPtr<IStream> istream;
-	if (FAILED(ImpledIStream::Create(stream, &istream)))
+	if (FAILED(ImpledIStream::Create(buffered, &istream)))
 		return dseed::error_fail;
 
 	GUID containerFormat;
@@ -327,7 +333,7 @@ dseed::error_t dseed::bitmaps::create_wic_bitmap_encoder(dseed::io::stream* stre
 	if (FAILED(wicEncoder->Initialize(istream.Get(), WICBitmapEncoderNoCache)))
 		return dseed::error_fail;
 
-	*encoder = new __wic_encoder(factory.Get(), wicEncoder.Get(), reinterpret_cast<const dseed::bitmaps::wic_encoder_options*>(options));
+	*encoder = new __wic_encoder(factory.Get(), wicEncoder.Get(), buffered, reinterpret_cast<const dseed::bitmaps::wic_encoder_options*>(options));
 	if (*encoder == nullptr)
 		return dseed::error_out_of_memory;
 	return dseed::error_good;
@@ -0,0 +1,62 @@
+#ifndef __DSEED_INTERNAL_BITMAP_PARALLEL_HXX__
+#define __DSEED_INTERNAL_BITMAP_PARALLEL_HXX__
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Parallel Jobs
+//  : Splits independent jobs(tiles, rows, frames) to hardware threads.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+namespace dseed::bitmaps::parallel
+{
+	inline size_t concurrency() noexcept
+	{
+		const auto count = std::thread::hardware_concurrency();
+		return count > 0 ? (size_t)count : 1;
+	}
+
+	// Runs fn(index) for every index in [0, count)
+	//  : Indices are fetched one by one from shared counter, so uneven jobs are balanced.
+	//  : If threads cannot be created, remained jobs run on caller thread.
+	template<class TFunc>
+	inline void for_each(size_t count, TFunc&& fn, size_t threads = 0) noexcept
+	{
+		if (threads == 0)
+			threads = concurrency();
+		threads = dseed::minimum(threads, count);
+
+		if (threads <= 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+				fn(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				fn(i);
+		};
+
+		std::vector<std::thread> workers;
+		try
+		{
+			workers.reserve(threads - 1);
+			for (size_t t = 1; t < threads; ++t)
+				workers.emplace_back(worker);
+		}
+		catch (...) { }
+
+		worker();
+
+		for (auto& thread : workers)
+			thread.join();
+	}
+}
+
+#endif
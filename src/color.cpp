@@ -7,6 +7,9 @@ size_t dseed::color::calc_bitmap_stride(pixelformat pf, size_t width) noexcept
 	case pixelformat::rgbaf:
 		return width * 16;
 
+	case pixelformat::raf:
+		return width * 8;
+
 	case pixelformat::rgba8:
 	case pixelformat::bgra8:
 	case pixelformat::yuva8:
@@ -22,6 +25,7 @@ size_t dseed::color::calc_bitmap_stride(pixelformat pf, size_t width) noexcept
 
 	case pixelformat::bgra4:
 	case pixelformat::bgr565:
+	case pixelformat::ra8:
 		return width * 2;
 
 	case pixelformat::bgr8_indexed8:
@@ -30,7 +34,7 @@ size_t dseed::color::calc_bitmap_stride(pixelformat pf, size_t width) noexcept
 		return width;
 
 	case pixelformat::yuyv8:
-		return (((width + 2) / 4) * 4) * 2;
+		return ((width + 1) / 2) * 4;
 
 	case pixelformat::depth16:
 		return width * 2;
@@ -59,6 +63,8 @@ size_t dseed::color::calc_bitmap_plane_size(pixelformat pf, const size2i& size)
 	case pixelformat::bgra8_indexed8:
 	case pixelformat::r8:
 	case pixelformat::rf:
+	case pixelformat::ra8:
+	case pixelformat::raf:
 	case pixelformat::yuv8:
 	case pixelformat::yuva8:
 	case pixelformat::hsv8:
@@ -26,7 +26,7 @@ public:
 public:
 	virtual size_t read(void* buffer, size_t length) noexcept override
 	{
-		if (_position + length < _length)
+		if (_position + length > _length)
 			length = _length - _position;
 		if (length == 0)
 			return 0;
@@ -38,12 +38,12 @@ public:
 	}
 	virtual size_t write(const void* data, size_t length) noexcept override
 	{
-		if (_position + length < _length)
+		if (_position + length > _length)
 			length = _length - _position;
 		if (length == 0)
 			return 0;
 
-		memcpy(_buffer, ((const uint8_t*)_buffer) + _position, length);
+		memcpy(((uint8_t*)_buffer) + _position, data, length);
 		_position += length;
 
 		return length;
@@ -101,6 +101,100 @@ dseed::error_t dseed::io::create_fixed_memorystream(void* buffer, size_t length,
 	return dseed::error_good;
 }
 
+class __blob_memorystream : public dseed::io::blobstream
+{
+public:
+	__blob_memorystream(dseed::blob* blob)
+		: _refCount(1), _blob(blob), _position(0)
+	{ }
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual size_t read(void* buffer, size_t length) noexcept override
+	{
+		length = dseed::minimum(length, _blob->size() - _position);
+		if (length == 0)
+			return 0;
+
+		memcpy(buffer, ((const uint8_t*)_blob->ptr()) + _position, length);
+		_position += length;
+
+		return length;
+	}
+	virtual size_t write(const void* data, size_t length) noexcept override
+	{
+		length = dseed::minimum(length, _blob->size() - _position);
+		if (length == 0)
+			return 0;
+
+		memcpy(((uint8_t*)_blob->ptr()) + _position, data, length);
+		_position += length;
+
+		return length;
+	}
+	virtual bool seek(dseed::io::seekorigin origin, size_t offset) noexcept override
+	{
+		const size_t length = _blob->size();
+		switch (origin)
+		{
+		case dseed::io::seekorigin::begin: break;
+		case dseed::io::seekorigin::current: offset += _position; break;
+		case dseed::io::seekorigin::end: offset = length - offset; break;
+		default: return false;
+		}
+
+		_position = dseed::minimum(offset, length);
+
+		return true;
+	}
+
+	virtual void flush() noexcept override { }
+	virtual dseed::error_t set_length(size_t length) noexcept override { return dseed::error_not_support; }
+
+public:
+	virtual size_t position() noexcept override { return _position; }
+	virtual size_t length() noexcept override { return _blob->size(); }
+
+public:
+	virtual bool readable() noexcept override { return true; }
+	virtual bool writable() noexcept override { return true; }
+	virtual bool seekable() noexcept override { return true; }
+
+public:
+	virtual dseed::error_t blob(dseed::blob** blob) noexcept override
+	{
+		if (blob == nullptr)
+			return dseed::error_invalid_args;
+		(*blob = _blob)->retain();
+		return dseed::error_good;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::blob> _blob;
+
+	size_t _position;
+};
+
+dseed::error_t dseed::io::create_blob_memorystream(dseed::blob* blob, dseed::io::stream** stream)
+{
+	if (blob == nullptr || stream == nullptr)
+		return dseed::error_invalid_args;
+	*stream = new __blob_memorystream(blob);
+	if (*stream == nullptr)
+		return dseed::error_out_of_memory;
+	return dseed::error_good;
+}
+
 class __variable_memorystream : public dseed::io::stream
 {
 public:
@@ -121,7 +215,7 @@ public:
 public:
 	virtual size_t read(void* buffer, size_t length) noexcept override
 	{
-		if (_position + length < _buffer.size())
+		if (_position + length > _buffer.size())
 			length = _buffer.size() - _position;
 		if (length == 0)
 			return 0;
@@ -265,6 +359,155 @@ dseed::error_t dseed::io::create_variable_memorystream(dseed::io::stream** strea
 	return dseed::error_good;
 }
 
+class __buffered_stream : public dseed::io::bufferedstream
+{
+public:
+	__buffered_stream(dseed::io::stream* stream)
+		: _refCount(1), _stream(stream), _pending(0), _failed(false)
+	{ }
+	~__buffered_stream()
+	{
+		drain();
+	}
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	dseed::error_t initialize(size_t bufferSize) noexcept
+	{
+		try { _buffer.resize(bufferSize); }
+		catch (...) { return dseed::error_out_of_memory; }
+		return dseed::error_good;
+	}
+
+public:
+	virtual size_t read(void* buffer, size_t length) noexcept override
+	{
+		if (!drain())
+			return 0;
+		return _stream->read(buffer, length);
+	}
+	virtual size_t write(const void* data, size_t length) noexcept override
+	{
+		if (_failed || length == 0)
+			return 0;
+
+		if (_pending + length > _buffer.size())
+		{
+			if (!drain())
+				return 0;
+			if (length >= _buffer.size())
+				return write_through(data, length);
+		}
+
+		memcpy(_buffer.data() + _pending, data, length);
+		_pending += length;
+
+		return length;
+	}
+	virtual bool seek(dseed::io::seekorigin origin, size_t offset) noexcept override
+	{
+		if (!drain())
+			return false;
+		return _stream->seek(origin, offset);
+	}
+	virtual void flush() noexcept override
+	{
+		if (drain())
+			_stream->flush();
+	}
+	virtual dseed::error_t set_length(size_t length) noexcept override
+	{
+		if (!drain())
+			return dseed::error_io;
+		return _stream->set_length(length);
+	}
+
+public:
+	virtual size_t position() noexcept override { return _stream->position() + _pending; }
+	virtual size_t length() noexcept override { return dseed::maximum(_stream->length(), position()); }
+
+public:
+	virtual bool readable() noexcept override { return _stream->readable(); }
+	virtual bool writable() noexcept override { return _stream->writable(); }
+	virtual bool seekable() noexcept override { return _stream->seekable(); }
+
+public:
+	virtual dseed::error_t commit() noexcept override
+	{
+		if (!drain())
+			return dseed::error_io;
+		_stream->flush();
+		return dseed::error_good;
+	}
+
+private:
+	size_t write_through(const void* data, size_t length) noexcept
+	{
+		const size_t written = _stream->write(data, length);
+		if (written != length)
+			_failed = true;
+		return written;
+	}
+
+	bool drain() noexcept
+	{
+		if (_pending > 0)
+		{
+			const size_t pending = _pending;
+			_pending = 0;
+			write_through(_buffer.data(), pending);
+		}
+		return !_failed;
+	}
+
+private:
+	std::atomic<int32_t> _refCount;
+	dseed::autoref<dseed::io::stream> _stream;
+
+	std::vector<uint8_t> _buffer;
+	size_t _pending;
+	bool _failed;
+};
+
+dseed::error_t dseed::io::create_buffered_stream(dseed::io::stream* stream, size_t buffer_size, dseed::io::bufferedstream** buffered)
+{
+	if (stream == nullptr || buffered == nullptr)
+		return dseed::error_invalid_args;
+
+	if (auto alreadyBuffered = dynamic_cast<dseed::io::bufferedstream*>(stream); alreadyBuffered != nullptr)
+	{
+		(*buffered = alreadyBuffered)->retain();
+		return dseed::error_good;
+	}
+
+	// Writes to memory are as cheap as gathering them
+	if (dynamic_cast<__memorystream*>(stream) != nullptr || dynamic_cast<__blob_memorystream*>(stream) != nullptr
+		|| dynamic_cast<__variable_memorystream*>(stream) != nullptr
+		|| dynamic_cast<__variable_memorystream_remove_after_read*>(stream) != nullptr)
+		buffer_size = 0;
+
+	auto temp = new __buffered_stream(stream);
+	if (temp == nullptr)
+		return dseed::error_out_of_memory;
+	if (auto err = temp->initialize(buffer_size); dseed::failed(err))
+	{
+		temp->release();
+		return err;
+	}
+
+	*buffered = temp;
+	return dseed::error_good;
+}
+
 #if PLATFORM_WINDOWS
 class __native_filestream_win32 : public dseed::io::stream
 {
@@ -397,7 +640,7 @@ public:
 	}
 	virtual bool seek(dseed::io::seekorigin origin, size_t offset) noexcept override
 	{
-		return !lseek(_fd, offset, (int)origin);
+		return lseek(_fd, offset, (int)origin) != -1;
 	}
 	virtual void flush() noexcept override
 	{
@@ -432,6 +675,75 @@ private:
 };
 #endif
 
+#if PLATFORM_WINDOWS
+class __mapped_file_blob_win32 : public dseed::blob
+{
+public:
+	__mapped_file_blob_win32(HANDLE mapping, void* view, size_t size)
+		: _refCount(1), _mapping(mapping), _view(view), _size(size)
+	{ }
+	~__mapped_file_blob_win32()
+	{
+		UnmapViewOfFile(_view);
+		CloseHandle(_mapping);
+	}
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual void* ptr() noexcept override { return _view; }
+	virtual const void* ptr() const noexcept override { return _view; }
+	virtual size_t size() const noexcept override { return _size; }
+
+private:
+	std::atomic<int32_t> _refCount;
+	HANDLE _mapping;
+	void* _view;
+	size_t _size;
+};
+#elif !PLATFORM_UWP
+#	include <sys/mman.h>
+class __mapped_file_blob_posix : public dseed::blob
+{
+public:
+	__mapped_file_blob_posix(void* view, size_t size)
+		: _refCount(1), _view(view), _size(size)
+	{ }
+	~__mapped_file_blob_posix()
+	{
+		munmap(_view, _size);
+	}
+
+public:
+	virtual int32_t retain() override { return ++_refCount; }
+	virtual int32_t release() override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual void* ptr() noexcept override { return _view; }
+	virtual const void* ptr() const noexcept override { return _view; }
+	virtual size_t size() const noexcept override { return _size; }
+
+private:
+	std::atomic<int32_t> _refCount;
+	void* _view;
+	size_t _size;
+};
+#endif
+
 dseed::error_t dseed::io::create_native_filestream(const char* path, bool create, dseed::io::stream** stream)
 {
 	if (stream == nullptr)
@@ -471,4 +783,89 @@ dseed::error_t dseed::io::create_native_filestream(const char* path, bool create
 	if (*stream == nullptr)
 		return dseed::error_out_of_memory;
 	return dseed::error_good;
+}
+
+dseed::error_t dseed::io::create_mapped_file_blob(const char* path, dseed::blob** blob)
+{
+	if (path == nullptr || blob == nullptr)
+		return dseed::error_invalid_args;
+#if PLATFORM_WINDOWS
+	char16_t filename[256];
+	utf8_to_utf16(path, filename, 256);
+	HANDLE file = CreateFile2((LPCWSTR)filename, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		auto error = GetLastError();
+		if (error == ERROR_ACCESS_DENIED)
+			return dseed::error_access_denied;
+		else if (error == ERROR_FILE_NOT_FOUND)
+			return dseed::error_file_not_found;
+		else return dseed::error_io;
+	}
+
+	// Mapping keeps file open, so file handle is not needed after this
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMapping(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr)
+		return dseed::error_io;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		return dseed::error_io;
+	}
+
+	*blob = new __mapped_file_blob_win32(mapping, view, (size_t)size.QuadPart);
+	if (*blob == nullptr)
+	{
+		UnmapViewOfFile(view);
+		CloseHandle(mapping);
+		return dseed::error_out_of_memory;
+	}
+#elif PLATFORM_UWP
+	return dseed::error_not_support;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+	{
+		if (errno == EACCES)
+			return dseed::error_access_denied;
+		else if (errno == ENOENT)
+			return dseed::error_file_not_found;
+		else return dseed::error_io;
+	}
+
+	// Mapping keeps file open, so descriptor is not needed after this
+	struct stat s;
+	void* view = MAP_FAILED;
+	if (fstat(fd, &s) == 0 && s.st_size > 0)
+		view = mmap(nullptr, (size_t)s.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return dseed::error_io;
+
+	*blob = new __mapped_file_blob_posix(view, (size_t)s.st_size);
+	if (*blob == nullptr)
+	{
+		munmap(view, (size_t)s.st_size);
+		return dseed::error_out_of_memory;
+	}
+#endif
+	return dseed::error_good;
+}
+
+dseed::error_t dseed::io::create_mapped_filestream(const char* path, dseed::io::stream** stream)
+{
+	if (stream == nullptr)
+		return dseed::error_invalid_args;
+
+	dseed::autoref<dseed::blob> blob;
+	if (auto err = create_mapped_file_blob(path, &blob); dseed::failed(err))
+		return err;
+
+	return create_blob_memorystream(blob, stream);
 }
\ No newline at end of file
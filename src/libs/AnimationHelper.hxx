@@ -0,0 +1,261 @@
+#ifndef __DSEED_ANIMATION_HELPER_HXX__
+#define __DSEED_ANIMATION_HELPER_HXX__
+
+#include <list>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Animation Frame Loader
+//  : Frames of GIF and animated WebP are drawn over canvas left by previous frames.
+//  : Key frame is a frame whose canvas before drawing is known without decoding previous frames,
+//    so decoding can start there. First frame is always key frame.
+//  : Canvas is stored in byte vector, pixel layout is decided by each decoder.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Canvases before drawing frame; checkpoints for seeking
+//  : Least recently used canvas is evicted when more than capacity canvases are stored.
+class __animation_canvas_cache
+{
+public:
+	__animation_canvas_cache (size_t capacity) noexcept : _capacity (capacity) { }
+
+public:
+	// Nearest canvas in (after, index]
+	bool find (size_t index, size_t after, size_t& found, std::vector<uint8_t>& canvas) noexcept
+	{
+		auto nearest = _entries.end ();
+		for (auto it = _entries.begin (); it != _entries.end (); ++it)
+		{
+			if (it->first > after && it->first <= index && (nearest == _entries.end () || it->first > nearest->first))
+				nearest = it;
+		}
+		if (nearest == _entries.end ())
+			return false;
+
+		try { canvas = nearest->second; }
+		catch (...) { return false; }
+		found = nearest->first;
+		_entries.splice (_entries.begin (), _entries, nearest);
+		return true;
+	}
+
+	void store (size_t index, const std::vector<uint8_t>& canvas) noexcept
+	{
+		if (_capacity == 0)
+			return;
+
+		for (auto it = _entries.begin (); it != _entries.end (); ++it)
+		{
+			if (it->first == index)
+			{
+				_entries.splice (_entries.begin (), _entries, it);
+				return;
+			}
+		}
+
+		try
+		{
+			if (_entries.size () >= _capacity)
+			{
+				// Storage of evicted canvas is reused
+				_entries.splice (_entries.begin (), _entries, std::prev (_entries.end ()));
+				_entries.front ().first = index;
+				_entries.front ().second = canvas;
+			}
+			else
+				_entries.emplace_front (index, canvas);
+		}
+		catch (...) { }
+	}
+
+private:
+	size_t _capacity;
+	std::list<std::pair<size_t, std::vector<uint8_t>>> _entries;
+};
+
+// Nearest key frame at or before index
+inline size_t __animation_key_frame (const std::vector<bool>& keys, size_t index) noexcept
+{
+	while (index > 0 && !keys[index])
+		--index;
+	return index;
+}
+
+// Splits frames into runs starting at key frames; runs do not depend on each other
+inline std::vector<std::pair<size_t, size_t>> __animation_key_runs (const std::vector<bool>& keys)
+{
+	std::vector<std::pair<size_t, size_t>> runs;
+	for (size_t i = 0; i < keys.size (); ++i)
+	{
+		if (i == 0 || keys[i])
+			runs.emplace_back (i, i + 1);
+		else
+			runs.back ().second = i + 1;
+	}
+	return runs;
+}
+
+// Whole stream as blob; blob of blob stream is shared, other streams are read into memory
+//  : Offsets in blob are same as offsets in stream.
+inline dseed::error_t __animation_stream_blob (dseed::io::stream* stream, dseed::blob** blob) noexcept
+{
+	if (auto blobStream = dynamic_cast<dseed::io::blobstream*> (stream); blobStream != nullptr
+		&& dseed::succeeded (blobStream->blob (blob)))
+		return dseed::error_good;
+
+	const size_t position = stream->position (), length = stream->length ();
+	dseed::autoref<dseed::blob> temp;
+	if (auto err = dseed::create_empty_blob (length, &temp); dseed::failed (err))
+		return err;
+	if (!stream->seek (dseed::io::seekorigin::begin, 0)
+		|| stream->read (temp->ptr (), length) != length)
+		return dseed::error_io;
+	stream->seek (dseed::io::seekorigin::begin, position);
+
+	*blob = temp.detach ();
+	return dseed::error_good;
+}
+
+// Loader decoding frames in order from key frame or cached canvas
+//  : Derived loader decodes next frame over canvas in step, and moves its reader to frame in seek.
+class __animation_frame_loader : public dseed::bitmaps::bitmap_frame_loader
+{
+public:
+	// Canvas is stored every this frames while decoding toward requested frame
+	static constexpr size_t checkpoint_interval = 32;
+
+public:
+	__animation_frame_loader (const std::vector<bool>& keys, size_t cacheSize)
+		: _refCount (1), _keys (keys), _cache (cacheSize), _next (0), _positioned (false)
+	{ }
+
+public:
+	virtual int32_t retain () override { return ++_refCount; }
+	virtual int32_t release () override
+	{
+		auto ret = --_refCount;
+		if (ret == 0)
+			delete this;
+		return ret;
+	}
+
+public:
+	virtual dseed::error_t load (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept override
+	{
+		if (index >= _keys.size ())
+			return dseed::error_invalid_args;
+
+		// Decoding resumes from nearest of current position, cached canvas and key frame
+		size_t start = __animation_key_frame (_keys, index), cached;
+		const bool resume = _positioned && _next <= index && _next >= start;
+		if (resume)
+			start = _next;
+
+		if (_cache.find (index, start, cached, _canvas))
+		{
+			if (auto err = reposition (cached, false); dseed::failed (err))
+				return err;
+		}
+		else if (!resume)
+		{
+			if (auto err = reposition (start, true); dseed::failed (err))
+				return err;
+		}
+
+		while (_next < index)
+		{
+			if (auto err = advance (nullptr); dseed::failed (err))
+				return err;
+			if (_next % checkpoint_interval == 0)
+				_cache.store (_next, _canvas);
+		}
+
+		_cache.store (index, _canvas);
+		return advance (bitmap);
+	}
+
+protected:
+	// Moves reader to frame; canvas is already set when keyCanvas is false
+	virtual dseed::error_t seek (size_t index, bool keyCanvas) noexcept = 0;
+	// Draws frame at current position over canvas, then applies disposal
+	//  : Composited frame is returned before disposal if bitmap is not null.
+	virtual dseed::error_t step (size_t index, dseed::bitmaps::bitmap** bitmap) noexcept = 0;
+
+	inline bool key (size_t index) const noexcept { return _keys[index]; }
+
+private:
+	dseed::error_t reposition (size_t index, bool keyCanvas) noexcept
+	{
+		_positioned = false;
+		if (auto err = seek (index, keyCanvas); dseed::failed (err))
+			return err;
+		_next = index;
+		_positioned = true;
+		return dseed::error_good;
+	}
+
+	dseed::error_t advance (dseed::bitmaps::bitmap** bitmap) noexcept
+	{
+		if (auto err = step (_next, bitmap); dseed::failed (err))
+		{
+			_positioned = false;
+			return err;
+		}
+		++_next;
+		return dseed::error_good;
+	}
+
+protected:
+	std::vector<uint8_t> _canvas;
+
+private:
+	std::atomic<int32_t> _refCount;
+	std::vector<bool> _keys;
+	__animation_canvas_cache _cache;
+	size_t _next;
+	bool _positioned;
+};
+
+// Decodes every frame; runs between key frames are decoded on worker threads with own loaders
+//  : createLoader makes loader reading from given stream over shared blob.
+template<class TCreateLoader>
+inline dseed::error_t __animation_decode_parallel (dseed::blob* blob, const std::vector<bool>& keys, size_t threads,
+	TCreateLoader&& createLoader, std::vector<dseed::autoref<dseed::bitmaps::bitmap>>& bitmaps) noexcept
+{
+	std::vector<std::pair<size_t, size_t>> runs;
+	try
+	{
+		runs = __animation_key_runs (keys);
+		bitmaps.resize (keys.size ());
+	}
+	catch (...) { return dseed::error_out_of_memory; }
+
+	std::atomic<dseed::error_t> result (dseed::error_good);
+	dseed::bitmaps::parallel::for_each (runs.size (), [&](size_t r)
+	{
+		dseed::autoref<dseed::io::stream> stream;
+		dseed::autoref<dseed::bitmaps::bitmap_frame_loader> loader;
+		if (auto err = dseed::io::create_blob_memorystream (blob, &stream); dseed::failed (err))
+		{
+			result = err;
+			return;
+		}
+		if (auto err = createLoader (stream.get (), &loader); dseed::failed (err))
+		{
+			result = err;
+			return;
+		}
+
+		for (size_t i = runs[r].first; i < runs[r].second && dseed::succeeded (result.load ()); ++i)
+		{
+			if (auto err = loader->load (i, &bitmaps[i]); dseed::failed (err))
+				result = err;
+		}
+	}, threads);
+
+	return result;
+}
+
+#endif
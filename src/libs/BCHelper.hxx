@@ -0,0 +1,479 @@
+#ifndef __DSEED_BC_HELPER_HXX__
+#define __DSEED_BC_HELPER_HXX__
+
+#include <cstring>
+#include <cmath>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Block Compression(BC1~BC5, BC7) Encoders
+//  : Each function compresses one 4x4 block of RGBA8 pixels, so callers split blocks
+//    to worker threads freely.
+//  : Endpoints are fitted on principal axis of block colours; BC7 uses mode 6 only.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Gathers 4x4 block of RGBA8 pixels, edge pixels are repeated for partial block
+inline void __bc_fetch_block (const uint8_t* pixels, size_t stride, int width, int height, int bx, int by, uint8_t block[64]) noexcept
+{
+	for (int y = 0; y < 4; ++y)
+	{
+		const uint8_t* row = pixels + (size_t)dseed::minimum (by * 4 + y, height - 1) * stride;
+		for (int x = 0; x < 4; ++x)
+			memcpy (block + (y * 4 + x) * 4, row + (size_t)dseed::minimum (bx * 4 + x, width - 1) * 4, 4);
+	}
+}
+
+// Principal axis of points by power iteration
+template<int Channels>
+inline void __bc_principal_axis (const float (*points)[4], int count, float mean[4], float axis[4]) noexcept
+{
+	for (int c = 0; c < 4; ++c)
+		mean[c] = axis[c] = 0;
+	for (int i = 0; i < count; ++i)
+		for (int c = 0; c < Channels; ++c)
+			mean[c] += points[i][c];
+	for (int c = 0; c < Channels; ++c)
+		mean[c] /= count;
+
+	float cov[4][4] = {};
+	for (int i = 0; i < count; ++i)
+	{
+		float d[4];
+		for (int c = 0; c < Channels; ++c)
+			d[c] = points[i][c] - mean[c];
+		for (int r = 0; r < Channels; ++r)
+			for (int c = 0; c < Channels; ++c)
+				cov[r][c] += d[r] * d[c];
+	}
+
+	for (int c = 0; c < Channels; ++c)
+		axis[c] = 1;
+	for (int iter = 0; iter < 8; ++iter)
+	{
+		float next[4] = {}, length = 0;
+		for (int r = 0; r < Channels; ++r)
+		{
+			for (int c = 0; c < Channels; ++c)
+				next[r] += cov[r][c] * axis[c];
+			length = dseed::maximum (length, fabsf (next[r]));
+		}
+		if (length <= 1e-6f)
+			break;
+		for (int c = 0; c < Channels; ++c)
+			axis[c] = next[c] / length;
+	}
+}
+
+// Fits two endpoints on principal axis of points
+template<int Channels>
+inline void __bc_fit_endpoints (const float (*points)[4], int count, float e0[4], float e1[4]) noexcept
+{
+	float mean[4], axis[4];
+	__bc_principal_axis<Channels> (points, count, mean, axis);
+
+	float tmin = 0, tmax = 0, length = 0;
+	for (int c = 0; c < Channels; ++c)
+		length += axis[c] * axis[c];
+	if (length > 0)
+	{
+		tmin = 1e30f; tmax = -1e30f;
+		for (int i = 0; i < count; ++i)
+		{
+			float t = 0;
+			for (int c = 0; c < Channels; ++c)
+				t += (points[i][c] - mean[c]) * axis[c];
+			t /= length;
+			tmin = dseed::minimum (tmin, t);
+			tmax = dseed::maximum (tmax, t);
+		}
+	}
+
+	for (int c = 0; c < 4; ++c)
+	{
+		e0[c] = dseed::clamp (mean[c] + axis[c] * tmax, 255.0f);
+		e1[c] = dseed::clamp (mean[c] + axis[c] * tmin, 255.0f);
+	}
+}
+
+inline uint16_t __bc_pack565 (const float c[4]) noexcept
+{
+	const int r = (int)(c[0] * 31 / 255 + 0.5f), g = (int)(c[1] * 63 / 255 + 0.5f), b = (int)(c[2] * 31 / 255 + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void __bc_unpack565 (uint16_t v, int c[3]) noexcept
+{
+	const int r = (v >> 11) & 0x1f, g = (v >> 5) & 0x3f, b = v & 0x1f;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+// Chooses nearest palette entries, returns squared error
+inline int __bc1_select (const uint8_t* block, const bool* skip, uint16_t c0, uint16_t c1, bool threeColors, uint32_t& indices) noexcept
+{
+	int palette[4][3];
+	__bc_unpack565 (c0, palette[0]);
+	__bc_unpack565 (c1, palette[1]);
+	for (int c = 0; c < 3; ++c)
+	{
+		if (threeColors)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		else
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+
+	int error = 0;
+	indices = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		if (skip != nullptr && skip[i])
+		{
+			indices |= 3u << (i * 2);
+			continue;
+		}
+
+		int best = 0, bestError = 0x7fffffff;
+		for (int p = 0; p < (threeColors ? 3 : 4); ++p)
+		{
+			const int dr = block[i * 4 + 0] - palette[p][0], dg = block[i * 4 + 1] - palette[p][1], db = block[i * 4 + 2] - palette[p][2];
+			const int e = dr * dr + dg * dg + db * db;
+			if (e < bestError)
+			{
+				bestError = e;
+				best = p;
+			}
+		}
+		indices |= (uint32_t)best << (i * 2);
+		error += bestError;
+	}
+	return error;
+}
+
+// Least squares endpoints for selected indices of 4-colour block
+inline bool __bc1_refine (const uint8_t* block, uint32_t indices, float e0[4], float e1[4]) noexcept
+{
+	static const float weights[4] = { 0, 1, 1.0f / 3, 2.0f / 3 };
+	float aa = 0, bb = 0, ab = 0, ax[3] = {}, bx[3] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		const float w = weights[(indices >> (i * 2)) & 3], a = 1 - w;
+		aa += a * a; bb += w * w; ab += a * w;
+		for (int c = 0; c < 3; ++c)
+		{
+			ax[c] += a * block[i * 4 + c];
+			bx[c] += w * block[i * 4 + c];
+		}
+	}
+
+	const float det = aa * bb - ab * ab;
+	if (fabsf (det) < 1e-6f)
+		return false;
+	for (int c = 0; c < 3; ++c)
+	{
+		e0[c] = dseed::clamp ((ax[c] * bb - bx[c] * ab) / det, 255.0f);
+		e1[c] = dseed::clamp ((bx[c] * aa - ax[c] * ab) / det, 255.0f);
+	}
+	return true;
+}
+
+inline void __bc_write16 (uint8_t* out, uint16_t v) noexcept { out[0] = (uint8_t)v; out[1] = (uint8_t)(v >> 8); }
+inline void __bc_write32 (uint8_t* out, uint32_t v) noexcept { for (int i = 0; i < 4; ++i) out[i] = (uint8_t)(v >> (i * 8)); }
+
+// BC1 Colour Block
+//  : If punchThrough, pixels with alpha under 128 are stored as transparent in 3-colour mode.
+//  : Otherwise block is always 4-colour mode, as BC2 and BC3 colour blocks are read.
+inline void __bc1_encode_block (const uint8_t* block, uint8_t* out, bool punchThrough) noexcept
+{
+	bool transparent[16] = {};
+	float points[16][4];
+	int count = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		if (punchThrough && block[i * 4 + 3] < 128)
+		{
+			transparent[i] = true;
+			continue;
+		}
+		for (int c = 0; c < 4; ++c)
+			points[count][c] = block[i * 4 + c];
+		++count;
+	}
+
+	if (count == 0)
+	{
+		__bc_write16 (out, 0);
+		__bc_write16 (out + 2, 0);
+		__bc_write32 (out + 4, 0xffffffff);
+		return;
+	}
+
+	float e0[4], e1[4];
+	__bc_fit_endpoints<3> (points, count, e0, e1);
+	uint16_t c0 = __bc_pack565 (e0), c1 = __bc_pack565 (e1);
+
+	if (count < 16)
+	{
+		// 3-colour mode is selected by c0 <= c1
+		if (c0 > c1)
+		{
+			const uint16_t t = c0; c0 = c1; c1 = t;
+		}
+		uint32_t indices;
+		__bc1_select (block, transparent, c0, c1, true, indices);
+		__bc_write16 (out, c0);
+		__bc_write16 (out + 2, c1);
+		__bc_write32 (out + 4, indices);
+		return;
+	}
+
+	uint32_t indices;
+	int error = __bc1_select (block, nullptr, c0, c1, false, indices);
+	float r0[4], r1[4];
+	if (error > 0 && __bc1_refine (block, indices, r0, r1))
+	{
+		const uint16_t rc0 = __bc_pack565 (r0), rc1 = __bc_pack565 (r1);
+		uint32_t refined;
+		const int refinedError = __bc1_select (block, nullptr, rc0, rc1, false, refined);
+		if (refinedError < error)
+		{
+			c0 = rc0; c1 = rc1; indices = refined; error = refinedError;
+		}
+	}
+
+	// 4-colour mode is selected by c0 > c1
+	if (c0 < c1)
+	{
+		const uint16_t t = c0; c0 = c1; c1 = t;
+		indices ^= 0x55555555;
+	}
+	else if (c0 == c1)
+		indices = 0;
+
+	__bc_write16 (out, c0);
+	__bc_write16 (out + 2, c1);
+	__bc_write32 (out + 4, indices);
+}
+
+// BC4 Single Channel Block
+//  : 8-value mode only, endpoints are block minimum and maximum.
+inline void __bc4_encode_block (const uint8_t* values, size_t step, uint8_t* out) noexcept
+{
+	int minimum = 255, maximum = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		minimum = dseed::minimum (minimum, (int)values[i * step]);
+		maximum = dseed::maximum (maximum, (int)values[i * step]);
+	}
+
+	out[0] = (uint8_t)maximum;
+	out[1] = (uint8_t)minimum;
+
+	uint64_t indices = 0;
+	if (maximum != minimum)
+	{
+		int palette[8] = { maximum, minimum };
+		for (int p = 2; p < 8; ++p)
+			palette[p] = ((8 - p) * maximum + (p - 1) * minimum) / 7;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0, bestError = 256;
+			for (int p = 0; p < 8; ++p)
+			{
+				const int e = abs ((int)values[i * step] - palette[p]);
+				if (e < bestError)
+				{
+					bestError = e;
+					best = p;
+				}
+			}
+			indices |= (uint64_t)best << (i * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+// BC2 Block
+//  : Explicit 4-bit alpha and BC1 colour.
+inline void __bc2_encode_block (const uint8_t* block, uint8_t* out) noexcept
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		const int a0 = (block[(i * 2) * 4 + 3] * 15 + 127) / 255, a1 = (block[(i * 2 + 1) * 4 + 3] * 15 + 127) / 255;
+		out[i] = (uint8_t)(a0 | (a1 << 4));
+	}
+	__bc1_encode_block (block, out + 8, false);
+}
+
+// BC3 Block
+//  : BC4 alpha and BC1 colour.
+inline void __bc3_encode_block (const uint8_t* block, uint8_t* out) noexcept
+{
+	__bc4_encode_block (block + 3, 4, out);
+	__bc1_encode_block (block, out + 8, false);
+}
+
+// BC5 Block
+//  : BC4 red and BC4 green.
+inline void __bc5_encode_block (const uint8_t* block, uint8_t* out) noexcept
+{
+	__bc4_encode_block (block + 0, 4, out);
+	__bc4_encode_block (block + 1, 4, out + 8);
+}
+
+class __bc_bit_writer
+{
+public:
+	__bc_bit_writer (uint8_t* out) noexcept
+		: _out (out), _bit (0)
+	{
+		memset (out, 0, 16);
+	}
+
+public:
+	inline void put (uint32_t value, int bits) noexcept
+	{
+		for (int i = 0; i < bits; ++i, ++_bit)
+			_out[_bit >> 3] |= (uint8_t)(((value >> i) & 1) << (_bit & 7));
+	}
+
+private:
+	uint8_t* _out;
+	int _bit;
+};
+
+// BC7 Block
+//  : Mode 6 only; one subset of RGBA 7-bit endpoints with P-bits and 4-bit indices.
+inline void __bc7_encode_block (const uint8_t* block, uint8_t* out) noexcept
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float points[16][4];
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 4; ++c)
+			points[i][c] = block[i * 4 + c];
+
+	float e0[4], e1[4];
+	__bc_fit_endpoints<4> (points, 16, e0, e1);
+
+	int bestError = 0x7fffffff;
+	int bestQ[2][4] = {}, bestP[2] = {};
+	uint8_t bestIndices[16] = {};
+	for (int pbits = 0; pbits < 4; ++pbits)
+	{
+		const int p[2] = { pbits & 1, pbits >> 1 };
+		int q[2][4], expanded[2][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			q[0][c] = dseed::clamp ((int)((e0[c] - p[0]) / 2 + 0.5f), 127);
+			q[1][c] = dseed::clamp ((int)((e1[c] - p[1]) / 2 + 0.5f), 127);
+			expanded[0][c] = (q[0][c] << 1) | p[0];
+			expanded[1][c] = (q[1][c] << 1) | p[1];
+		}
+
+		int palette[16][4];
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 4; ++c)
+				palette[i][c] = ((64 - weights[i]) * expanded[0][c] + weights[i] * expanded[1][c] + 32) >> 6;
+
+		int error = 0;
+		uint8_t indices[16];
+		for (int i = 0; i < 16 && error < bestError; ++i)
+		{
+			int best = 0, bestPixelError = 0x7fffffff;
+			for (int k = 0; k < 16; ++k)
+			{
+				int e = 0;
+				for (int c = 0; c < 4; ++c)
+				{
+					const int d = block[i * 4 + c] - palette[k][c];
+					e += d * d;
+				}
+				if (e < bestPixelError)
+				{
+					bestPixelError = e;
+					best = k;
+				}
+			}
+			indices[i] = (uint8_t)best;
+			error += bestPixelError;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy (bestQ, q, sizeof (q));
+			bestP[0] = p[0]; bestP[1] = p[1];
+			memcpy (bestIndices, indices, sizeof (indices));
+		}
+	}
+
+	// MSB of first index is implied 0, so endpoints are swapped if it is set
+	if (bestIndices[0] & 0x8)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			const int t = bestQ[0][c]; bestQ[0][c] = bestQ[1][c]; bestQ[1][c] = t;
+		}
+		const int t = bestP[0]; bestP[0] = bestP[1]; bestP[1] = t;
+		for (int i = 0; i < 16; ++i)
+			bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+	}
+
+	__bc_bit_writer writer (out);
+	writer.put (1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.put (bestQ[0][c], 7);
+		writer.put (bestQ[1][c], 7);
+	}
+	writer.put (bestP[0], 1);
+	writer.put (bestP[1], 1);
+	writer.put (bestIndices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		writer.put (bestIndices[i], 4);
+}
+
+// Compresses one block of format from RGBA8 block, returns false for formats without encoder
+inline bool __bc_encode_block (dseed::color::pixelformat format, const uint8_t* block, uint8_t* out) noexcept
+{
+	switch (format)
+	{
+	case dseed::color::pixelformat::bc1: __bc1_encode_block (block, out, true); return true;
+	case dseed::color::pixelformat::bc2: __bc2_encode_block (block, out); return true;
+	case dseed::color::pixelformat::bc3: __bc3_encode_block (block, out); return true;
+	case dseed::color::pixelformat::bc4: __bc4_encode_block (block, 4, out); return true;
+	case dseed::color::pixelformat::bc5: __bc5_encode_block (block, out); return true;
+	case dseed::color::pixelformat::bc7: __bc7_encode_block (block, out); return true;
+	default: return false;
+	}
+}
+
+inline size_t __bc_block_bytes (dseed::color::pixelformat format) noexcept
+{
+	switch (format)
+	{
+	case dseed::color::pixelformat::bc1:
+	case dseed::color::pixelformat::bc4:
+		return 8;
+	case dseed::color::pixelformat::bc2:
+	case dseed::color::pixelformat::bc3:
+	case dseed::color::pixelformat::bc5:
+	case dseed::color::pixelformat::bc7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+#endif
@@ -203,6 +203,7 @@ struct DDS_PIXELFORMAT
 #define DDS_HEADER_FLAGS_PITCH			0x8
 #define DDS_HEADER_FLAGS_PIXELFORMAT	0x1000
 #define DDS_HEADER_FLAGS_LINEARSIZE		0x80000
+#define DDS_HEADER_FLAGS_MIPMAP			0x20000
 #define DDS_HEADER_FLAGS_REQUIRED		(DDS_HEADER_FLAGS_CAPS | DDS_HEADER_FLAGS_HEIGHT |\
 											DDS_HEADER_FLAGS_WIDTH | DDS_HEADER_FLAGS_PIXELFORMAT)
 
@@ -222,6 +223,13 @@ struct DDS_PIXELFORMAT
                                DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ)
 
 #define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+#define DDS_FLAGS_VOLUME 0x00200000 // DDSCAPS2_VOLUME
+
+#define DDS_SURFACE_FLAGS_TEXTURE 0x00001000 // DDSCAPS_TEXTURE
+#define DDS_SURFACE_FLAGS_MIPMAP  0x00400008 // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+#define DDS_SURFACE_FLAGS_CUBEMAP 0x00000008 // DDSCAPS_COMPLEX
+
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
 
 enum DDS_MISC_FLAGS2
 {
@@ -258,4 +266,14 @@ struct DDS_HEADER_DXT10
 constexpr uint32_t DDS_MAGIC = 0x20534444;
 constexpr uint32_t make_fourcc(uint8_t ch0, uint8_t ch1, uint8_t ch2, uint8_t ch3) { return ((uint32_t)ch0 | ((uint32_t)ch1 << 8) | ((uint32_t)ch2 << 16) | ((uint32_t)ch3 << 24)); }
 
+// Size of mip level
+//  : Faces of cubemap and slices of array are stored in depth, so depth shrinks only for volume.
+inline dseed::size3i __dds_level_size(const dseed::size3i& size, size_t level, bool volume) noexcept
+{
+	return dseed::size3i(
+		dseed::maximum(1, size.width >> level),
+		dseed::maximum(1, size.height >> level),
+		volume ? dseed::maximum(1, size.depth >> level) : size.depth);
+}
+
 #endif
\ No newline at end of file
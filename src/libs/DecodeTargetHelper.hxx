@@ -0,0 +1,148 @@
+#ifndef __DSEED_DECODE_TARGET_HELPER_HXX__
+#define __DSEED_DECODE_TARGET_HELPER_HXX__
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Decode Target
+//  : Caller-owned memory(locked bitmap, mapped staging buffer) which decoders write rows to.
+//  : Row means block row for block-compressed formats.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+struct __decode_target
+{
+	uint8_t* pixels;
+	size_t rowBytes;
+	size_t stride;
+	size_t rows;
+	size_t depth;
+
+	inline uint8_t* row (size_t y, size_t z = 0) const noexcept { return pixels + ((z * rows) + y) * stride; }
+	inline bool packed () const noexcept { return stride == rowBytes; }
+};
+
+// Bytes of one row without padding
+//  : Library bitmap rows of 24-bit formats are aligned to 4 bytes, so they are counted by pixel here.
+inline size_t __packed_row_bytes (dseed::color::pixelformat format, size_t width) noexcept
+{
+	switch (format)
+	{
+	case dseed::color::pixelformat::rgb8:
+	case dseed::color::pixelformat::bgr8:
+	case dseed::color::pixelformat::yuv8:
+	case dseed::color::pixelformat::hsv8:
+		return width * 3;
+	default:
+		return dseed::color::calc_bitmap_plane_size (format, dseed::size2i ((int)width, 1));
+	}
+}
+
+// Bytes skipped after each row of data stored in library bitmap layout(DDS, KTX)
+inline size_t __bitmap_row_padding (dseed::color::pixelformat format, size_t width, const __decode_target& target) noexcept
+{
+	const size_t bitmapRowBytes = dseed::color::calc_bitmap_plane_size (format, dseed::size2i ((int)width, 1));
+	return bitmapRowBytes > target.rowBytes ? bitmapRowBytes - target.rowBytes : 0;
+}
+
+// Validates caller memory against decoded layout
+//  : Stride 0 means tightly packed rows.
+//  : Formats without regular rows(NV12) are written as packed planes.
+inline dseed::error_t __prepare_decode_target (dseed::color::pixelformat format, const dseed::size3i& size,
+	void* pixels, size_t stride, size_t length, __decode_target& target) noexcept
+{
+	if (pixels == nullptr || size.width <= 0 || size.height <= 0 || size.depth <= 0)
+		return dseed::error_invalid_args;
+
+	const size_t bitmapRowBytes = dseed::color::calc_bitmap_plane_size (format, dseed::size2i (size.width, 1));
+	const size_t planeBytes = dseed::color::calc_bitmap_plane_size (format, dseed::size2i (size.width, size.height));
+	if (bitmapRowBytes == 0 || planeBytes == 0)
+		return dseed::error_not_support;
+
+	size_t rowBytes = __packed_row_bytes (format, size.width);
+	size_t rows = planeBytes / bitmapRowBytes;
+	if (planeBytes % bitmapRowBytes != 0)
+	{
+		rowBytes = planeBytes;
+		rows = 1;
+		stride = 0;
+	}
+
+	target.pixels = (uint8_t*)pixels;
+	target.rowBytes = rowBytes;
+	target.stride = stride == 0 ? rowBytes : stride;
+	target.rows = rows;
+	target.depth = size.depth;
+
+	if (target.stride < rowBytes)
+		return dseed::error_invalid_args;
+	if (length < (target.rows * target.depth - 1) * target.stride + rowBytes)
+		return dseed::error_out_of_range;
+
+	return dseed::error_good;
+}
+
+// Reads raw rows from stream
+//  : Packed target is read at once, otherwise row by row.
+//  : Rows of bottom-up images(DIB, TGA) are stored in reverse order;
+//    padding is bytes skipped after each row in stream.
+inline dseed::error_t __read_decode_target (dseed::io::stream* stream, const __decode_target& target,
+	bool bottomUp = false, size_t padding = 0) noexcept
+{
+	if (target.packed () && !bottomUp && padding == 0)
+	{
+		const size_t total = target.rowBytes * target.rows * target.depth;
+		return stream->read (target.pixels, total) == total ? dseed::error_good : dseed::error_io;
+	}
+
+	for (size_t z = 0; z < target.depth; ++z)
+	{
+		for (size_t y = 0; y < target.rows; ++y)
+		{
+			uint8_t* row = target.row (bottomUp ? target.rows - y - 1 : y, z);
+			if (stream->read (row, target.rowBytes) != target.rowBytes)
+				return dseed::error_io;
+			if (padding > 0 && !stream->seek (dseed::io::seekorigin::current, padding))
+				return dseed::error_io;
+		}
+	}
+
+	return dseed::error_good;
+}
+
+// Locks bitmap as decode target with its own row stride
+template<class TDecodeFunc>
+inline dseed::error_t __decode_into_bitmap (dseed::bitmaps::bitmap* bitmap, TDecodeFunc&& decode) noexcept
+{
+	const auto size = bitmap->size ();
+	const auto format = bitmap->format ();
+
+	void* ptr;
+	if (dseed::failed (bitmap->lock (&ptr)))
+		return dseed::error_fail;
+
+	__decode_target target;
+	auto err = __prepare_decode_target (format, size, ptr, dseed::color::calc_bitmap_stride (format, size.width),
+		dseed::color::calc_bitmap_total_size (format, size), target);
+	if (dseed::succeeded (err))
+		err = decode (target);
+
+	bitmap->unlock ();
+	return err;
+}
+
+// Makes bitmap referencing pixels at offset of blob stream(mapped file, shared blob)
+//  : Returns error_not_support if stream is not blob stream, then caller reads pixels as usual.
+inline dseed::error_t __reference_blob_bitmap (dseed::io::stream* stream, size_t offset, dseed::bitmaps::bitmaptype type,
+	const dseed::size3i& size, dseed::color::pixelformat format, dseed::bitmaps::bitmap** bitmap) noexcept
+{
+	auto blobStream = dynamic_cast<dseed::io::blobstream*> (stream);
+	if (blobStream == nullptr)
+		return dseed::error_not_support;
+
+	dseed::autoref<dseed::blob> blob;
+	if (auto err = blobStream->blob (&blob); dseed::failed (err))
+		return err;
+
+	return dseed::bitmaps::create_bitmap (blob, offset, type, size, format, nullptr, bitmap);
+}
+
+#endif
@@ -0,0 +1,350 @@
+#ifndef __DSEED_KTX2_HELPER_HXX__
+#define __DSEED_KTX2_HELPER_HXX__
+
+#include <vector>
+#include <cstring>
+
+#if defined(USE_ZLIB)
+#	include <zlib.h>
+#endif
+#if defined(USE_ZSTD)
+#	include <zstd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// KTX 2.0 Container
+//  : Mip levels are stored from smallest to largest, and level index at head of file
+//    gives offset and length of each level, so one level is read without touching others.
+//  : Each level can be supercompressed by itself(zstd or zlib), BasisLZ is not supported.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+struct KTX2Header
+{
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct KTX2LevelIndex
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+const uint8_t KTX2FileIdentifier[12] = {
+	0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+#define KTX2_SUPERCOMPRESSION_NONE					0
+#define KTX2_SUPERCOMPRESSION_BASISLZ				1
+#define KTX2_SUPERCOMPRESSION_ZSTD					2
+#define KTX2_SUPERCOMPRESSION_ZLIB					3
+
+#define KHR_DF_MODEL_RGBSDA							1
+#define KHR_DF_MODEL_BC1A							128
+#define KHR_DF_MODEL_BC2							129
+#define KHR_DF_MODEL_BC3							130
+#define KHR_DF_MODEL_BC4							131
+#define KHR_DF_MODEL_BC5							132
+#define KHR_DF_MODEL_BC6H							133
+#define KHR_DF_MODEL_BC7							134
+#define KHR_DF_MODEL_ETC1							160
+#define KHR_DF_MODEL_ETC2							161
+#define KHR_DF_MODEL_ASTC							162
+#define KHR_DF_MODEL_PVRTC							164
+#define KHR_DF_MODEL_PVRTC2							165
+
+#define KHR_DF_PRIMARIES_BT709						1
+#define KHR_DF_TRANSFER_LINEAR						1
+
+#define KHR_DF_SAMPLE_DATATYPE_SIGNED				0x40
+#define KHR_DF_SAMPLE_DATATYPE_FLOAT				0x80
+
+// Pixel format and Vulkan format pair with what Data Format Descriptor needs
+//  : Samples are (channel | qualifiers, bit offset, bit length) in a texel block.
+struct __ktx2_format
+{
+	dseed::color::pixelformat format;
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint8_t colorModel;
+	uint8_t blockWidth, blockHeight;
+	uint8_t bytesPerBlock;
+	uint8_t sampleCount;
+	struct { uint8_t channel; uint16_t bitOffset; uint8_t bitLength; } samples[4];
+};
+
+#define KTX2_UNORM8(f, vk, s)						{ dseed::color::pixelformat::f, vk, 1, KHR_DF_MODEL_RGBSDA, 1, 1, s, s,
+#define KTX2_BLOCK(f, vk, m, w, h, b, n)			{ dseed::color::pixelformat::f, vk, 1, m, w, h, b, n,
+const __ktx2_format KTX2Formats[] = {
+	KTX2_UNORM8 (r8, 9, 1) { { 0, 0, 8 } } },
+	KTX2_UNORM8 (rgb8, 23, 3) { { 0, 0, 8 }, { 1, 8, 8 }, { 2, 16, 8 } } },
+	KTX2_UNORM8 (bgr8, 30, 3) { { 2, 0, 8 }, { 1, 8, 8 }, { 0, 16, 8 } } },
+	KTX2_UNORM8 (rgba8, 37, 4) { { 0, 0, 8 }, { 1, 8, 8 }, { 2, 16, 8 }, { 15, 24, 8 } } },
+	KTX2_UNORM8 (bgra8, 44, 4) { { 2, 0, 8 }, { 1, 8, 8 }, { 0, 16, 8 }, { 15, 24, 8 } } },
+	{ dseed::color::pixelformat::bgr565, 4, 2, KHR_DF_MODEL_RGBSDA, 1, 1, 2, 3, { { 2, 0, 5 }, { 1, 5, 6 }, { 0, 11, 5 } } },
+	{ dseed::color::pixelformat::bgra4, 1000340000, 2, KHR_DF_MODEL_RGBSDA, 1, 1, 2, 4, { { 2, 0, 4 }, { 1, 4, 4 }, { 0, 8, 4 }, { 15, 12, 4 } } },
+	{ dseed::color::pixelformat::rf, 100, 4, KHR_DF_MODEL_RGBSDA, 1, 1, 4, 1,
+		{ { 0 | KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED, 0, 32 } } },
+	{ dseed::color::pixelformat::rgbaf, 109, 4, KHR_DF_MODEL_RGBSDA, 1, 1, 16, 4, {
+		{ 0 | KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED, 0, 32 },
+		{ 1 | KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED, 32, 32 },
+		{ 2 | KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED, 64, 32 },
+		{ 15 | KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED, 96, 32 } } },
+	{ dseed::color::pixelformat::depth16, 124, 2, KHR_DF_MODEL_RGBSDA, 1, 1, 2, 1, { { 14, 0, 16 } } },
+
+	KTX2_BLOCK (bc1, 133, KHR_DF_MODEL_BC1A, 4, 4, 8, 1) { { 1, 0, 64 } } },
+	KTX2_BLOCK (bc2, 135, KHR_DF_MODEL_BC2, 4, 4, 16, 2) { { 15, 0, 64 }, { 0, 64, 64 } } },
+	KTX2_BLOCK (bc3, 137, KHR_DF_MODEL_BC3, 4, 4, 16, 2) { { 15, 0, 64 }, { 0, 64, 64 } } },
+	KTX2_BLOCK (bc4, 139, KHR_DF_MODEL_BC4, 4, 4, 8, 1) { { 0, 0, 64 } } },
+	KTX2_BLOCK (bc5, 141, KHR_DF_MODEL_BC5, 4, 4, 16, 2) { { 0, 0, 64 }, { 1, 64, 64 } } },
+	KTX2_BLOCK (bc6, 144, KHR_DF_MODEL_BC6H, 4, 4, 16, 1) { { 0 | KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED, 0, 128 } } },
+	KTX2_BLOCK (bc7, 145, KHR_DF_MODEL_BC7, 4, 4, 16, 1) { { 0, 0, 128 } } },
+
+	// ETC1 is subset of ETC2, so it is stored as ETC2 RGB with same descriptor and read as ETC2
+	KTX2_BLOCK (etc2, 147, KHR_DF_MODEL_ETC2, 4, 4, 8, 1) { { 2, 0, 64 } } },
+	KTX2_BLOCK (etc1, 147, KHR_DF_MODEL_ETC2, 4, 4, 8, 1) { { 2, 0, 64 } } },
+	KTX2_BLOCK (etc2a, 151, KHR_DF_MODEL_ETC2, 4, 4, 16, 2) { { 15, 0, 64 }, { 2, 64, 64 } } },
+
+	KTX2_BLOCK (astc4x4, 157, KHR_DF_MODEL_ASTC, 4, 4, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc5x4, 159, KHR_DF_MODEL_ASTC, 5, 4, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc5x5, 161, KHR_DF_MODEL_ASTC, 5, 5, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc6x5, 163, KHR_DF_MODEL_ASTC, 6, 5, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc6x6, 165, KHR_DF_MODEL_ASTC, 6, 6, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc8x5, 167, KHR_DF_MODEL_ASTC, 8, 5, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc8x6, 169, KHR_DF_MODEL_ASTC, 8, 6, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc8x8, 171, KHR_DF_MODEL_ASTC, 8, 8, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc10x5, 173, KHR_DF_MODEL_ASTC, 10, 5, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc10x6, 175, KHR_DF_MODEL_ASTC, 10, 6, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc10x8, 177, KHR_DF_MODEL_ASTC, 10, 8, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc10x10, 179, KHR_DF_MODEL_ASTC, 10, 10, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc12x10, 181, KHR_DF_MODEL_ASTC, 12, 10, 16, 1) { { 0, 0, 128 } } },
+	KTX2_BLOCK (astc12x12, 183, KHR_DF_MODEL_ASTC, 12, 12, 16, 1) { { 0, 0, 128 } } },
+
+	KTX2_BLOCK (pvrtc_2abpp, 1000054000, KHR_DF_MODEL_PVRTC, 8, 4, 8, 1) { { 0, 0, 64 } } },
+	KTX2_BLOCK (pvrtc_2bpp, 1000054000, KHR_DF_MODEL_PVRTC, 8, 4, 8, 1) { { 0, 0, 64 } } },
+	KTX2_BLOCK (pvrtc_4abpp, 1000054001, KHR_DF_MODEL_PVRTC, 4, 4, 8, 1) { { 0, 0, 64 } } },
+	KTX2_BLOCK (pvrtc_4bpp, 1000054001, KHR_DF_MODEL_PVRTC, 4, 4, 8, 1) { { 0, 0, 64 } } },
+	KTX2_BLOCK (pvrtc2_2bpp, 1000054002, KHR_DF_MODEL_PVRTC2, 8, 4, 8, 1) { { 0, 0, 64 } } },
+	KTX2_BLOCK (pvrtc2_4bpp, 1000054003, KHR_DF_MODEL_PVRTC2, 4, 4, 8, 1) { { 0, 0, 64 } } },
+};
+#undef KTX2_UNORM8
+#undef KTX2_BLOCK
+
+// Finds format by Vulkan format
+//  : sRGB variants are read as same pixel format, dseed does not tell them apart.
+//  : Unsigned BC6H is not supported, bc6 of dseed is signed.
+inline const __ktx2_format* __ktx2_find_format (uint32_t vkFormat) noexcept
+{
+	switch (vkFormat)
+	{
+	case 15: vkFormat = 9; break;
+	case 29: vkFormat = 23; break;
+	case 36: vkFormat = 30; break;
+	case 43: vkFormat = 37; break;
+	case 50: vkFormat = 44; break;
+	case 131: case 132: case 134: vkFormat = 133; break;
+	case 143: return nullptr;
+	case 136: case 138: case 146: case 148: case 152: --vkFormat; break;
+	case 1000054004: case 1000054005: case 1000054006: case 1000054007: vkFormat -= 4; break;
+	default:
+		if (vkFormat >= 157 && vkFormat <= 184 && (vkFormat % 2) == 0)
+			--vkFormat;
+		break;
+	}
+
+	for (const auto& f : KTX2Formats)
+		if (f.vkFormat == vkFormat)
+			return &f;
+	return nullptr;
+}
+
+inline const __ktx2_format* __ktx2_find_format (dseed::color::pixelformat format) noexcept
+{
+	for (const auto& f : KTX2Formats)
+		if (f.format == format)
+			return &f;
+	return nullptr;
+}
+
+// Size of mip level
+//  : Each level is floor of half of upper level as Vulkan, at least 1.
+//  : Layers and faces are not halved, only z-slices of volume texture are.
+inline dseed::size3i __ktx2_level_size (const dseed::size3i& size, size_t level, bool volume) noexcept
+{
+	return dseed::size3i (
+		dseed::maximum (size.width >> level, 1),
+		dseed::maximum (size.height >> level, 1),
+		volume ? dseed::maximum (size.depth >> level, 1) : size.depth
+	);
+}
+
+// Bytes of one row in level data
+//  : KTX2 rows are tightly packed, but dseed pads rgb8/bgr8 bitmap rows to 4 bytes.
+//  : Block rows are same in both.
+inline size_t __ktx2_row_bytes (const __ktx2_format& format, size_t width, size_t bitmapRowBytes) noexcept
+{
+	return (format.blockWidth == 1 && format.blockHeight == 1) ? width * format.bytesPerBlock : bitmapRowBytes;
+}
+
+// Bytes of mip level in level data before supercompression
+inline size_t __ktx2_level_length (const __ktx2_format& format, const dseed::size3i& size) noexcept
+{
+	const size_t bitmapRowBytes = dseed::color::calc_bitmap_plane_size (format.format, dseed::size2i (size.width, 1));
+	const size_t rowBytes = __ktx2_row_bytes (format, size.width, bitmapRowBytes);
+	if (rowBytes == bitmapRowBytes)
+		return dseed::color::calc_bitmap_total_size (format.format, size);
+	return rowBytes * size.height * size.depth;
+}
+
+// Makes tightly packed level data from bitmap pixels
+//  : Returns pixels itself if bitmap rows are not padded, otherwise rows are copied into packed.
+inline const uint8_t* __ktx2_pack_level (const __ktx2_format& format, const dseed::size3i& size, const uint8_t* pixels,
+	std::vector<uint8_t>& packed)
+{
+	const size_t bitmapRowBytes = dseed::color::calc_bitmap_plane_size (format.format, dseed::size2i (size.width, 1));
+	const size_t rowBytes = __ktx2_row_bytes (format, size.width, bitmapRowBytes);
+	if (rowBytes == bitmapRowBytes)
+		return pixels;
+
+	const size_t rows = (size_t)size.height * size.depth;
+	packed.resize (rowBytes * rows);
+	for (size_t y = 0; y < rows; ++y)
+		memcpy (packed.data () + y * rowBytes, pixels + y * bitmapRowBytes, rowBytes);
+	return packed.data ();
+}
+
+// Makes Data Format Descriptor with one basic descriptor block
+inline void __ktx2_make_dfd (const __ktx2_format& format, std::vector<uint32_t>& dfd)
+{
+	const uint32_t blockSize = 24 + 16 * format.sampleCount;
+	dfd.clear ();
+	dfd.push_back (4 + blockSize);
+	dfd.push_back (0);
+	dfd.push_back (2 | (blockSize << 16));
+	dfd.push_back (format.colorModel | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16));
+	dfd.push_back ((uint32_t)(format.blockWidth - 1) | ((uint32_t)(format.blockHeight - 1) << 8));
+	dfd.push_back (format.bytesPerBlock);
+	dfd.push_back (0);
+
+	for (int i = 0; i < format.sampleCount; ++i)
+	{
+		const auto& sample = format.samples[i];
+		const bool isFloat = (sample.channel & KHR_DF_SAMPLE_DATATYPE_FLOAT) != 0;
+		const bool compressed = format.colorModel != KHR_DF_MODEL_RGBSDA;
+		dfd.push_back (sample.bitOffset | ((uint32_t)(sample.bitLength - 1) << 16) | ((uint32_t)sample.channel << 24));
+		dfd.push_back (0);
+		if (isFloat)
+		{
+			// -1.0f ~ 1.0f
+			dfd.push_back (0xBF800000);
+			dfd.push_back (0x3F800000);
+		}
+		else
+		{
+			dfd.push_back (0);
+			dfd.push_back (compressed || sample.bitLength >= 32 ? 0xFFFFFFFF : (1u << sample.bitLength) - 1);
+		}
+	}
+}
+
+// Level Supercompression
+inline bool __ktx2_supercompress (uint32_t scheme, const uint8_t* src, size_t length, int level, std::vector<uint8_t>& out) noexcept
+{
+	try
+	{
+		switch (scheme)
+		{
+		case KTX2_SUPERCOMPRESSION_NONE:
+			out.assign (src, src + length);
+			return true;
+#if defined(USE_ZSTD)
+		case KTX2_SUPERCOMPRESSION_ZSTD:
+		{
+			out.resize (ZSTD_compressBound (length));
+			const size_t written = ZSTD_compress (out.data (), out.size (), src, length,
+				level < 0 ? ZSTD_CLEVEL_DEFAULT : dseed::minimum (level, ZSTD_maxCLevel ()));
+			if (ZSTD_isError (written))
+				return false;
+			out.resize (written);
+			return true;
+		}
+#endif
+#if defined(USE_ZLIB)
+		case KTX2_SUPERCOMPRESSION_ZLIB:
+		{
+			uLongf written = compressBound ((uLong)length);
+			out.resize (written);
+			if (compress2 (out.data (), &written, src, (uLong)length, level < 0 ? Z_DEFAULT_COMPRESSION : dseed::minimum (level, 9)) != Z_OK)
+				return false;
+			out.resize (written);
+			return true;
+		}
+#endif
+		default:
+			return false;
+		}
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
+
+inline bool __ktx2_decompress (uint32_t scheme, const uint8_t* src, size_t length, uint8_t* dest, size_t destLength) noexcept
+{
+	switch (scheme)
+	{
+	case KTX2_SUPERCOMPRESSION_NONE:
+		if (length != destLength)
+			return false;
+		memcpy (dest, src, length);
+		return true;
+#if defined(USE_ZSTD)
+	case KTX2_SUPERCOMPRESSION_ZSTD:
+		return ZSTD_decompress (dest, destLength, src, length) == destLength;
+#endif
+#if defined(USE_ZLIB)
+	case KTX2_SUPERCOMPRESSION_ZLIB:
+	{
+		uLongf written = (uLongf)destLength;
+		return uncompress (dest, &written, src, (uLong)length) == Z_OK && written == destLength;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+inline bool __ktx2_supercompression_supported (uint32_t scheme) noexcept
+{
+	switch (scheme)
+	{
+	case KTX2_SUPERCOMPRESSION_NONE: return true;
+#if defined(USE_ZSTD)
+	case KTX2_SUPERCOMPRESSION_ZSTD: return true;
+#endif
+#if defined(USE_ZLIB)
+	case KTX2_SUPERCOMPRESSION_ZLIB: return true;
+#endif
+	default: return false;
+	}
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __DSEED_QOI_HELPER_HXX__
+#define __DSEED_QOI_HELPER_HXX__
+
+#if ARCH_X86SET && !DONT_USE_SSE
+#	include <immintrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Quite OK Image Format
+//  : Byte-oriented lossless format; every chunk is decided from previous pixel
+//    and 64-entry hash table of recently seen pixels, so both directions are single pass.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t QOI_HEADER_SIZE = 14;
+constexpr uint8_t QOI_END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+constexpr uint32_t QOI_MAXIMUM_PIXELS = 400000000;
+
+constexpr uint8_t QOI_OP_INDEX = 0x00;
+constexpr uint8_t QOI_OP_DIFF = 0x40;
+constexpr uint8_t QOI_OP_LUMA = 0x80;
+constexpr uint8_t QOI_OP_RUN = 0xc0;
+constexpr uint8_t QOI_OP_RGB = 0xfe;
+constexpr uint8_t QOI_OP_RGBA = 0xff;
+constexpr uint8_t QOI_MASK_2 = 0xc0;
+constexpr int QOI_MAXIMUM_RUN = 62;
+
+struct __qoi_header
+{
+	uint32_t width, height;
+	uint8_t channels;
+	uint8_t colorspace;
+};
+
+struct __qoi_rgba
+{
+	uint8_t r, g, b, a;
+
+	inline bool operator== (const __qoi_rgba& other) const noexcept
+	{
+		return r == other.r && g == other.g && b == other.b && a == other.a;
+	}
+	inline bool operator!= (const __qoi_rgba& other) const noexcept { return !(*this == other); }
+};
+
+inline int __qoi_hash (const __qoi_rgba& px) noexcept
+{
+	return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+}
+
+inline uint32_t __qoi_read_be32 (const uint8_t* bytes) noexcept
+{
+	return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+inline void __qoi_write_be32 (uint8_t* bytes, uint32_t value) noexcept
+{
+	bytes[0] = (uint8_t)(value >> 24);
+	bytes[1] = (uint8_t)(value >> 16);
+	bytes[2] = (uint8_t)(value >> 8);
+	bytes[3] = (uint8_t)value;
+}
+
+inline bool __qoi_parse_header (const uint8_t (&bytes)[QOI_HEADER_SIZE], __qoi_header& header) noexcept
+{
+	if (memcmp (bytes, "qoif", 4) != 0)
+		return false;
+
+	header.width = __qoi_read_be32 (bytes + 4);
+	header.height = __qoi_read_be32 (bytes + 8);
+	header.channels = bytes[12];
+	header.colorspace = bytes[13];
+
+	if (header.width == 0 || header.height == 0 || header.width > INT32_MAX || header.height > INT32_MAX
+		|| header.height >= QOI_MAXIMUM_PIXELS / header.width
+		|| header.channels < 3 || header.channels > 4 || header.colorspace > 1)
+		return false;
+
+	return true;
+}
+
+inline void __qoi_make_header (const __qoi_header& header, uint8_t (&bytes)[QOI_HEADER_SIZE]) noexcept
+{
+	memcpy (bytes, "qoif", 4);
+	__qoi_write_be32 (bytes + 4, header.width);
+	__qoi_write_be32 (bytes + 8, header.height);
+	bytes[12] = header.channels;
+	bytes[13] = header.colorspace;
+}
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef __DSEED_SIGNATURE_HELPER_HXX__
+#define __DSEED_SIGNATURE_HELPER_HXX__
+
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Decoder Signature Sniffing
+//  : Head of stream is read once, then only decoders with matched signature are tried.
+//  : Decoders without signature are tried after all matched decoders failed.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+struct __signature
+{
+	std::vector<uint8_t> magic;
+	std::vector<uint8_t> mask;
+
+	__signature (std::initializer_list<uint8_t> magic, std::initializer_list<uint8_t> mask = {})
+		: magic (magic), mask (mask)
+	{ }
+	__signature (const dseed::io::stream_signature& signature)
+		: magic ((const uint8_t*)signature.magic, (const uint8_t*)signature.magic + signature.length)
+	{
+		if (signature.mask != nullptr)
+			mask.assign ((const uint8_t*)signature.mask, (const uint8_t*)signature.mask + signature.length);
+	}
+
+	bool match (const uint8_t* head, size_t headLength) const noexcept
+	{
+		if (magic.size () > headLength)
+			return false;
+		for (size_t i = 0; i < magic.size (); ++i)
+		{
+			const uint8_t m = mask.empty () ? 0xff : mask[i];
+			if ((head[i] & m) != (magic[i] & m))
+				return false;
+		}
+		return true;
+	}
+};
+
+using __signatures = std::vector<__signature>;
+
+inline bool __copy_signatures (const dseed::io::stream_signature* signatures, size_t count, __signatures& dest) noexcept
+{
+	if (count > 0 && signatures == nullptr)
+		return false;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (signatures[i].magic == nullptr || signatures[i].length == 0
+			|| signatures[i].length > dseed::io::maximum_signature_length)
+			return false;
+	}
+
+	try
+	{
+		dest.assign (signatures, signatures + count);
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+// Reads head of stream for sniffing, then rewinds stream
+inline size_t __read_signature_head (dseed::io::stream* stream, uint8_t (&head)[dseed::io::maximum_signature_length]) noexcept
+{
+	stream->seek (dseed::io::seekorigin::begin, 0);
+	size_t total = 0;
+	while (total < dseed::io::maximum_signature_length)
+	{
+		auto read = stream->read (head + total, dseed::io::maximum_signature_length - total);
+		if (read == 0)
+			break;
+		total += read;
+	}
+	stream->seek (dseed::io::seekorigin::begin, 0);
+	return total;
+}
+
+// Orders decoder indices to try
+//  : Matched decoders first, longer(more specific) match first; then decoders without signature.
+template<class TSignaturesGetter>
+inline void __sniff_decoders (const uint8_t* head, size_t headLength, int32_t decoderCount,
+	TSignaturesGetter&& signaturesOf, std::vector<int32_t>& order)
+{
+	std::vector<std::pair<size_t, int32_t>> matched;
+	std::vector<int32_t> unsigned_;
+	for (int32_t i = 0; i < decoderCount; ++i)
+	{
+		const __signatures& signatures = signaturesOf (i);
+		if (signatures.empty ())
+		{
+			unsigned_.push_back (i);
+			continue;
+		}
+
+		size_t longest = 0;
+		for (const auto& signature : signatures)
+			if (signature.magic.size () > longest && signature.match (head, headLength))
+				longest = signature.magic.size ();
+		if (longest > 0)
+			matched.push_back (std::make_pair (longest, i));
+	}
+
+	std::stable_sort (matched.begin (), matched.end (), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	order.clear ();
+	for (const auto& m : matched)
+		order.push_back (m.second);
+	order.insert (order.end (), unsigned_.begin (), unsigned_.end ());
+}
+
+#endif
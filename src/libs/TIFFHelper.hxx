@@ -0,0 +1,302 @@
+#ifndef __DSEED_TIFF_HELPER_HXX__
+#define __DSEED_TIFF_HELPER_HXX__
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// TIFF Segment Codecs
+//  : libtiff keeps codec state in TIFF handle, so one handle cannot compress or decompress
+//    tiles(strips) on several threads. These work on one raw segment(tile or strip)
+//    without handle, so segments are processed on worker threads and only raw read/write
+//    goes through libtiff.
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+constexpr int TIFF_LZW_CODE_CLEAR = 256;
+constexpr int TIFF_LZW_CODE_EOI = 257;
+constexpr int TIFF_LZW_CODE_FIRST = 258;
+constexpr int TIFF_LZW_BITS_MIN = 9;
+constexpr int TIFF_LZW_BITS_MAX = 12;
+constexpr int TIFF_LZW_CODE_MAX = (1 << TIFF_LZW_BITS_MAX) - 1;
+constexpr size_t TIFF_LZW_HASH_SIZE = 8192;
+
+class __tiff_lzw_bit_writer
+{
+public:
+	__tiff_lzw_bit_writer (std::vector<uint8_t>& out) noexcept
+		: _out (out), _data (0), _bits (0)
+	{ }
+
+public:
+	inline void put (int code, int nbits)
+	{
+		_data = (_data << nbits) | (uint32_t)code;
+		_bits += nbits;
+		while (_bits >= 8)
+		{
+			_bits -= 8;
+			_out.push_back ((uint8_t)(_data >> _bits));
+		}
+	}
+	inline void flush ()
+	{
+		if (_bits > 0)
+			_out.push_back ((uint8_t)(_data << (8 - _bits)));
+		_bits = 0;
+	}
+
+private:
+	std::vector<uint8_t>& _out;
+	uint32_t _data;
+	int _bits;
+};
+
+// TIFF LZW Encoding
+//  : MSB-first codes with early change, same stream as libtiff writes except adaptive table reset.
+inline bool __tiff_lzw_encode (const uint8_t* src, size_t length, std::vector<uint8_t>& out) noexcept
+{
+	try
+	{
+		out.clear ();
+		out.reserve (length / 2 + 16);
+
+		// Key is (prefix << 8 | byte) + 1, 0 is empty slot
+		std::vector<uint32_t> keys (TIFF_LZW_HASH_SIZE);
+		std::vector<uint16_t> codes (TIFF_LZW_HASH_SIZE);
+
+		__tiff_lzw_bit_writer writer (out);
+		int nbits = TIFF_LZW_BITS_MIN, maxcode = (1 << TIFF_LZW_BITS_MIN) - 1;
+		int freeEntry = TIFF_LZW_CODE_FIRST;
+
+		writer.put (TIFF_LZW_CODE_CLEAR, nbits);
+		if (length == 0)
+		{
+			writer.put (TIFF_LZW_CODE_EOI, nbits);
+			writer.flush ();
+			return true;
+		}
+
+		int ent = src[0];
+		for (size_t i = 1; i < length; ++i)
+		{
+			const uint8_t c = src[i];
+			const uint32_t key = (((uint32_t)ent << 8) | c) + 1;
+			size_t slot = (key * 2654435761u) & (TIFF_LZW_HASH_SIZE - 1);
+			while (keys[slot] != 0 && keys[slot] != key)
+				slot = (slot + 1) & (TIFF_LZW_HASH_SIZE - 1);
+
+			if (keys[slot] == key)
+			{
+				ent = codes[slot];
+				continue;
+			}
+
+			writer.put (ent, nbits);
+			ent = c;
+			keys[slot] = key;
+			codes[slot] = (uint16_t)freeEntry++;
+
+			if (freeEntry == TIFF_LZW_CODE_MAX - 1)
+			{
+				// Table is full, reset it
+				writer.put (TIFF_LZW_CODE_CLEAR, nbits);
+				std::fill (keys.begin (), keys.end (), 0);
+				freeEntry = TIFF_LZW_CODE_FIRST;
+				nbits = TIFF_LZW_BITS_MIN;
+				maxcode = (1 << TIFF_LZW_BITS_MIN) - 1;
+			}
+			else if (freeEntry > maxcode)
+			{
+				++nbits;
+				maxcode = (1 << nbits) - 1;
+			}
+		}
+
+		// Decoder adds entry for last code too, so code width can change before EOI
+		writer.put (ent, nbits);
+		++freeEntry;
+		if (freeEntry == TIFF_LZW_CODE_MAX - 1)
+		{
+			writer.put (TIFF_LZW_CODE_CLEAR, nbits);
+			nbits = TIFF_LZW_BITS_MIN;
+		}
+		else if (freeEntry > maxcode)
+			++nbits;
+
+		writer.put (TIFF_LZW_CODE_EOI, nbits);
+		writer.flush ();
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+// TIFF LZW Decoding
+//  : Old-style(LSB-first) streams are not supported; returns false for them.
+//  : Returns false if stream is corrupted or ends before destination is filled.
+inline bool __tiff_lzw_decode (const uint8_t* src, size_t length, uint8_t* dest, size_t destLength) noexcept
+{
+	if (length >= 2 && src[0] == 0 && (src[1] & 0x1))
+		return false;
+
+	uint16_t prefix[TIFF_LZW_CODE_MAX + 1];
+	uint8_t suffix[TIFF_LZW_CODE_MAX + 1], first[TIFF_LZW_CODE_MAX + 1];
+	uint16_t lengths[TIFF_LZW_CODE_MAX + 1];
+	for (int i = 0; i < 256; ++i)
+	{
+		prefix[i] = 0;
+		suffix[i] = first[i] = (uint8_t)i;
+		lengths[i] = 1;
+	}
+
+	size_t p = 0, written = 0;
+	uint32_t data = 0;
+	int bits = 0, nbits = TIFF_LZW_BITS_MIN;
+	int freeEntry = TIFF_LZW_CODE_FIRST, oldcode = -1;
+
+	auto nextCode = [&]() -> int
+	{
+		while (bits < nbits)
+		{
+			if (p >= length)
+				return TIFF_LZW_CODE_EOI;
+			data = (data << 8) | src[p++];
+			bits += 8;
+		}
+		bits -= nbits;
+		return (int)((data >> bits) & ((1u << nbits) - 1));
+	};
+	auto output = [&](int code) -> bool
+	{
+		const size_t len = lengths[code];
+		if (written + len > destLength)
+			return false;
+		uint8_t* out = dest + written + len;
+		for (int c = code; out != dest + written; c = prefix[c])
+			*--out = suffix[c];
+		written += len;
+		return true;
+	};
+
+	while (written < destLength)
+	{
+		int code = nextCode ();
+		if (code == TIFF_LZW_CODE_EOI)
+			break;
+
+		if (code == TIFF_LZW_CODE_CLEAR)
+		{
+			nbits = TIFF_LZW_BITS_MIN;
+			freeEntry = TIFF_LZW_CODE_FIRST;
+			code = nextCode ();
+			if (code == TIFF_LZW_CODE_EOI)
+				break;
+			if (code > 255)
+				return false;
+			dest[written++] = (uint8_t)code;
+			oldcode = code;
+			continue;
+		}
+
+		if (oldcode == -1)
+		{
+			if (code > 255)
+				return false;
+			dest[written++] = (uint8_t)code;
+			oldcode = code;
+			continue;
+		}
+
+		if (code > freeEntry || freeEntry > TIFF_LZW_CODE_MAX)
+			return false;
+
+		// KwKwK case refers entry being added now
+		const uint8_t head = code < freeEntry ? first[code] : first[oldcode];
+		prefix[freeEntry] = (uint16_t)oldcode;
+		suffix[freeEntry] = head;
+		first[freeEntry] = first[oldcode];
+		lengths[freeEntry] = lengths[oldcode] + 1;
+		++freeEntry;
+
+		if (!output (code))
+			return false;
+
+		if (freeEntry >= (1 << nbits) - 1 && nbits < TIFF_LZW_BITS_MAX)
+			++nbits;
+		oldcode = code;
+	}
+
+	return written == destLength;
+}
+
+// TIFF Deflate(Adobe Deflate) Segment
+//  : zlib stream, same as libtiff ZIP codec writes.
+inline bool __tiff_deflate (const uint8_t* src, size_t length, int level, std::vector<uint8_t>& out) noexcept
+{
+	try
+	{
+		uLongf outLength = compressBound ((uLong)length);
+		out.resize (outLength);
+		if (compress2 (out.data (), &outLength, src, (uLong)length, level < 0 ? Z_DEFAULT_COMPRESSION : dseed::minimum (level, 9)) != Z_OK)
+			return false;
+		out.resize (outLength);
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+inline bool __tiff_inflate (const uint8_t* src, size_t length, uint8_t* dest, size_t destLength) noexcept
+{
+	z_stream zs = {};
+	if (inflateInit (&zs) != Z_OK)
+		return false;
+
+	zs.next_in = const_cast<Bytef*>(src);
+	zs.avail_in = (uInt)length;
+	zs.next_out = dest;
+	zs.avail_out = (uInt)destLength;
+	const int ret = inflate (&zs, Z_FINISH);
+	inflateEnd (&zs);
+
+	// Some writers pad segments after stream end
+	return (ret == Z_STREAM_END || ret == Z_BUF_ERROR || ret == Z_OK) && zs.avail_out == 0;
+}
+
+// Horizontal Differencing Predictor(2) for 8-bit samples
+inline void __tiff_horizontal_diff8 (uint8_t* row, size_t length, size_t samples) noexcept
+{
+	for (size_t i = length; i > samples; --i)
+		row[i - 1] -= row[i - 1 - samples];
+}
+
+inline void __tiff_horizontal_acc8 (uint8_t* row, size_t length, size_t samples) noexcept
+{
+	for (size_t i = samples; i < length; ++i)
+		row[i] += row[i - samples];
+}
+
+// Floating Point Predictor(3)
+//  : Bytes of each sample are split to planes from most significant byte, then differenced.
+inline void __tiff_floating_point_diff (uint8_t* row, size_t length, size_t samples, size_t bytesPerSample, uint8_t* temp) noexcept
+{
+	const size_t count = length / bytesPerSample;
+	memcpy (temp, row, length);
+	for (size_t i = 0; i < count; ++i)
+	{
+		// Samples in memory are little-endian
+		for (size_t b = 0; b < bytesPerSample; ++b)
+			row[(bytesPerSample - b - 1) * count + i] = temp[bytesPerSample * i + b];
+	}
+	__tiff_horizontal_diff8 (row, length, samples);
+}
+
+#endif
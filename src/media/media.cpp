@@ -1,5 +1,7 @@
 #include <dseed.h>
 
+#include "../libs/SignatureHelper.hxx"
+
 constexpr int32_t MAXIMUM_MEDIA_DECODER_COUNT = 512;
 std::function<dseed::error_t (dseed::io::stream*, dseed::media::media_decoder**)> g_media_decoder_creator[MAXIMUM_MEDIA_DECODER_COUNT] =
 {
@@ -12,14 +14,46 @@ std::function<dseed::error_t (dseed::io::stream*, dseed::media::media_decoder**)
 
 	dseed::media::create_media_foundation_media_decoder,
 };
+__signatures g_media_decoder_signatures[MAXIMUM_MEDIA_DECODER_COUNT] =
+{
+	{ { { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E' }, { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF } } },
+	{ { { 'I', 'D', '3' } }, { { 0xFF, 0xE0 }, { 0xFF, 0xE0 } } },
+
+	// Ogg page with single segment has codec identification header at 28
+	{
+		{ { 'O', 'g', 'g', 'S', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 'v', 'o', 'r', 'b', 'i', 's' },
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } },
+		{ { 'O', 'g', 'g', 'S' } },
+	},
+	{
+		{ { 'O', 'g', 'g', 'S', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd' },
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } },
+		{ { 'O', 'g', 'g', 'S' } },
+	},
+	{ { { 'f', 'L', 'a', 'C' } } },
+
+	{ },
+};
 std::atomic<int32_t> g_media_decoder_creator_count = 6;
 
-dseed::error_t dseed::media::add_media_decoder (createmediadecoder_fn fn)
+dseed::error_t dseed::media::add_media_decoder (createmediadecoder_fn fn, const dseed::io::stream_signature* signatures, size_t signatureCount)
 {
 	if (fn == nullptr)
 		return dseed::error_invalid_args;
 
-	g_media_decoder_creator[++g_media_decoder_creator_count] = fn;
+	__signatures copied;
+	if (!__copy_signatures (signatures, signatureCount, copied))
+		return dseed::error_invalid_args;
+
+	auto index = g_media_decoder_creator_count++;
+	if (index >= MAXIMUM_MEDIA_DECODER_COUNT)
+	{
+		--g_media_decoder_creator_count;
+		return dseed::error_out_of_range;
+	}
+
+	g_media_decoder_creator[index] = fn;
+	g_media_decoder_signatures[index] = std::move (copied);
 	return dseed::error_good;
 }
 dseed::error_t dseed::media::detect_media_decoder (dseed::io::stream* stream, dseed::media::media_decoder** decoder)
@@ -27,9 +61,17 @@ dseed::error_t dseed::media::detect_media_decoder (dseed::io::stream* stream, ds
 	if (stream == nullptr || !stream->seekable () || decoder == nullptr)
 		return dseed::error_invalid_args;
 
-	for (int i = 0; i < g_media_decoder_creator_count; ++i)
+	uint8_t head[dseed::io::maximum_signature_length];
+	auto headLength = __read_signature_head (stream, head);
+
+	std::vector<int32_t> order;
+	__sniff_decoders (head, headLength, g_media_decoder_creator_count,
+		[](int32_t i) -> const __signatures& { return g_media_decoder_signatures[i]; }, order);
+
+	for (auto i : order)
 	{
 		stream->seek (dseed::io::seekorigin::begin, 0);
+		*decoder = nullptr;
 		auto err = g_media_decoder_creator[i] (stream, decoder);
 		if (dseed::succeeded (err))
 			return dseed::error_good;
@@ -37,6 +79,7 @@ dseed::error_t dseed::media::detect_media_decoder (dseed::io::stream* stream, ds
 		{
 			if (*decoder)
 				(*decoder)->release ();
+			*decoder = nullptr;
 		}
 	}
 
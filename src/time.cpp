@@ -36,7 +36,7 @@ dseed::timespan dseed::timespan::current_ticks () noexcept
 #else
 	struct timespec tspec;
 	clock_gettime (CLOCK_MONOTONIC, &tspec);
-	return timespan ((tspec.tv_sec * 1000000000LL) + tspec.tv_nsec);
+	return timespan ((tspec.tv_sec * TICKS_PER_SECOND) + tspec.tv_nsec / 100);
 #endif
 }
 